@@ -1,16 +1,305 @@
 
 // import 'dart:typed_data';
+import 'dart:ui' show Size;
 
 import 'package:flutter/services.dart';
 
 import 'desktop_screenshot_platform_interface.dart';
+import 'desktop_screenshot_types.dart';
+
+export 'desktop_screenshot_raw_frame.dart';
+export 'desktop_screenshot_types.dart';
 
 class DesktopScreenshot {
   Future<String?> getPlatformVersion() {
     return DesktopScreenshotPlatform.instance.getPlatformVersion();
   }
 
-  Future<Uint8List?> getScreenshot() async {
-    return DesktopScreenshotPlatform.instance.getScreenshot();
+  /// Captures all monitors as PNG. Any [redactions] are applied to the raw
+  /// pixels before encoding. With a [palette] mode other than
+  /// [PaletteMode.off], screens with few colors are written as much smaller
+  /// indexed-color PNGs.
+  Future<Uint8List?> getScreenshot(
+      {List<Redaction>? redactions, PaletteMode palette = PaletteMode.off}) async {
+    return DesktopScreenshotPlatform.instance
+        .getScreenshot(redactions: redactions, palette: palette);
+  }
+
+  /// Captures all monitors and encodes them to fit [maxBytes] and
+  /// [maxEncodeMs] (null: no limit). Format, compression level, palette
+  /// mode and downscaling are picked natively from trial encodes of a few
+  /// sampled tiles and the sizes and times of recent captures. A byte
+  /// limit the first pick misses is retried natively with cheaper
+  /// settings. The result reports what was chosen.
+  Future<BudgetedScreenshot?> getBudgetedScreenshot(
+      {int? maxBytes, int? maxEncodeMs}) {
+    return DesktopScreenshotPlatform.instance
+        .getBudgetedScreenshot(maxBytes: maxBytes, maxEncodeMs: maxEncodeMs);
+  }
+
+  /// Captures all monitors into a hybrid image: tiles of [tileSize] pixels
+  /// that hold text, UI or flat color are kept lossless in a PNG, tiles
+  /// that look like photos or video go into a JPEG of [quality] (1-100).
+  /// Mixed screens come out several times smaller than one PNG with the
+  /// text untouched. Use [decodeHybridImage] to turn the result back into
+  /// a PNG.
+  Future<HybridScreenshot?> getHybridScreenshot(
+      {int tileSize = 64, int quality = 80}) {
+    return DesktopScreenshotPlatform.instance
+        .getHybridScreenshot(tileSize: tileSize, quality: quality);
+  }
+
+  /// Composites the [HybridScreenshot.bytes] of [getHybridScreenshot]
+  /// into a PNG.
+  Future<Uint8List?> decodeHybridImage(Uint8List bytes) {
+    return DesktopScreenshotPlatform.instance.decodeHybridImage(bytes);
+  }
+
+  /// Captures the desktop and delivers the encoded image in chunks while it
+  /// is still being encoded, so uploading or writing can start before the
+  /// encode finishes. The stream ends with a [ScreenshotStreamDone] holding
+  /// the totals. Chunks are at least [chunkSize] bytes (64 KiB by default)
+  /// except for the last one. Only one stream can be active at a time.
+  Stream<ScreenshotStreamEvent> getScreenshotStream(
+      {ScreenshotFormat format = ScreenshotFormat.png, int? chunkSize}) {
+    return DesktopScreenshotPlatform.instance
+        .getScreenshotStream(format: format, chunkSize: chunkSize);
+  }
+
+  /// Captures the desktop and receives it over a binary message channel as
+  /// one buffer: a fixed header followed by the payload, with no codec
+  /// containers on either side. With no [format] the payload is the
+  /// unencoded BGRA pixels, which is the cheapest way to get full frames
+  /// into Dart; [ScreenFrame.bytes] is a view into the received message.
+  Future<ScreenFrame?> getFrame({ScreenshotFormat? format}) {
+    return DesktopScreenshotPlatform.instance.getFrame(format: format);
+  }
+
+  /// Captures several [regions] from a single grab. The result holds one
+  /// encoded image per region, in the same order; regions that fall
+  /// outside the desktop yield an empty list. Returns null if the grab or
+  /// any region's encode fails.
+  Future<List<Uint8List>?> getScreenshotRegions(List<ScreenRect> regions,
+      {ScreenshotFormat format = ScreenshotFormat.png}) {
+    return DesktopScreenshotPlatform.instance
+        .getScreenshotRegions(regions, format: format);
+  }
+
+  /// Grabs the desktop once and produces every output in [outputs] from
+  /// that single frame, e.g. a full-size PNG, a small JPEG thumbnail and a
+  /// fingerprint. Outputs of the same region share one crop and outputs of
+  /// the same size share one downscale; the encodes run concurrently. The
+  /// results come back in one response, in the order of [outputs].
+  Future<List<PipelineResult>?> capturePipeline(List<PipelineOutput> outputs) {
+    return DesktopScreenshotPlatform.instance.capturePipeline(outputs);
+  }
+
+  /// Grabs the desktop into a native buffer without encoding it. Use the
+  /// returned handle to crop, scale or encode later, and release it when
+  /// done. Unreleased handles are evicted least-recently-used first once
+  /// they exceed the limit set by [setHandleMemoryLimit].
+  Future<CaptureHandle?> captureHandle() async {
+    final id = await DesktopScreenshotPlatform.instance.captureHandle();
+    return id == null ? null : CaptureHandle._(id);
+  }
+
+  /// Searches the screen, or just [region], for [templatePng] and returns
+  /// up to [maxMatches] non-overlapping places scoring at least
+  /// [threshold], best first. Matching runs natively on the captured
+  /// pixels; only the coordinates come back.
+  Future<List<ScreenMatch>?> findOnScreen(Uint8List templatePng,
+      {double threshold = 0.9, ScreenRect? region, int maxMatches = 16}) {
+    return DesktopScreenshotPlatform.instance.findOnScreen(templatePng,
+        threshold: threshold, region: region, maxMatches: maxMatches);
+  }
+
+  /// Reads the colors under [points] as 0xAARRGGBB values (the packing of
+  /// Color.value), in the same order, with null for points off the
+  /// desktop. Only small areas around the points are grabbed, so this is
+  /// cheap enough to poll at a high rate.
+  Future<List<int?>?> samplePixels(List<ScreenPoint> points) {
+    return DesktopScreenshotPlatform.instance.samplePixels(points);
+  }
+
+  /// Computes color histograms, mean and variance of luminance and a
+  /// uniform-screen flag natively for one [monitor] (by index), a [region],
+  /// or the whole desktop. With both, [region] is relative to the monitor.
+  Future<ScreenStats?> getScreenStats({ScreenRect? region, int? monitor}) {
+    return DesktopScreenshotPlatform.instance
+        .getScreenStats(region: region, monitor: monitor);
+  }
+
+  /// Resizes the native worker pool to [threads] (0 = one per core) and
+  /// optionally pins each worker to its own core.
+  Future<void> configureThreadPool(
+      {int threads = 0, bool pinThreads = false}) {
+    return DesktopScreenshotPlatform.instance
+        .configureThreadPool(threads: threads, pinThreads: pinThreads);
+  }
+
+  /// Size, task and steal counters and queue depth of the worker pool.
+  Future<ThreadPoolStats?> getThreadPoolStats() {
+    return DesktopScreenshotPlatform.instance.getThreadPoolStats();
+  }
+
+  /// Chooses how full-desktop captures grab a multi-monitor desktop. In
+  /// [MonitorCaptureMode.parallel] every monitor is copied on its own
+  /// worker thread, so a grab takes about as long as the slowest monitor.
+  /// Linux supports it on X11 only.
+  Future<void> setMonitorCaptureMode(MonitorCaptureMode mode) {
+    return DesktopScreenshotPlatform.instance.setMonitorCaptureMode(mode);
+  }
+
+  /// Native bytes the plugin's captures hold right now and at most, in
+  /// total and per [MemoryStage], against the ceiling set with
+  /// [setMemoryLimit]. [resetPeaks] lowers the peaks to the current values
+  /// after reading them.
+  Future<MemoryStats?> getMemoryStats({bool resetPeaks = false}) {
+    return DesktopScreenshotPlatform.instance
+        .getMemoryStats(resetPeaks: resetPeaks);
+  }
+
+  /// Caps the native memory all captures of the process may hold at
+  /// [bytes]; 0 removes the cap. A capture that would not fit whole is
+  /// grabbed in stripes, then downscaled by 2, 4 or 8, and fails only if
+  /// none of that fits. Captures that report desktop coordinates (regions,
+  /// [findOnScreen], redacted screenshots) are never downscaled. Window
+  /// screenshots, and the screenshot stream on Windows, need the whole
+  /// image at once and fail when it does not fit.
+  Future<void> setMemoryLimit(int bytes) {
+    return DesktopScreenshotPlatform.instance.setMemoryLimit(bytes);
+  }
+
+  /// Starts recording a timeline of the native capture path: each method
+  /// call and frame request, and the grab, convert, encode and reply
+  /// stages under it, on every thread. Each thread keeps its first
+  /// [eventsPerThread] events. A new recording replaces the previous one;
+  /// while nothing is recording the trace points cost next to nothing.
+  Future<void> startTrace({int eventsPerThread = 16384}) {
+    return DesktopScreenshotPlatform.instance
+        .startTrace(eventsPerThread: eventsPerThread);
+  }
+
+  /// Stops the recording started with [startTrace], keeping what it holds
+  /// for [dumpTrace].
+  Future<void> stopTrace() {
+    return DesktopScreenshotPlatform.instance.stopTrace();
+  }
+
+  /// Writes the recording to the file at [path] as Chrome trace-event
+  /// JSON, which chrome://tracing and ui.perfetto.dev open. Returns how
+  /// many events it held, or null if the file could not be written.
+  Future<TraceSummary?> dumpTrace(String path) {
+    return DesktopScreenshotPlatform.instance.dumpTrace(path);
+  }
+
+  /// Pays the one-time costs of the first capture ahead of time: display
+  /// connections, the [expectedFormat] encoder, buffers of [maxSize] (the
+  /// whole desktop by default) and the monitor layout. The work runs off
+  /// the UI thread; the returned duration is how long it took. Every call
+  /// is answered for its own arguments, including calls made while an
+  /// earlier one is still running.
+  Future<Duration?> prepare(
+      {ScreenshotFormat expectedFormat = ScreenshotFormat.png, Size? maxSize}) {
+    return DesktopScreenshotPlatform.instance
+        .prepare(expectedFormat: expectedFormat, maxSize: maxSize);
+  }
+
+  /// Visible top-level application windows with their titles and
+  /// positions, bottom to top.
+  Future<List<ScreenWindow>?> listWindows() {
+    return DesktopScreenshotPlatform.instance.listWindows();
+  }
+
+  /// Captures a single window from listWindows. Only the window's own
+  /// pixels are grabbed and encoded, including parts covered by other
+  /// windows (on Linux this needs an X11 session with Composite).
+  Future<Uint8List?> getWindowScreenshot(int windowId,
+      {ScreenshotFormat format = ScreenshotFormat.png}) {
+    return DesktopScreenshotPlatform.instance
+        .getWindowScreenshot(windowId, format: format);
+  }
+
+  /// Captures the screen straight onto the system clipboard. The pixels
+  /// never cross the platform channel and are not encoded until an
+  /// application pastes them. Returns false if the capture failed.
+  Future<bool> copyScreenshotToClipboard() {
+    return DesktopScreenshotPlatform.instance.copyScreenshotToClipboard();
+  }
+
+  /// Hit and miss counters of the cache that lets getScreenshot skip
+  /// encoding when the screen has not changed.
+  Future<EncodeCacheStats?> getEncodeCacheStats() {
+    return DesktopScreenshotPlatform.instance.getEncodeCacheStats();
+  }
+
+  /// Drops cached screenshots and resets the counters.
+  Future<void> clearEncodeCache() {
+    return DesktopScreenshotPlatform.instance.clearEncodeCache();
+  }
+
+  /// Linux only: switches to client mode, reading frames from the
+  /// shared-memory ring published by the capture daemon named [name]
+  /// instead of grabbing the screen. getScreenshot and captureHandle then
+  /// return the daemon's latest frame. Returns false if no daemon is
+  /// running.
+  Future<bool> attachFrameRing({String name = '/desktop_screenshot'}) {
+    return DesktopScreenshotPlatform.instance.attachFrameRing(name: name);
+  }
+
+  /// Leaves client mode and goes back to capturing directly.
+  Future<void> detachFrameRing() {
+    return DesktopScreenshotPlatform.instance.detachFrameRing();
+  }
+
+  /// Linux only: starts a live preview of the desktop and returns the id
+  /// of a texture to show with `Texture(textureId: id)`. Frames are grabbed
+  /// up to [fps] times a second (1-120) straight into the texture, so
+  /// nothing is encoded, sent to Dart or decoded. Calling it again while
+  /// the preview runs changes the rate and returns the same id. Returns
+  /// null where previews are not supported.
+  Future<int?> startPreview({int fps = 30}) {
+    return DesktopScreenshotPlatform.instance.startPreview(fps: fps);
+  }
+
+  /// Stops the live preview and releases its texture.
+  Future<void> stopPreview() {
+    return DesktopScreenshotPlatform.instance.stopPreview();
+  }
+
+  /// Caps the native memory held by unreleased [CaptureHandle]s.
+  Future<void> setHandleMemoryLimit(int bytes) {
+    return DesktopScreenshotPlatform.instance.setHandleMemoryLimit(bytes);
+  }
+}
+
+/// A captured frame kept on the native side. See
+/// [DesktopScreenshot.captureHandle].
+class CaptureHandle {
+  CaptureHandle._(this.id);
+
+  final int id;
+
+  /// Encodes the frame. Returns null if the handle was released or evicted.
+  Future<Uint8List?> encode({ScreenshotFormat format = ScreenshotFormat.png}) {
+    return DesktopScreenshotPlatform.instance.encodeHandle(id, format: format);
+  }
+
+  /// Returns a new handle holding [rect] of this frame.
+  Future<CaptureHandle?> crop(ScreenRect rect) async {
+    final id = await DesktopScreenshotPlatform.instance.cropHandle(this.id, rect);
+    return id == null ? null : CaptureHandle._(id);
+  }
+
+  /// Returns a new handle holding this frame resized to [width]x[height].
+  Future<CaptureHandle?> scale(int width, int height) async {
+    final id = await DesktopScreenshotPlatform.instance
+        .scaleHandle(this.id, width, height);
+    return id == null ? null : CaptureHandle._(id);
+  }
+
+  /// Frees the native buffer. Returns false if it was already gone.
+  Future<bool> release() {
+    return DesktopScreenshotPlatform.instance.releaseHandle(id);
   }
 }
@@ -1,6 +1,9 @@
+import 'dart:ui' show Size;
+
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 import 'desktop_screenshot_platform_interface.dart';
+import 'desktop_screenshot_types.dart';
 
 /// An implementation of [DesktopScreenshotPlatform] that uses method channels.
 class MethodChannelDesktopScreenshot extends DesktopScreenshotPlatform {
@@ -8,6 +11,16 @@ class MethodChannelDesktopScreenshot extends DesktopScreenshotPlatform {
   @visibleForTesting
   final methodChannel = const MethodChannel('desktop_screenshot');
 
+  /// The event channel that streams encoded screenshot chunks.
+  @visibleForTesting
+  final streamChannel = const EventChannel('desktop_screenshot/stream');
+
+  /// The binary channel that carries whole frames behind a fixed header,
+  /// without StandardMethodCodec containers.
+  @visibleForTesting
+  final frameChannel = const BasicMessageChannel<ByteData>(
+      'desktop_screenshot/frames', BinaryCodec());
+
   @override
   Future<String?> getPlatformVersion() async {
     final version = await methodChannel.invokeMethod<String>('getPlatformVersion');
@@ -15,13 +28,385 @@ class MethodChannelDesktopScreenshot extends DesktopScreenshotPlatform {
   }
 
   @override
-  Future<Uint8List?> getScreenshot() async {
+  Future<Uint8List?> getScreenshot(
+      {List<Redaction>? redactions, PaletteMode palette = PaletteMode.off}) async {
     try {
-      var result = await methodChannel.invokeMethod<List<int>?>("getScreenshot");
+      var result = await methodChannel.invokeMethod<List<int>?>("getScreenshot", {
+        if (redactions != null && redactions.isNotEmpty)
+          'redactions': redactions.map((r) => r.toMap()).toList(),
+        if (palette != PaletteMode.off) 'palette': palette.name,
+      });
       final List<int> screenshot = result ?? [];
       return Uint8List.fromList(screenshot);
     } catch (e) {
       return null;
     }
   }
+
+  @override
+  Stream<ScreenshotStreamEvent> getScreenshotStream(
+      {ScreenshotFormat format = ScreenshotFormat.png, int? chunkSize}) {
+    return streamChannel.receiveBroadcastStream({
+      'format': format.name,
+      if (chunkSize != null) 'chunkSize': chunkSize,
+    }).map(ScreenshotStreamEvent.fromPlatform);
+  }
+
+  @override
+  Future<ScreenFrame?> getFrame({ScreenshotFormat? format}) async {
+    try {
+      final reply = await frameChannel.send(ScreenFrame.request(format));
+      return reply == null ? null : ScreenFrame.fromMessage(reply);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<List<Uint8List>?> getScreenshotRegions(List<ScreenRect> regions,
+      {ScreenshotFormat format = ScreenshotFormat.png}) async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<List<Object?>>("getScreenshotRegions", {
+        'regions': regions.map((r) => r.toMap()).toList(),
+        'format': format.name,
+      });
+      return result
+          ?.map((bytes) => Uint8List.fromList((bytes as List).cast<int>()))
+          .toList();
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<List<PipelineResult>?> capturePipeline(
+      List<PipelineOutput> outputs) async {
+    try {
+      final result = await methodChannel.invokeMethod<List<Object?>>(
+          "capturePipeline",
+          {'outputs': outputs.map((o) => o.toMap()).toList()});
+      return result
+          ?.map((entry) =>
+              PipelineResult.fromMap(entry as Map<Object?, Object?>))
+          .toList();
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<int?> captureHandle() async {
+    try {
+      return await methodChannel.invokeMethod<int>("captureHandle");
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<Uint8List?> encodeHandle(int id,
+      {ScreenshotFormat format = ScreenshotFormat.png}) async {
+    try {
+      final result = await methodChannel.invokeMethod<List<int>>(
+          "encodeHandle", {'id': id, 'format': format.name});
+      return result == null ? null : Uint8List.fromList(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<int?> cropHandle(int id, ScreenRect rect) async {
+    try {
+      return await methodChannel
+          .invokeMethod<int>("cropHandle", {'id': id, ...rect.toMap()});
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<int?> scaleHandle(int id, int width, int height) async {
+    try {
+      return await methodChannel.invokeMethod<int>(
+          "scaleHandle", {'id': id, 'width': width, 'height': height});
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<bool> releaseHandle(int id) async {
+    try {
+      return await methodChannel
+              .invokeMethod<bool>("releaseHandle", {'id': id}) ??
+          false;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  @override
+  Future<void> setHandleMemoryLimit(int bytes) async {
+    await methodChannel.invokeMethod<void>("setHandleMemoryLimit", {'bytes': bytes});
+  }
+
+  @override
+  Future<List<ScreenMatch>?> findOnScreen(Uint8List templatePng,
+      {double threshold = 0.9, ScreenRect? region, int maxMatches = 16}) async {
+    try {
+      final result =
+          await methodChannel.invokeMethod<List<Object?>>("findOnScreen", {
+        'template': templatePng,
+        'threshold': threshold,
+        'region': region?.toMap(),
+        'maxMatches': maxMatches,
+      });
+      return result
+          ?.map((match) => ScreenMatch.fromMap(match as Map<Object?, Object?>))
+          .toList();
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<List<int?>?> samplePixels(List<ScreenPoint> points) async {
+    final coords = Int32List(points.length * 2);
+    for (var i = 0; i < points.length; i++) {
+      coords[2 * i] = points[i].x;
+      coords[2 * i + 1] = points[i].y;
+    }
+    try {
+      final result = await methodChannel
+          .invokeMethod<List<Object?>>("samplePixels", {'points': coords});
+      return result?.cast<int?>();
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<ScreenStats?> getScreenStats(
+      {ScreenRect? region, int? monitor}) async {
+    try {
+      final result = await methodChannel.invokeMethod<Map<Object?, Object?>>(
+          "getScreenStats", {'region': region?.toMap(), 'monitor': monitor});
+      return result == null ? null : ScreenStats.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<void> configureThreadPool(
+      {int threads = 0, bool pinThreads = false}) async {
+    await methodChannel.invokeMethod<void>("configureThreadPool",
+        {'threads': threads, 'pinThreads': pinThreads});
+  }
+
+  @override
+  Future<ThreadPoolStats?> getThreadPoolStats() async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getThreadPoolStats");
+      return result == null ? null : ThreadPoolStats.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<void> setMonitorCaptureMode(MonitorCaptureMode mode) async {
+    await methodChannel
+        .invokeMethod<void>("setMonitorCaptureMode", {'mode': mode.name});
+  }
+
+  @override
+  Future<MemoryStats?> getMemoryStats({bool resetPeaks = false}) async {
+    try {
+      final result = await methodChannel.invokeMethod<Map<Object?, Object?>>(
+          "getMemoryStats", {'resetPeaks': resetPeaks});
+      return result == null ? null : MemoryStats.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<void> setMemoryLimit(int bytes) async {
+    await methodChannel.invokeMethod<void>("setMemoryLimit", {'bytes': bytes});
+  }
+
+  @override
+  Future<void> startTrace({int eventsPerThread = 16384}) async {
+    await methodChannel.invokeMethod<void>(
+        "startTrace", {'eventsPerThread': eventsPerThread});
+  }
+
+  @override
+  Future<void> stopTrace() async {
+    await methodChannel.invokeMethod<void>("stopTrace");
+  }
+
+  @override
+  Future<TraceSummary?> dumpTrace(String path) async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("dumpTrace", {'path': path});
+      return result == null ? null : TraceSummary.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<Duration?> prepare(
+      {ScreenshotFormat expectedFormat = ScreenshotFormat.png,
+      Size? maxSize}) async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("prepare", {
+        'format': expectedFormat.name,
+        if (maxSize != null) 'width': maxSize.width.ceil(),
+        if (maxSize != null) 'height': maxSize.height.ceil(),
+      });
+      final micros = result?['micros'];
+      return micros is int ? Duration(microseconds: micros) : null;
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<List<ScreenWindow>?> listWindows() async {
+    try {
+      final result =
+          await methodChannel.invokeMethod<List<Object?>>("listWindows");
+      return result
+          ?.map((window) =>
+              ScreenWindow.fromMap(window as Map<Object?, Object?>))
+          .toList();
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<Uint8List?> getWindowScreenshot(int windowId,
+      {ScreenshotFormat format = ScreenshotFormat.png}) async {
+    try {
+      return await methodChannel.invokeMethod<Uint8List>(
+          "getWindowScreenshot", {'windowId': windowId, 'format': format.name});
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<BudgetedScreenshot?> getBudgetedScreenshot(
+      {int? maxBytes, int? maxEncodeMs}) async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getBudgetedScreenshot", {
+        if (maxBytes != null) 'maxBytes': maxBytes,
+        if (maxEncodeMs != null) 'maxEncodeMs': maxEncodeMs,
+      });
+      return result == null ? null : BudgetedScreenshot.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<HybridScreenshot?> getHybridScreenshot(
+      {int tileSize = 64, int quality = 80}) async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getHybridScreenshot", {
+        'tileSize': tileSize,
+        'quality': quality,
+      });
+      return result == null ? null : HybridScreenshot.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<Uint8List?> decodeHybridImage(Uint8List bytes) async {
+    try {
+      return await methodChannel
+          .invokeMethod<Uint8List>("decodeHybridImage", {'bytes': bytes});
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<bool> copyScreenshotToClipboard() async {
+    try {
+      return await methodChannel
+              .invokeMethod<bool>("copyScreenshotToClipboard") ??
+          false;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  @override
+  Future<EncodeCacheStats?> getEncodeCacheStats() async {
+    try {
+      final result = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getEncodeCacheStats");
+      return result == null ? null : EncodeCacheStats.fromMap(result);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<void> clearEncodeCache() async {
+    await methodChannel.invokeMethod<void>("clearEncodeCache");
+  }
+
+  @override
+  Future<bool> attachFrameRing({String name = '/desktop_screenshot'}) async {
+    try {
+      return await methodChannel
+              .invokeMethod<bool>("attachFrameRing", {'name': name}) ??
+          false;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  @override
+  Future<void> detachFrameRing() async {
+    try {
+      await methodChannel.invokeMethod<void>("detachFrameRing");
+    } catch (e) {
+      // Only Linux has a client mode.
+    }
+  }
+
+  @override
+  Future<int?> startPreview({int fps = 30}) async {
+    try {
+      return await methodChannel
+          .invokeMethod<int>("startPreview", {'fps': fps});
+    } catch (e) {
+      return null;
+    }
+  }
+
+  @override
+  Future<void> stopPreview() async {
+    try {
+      await methodChannel.invokeMethod<void>("stopPreview");
+    } catch (e) {
+      // Only Linux has a texture preview.
+    }
+  }
 }
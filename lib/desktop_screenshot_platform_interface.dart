@@ -1,9 +1,11 @@
 // import 'dart:typed_data';
+import 'dart:ui' show Size;
 
 import 'package:flutter/services.dart';
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
 import 'desktop_screenshot_method_channel.dart';
+import 'desktop_screenshot_types.dart';
 
 abstract class DesktopScreenshotPlatform extends PlatformInterface {
   /// Constructs a DesktopScreenshotPlatform.
@@ -30,7 +32,158 @@ abstract class DesktopScreenshotPlatform extends PlatformInterface {
     throw UnimplementedError('platformVersion() has not been implemented.');
   }
 
-  Future<Uint8List?> getScreenshot() {
+  Future<Uint8List?> getScreenshot(
+      {List<Redaction>? redactions, PaletteMode palette = PaletteMode.off}) {
     throw UnimplementedError('getScreenshot() has not been implemented.');
   }
+
+  Stream<ScreenshotStreamEvent> getScreenshotStream(
+      {ScreenshotFormat format = ScreenshotFormat.png, int? chunkSize}) {
+    throw UnimplementedError('getScreenshotStream() has not been implemented.');
+  }
+
+  Future<ScreenFrame?> getFrame({ScreenshotFormat? format}) {
+    throw UnimplementedError('getFrame() has not been implemented.');
+  }
+
+  Future<List<Uint8List>?> getScreenshotRegions(List<ScreenRect> regions,
+      {ScreenshotFormat format = ScreenshotFormat.png}) {
+    throw UnimplementedError(
+        'getScreenshotRegions() has not been implemented.');
+  }
+
+  Future<List<PipelineResult>?> capturePipeline(List<PipelineOutput> outputs) {
+    throw UnimplementedError('capturePipeline() has not been implemented.');
+  }
+
+  Future<int?> captureHandle() {
+    throw UnimplementedError('captureHandle() has not been implemented.');
+  }
+
+  Future<Uint8List?> encodeHandle(int id,
+      {ScreenshotFormat format = ScreenshotFormat.png}) {
+    throw UnimplementedError('encodeHandle() has not been implemented.');
+  }
+
+  Future<int?> cropHandle(int id, ScreenRect rect) {
+    throw UnimplementedError('cropHandle() has not been implemented.');
+  }
+
+  Future<int?> scaleHandle(int id, int width, int height) {
+    throw UnimplementedError('scaleHandle() has not been implemented.');
+  }
+
+  Future<bool> releaseHandle(int id) {
+    throw UnimplementedError('releaseHandle() has not been implemented.');
+  }
+
+  Future<void> setHandleMemoryLimit(int bytes) {
+    throw UnimplementedError(
+        'setHandleMemoryLimit() has not been implemented.');
+  }
+
+  Future<List<ScreenMatch>?> findOnScreen(Uint8List templatePng,
+      {double threshold = 0.9, ScreenRect? region, int maxMatches = 16}) {
+    throw UnimplementedError('findOnScreen() has not been implemented.');
+  }
+
+  Future<List<int?>?> samplePixels(List<ScreenPoint> points) {
+    throw UnimplementedError('samplePixels() has not been implemented.');
+  }
+
+  Future<ScreenStats?> getScreenStats({ScreenRect? region, int? monitor}) {
+    throw UnimplementedError('getScreenStats() has not been implemented.');
+  }
+
+  Future<void> configureThreadPool(
+      {int threads = 0, bool pinThreads = false}) {
+    throw UnimplementedError('configureThreadPool() has not been implemented.');
+  }
+
+  Future<ThreadPoolStats?> getThreadPoolStats() {
+    throw UnimplementedError('getThreadPoolStats() has not been implemented.');
+  }
+
+  Future<void> setMonitorCaptureMode(MonitorCaptureMode mode) {
+    throw UnimplementedError(
+        'setMonitorCaptureMode() has not been implemented.');
+  }
+
+  Future<MemoryStats?> getMemoryStats({bool resetPeaks = false}) {
+    throw UnimplementedError('getMemoryStats() has not been implemented.');
+  }
+
+  Future<void> setMemoryLimit(int bytes) {
+    throw UnimplementedError('setMemoryLimit() has not been implemented.');
+  }
+
+  Future<void> startTrace({int eventsPerThread = 16384}) {
+    throw UnimplementedError('startTrace() has not been implemented.');
+  }
+
+  Future<void> stopTrace() {
+    throw UnimplementedError('stopTrace() has not been implemented.');
+  }
+
+  Future<TraceSummary?> dumpTrace(String path) {
+    throw UnimplementedError('dumpTrace() has not been implemented.');
+  }
+
+  Future<Duration?> prepare(
+      {ScreenshotFormat expectedFormat = ScreenshotFormat.png, Size? maxSize}) {
+    throw UnimplementedError('prepare() has not been implemented.');
+  }
+
+  Future<List<ScreenWindow>?> listWindows() {
+    throw UnimplementedError('listWindows() has not been implemented.');
+  }
+
+  Future<Uint8List?> getWindowScreenshot(int windowId,
+      {ScreenshotFormat format = ScreenshotFormat.png}) {
+    throw UnimplementedError('getWindowScreenshot() has not been implemented.');
+  }
+
+  Future<BudgetedScreenshot?> getBudgetedScreenshot(
+      {int? maxBytes, int? maxEncodeMs}) {
+    throw UnimplementedError(
+        'getBudgetedScreenshot() has not been implemented.');
+  }
+
+  Future<HybridScreenshot?> getHybridScreenshot(
+      {int tileSize = 64, int quality = 80}) {
+    throw UnimplementedError('getHybridScreenshot() has not been implemented.');
+  }
+
+  Future<Uint8List?> decodeHybridImage(Uint8List bytes) {
+    throw UnimplementedError('decodeHybridImage() has not been implemented.');
+  }
+
+  Future<bool> copyScreenshotToClipboard() {
+    throw UnimplementedError(
+        'copyScreenshotToClipboard() has not been implemented.');
+  }
+
+  Future<EncodeCacheStats?> getEncodeCacheStats() {
+    throw UnimplementedError('getEncodeCacheStats() has not been implemented.');
+  }
+
+  Future<void> clearEncodeCache() {
+    throw UnimplementedError('clearEncodeCache() has not been implemented.');
+  }
+
+  Future<bool> attachFrameRing({String name = '/desktop_screenshot'}) {
+    throw UnimplementedError('attachFrameRing() has not been implemented.');
+  }
+
+  Future<void> detachFrameRing() {
+    throw UnimplementedError('detachFrameRing() has not been implemented.');
+  }
+
+  Future<int?> startPreview({int fps = 30}) {
+    throw UnimplementedError('startPreview() has not been implemented.');
+  }
+
+  Future<void> stopPreview() {
+    throw UnimplementedError('stopPreview() has not been implemented.');
+  }
 }
@@ -0,0 +1,139 @@
+import 'dart:typed_data';
+
+/// How each byte of a raw frame was predicted before compression.
+enum RawFramePredictor { none, left, up }
+
+/// A frame in the plugin's raw container ([ScreenshotFormat.raw]): BGRA
+/// pixels compressed with a delta predictor and LZ4, much cheaper to
+/// produce than PNG.
+///
+/// Decoding happens in Dart, so the bytes can also be shipped to another
+/// process or isolate and decoded there.
+class RawFrame {
+  RawFrame._(this.width, this.height, this.stride, this.timestamp, this.pixels);
+
+  static const int headerSize = 32;
+
+  final int width;
+  final int height;
+
+  /// Bytes per row of [pixels]; at least `width * 4`.
+  final int stride;
+
+  /// Capture time (UTC).
+  final DateTime timestamp;
+
+  /// Top-down BGRA rows of [stride] bytes.
+  final Uint8List pixels;
+
+  /// Decodes a container produced by the native side. Returns null if
+  /// [bytes] is not a valid raw frame.
+  static RawFrame? decode(Uint8List bytes) {
+    if (bytes.length < headerSize ||
+        bytes[0] != 0x44 || // D
+        bytes[1] != 0x53 || // S
+        bytes[2] != 0x52 || // R
+        bytes[3] != 0x46 || // F
+        bytes[4] != 1 ||
+        bytes[5] != 0 ||
+        bytes[6] >= RawFramePredictor.values.length) {
+      return null;
+    }
+    final header = ByteData.sublistView(bytes, 0, headerSize);
+    final width = header.getUint32(8, Endian.little);
+    final height = header.getUint32(12, Endian.little);
+    final stride = header.getUint32(16, Endian.little);
+    final payload = header.getUint32(20, Endian.little);
+    final micros = header.getUint64(24, Endian.little) ~/ 1000;
+    if (stride < width * 4 || payload != bytes.length - headerSize) {
+      return null;
+    }
+    final rawSize = stride * height;
+    if (rawSize ~/ 255 > payload) return null;
+
+    final body = Uint8List.sublistView(bytes, headerSize);
+    final Uint8List pixels;
+    switch (bytes[7]) {
+      case 0:
+        if (payload != rawSize) return null;
+        pixels = Uint8List.fromList(body);
+      case 1:
+        final out = Uint8List(rawSize);
+        if (!_lz4Decompress(body, out)) return null;
+        pixels = out;
+      default:
+        return null;
+    }
+    _unpredict(pixels, stride, height, RawFramePredictor.values[bytes[6]]);
+    return RawFrame._(width, height, stride,
+        DateTime.fromMicrosecondsSinceEpoch(micros, isUtc: true), pixels);
+  }
+
+  static bool _lz4Decompress(Uint8List src, Uint8List dst) {
+    var ip = 0;
+    var op = 0;
+    while (ip < src.length) {
+      final token = src[ip++];
+      var literals = token >> 4;
+      if (literals == 15) {
+        int byte;
+        do {
+          if (ip >= src.length) return false;
+          byte = src[ip++];
+          literals += byte;
+        } while (byte == 255);
+      }
+      if (literals > src.length - ip || literals > dst.length - op) {
+        return false;
+      }
+      dst.setRange(op, op + literals, src, ip);
+      op += literals;
+      ip += literals;
+      if (ip == src.length) break;
+
+      if (src.length - ip < 2) return false;
+      final offset = src[ip] | (src[ip + 1] << 8);
+      ip += 2;
+      if (offset == 0 || offset > op) return false;
+      var length = token & 15;
+      if (length == 15) {
+        int byte;
+        do {
+          if (ip >= src.length) return false;
+          byte = src[ip++];
+          length += byte;
+        } while (byte == 255);
+      }
+      length += 4;
+      if (length > dst.length - op) return false;
+      if (offset >= length) {
+        dst.setRange(op, op + length, dst, op - offset);
+      } else {
+        for (var i = 0; i < length; i++) {
+          dst[op + i] = dst[op + i - offset];
+        }
+      }
+      op += length;
+    }
+    return op == dst.length;
+  }
+
+  static void _unpredict(
+      Uint8List pixels, int stride, int height, RawFramePredictor predictor) {
+    switch (predictor) {
+      case RawFramePredictor.none:
+        return;
+      case RawFramePredictor.left:
+        for (var y = 0; y < height; y++) {
+          final row = y * stride;
+          for (var i = row + 4; i < row + stride; i++) {
+            pixels[i] = (pixels[i] + pixels[i - 4]) & 0xFF;
+          }
+        }
+      case RawFramePredictor.up:
+        for (var i = stride; i < stride * height; i++) {
+          pixels[i] = (pixels[i] + pixels[i - stride]) & 0xFF;
+        }
+    }
+  }
+}
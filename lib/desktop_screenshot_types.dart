@@ -0,0 +1,588 @@
+import 'dart:typed_data';
+
+/// Encodings the native side can produce. [raw] is the plugin's compressed
+/// BGRA container, decoded with RawFrame.decode.
+enum ScreenshotFormat { png, jpeg, bmp, raw }
+
+/// Whether getScreenshot may write an indexed-color (palette) PNG.
+enum PaletteMode {
+  /// Always truecolor.
+  off,
+
+  /// Indexed only if the screen has at most 256 distinct colors (lossless).
+  exact,
+
+  /// Indexed always; quantizes with median cut when there are more than 256
+  /// colors (lossy in that case).
+  quantize,
+}
+
+/// An integer pixel rectangle relative to the top-left corner of the
+/// combined desktop.
+class ScreenRect {
+  const ScreenRect(this.x, this.y, this.width, this.height);
+
+  final int x;
+  final int y;
+  final int width;
+  final int height;
+
+  Map<String, dynamic> toMap() =>
+      {'x': x, 'y': y, 'width': width, 'height': height};
+}
+
+/// A pixel position relative to the top-left corner of the combined desktop.
+class ScreenPoint {
+  const ScreenPoint(this.x, this.y);
+
+  final int x;
+  final int y;
+}
+
+/// How a [Redaction] hides the pixels under its rectangle.
+enum RedactionMode { fill, pixelate, blur }
+
+/// A rectangle that is masked natively before the screenshot is encoded.
+///
+/// Coordinates are in pixels relative to the top-left corner of the captured
+/// image.
+class Redaction {
+  const Redaction({
+    required this.x,
+    required this.y,
+    required this.width,
+    required this.height,
+    this.mode = RedactionMode.fill,
+    this.color = 0xFF000000,
+    this.strength = 8,
+  });
+
+  final int x;
+  final int y;
+  final int width;
+  final int height;
+  final RedactionMode mode;
+
+  /// Fill color as 0xAARRGGBB. Only used by [RedactionMode.fill].
+  final int color;
+
+  /// Block size for [RedactionMode.pixelate], radius for [RedactionMode.blur].
+  final int strength;
+
+  Map<String, dynamic> toMap() => {
+        'x': x,
+        'y': y,
+        'width': width,
+        'height': height,
+        'mode': mode.name,
+        'color': color,
+        'strength': strength,
+      };
+}
+
+/// Counters of the native encoded-result cache used by getScreenshot.
+class EncodeCacheStats {
+  const EncodeCacheStats(
+      {required this.hits, required this.misses, required this.entries});
+
+  factory EncodeCacheStats.fromMap(Map<Object?, Object?> map) =>
+      EncodeCacheStats(
+        hits: map['hits'] as int? ?? 0,
+        misses: map['misses'] as int? ?? 0,
+        entries: map['entries'] as int? ?? 0,
+      );
+
+  /// Captures whose frame was unchanged and were answered without encoding.
+  final int hits;
+  final int misses;
+
+  /// Parameter sets (palette mode, redactions) currently cached.
+  final int entries;
+}
+
+/// One event of a screenshot stream (see getScreenshotStream): a run of
+/// [ScreenshotChunk]s followed by a single [ScreenshotStreamDone].
+sealed class ScreenshotStreamEvent {
+  const ScreenshotStreamEvent();
+
+  /// Decodes a raw platform event: byte lists are chunks, the final map
+  /// holds the totals.
+  factory ScreenshotStreamEvent.fromPlatform(Object? event) {
+    if (event is Uint8List) return ScreenshotChunk(event);
+    if (event is List<int>) return ScreenshotChunk(Uint8List.fromList(event));
+    final map = event as Map<Object?, Object?>;
+    return ScreenshotStreamDone(
+      totalBytes: map['totalBytes'] as int? ?? 0,
+      chunks: map['chunks'] as int? ?? 0,
+      encodeTime: Duration(microseconds: map['encodeMicros'] as int? ?? 0),
+    );
+  }
+}
+
+/// The next piece of the encoded image. Concatenating every chunk in order
+/// gives the complete file.
+class ScreenshotChunk extends ScreenshotStreamEvent {
+  const ScreenshotChunk(this.bytes);
+
+  final Uint8List bytes;
+}
+
+/// Sent once the encoder has finished, after the last chunk.
+class ScreenshotStreamDone extends ScreenshotStreamEvent {
+  const ScreenshotStreamDone(
+      {required this.totalBytes, required this.chunks, required this.encodeTime});
+
+  final int totalBytes;
+  final int chunks;
+
+  /// Time from the first encoder write to the last chunk being sent.
+  final Duration encodeTime;
+}
+
+/// A place where findOnScreen found the template, in desktop pixels.
+class ScreenMatch {
+  const ScreenMatch(this.rect, this.score);
+
+  factory ScreenMatch.fromMap(Map<Object?, Object?> map) => ScreenMatch(
+        ScreenRect(
+          map['x'] as int? ?? 0,
+          map['y'] as int? ?? 0,
+          map['width'] as int? ?? 0,
+          map['height'] as int? ?? 0,
+        ),
+        (map['score'] as num?)?.toDouble() ?? 0,
+      );
+
+  final ScreenRect rect;
+
+  /// Normalized cross-correlation of the luminance; 1 is a perfect match.
+  final double score;
+}
+
+/// Summary of a screen area computed natively by getScreenStats.
+class ScreenStats {
+  const ScreenStats({
+    required this.pixels,
+    required this.red,
+    required this.green,
+    required this.blue,
+    required this.meanLuminance,
+    required this.luminanceVariance,
+    required this.uniform,
+  });
+
+  factory ScreenStats.fromMap(Map<Object?, Object?> map) {
+    List<int> histogram(Object? counts) =>
+        counts is List ? counts.cast<int>() : List<int>.filled(256, 0);
+    return ScreenStats(
+      pixels: map['pixels'] as int? ?? 0,
+      red: histogram(map['red']),
+      green: histogram(map['green']),
+      blue: histogram(map['blue']),
+      meanLuminance: (map['meanLuminance'] as num?)?.toDouble() ?? 0,
+      luminanceVariance: (map['luminanceVariance'] as num?)?.toDouble() ?? 0,
+      uniform: map['uniform'] as bool? ?? false,
+    );
+  }
+
+  final int pixels;
+
+  /// 256-entry histograms: how many pixels have each channel value.
+  final List<int> red;
+  final List<int> green;
+  final List<int> blue;
+
+  /// Luminance (BT.601 weights) on a 0..255 scale.
+  final double meanLuminance;
+  final double luminanceVariance;
+
+  /// No channel varies by more than a few levels: a black, blank or
+  /// frozen-on-one-color display.
+  final bool uniform;
+}
+
+/// Size and counters of the native worker pool shared by every parallel
+/// stage (encoding, scaling, matching).
+class ThreadPoolStats {
+  const ThreadPoolStats(
+      {required this.threads,
+      required this.tasks,
+      required this.steals,
+      required this.queueDepth});
+
+  factory ThreadPoolStats.fromMap(Map<Object?, Object?> map) =>
+      ThreadPoolStats(
+        threads: map['threads'] as int? ?? 0,
+        tasks: map['tasks'] as int? ?? 0,
+        steals: map['steals'] as int? ?? 0,
+        queueDepth: map['queueDepth'] as int? ?? 0,
+      );
+
+  final int threads;
+
+  /// Row-range tasks executed so far.
+  final int tasks;
+
+  /// Tasks an idle thread took from another thread's queue.
+  final int steals;
+
+  /// Tasks waiting to start when the stats were read.
+  final int queueDepth;
+}
+
+/// Where a capture's native buffers are in their life.
+enum MemoryStage {
+  /// What the platform grabs into: GDI bitmaps, GDK pixbufs, shared
+  /// memory segments.
+  grab,
+
+  /// Unencoded BGRA frames and their crops and downscales.
+  frame,
+
+  /// Encoder output.
+  encode,
+
+  /// Copies handed to Flutter.
+  result,
+}
+
+/// Current and highest bytes held by one [MemoryStage].
+class MemoryStageStats {
+  const MemoryStageStats({required this.current, required this.peak});
+
+  factory MemoryStageStats.fromMap(Map<Object?, Object?> map) =>
+      MemoryStageStats(
+        current: map['current'] as int? ?? 0,
+        peak: map['peak'] as int? ?? 0,
+      );
+
+  final int current;
+  final int peak;
+}
+
+/// Native memory held by captures across the process, returned by
+/// getMemoryStats.
+class MemoryStats {
+  const MemoryStats(
+      {required this.current,
+      required this.peak,
+      required this.limit,
+      required this.stages,
+      required this.handles,
+      required this.degraded,
+      required this.refused});
+
+  factory MemoryStats.fromMap(Map<Object?, Object?> map) {
+    final stages = map['stages'] as Map<Object?, Object?>? ?? const {};
+    return MemoryStats(
+      current: map['current'] as int? ?? 0,
+      peak: map['peak'] as int? ?? 0,
+      limit: map['limit'] as int? ?? 0,
+      stages: {
+        for (final stage in MemoryStage.values)
+          stage: MemoryStageStats.fromMap(
+              stages[stage.name] as Map<Object?, Object?>? ?? const {}),
+      },
+      handles: map['handles'] as int? ?? 0,
+      degraded: map['degraded'] as int? ?? 0,
+      refused: map['refused'] as int? ?? 0,
+    );
+  }
+
+  final int current;
+  final int peak;
+
+  /// The ceiling set with setMemoryLimit; 0 when there is none.
+  final int limit;
+  final Map<MemoryStage, MemoryStageStats> stages;
+
+  /// Bytes held by frames kept for capture handles.
+  final int handles;
+
+  /// Captures taken in stripes or downscaled to stay under [limit], and
+  /// captures that failed because not even that fit.
+  final int degraded;
+  final int refused;
+}
+
+/// What a trace written by dumpTrace holds.
+class TraceSummary {
+  const TraceSummary(
+      {required this.events, required this.dropped, required this.threads});
+
+  factory TraceSummary.fromMap(Map<Object?, Object?> map) => TraceSummary(
+        events: map['events'] as int? ?? 0,
+        dropped: map['dropped'] as int? ?? 0,
+        threads: map['threads'] as int? ?? 0,
+      );
+
+  final int events;
+
+  /// Events left out because their thread's buffer was full; raise
+  /// eventsPerThread in startTrace to keep them.
+  final int dropped;
+  final int threads;
+}
+
+/// A top-level window returned by listWindows.
+class ScreenWindow {
+  const ScreenWindow(this.id, this.title, this.rect);
+
+  factory ScreenWindow.fromMap(Map<Object?, Object?> map) => ScreenWindow(
+        map['id'] as int? ?? 0,
+        map['title'] as String? ?? '',
+        ScreenRect(
+          map['x'] as int? ?? 0,
+          map['y'] as int? ?? 0,
+          map['width'] as int? ?? 0,
+          map['height'] as int? ?? 0,
+        ),
+      );
+
+  /// Native window id (an X11 window on Linux, an HWND on Windows), for
+  /// getWindowScreenshot.
+  final int id;
+
+  final String title;
+
+  /// Where the window is, in the same desktop coordinates as
+  /// getScreenshotRegions.
+  final ScreenRect rect;
+}
+
+/// A capture encoded by getBudgetedScreenshot, with the settings that were
+/// picked to fit the budget.
+class BudgetedScreenshot {
+  const BudgetedScreenshot({
+    required this.bytes,
+    required this.format,
+    required this.level,
+    required this.palette,
+    required this.scale,
+    required this.width,
+    required this.height,
+    required this.encodeTime,
+    required this.trials,
+    required this.withinBudget,
+  });
+
+  factory BudgetedScreenshot.fromMap(Map<Object?, Object?> map) =>
+      BudgetedScreenshot(
+        bytes: map['bytes'] as Uint8List? ?? Uint8List(0),
+        format: ScreenshotFormat.values.firstWhere(
+            (f) => f.name == map['format'],
+            orElse: () => ScreenshotFormat.png),
+        level: map['level'] as int? ?? 0,
+        palette: PaletteMode.values.firstWhere(
+            (p) => p.name == map['palette'],
+            orElse: () => PaletteMode.off),
+        scale: map['scale'] as int? ?? 1,
+        width: map['width'] as int? ?? 0,
+        height: map['height'] as int? ?? 0,
+        encodeTime: Duration(microseconds: map['encodeMicros'] as int? ?? 0),
+        trials: map['trials'] as int? ?? 0,
+        withinBudget: map['withinBudget'] as bool? ?? false,
+      );
+
+  final Uint8List bytes;
+  final ScreenshotFormat format;
+
+  /// zlib level for PNG, quality (1-100) for JPEG.
+  final int level;
+
+  /// Palette mode of a PNG. [PaletteMode.exact] stays truecolor when the
+  /// screen has too many colors.
+  final PaletteMode palette;
+
+  /// The image is 1/[scale] of the desktop in each dimension.
+  final int scale;
+  final int width;
+  final int height;
+
+  /// Scaling, palette reduction and encoding of [bytes].
+  final Duration encodeTime;
+
+  /// Sample encodes spent choosing the settings.
+  final int trials;
+
+  /// False when even the cheapest settings missed a limit.
+  final bool withinBudget;
+}
+
+/// A capture encoded by getHybridScreenshot.
+///
+/// [bytes] is a small container (magic "DSHY") holding a map of which
+/// tiles are photos, a PNG of the rest of the screen and a JPEG of the
+/// photo tiles' bounding box; decodeHybridImage composites it.
+class HybridScreenshot {
+  const HybridScreenshot({
+    required this.bytes,
+    required this.width,
+    required this.height,
+    required this.tiles,
+    required this.photoTiles,
+  });
+
+  factory HybridScreenshot.fromMap(Map<Object?, Object?> map) =>
+      HybridScreenshot(
+        bytes: map['bytes'] as Uint8List? ?? Uint8List(0),
+        width: map['width'] as int? ?? 0,
+        height: map['height'] as int? ?? 0,
+        tiles: map['tiles'] as int? ?? 0,
+        photoTiles: map['photoTiles'] as int? ?? 0,
+      );
+
+  final Uint8List bytes;
+  final int width;
+  final int height;
+
+  /// Tiles the screen was cut into, and how many of them went to JPEG.
+  final int tiles;
+  final int photoTiles;
+}
+
+/// What a [PipelineOutput] produces from its part of the capture.
+enum PipelineProduct {
+  /// An encoded image.
+  image,
+
+  /// A 64-bit hash of the pixels, for cheap change detection.
+  fingerprint,
+}
+
+/// One output of capturePipeline.
+class PipelineOutput {
+  /// An image of [region] (the whole desktop when null) encoded as
+  /// [format], at [scale] times the region's size.
+  const PipelineOutput.image(
+      {this.format = ScreenshotFormat.png, this.scale = 1.0, this.region})
+      : product = PipelineProduct.image;
+
+  /// A fingerprint of [region] at [scale]. Fingerprinting a small scale
+  /// ignores changes too fine to survive the downscale.
+  const PipelineOutput.fingerprint({this.scale = 1.0, this.region})
+      : product = PipelineProduct.fingerprint,
+        format = ScreenshotFormat.png;
+
+  final PipelineProduct product;
+
+  /// Unused for fingerprints.
+  final ScreenshotFormat format;
+
+  /// Output size relative to the region, in (0, 1].
+  final double scale;
+
+  /// Part of the desktop to use; null means all of it.
+  final ScreenRect? region;
+
+  Map<String, dynamic> toMap() => {
+        'product': product.name,
+        'format': format.name,
+        'scale': scale,
+        if (region != null) 'region': region!.toMap(),
+      };
+}
+
+/// What one [PipelineOutput] produced.
+class PipelineResult {
+  const PipelineResult({
+    this.bytes,
+    this.fingerprint,
+    required this.width,
+    required this.height,
+  });
+
+  factory PipelineResult.fromMap(Map<Object?, Object?> map) => PipelineResult(
+        bytes: map['bytes'] as Uint8List?,
+        fingerprint: map['fingerprint'] as int?,
+        width: map['width'] as int? ?? 0,
+        height: map['height'] as int? ?? 0,
+      );
+
+  /// The encoded image, for [PipelineProduct.image]. Empty when the region
+  /// lies outside the desktop.
+  final Uint8List? bytes;
+
+  /// For [PipelineProduct.fingerprint].
+  final int? fingerprint;
+
+  /// Size of the scaled region; zero when it lies outside the desktop.
+  final int width;
+  final int height;
+}
+
+/// A capture received over the binary frame channel by getFrame.
+class ScreenFrame {
+  const ScreenFrame({
+    required this.format,
+    required this.width,
+    required this.height,
+    required this.timestamp,
+    required this.bytes,
+  });
+
+  static const int _headerSize = 32;
+  static const List<int> _requestMagic = [0x44, 0x53, 0x46, 0x51]; // DSFQ
+  static const List<int> _messageMagic = [0x44, 0x53, 0x46, 0x4D]; // DSFM
+  static const int _version = 1;
+  static const int _pixels = 4;
+
+  /// The request getFrame sends: magic, version and the wanted payload
+  /// ([format]'s index, or 4 for unencoded pixels).
+  static ByteData request(ScreenshotFormat? format) {
+    final data = ByteData(8);
+    for (var i = 0; i < 4; ++i) {
+      data.setUint8(i, _requestMagic[i]);
+    }
+    data.setUint8(4, _version);
+    data.setUint8(5, format?.index ?? _pixels);
+    return data;
+  }
+
+  /// Parses a reply: a 32-byte little-endian header followed by the
+  /// payload. Returns null for error replies and malformed messages.
+  /// [bytes] is a view into [message], not a copy.
+  static ScreenFrame? fromMessage(ByteData message) {
+    if (message.lengthInBytes < _headerSize) return null;
+    for (var i = 0; i < 4; ++i) {
+      if (message.getUint8(i) != _messageMagic[i]) return null;
+    }
+    final payload = message.getUint8(5);
+    if (message.getUint8(4) != _version ||
+        payload > _pixels ||
+        message.getUint8(6) != 0) {
+      return null;
+    }
+    final size = message.getUint32(24, Endian.little);
+    if (size > message.lengthInBytes - _headerSize) return null;
+    return ScreenFrame(
+      format: payload == _pixels ? null : ScreenshotFormat.values[payload],
+      width: message.getUint32(8, Endian.little),
+      height: message.getUint32(12, Endian.little),
+      timestamp: DateTime.fromMicrosecondsSinceEpoch(
+          message.getUint64(16, Endian.little) ~/ 1000),
+      bytes: message.buffer
+          .asUint8List(message.offsetInBytes + _headerSize, size),
+    );
+  }
+
+  /// Encoding of [bytes]; null for unencoded BGRA rows of [width] * 4
+  /// bytes.
+  final ScreenshotFormat? format;
+  final int width;
+  final int height;
+
+  /// When the frame was captured.
+  final DateTime timestamp;
+  final Uint8List bytes;
+}
+
+/// How a full-desktop capture grabs several monitors.
+enum MonitorCaptureMode {
+  /// One monitor after another, or the whole desktop in one piece.
+  sequential,
+
+  /// Every monitor at once, each on its own worker thread (and, on Linux,
+  /// its own X connection and shared-memory segment).
+  parallel,
+}
@@ -0,0 +1,94 @@
+// Compares the native cost of sending one frame to Dart over the method
+// channel (a Uint8List FlValue in a StandardMethodCodec success envelope)
+// with the "desktop_screenshot/frames" binary message (header and payload
+// in one buffer handed to the engine as GBytes). Both end with the GBytes
+// the engine sends; the engine's own copy to Dart is the same for both.
+//
+// Build the example app with tests enabled, then run e.g.
+// $ build/linux/x64/release/plugins/desktop_screenshot/desktop_screenshot_frame_channel_benchmark
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "frame_message.h"
+
+namespace {
+
+using desktop_screenshot::Frame;
+
+constexpr int kIterations = 20;
+
+double MillisecondsPerRun(const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+Frame MakeFrame(int width, int height) {
+  std::mt19937 rng(3);
+  Frame frame;
+  frame.Allocate(width, height);
+  for (uint8_t& byte : frame.pixels) byte = static_cast<uint8_t>(rng());
+  return frame;
+}
+
+// What the method channel does for a frame: tight rows into a vector, the
+// vector into a Uint8List value, the value into a codec envelope.
+size_t SendOverMethodChannel(FlMethodCodec* codec, const Frame& frame) {
+  std::vector<uint8_t> pixels(frame.pixels.size());
+  std::memcpy(pixels.data(), frame.pixels.data(), pixels.size());
+  g_autoptr(FlValue) value = fl_value_new_uint8_list(pixels.data(),
+                                                     pixels.size());
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GBytes) envelope =
+      fl_method_codec_encode_success_envelope(codec, value, &error);
+  return envelope ? g_bytes_get_size(envelope) : 0;
+}
+
+size_t SendOverFrameChannel(const Frame& frame) {
+  auto* owned = new std::vector<uint8_t>(
+      desktop_screenshot::BuildPixelMessage(frame, 0));
+  g_autoptr(GBytes) message = g_bytes_new_with_free_func(
+      owned->data(), owned->size(),
+      [](gpointer data) { delete static_cast<std::vector<uint8_t>*>(data); },
+      owned);
+  return g_bytes_get_size(message);
+}
+
+void Report(const char* name, int width, int height) {
+  Frame frame = MakeFrame(width, height);
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  size_t method_bytes = 0;
+  size_t frame_bytes = 0;
+  const double method_ms = MillisecondsPerRun([&] {
+    method_bytes = SendOverMethodChannel(FL_METHOD_CODEC(codec), frame);
+  });
+  const double frame_ms =
+      MillisecondsPerRun([&] { frame_bytes = SendOverFrameChannel(frame); });
+  const double megabytes = frame.pixels.size() / 1e6;
+  std::printf("%-5s %4dx%-4d %6.1f MB  method channel %7.2f ms (%6.0f MB/s, "
+              "%zu B)  frame channel %7.2f ms (%6.0f MB/s, %zu B)  %.1fx\n",
+              name, width, height, megabytes, method_ms,
+              megabytes / (method_ms / 1000), method_bytes, frame_ms,
+              megabytes / (frame_ms / 1000), frame_bytes,
+              method_ms / frame_ms);
+}
+
+}  // namespace
+
+int main() {
+  std::printf("Raw BGRA frame to the GBytes handed to the engine, "
+              "%d iterations\n", kIterations);
+  Report("720p", 1280, 720);
+  Report("1440p", 2560, 1440);
+  Report("4K", 3840, 2160);
+  return 0;
+}
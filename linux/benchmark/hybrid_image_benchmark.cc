@@ -0,0 +1,172 @@
+// Compares the truecolor PNGs gdk-pixbuf writes for getScreenshot with
+// getHybridScreenshot's container, on synthetic screens mixing text with
+// photo or video panes.
+//
+// Build the example app with tests enabled, then run e.g.
+// $ build/linux/x64/release/plugins/desktop_screenshot/desktop_screenshot_hybrid_image_benchmark
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "hybrid_image.h"
+#include "palette.h"
+#include "png_writer.h"
+
+namespace {
+
+using desktop_screenshot::EncodeSettings;
+using desktop_screenshot::Frame;
+using desktop_screenshot::HybridOptions;
+using desktop_screenshot::HybridStats;
+using desktop_screenshot::ImageFormat;
+using desktop_screenshot::IndexedImage;
+using desktop_screenshot::PaletteMode;
+using desktop_screenshot::Rect;
+
+constexpr int kWidth = 2560;
+constexpr int kHeight = 1440;
+constexpr int kIterations = 5;
+
+void Put(Frame* frame, int x, int y, uint32_t argb) {
+  std::memcpy(frame->Row(y) + x * 4, &argb, 4);
+}
+
+// Light background with rows of dark "glyph" runs, like a browser page.
+void PaintText(Frame* frame, unsigned seed) {
+  std::mt19937 rng(seed);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) Put(frame, x, y, 0xFFF6F6F6);
+  }
+  for (int line = 0; line + 14 < kHeight; line += 18) {
+    for (int x = 8; x + 9 < kWidth; x += 9) {
+      if (rng() % 5 == 0) continue;
+      uint32_t color = rng() % 8 == 0 ? 0xFF1A4FB0 : 0xFF202020;
+      for (int y = line; y < line + 14; ++y) {
+        uint32_t bits = rng();
+        for (int i = 0; i < 7; ++i) {
+          if (bits & (1u << i)) Put(frame, x + i, y, color);
+        }
+      }
+    }
+  }
+}
+
+// Smooth gradients with sensor-like noise over |rect|.
+void PaintPhoto(Frame* frame, const Rect& rect) {
+  std::mt19937 rng(7);
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    for (int x = rect.x; x < rect.x + rect.width; ++x) {
+      uint32_t r = ((x - rect.x) * 255 / rect.width + rng() % 12) & 0xFF;
+      uint32_t g = ((y - rect.y) * 255 / rect.height + rng() % 12) & 0xFF;
+      uint32_t b = (96 + rng() % 12) & 0xFF;
+      Put(frame, x, y, 0xFF000000u | (r << 16) | (g << 8) | b);
+    }
+  }
+}
+
+Frame MakeScreen(const std::vector<Rect>& photos) {
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  PaintText(&frame, 1);
+  for (const Rect& rect : photos) PaintPhoto(&frame, rect);
+  return frame;
+}
+
+double MillisecondsPerRun(const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+GdkPixbuf* ToPixbuf(const Frame& frame) {
+  GdkPixbuf* pixbuf =
+      gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, frame.width, frame.height);
+  guint8* pixels = gdk_pixbuf_get_pixels(pixbuf);
+  int stride = gdk_pixbuf_get_rowstride(pixbuf);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* src = frame.Row(y);
+    guint8* dst = pixels + y * stride;
+    for (int x = 0; x < frame.width; ++x, src += 4, dst += 3) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+  }
+  return pixbuf;
+}
+
+// The layers as the plugin encodes them: indexed PNG when the palette
+// fits, otherwise gdk-pixbuf PNG or JPEG.
+bool EncodeLayer(const Frame& frame, const EncodeSettings& settings,
+                 std::vector<uint8_t>* out) {
+  if (settings.format == ImageFormat::kPng &&
+      settings.palette != PaletteMode::kOff) {
+    IndexedImage indexed;
+    if (desktop_screenshot::BuildIndexedImage(frame, settings.palette,
+                                              &indexed)) {
+      *out = desktop_screenshot::EncodeIndexedPng(indexed, settings.level);
+      return true;
+    }
+  }
+  GdkPixbuf* pixbuf = ToPixbuf(frame);
+  const bool jpeg = settings.format == ImageFormat::kJpeg;
+  gchar* level = g_strdup_printf("%d", settings.level);
+  gchar* buffer = nullptr;
+  gsize size = 0;
+  bool ok = gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size,
+                                      jpeg ? "jpeg" : "png", nullptr,
+                                      jpeg ? "quality" : "compression", level,
+                                      nullptr);
+  if (ok) out->assign(buffer, buffer + size);
+  g_free(buffer);
+  g_free(level);
+  g_object_unref(pixbuf);
+  return ok;
+}
+
+// The current getScreenshot path: an RGB pixbuf saved as PNG.
+size_t EncodeTruecolor(const Frame& frame) {
+  GdkPixbuf* pixbuf = ToPixbuf(frame);
+  gchar* buffer = nullptr;
+  gsize size = 0;
+  gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size, "png", nullptr, nullptr);
+  g_free(buffer);
+  g_object_unref(pixbuf);
+  return size;
+}
+
+void Report(const char* name, const Frame& frame) {
+  size_t png_size = 0;
+  double png_ms =
+      MillisecondsPerRun([&] { png_size = EncodeTruecolor(frame); });
+  std::vector<uint8_t> hybrid;
+  HybridStats stats;
+  double hybrid_ms = MillisecondsPerRun([&] {
+    desktop_screenshot::EncodeHybridImage(frame, HybridOptions(), EncodeLayer,
+                                          &hybrid, &stats);
+  });
+  std::printf("%-16s png %9zu B %7.1f ms | hybrid (%4d/%4d photo tiles) "
+              "%9zu B %7.1f ms | %.1fx smaller\n",
+              name, png_size, png_ms, stats.photo_tiles, stats.tiles,
+              hybrid.size(), hybrid_ms, double(png_size) / hybrid.size());
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%dx%d, mean of %d runs\n", kWidth, kHeight, kIterations);
+  Report("text only", MakeScreen({}));
+  Report("video pane", MakeScreen({Rect{1280, 180, 1120, 630}}));
+  Report("photo gallery",
+         MakeScreen({Rect{100, 100, 700, 500}, Rect{900, 100, 700, 500},
+                     Rect{1700, 100, 700, 500}, Rect{100, 700, 2300, 600}}));
+  return 0;
+}
@@ -0,0 +1,146 @@
+// Compares the truecolor PNGs gdk-pixbuf writes for getScreenshot with the
+// indexed PNGs produced by palette mode, on synthetic screens.
+//
+// Build the example app with tests enabled, then run e.g.
+// $ build/linux/x64/release/plugins/desktop_screenshot/desktop_screenshot_palette_benchmark
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+
+#include "palette.h"
+#include "png_writer.h"
+
+namespace {
+
+using desktop_screenshot::Frame;
+using desktop_screenshot::IndexedImage;
+using desktop_screenshot::PaletteMode;
+
+constexpr int kWidth = 2560;
+constexpr int kHeight = 1440;
+constexpr int kIterations = 5;
+
+void Put(Frame* frame, int x, int y, uint32_t argb) {
+  std::memcpy(frame->Row(y) + x * 4, &argb, 4);
+}
+
+// Dark background with rows of short colored "glyph" runs drawn from
+// |colors| syntax-highlighting colors, like a terminal or code editor.
+Frame MakeTextScreen(int colors, unsigned seed) {
+  std::mt19937 rng(seed);
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) Put(&frame, x, y, 0xFF1E1E1E);
+  }
+  std::vector<uint32_t> palette;
+  for (int i = 0; i < colors; ++i) palette.push_back(0xFF000000u | rng());
+  for (int line = 0; line + 14 < kHeight; line += 18) {
+    for (int x = 8; x + 9 < kWidth; x += 9) {
+      if (rng() % 5 == 0) continue;
+      uint32_t color = palette[rng() % palette.size()];
+      for (int y = line; y < line + 14; ++y) {
+        uint32_t bits = rng();
+        for (int i = 0; i < 7; ++i) {
+          if (bits & (1u << i)) Put(&frame, x + i, y, color);
+        }
+      }
+    }
+  }
+  return frame;
+}
+
+// Smooth gradients with noise: far more than 256 colors.
+Frame MakePhotoScreen() {
+  std::mt19937 rng(7);
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      uint32_t r = (x * 255 / kWidth + rng() % 8) & 0xFF;
+      uint32_t g = (y * 255 / kHeight + rng() % 8) & 0xFF;
+      uint32_t b = ((x + y) * 255 / (kWidth + kHeight)) & 0xFF;
+      Put(&frame, x, y, 0xFF000000u | (r << 16) | (g << 8) | b);
+    }
+  }
+  return frame;
+}
+
+double MillisecondsPerRun(const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+// The current getScreenshot path: an RGB pixbuf saved as PNG.
+size_t EncodeTruecolor(const Frame& frame) {
+  GdkPixbuf* pixbuf =
+      gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, frame.width, frame.height);
+  guint8* pixels = gdk_pixbuf_get_pixels(pixbuf);
+  int stride = gdk_pixbuf_get_rowstride(pixbuf);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* src = frame.Row(y);
+    guint8* dst = pixels + y * stride;
+    for (int x = 0; x < frame.width; ++x, src += 4, dst += 3) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+  }
+  gchar* buffer = nullptr;
+  gsize size = 0;
+  gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size, "png", nullptr, nullptr);
+  g_free(buffer);
+  g_object_unref(pixbuf);
+  return size;
+}
+
+size_t EncodeIndexed(const Frame& frame, PaletteMode mode, int* colors) {
+  IndexedImage indexed;
+  if (!desktop_screenshot::BuildIndexedImage(frame, mode, &indexed)) {
+    *colors = -1;
+    return 0;
+  }
+  *colors = static_cast<int>(indexed.palette.size());
+  return desktop_screenshot::EncodeIndexedPng(indexed).size();
+}
+
+void Report(const char* name, const Frame& frame, PaletteMode mode) {
+  size_t truecolor_size = 0;
+  double truecolor_ms =
+      MillisecondsPerRun([&] { truecolor_size = EncodeTruecolor(frame); });
+  size_t indexed_size = 0;
+  int colors = 0;
+  double indexed_ms = MillisecondsPerRun(
+      [&] { indexed_size = EncodeIndexed(frame, mode, &colors); });
+
+  if (colors < 0) {
+    std::printf("%-18s truecolor %9zu B %7.1f ms | indexed: too many colors, "
+                "bailed out in %.1f ms\n",
+                name, truecolor_size, truecolor_ms, indexed_ms);
+    return;
+  }
+  std::printf("%-18s truecolor %9zu B %7.1f ms | indexed (%3d colors) %9zu B "
+              "%7.1f ms | %.1fx smaller, %.1fx faster\n",
+              name, truecolor_size, truecolor_ms, colors, indexed_size,
+              indexed_ms, double(truecolor_size) / indexed_size,
+              truecolor_ms / indexed_ms);
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%dx%d, mean of %d runs\n", kWidth, kHeight, kIterations);
+  Report("terminal (8)", MakeTextScreen(8, 1), PaletteMode::kExact);
+  Report("ide (40)", MakeTextScreen(40, 2), PaletteMode::kExact);
+  Report("photo exact", MakePhotoScreen(), PaletteMode::kExact);
+  Report("photo quantize", MakePhotoScreen(), PaletteMode::kQuantize);
+  return 0;
+}
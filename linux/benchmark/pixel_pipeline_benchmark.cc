@@ -0,0 +1,159 @@
+// Compares the fused, layout-specialized pixel loops of pixel_pipeline.h
+// with the staged conversions they replaced: a per-pixel channel-count
+// branch for each conversion and a full-size intermediate frame between
+// stages. Single core, synthetic 2560x1440 pixbuf-style RGB input.
+//
+// Build the example app with tests enabled, then run e.g.
+// $ build/linux/x64/release/plugins/desktop_screenshot/desktop_screenshot_pixel_pipeline_benchmark
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "frame.h"
+#include "pixel_pipeline.h"
+#include "scale.h"
+
+namespace {
+
+using desktop_screenshot::BgraPixels;
+using desktop_screenshot::Frame;
+using desktop_screenshot::RgbPixels;
+
+constexpr int kWidth = 2560;
+constexpr int kHeight = 1440;
+constexpr int kIterations = 20;
+
+// An RGB image with pixbuf-style row padding.
+struct Image {
+  int width = 0;
+  int height = 0;
+  int channels = 3;
+  int stride = 0;
+  std::vector<uint8_t> pixels;
+
+  void Allocate(int w, int h, int c) {
+    width = w;
+    height = h;
+    channels = c;
+    stride = (w * c + 3) & ~3;
+    pixels.assign(static_cast<size_t>(stride) * h, 0);
+  }
+};
+
+Image MakeScreen() {
+  std::mt19937 rng(3);
+  Image image;
+  image.Allocate(kWidth, kHeight, 3);
+  for (int y = 0; y < kHeight; ++y) {
+    uint8_t* p = image.pixels.data() + static_cast<size_t>(y) * image.stride;
+    for (int x = 0; x < kWidth; ++x, p += 3) {
+      p[0] = static_cast<uint8_t>(x * 255 / kWidth + rng() % 16);
+      p[1] = static_cast<uint8_t>(y * 255 / kHeight);
+      p[2] = static_cast<uint8_t>(rng());
+    }
+  }
+  return image;
+}
+
+// The conversions as they were written before pixel_pipeline.h: the
+// channel count is a run-time value tested for every pixel.
+void StagedToFrame(const Image& image, Frame* frame) {
+  frame->Allocate(image.width, image.height);
+  for (int y = 0; y < frame->height; ++y) {
+    const uint8_t* src =
+        image.pixels.data() + static_cast<size_t>(y) * image.stride;
+    uint8_t* dst = frame->Row(y);
+    for (int x = 0; x < frame->width; ++x, src += image.channels, dst += 4) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = image.channels == 4 ? src[3] : 0xFF;
+    }
+  }
+}
+
+void StagedToImage(const Frame& frame, Image* image) {
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* src = frame.Row(y);
+    uint8_t* dst =
+        image->pixels.data() + static_cast<size_t>(y) * image->stride;
+    for (int x = 0; x < frame.width; ++x, src += 4, dst += image->channels) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      if (image->channels == 4) dst[3] = src[3];
+    }
+  }
+}
+
+double MillisecondsPerRun(const std::function<void()>& run) {
+  run();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+void Report(const char* name, double staged_ms, double fused_ms) {
+  const double megapixels = static_cast<double>(kWidth) * kHeight / 1e6;
+  std::printf("%-28s staged %7.0f Mpx/s  fused %7.0f Mpx/s  %5.2fx\n", name,
+              megapixels / (staged_ms / 1000), megapixels / (fused_ms / 1000),
+              staged_ms / fused_ms);
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%dx%d RGB, %d iterations, one core\n", kWidth, kHeight,
+              kIterations);
+  const Image screen = MakeScreen();
+
+  // Grab to frame: RGB pixbuf into BGRA.
+  Frame frame;
+  double staged = MillisecondsPerRun([&] { StagedToFrame(screen, &frame); });
+  double fused = MillisecondsPerRun([&] {
+    frame.Allocate(screen.width, screen.height);
+    desktop_screenshot::ConvertPixels<RgbPixels, BgraPixels>(
+        screen.pixels.data(), screen.stride, frame.Row(0), frame.stride,
+        frame.width, frame.height);
+  });
+  Report("rgb -> bgra", staged, fused);
+
+  // Frame to encoder input: BGRA into an RGB pixbuf.
+  Image out;
+  out.Allocate(kWidth, kHeight, 3);
+  staged = MillisecondsPerRun([&] { StagedToImage(frame, &out); });
+  fused = MillisecondsPerRun([&] {
+    desktop_screenshot::ConvertPixels<BgraPixels, RgbPixels>(
+        frame.Row(0), frame.stride, out.pixels.data(), out.stride,
+        frame.width, frame.height);
+  });
+  Report("bgra -> rgb", staged, fused);
+
+  // A half-size capture ready for the encoder: convert, downscale and
+  // convert back, with two intermediate frames, against one pass.
+  for (int scale : {2, 4}) {
+    Image small;
+    small.Allocate(kWidth / scale, kHeight / scale, 3);
+    staged = MillisecondsPerRun([&] {
+      Frame converted;
+      StagedToFrame(screen, &converted);
+      Frame scaled = desktop_screenshot::ScaleFrame(
+          converted, kWidth / scale, kHeight / scale);
+      StagedToImage(scaled, &small);
+    });
+    fused = MillisecondsPerRun([&] {
+      desktop_screenshot::ConvertDownscaled<RgbPixels, RgbPixels>(
+          screen.pixels.data(), screen.stride, kWidth, kHeight, scale,
+          small.pixels.data(), small.stride);
+    });
+    char name[32];
+    std::snprintf(name, sizeof(name), "rgb -> 1/%d -> rgb", scale);
+    Report(name, staged, fused);
+  }
+  return 0;
+}
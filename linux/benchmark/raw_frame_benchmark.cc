@@ -0,0 +1,126 @@
+// Measures the raw-frame container (predictor + LZ4) on synthetic screens:
+// compression ratio and single-core encode/decode throughput for each
+// predictor.
+//
+// Build the example app with tests enabled, then run e.g.
+// $ build/linux/x64/release/plugins/desktop_screenshot/desktop_screenshot_raw_frame_benchmark
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "raw_frame.h"
+
+namespace {
+
+using desktop_screenshot::Frame;
+using desktop_screenshot::FramePredictor;
+
+constexpr int kWidth = 2560;
+constexpr int kHeight = 1440;
+constexpr int kIterations = 10;
+
+void Put(Frame* frame, int x, int y, uint32_t argb) {
+  std::memcpy(frame->Row(y) + x * 4, &argb, 4);
+}
+
+// Dark background with rows of short colored "glyph" runs, like a code
+// editor.
+Frame MakeTextScreen() {
+  std::mt19937 rng(1);
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) Put(&frame, x, y, 0xFF1E1E1E);
+  }
+  for (int line = 0; line + 14 < kHeight; line += 18) {
+    for (int x = 8; x + 9 < kWidth; x += 9) {
+      if (rng() % 5 == 0) continue;
+      uint32_t color = 0xFF000000u | (rng() % 6) * 0x2A2A2A;
+      for (int y = line; y < line + 14; ++y) {
+        uint32_t bits = rng();
+        for (int i = 0; i < 7; ++i) {
+          if (bits & (1u << i)) Put(&frame, x + i, y, color);
+        }
+      }
+    }
+  }
+  return frame;
+}
+
+// Flat panels with a vertical gradient title bar, like a desktop UI.
+Frame MakeUiScreen() {
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      uint32_t color = x < 300 ? 0xFF2B2D30 : 0xFFF5F5F5;
+      if (y < 40) color = 0xFF000000u | static_cast<uint32_t>(0x40 + y * 2) * 0x010101;
+      Put(&frame, x, y, color);
+    }
+  }
+  return frame;
+}
+
+// Smooth gradients with noise.
+Frame MakePhotoScreen() {
+  std::mt19937 rng(7);
+  Frame frame;
+  frame.Allocate(kWidth, kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      uint32_t r = (x * 255 / kWidth + rng() % 8) & 0xFF;
+      uint32_t g = (y * 255 / kHeight + rng() % 8) & 0xFF;
+      uint32_t b = ((x + y) * 255 / (kWidth + kHeight)) & 0xFF;
+      Put(&frame, x, y, 0xFF000000u | (r << 16) | (g << 8) | b);
+    }
+  }
+  return frame;
+}
+
+double MillisecondsPerRun(const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+void Report(const char* name, const Frame& frame) {
+  const double megabytes = frame.pixels.size() / 1e6;
+  const struct {
+    const char* name;
+    FramePredictor predictor;
+  } predictors[] = {{"none", FramePredictor::kNone},
+                    {"left", FramePredictor::kLeft},
+                    {"up", FramePredictor::kUp}};
+  for (const auto& entry : predictors) {
+    std::vector<uint8_t> encoded;
+    double encode_ms = MillisecondsPerRun([&] {
+      encoded = desktop_screenshot::EncodeRawFrame(frame, 0, entry.predictor);
+    });
+    Frame decoded;
+    double decode_ms = MillisecondsPerRun([&] {
+      desktop_screenshot::DecodeRawFrame(encoded.data(), encoded.size(),
+                                         &decoded, nullptr);
+    });
+    std::printf("%-6s %-5s %6.1fx  encode %7.0f MB/s  decode %7.0f MB/s\n",
+                name, entry.name,
+                static_cast<double>(frame.pixels.size()) / encoded.size(),
+                megabytes / (encode_ms / 1000), megabytes / (decode_ms / 1000));
+  }
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%dx%d BGRA, %d iterations, one core\n", kWidth, kHeight,
+              kIterations);
+  Report("text", MakeTextScreen());
+  Report("ui", MakeUiScreen());
+  Report("photo", MakePhotoScreen());
+  return 0;
+}
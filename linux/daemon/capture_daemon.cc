@@ -0,0 +1,110 @@
+// Captures the screen at a fixed rate and publishes every frame into a
+// shared-memory ring, so several local processes (each running the plugin
+// in client mode via attachFrameRing) can read the same frames without
+// grabbing the screen themselves.
+//
+//   desktop_screenshot_capture_daemon [--name /desktop_screenshot]
+//                                     [--fps 30] [--slots 4]
+
+#include <gdk/gdk.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "frame.h"
+#include "frame_ring.h"
+#include "screen_capture.h"
+
+namespace {
+
+std::atomic<bool> g_running(true);
+
+void HandleSignal(int) { g_running = false; }
+
+// Without a main loop GDK only learns of resolution changes (RandR and root
+// ConfigureNotify events) when its queue is read, and until then keeps
+// grabbing at the old root size.
+void DrainGdkEvents() {
+  while (GdkEvent* event = gdk_event_get()) gdk_event_free(event);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  gdk_init(&argc, &argv);
+
+  std::string name = "/desktop_screenshot";
+  int fps = 30;
+  int slots = 4;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--name") == 0) {
+      name = argv[i + 1];
+    } else if (std::strcmp(argv[i], "--fps") == 0) {
+      fps = std::atoi(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--slots") == 0) {
+      slots = std::atoi(argv[i + 1]);
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (fps <= 0 || slots < 2) {
+    std::fprintf(stderr, "--fps must be positive and --slots at least 2\n");
+    return 2;
+  }
+
+  desktop_screenshot::Frame frame;
+  if (!capture_root_frame(&frame)) {
+    std::fprintf(stderr, "failed to capture the screen\n");
+    return 1;
+  }
+  // Slots are sized for the current screen. A larger screen gets a new
+  // ring under the same name; attached clients notice the old one closed
+  // and reopen it.
+  std::unique_ptr<desktop_screenshot::FrameRingWriter> ring =
+      desktop_screenshot::FrameRingWriter::Create(name, slots,
+                                                  frame.pixels.size());
+  if (!ring) {
+    std::fprintf(stderr, "failed to create shared memory %s\n", name.c_str());
+    return 1;
+  }
+
+  std::signal(SIGINT, HandleSignal);
+  std::signal(SIGTERM, HandleSignal);
+
+  const auto period = std::chrono::nanoseconds(1000000000 / fps);
+  auto next = std::chrono::steady_clock::now();
+  while (g_running) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t timestamp = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch())
+            .count());
+    if (!ring->Publish(frame, timestamp)) {
+      // The old ring must be gone first: its destructor unlinks the name.
+      ring.reset();
+      ring = desktop_screenshot::FrameRingWriter::Create(name, slots,
+                                                         frame.pixels.size());
+      if (!ring || !ring->Publish(frame, timestamp)) {
+        std::fprintf(stderr, "failed to recreate shared memory %s for %dx%d\n",
+                     name.c_str(), frame.width, frame.height);
+        return 1;
+      }
+    }
+    // Skip missed ticks instead of bursting to catch up.
+    next += period;
+    if (next < now) next = now + period;
+    std::this_thread::sleep_until(next);
+    DrainGdkEvents();
+    if (!capture_root_frame(&frame)) break;
+  }
+  // The ring's destructor unlinks the shared-memory object.
+  return 0;
+}
@@ -1,12 +1,79 @@
 #include "include/desktop_screenshot/desktop_screenshot_plugin.h"
 
 #include <flutter_linux/flutter_linux.h>
+#include <gdk/gdkx.h>
 #include <gtk/gtk.h>
 #include <sys/utsname.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "capture_pipeline.h"
+#include "chunk_writer.h"
+#include "encode_budget.h"
 #include "desktop_screenshot_plugin_private.h"
+#include "encode_cache.h"
+#include "frame.h"
+#include "frame_hash.h"
+#include "frame_message.h"
+#include "frame_ring.h"
+#include "frame_store.h"
+#include "hybrid_image.h"
+#include "image_format.h"
+#include "memory_ledger.h"
+#include "monitor_capture.h"
+#include "palette.h"
+#include "parallel.h"
+#include "pixel_sample.h"
+#include "png_writer.h"
+#include "preview_texture.h"
+#include "raw_frame.h"
+#include "redaction.h"
+#include "scale.h"
+#include "screen_capture.h"
+#include "screen_stats.h"
+#include "task_pool.h"
+#include "template_match.h"
+#include "trace.h"
+#include "window_capture.h"
+
+using desktop_screenshot::BudgetPlanner;
+using desktop_screenshot::BudgetResult;
+using desktop_screenshot::ChunkWriter;
+using desktop_screenshot::EncodeCache;
+using desktop_screenshot::Frame;
+using desktop_screenshot::FramePayload;
+using desktop_screenshot::FrameRingReader;
+using desktop_screenshot::FrameStatus;
+using desktop_screenshot::FrameStore;
+using desktop_screenshot::HybridOptions;
+using desktop_screenshot::HybridStats;
+using desktop_screenshot::EncodeSettings;
+using desktop_screenshot::ImageFormat;
+using desktop_screenshot::IncrementalPngEncoder;
+using desktop_screenshot::IndexedImage;
+using desktop_screenshot::MemoryCharge;
+using desktop_screenshot::MemoryLedger;
+using desktop_screenshot::MemoryStage;
+using desktop_screenshot::PaletteMode;
+using desktop_screenshot::PipelineOutput;
+using desktop_screenshot::PipelineResult;
+using desktop_screenshot::Rect;
+using desktop_screenshot::Redaction;
+using desktop_screenshot::ScopedTrace;
+using desktop_screenshot::TaskPool;
+using desktop_screenshot::TemplateMatch;
+
+// A frame buffer prepare() has faulted in, and its bytes in the ledger.
+struct WarmFrame {
+  Frame frame;
+  MemoryCharge charge;
+};
 
 #define DESKTOP_SCREENSHOT_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), desktop_screenshot_plugin_get_type(), \
@@ -14,10 +81,95 @@
 
 struct _DesktopScreenshotPlugin {
   GObject parent_instance;
+
+  // Frames captured by captureHandle, awaiting crop/scale/encode/release.
+  FrameStore* frames;
+
+  // Last getScreenshot outputs, reused while the screen does not change.
+  EncodeCache* cache;
+
+  // Truecolor getScreenshot PNGs, re-deflating only the bands of the
+  // screen that changed since the previous one.
+  IncrementalPngEncoder* png;
+
+  // Shared-memory ring published by the capture daemon. While attached,
+  // getScreenshot and captureHandle read its latest frame instead of
+  // grabbing the screen themselves.
+  FrameRingReader* ring;
+
+  // Worker threads shared by every parallel stage and plugin instance.
+  // Each instance holds one reference; the last dispose joins them.
+  TaskPool* pool;
+
+  // Per-window capture, created on first use. Stays nullptr outside X11.
+  WindowCapturer* windows;
+
+  // Grabs every monitor concurrently in "parallel" monitor capture mode;
+  // nullptr in the default "sequential" mode, which grabs the root window
+  // through GDK in one piece.
+  MonitorCapturer* monitors;
+
+  // Settings picker for getBudgetedScreenshot, learning from each capture.
+  BudgetPlanner* budget;
+
+  // The full-size frame buffer warmed by prepare(), which the next capture
+  // grabs into instead of allocating; nullptr once taken.
+  WarmFrame* warm;
+
+  // Where the live preview's texture is registered.
+  FlTextureRegistrar* textures;
+
+  // The live preview while it runs, and the timeout that refreshes it.
+  PreviewTexture* preview;
+  guint preview_source;
 };
 
 G_DEFINE_TYPE(DesktopScreenshotPlugin, desktop_screenshot_plugin, g_object_get_type())
 
+static FlMethodResponse* get_screenshot(DesktopScreenshotPlugin* self,
+                                        FlValue* args);
+static FlMethodResponse* get_encode_cache_stats(DesktopScreenshotPlugin* self);
+static FlMethodResponse* get_budgeted_screenshot(DesktopScreenshotPlugin* self,
+                                                 FlValue* args);
+static FlMethodResponse* get_hybrid_screenshot(DesktopScreenshotPlugin* self,
+                                               FlValue* args);
+static FlMethodResponse* decode_hybrid_image(FlValue* args);
+static FlMethodResponse* attach_frame_ring(DesktopScreenshotPlugin* self,
+                                           FlValue* args);
+static FlMethodResponse* get_screenshot_regions(DesktopScreenshotPlugin* self,
+                                                FlValue* args);
+static FlMethodResponse* capture_pipeline(DesktopScreenshotPlugin* self,
+                                          FlValue* args);
+static FlMethodResponse* handle_frame_method(DesktopScreenshotPlugin* self,
+                                             const gchar* method,
+                                             FlValue* args);
+static FlMethodResponse* copy_screenshot_to_clipboard(
+    DesktopScreenshotPlugin* self);
+static FlMethodResponse* find_on_screen(DesktopScreenshotPlugin* self,
+                                        FlValue* args);
+static FlMethodResponse* sample_pixels(DesktopScreenshotPlugin* self,
+                                       FlValue* args);
+static FlMethodResponse* get_screen_stats(DesktopScreenshotPlugin* self,
+                                          FlValue* args);
+static FlMethodResponse* configure_thread_pool(DesktopScreenshotPlugin* self,
+                                               FlValue* args);
+static FlMethodResponse* get_thread_pool_stats(DesktopScreenshotPlugin* self);
+static FlMethodResponse* set_monitor_capture_mode(DesktopScreenshotPlugin* self,
+                                                  FlValue* args);
+static FlMethodResponse* get_memory_stats(DesktopScreenshotPlugin* self,
+                                          FlValue* args);
+static FlMethodResponse* set_memory_limit(FlValue* args);
+static FlMethodResponse* start_trace(FlValue* args);
+static FlMethodResponse* dump_trace(FlValue* args);
+static void prepare(DesktopScreenshotPlugin* self, FlMethodCall* method_call);
+static FlMethodResponse* list_windows(DesktopScreenshotPlugin* self);
+static FlMethodResponse* get_window_screenshot(DesktopScreenshotPlugin* self,
+                                               FlValue* args);
+static void read_image_from_clipboard(FlMethodCall* method_call);
+static FlMethodResponse* start_preview(DesktopScreenshotPlugin* self,
+                                       FlValue* args);
+static void stop_preview(DesktopScreenshotPlugin* self);
+
 // Called when a method call is received from Flutter.
 static void desktop_screenshot_plugin_handle_method_call(
     DesktopScreenshotPlugin* self,
@@ -25,9 +177,84 @@ static void desktop_screenshot_plugin_handle_method_call(
   g_autoptr(FlMethodResponse) response = nullptr;
 
   const gchar* method = fl_method_call_get_name(method_call);
+  ScopedTrace request(desktop_screenshot::InternTraceName(method), "request");
 
   if (strcmp(method, "getPlatformVersion") == 0) {
     response = get_platform_version();
+  } else if (strcmp(method, "getScreenshot") == 0) {
+    response = get_screenshot(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getBudgetedScreenshot") == 0) {
+    response =
+        get_budgeted_screenshot(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getHybridScreenshot") == 0) {
+    response =
+        get_hybrid_screenshot(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "decodeHybridImage") == 0) {
+    response = decode_hybrid_image(fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getEncodeCacheStats") == 0) {
+    response = get_encode_cache_stats(self);
+  } else if (strcmp(method, "clearEncodeCache") == 0) {
+    self->cache->Clear();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (strcmp(method, "attachFrameRing") == 0) {
+    response = attach_frame_ring(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "detachFrameRing") == 0) {
+    delete self->ring;
+    self->ring = nullptr;
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (strcmp(method, "getScreenshotRegions") == 0) {
+    response =
+        get_screenshot_regions(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "capturePipeline") == 0) {
+    response = capture_pipeline(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "captureHandle") == 0 ||
+             strcmp(method, "encodeHandle") == 0 ||
+             strcmp(method, "cropHandle") == 0 ||
+             strcmp(method, "scaleHandle") == 0 ||
+             strcmp(method, "releaseHandle") == 0 ||
+             strcmp(method, "setHandleMemoryLimit") == 0) {
+    response = handle_frame_method(self, method,
+                                   fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "copyScreenshotToClipboard") == 0) {
+    response = copy_screenshot_to_clipboard(self);
+  } else if (strcmp(method, "findOnScreen") == 0) {
+    response = find_on_screen(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "samplePixels") == 0) {
+    response = sample_pixels(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getScreenStats") == 0) {
+    response = get_screen_stats(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "configureThreadPool") == 0) {
+    response =
+        configure_thread_pool(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getThreadPoolStats") == 0) {
+    response = get_thread_pool_stats(self);
+  } else if (strcmp(method, "setMonitorCaptureMode") == 0) {
+    response =
+        set_monitor_capture_mode(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getMemoryStats") == 0) {
+    response = get_memory_stats(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "setMemoryLimit") == 0) {
+    response = set_memory_limit(fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "startTrace") == 0) {
+    response = start_trace(fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "stopTrace") == 0) {
+    desktop_screenshot::StopTracing();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (strcmp(method, "dumpTrace") == 0) {
+    response = dump_trace(fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "prepare") == 0) {
+    prepare(self, method_call);
+    return;
+  } else if (strcmp(method, "listWindows") == 0) {
+    response = list_windows(self);
+  } else if (strcmp(method, "getWindowScreenshot") == 0) {
+    response =
+        get_window_screenshot(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "startPreview") == 0) {
+    response = start_preview(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "stopPreview") == 0) {
+    stop_preview(self);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
   } else if (strcmp(method, "readImageFromClipboard") == 0) {
       read_image_from_clipboard(method_call);
       return;
@@ -35,6 +262,7 @@ static void desktop_screenshot_plugin_handle_method_call(
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
 
+  ScopedTrace reply("reply");
   fl_method_call_respond(method_call, response, nullptr);
 }
 
@@ -46,6 +274,1158 @@ FlMethodResponse* get_platform_version() {
   return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 }
 
+// The rects of every monitor GDK reports, in root window coordinates and
+// device pixels, which is what the X grabs take.
+static std::vector<Rect> monitor_rects() {
+  GdkDisplay* display = gdk_display_get_default();
+  std::vector<Rect> monitors;
+  for (int i = 0; i < gdk_display_get_n_monitors(display); ++i) {
+    GdkMonitor* monitor = gdk_display_get_monitor(display, i);
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(monitor, &geometry);
+    monitors.push_back(MonitorDeviceRect(
+        Rect{geometry.x, geometry.y, geometry.width, geometry.height},
+        gdk_monitor_get_scale_factor(monitor)));
+  }
+  return monitors;
+}
+
+// The size of a full-desktop grab: the root window in device pixels. GDK
+// sizes windows in application pixels; desktop coordinates, which every
+// method's rects and points are in, are device pixels like the frames.
+static void desktop_size(int* width, int* height) {
+  GdkWindow* root = gdk_get_default_root_window();
+  const int scale = gdk_window_get_scale_factor(root);
+  *width = gdk_window_get_width(root) * scale;
+  *height = gdk_window_get_height(root) * scale;
+}
+
+// Grabs every monitor GDK reports concurrently, falling back to the root
+// window if that fails (e.g. the layout changed under it).
+static bool capture_monitors(DesktopScreenshotPlugin* self, Frame* frame) {
+  return self->monitors->Capture(monitor_rects(), frame) ||
+         capture_root_frame(frame);
+}
+
+// The attached ring, reopened by name once the daemon has replaced it (it
+// does when the screen grows). nullptr outside client mode.
+static FrameRingReader* attached_ring(DesktopScreenshotPlugin* self) {
+  if (self->ring && self->ring->closed()) {
+    std::unique_ptr<FrameRingReader> ring =
+        FrameRingReader::Open(self->ring->name());
+    if (ring) {
+      delete self->ring;
+      self->ring = ring.release();
+    }
+  }
+  return self->ring;
+}
+
+// Grabs |rect| of the root window, in device pixels, into |frame|. GDK
+// takes application pixels and returns device pixels: this grabs the
+// application pixels covering |rect| and crops |rect| out of them.
+static bool grab_device_rect(GdkWindow* root, const Rect& rect,
+                             Frame* frame) {
+  const int scale = gdk_window_get_scale_factor(root);
+  const int x = rect.x / scale;
+  const int y = rect.y / scale;
+  ScopedTrace trace("grab");
+  g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_get_from_window(
+      root, x, y, (rect.x + rect.width + scale - 1) / scale - x,
+      (rect.y + rect.height + scale - 1) / scale - y);
+  if (!pixbuf) return false;
+  pixbuf_to_frame(pixbuf, frame);
+  if (scale > 1) {
+    *frame = desktop_screenshot::CropFrame(
+        *frame,
+        Rect{rect.x - x * scale, rect.y - y * scale, rect.width, rect.height});
+  }
+  return true;
+}
+
+// Takes the current screen contents: the attached ring's latest frame in
+// client mode, otherwise a fresh grab of the desktop, planned against the
+// memory ceiling. A grab that does not fit in one piece is taken in
+// stripes of the root window, downscaled by up to |max_scale|. |charge|
+// holds the frame's bytes in the ledger for as long as the caller keeps
+// it.
+static bool capture_frame_scaled(DesktopScreenshotPlugin* self, Frame* frame,
+                                 MemoryCharge* charge, int max_scale) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  if (self->warm) {
+    // Every path below sizes |frame| with Allocate or assign, which keep
+    // the warm buffer's pages when it is large enough.
+    frame->pixels.swap(self->warm->frame.pixels);
+    delete self->warm;
+    self->warm = nullptr;
+  }
+  if (attached_ring(self)) {
+    ScopedTrace trace("grab");
+    if (!self->ring->ReadLatest(frame, nullptr)) return false;
+    *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+    return true;
+  }
+
+  GdkWindow* root = gdk_get_default_root_window();
+  int width = 0;
+  int height = 0;
+  desktop_size(&width, &height);
+  // GDK grabs into an RGB pixbuf, parallel mode into BGRX SHM segments.
+  const int grab_bpp = self->monitors ? 4 : 3;
+  desktop_screenshot::CapturePlan plan = desktop_screenshot::PlanCapture(
+      ledger.Available(), width, height, grab_bpp, max_scale);
+  if (!plan.possible) {
+    ledger.NoteRefused();
+    return false;
+  }
+
+  if (!plan.degraded()) {
+    MemoryCharge grab = ledger.Charge(
+        MemoryStage::kGrab, static_cast<size_t>(width) * height * grab_bpp);
+    bool ok = self->monitors ? capture_monitors(self, frame)
+                             : capture_root_frame(frame);
+    if (!ok) return false;
+    *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+    return true;
+  }
+
+  ledger.NoteDegraded();
+  *charge = ledger.Charge(MemoryStage::kFrame,
+                          static_cast<size_t>(plan.width) * plan.height * 4);
+  return desktop_screenshot::CaptureInStripes(
+      plan, width, height,
+      [&ledger, root](const Rect& rect, Frame* stripe) {
+        MemoryCharge grab = ledger.Charge(
+            MemoryStage::kGrab,
+            static_cast<size_t>(rect.width) * rect.height * (3 + 4));
+        return grab_device_rect(root, rect, stripe);
+      },
+      frame);
+}
+
+// A full-size capture, for callers that work in desktop coordinates.
+static bool capture_frame(DesktopScreenshotPlugin* self, Frame* frame,
+                          MemoryCharge* charge) {
+  return capture_frame_scaled(self, frame, charge, 1);
+}
+
+// A capture whose only use is an image of the desktop, which may come out
+// downscaled under a tight memory ceiling.
+static bool capture_image_frame(DesktopScreenshotPlugin* self, Frame* frame,
+                                MemoryCharge* charge) {
+  return capture_frame_scaled(self, frame, charge,
+                              desktop_screenshot::kMaxCaptureScale);
+}
+
+// Takes |area| of the screen, in desktop coordinates, at full size: copied
+// out of the attached ring's latest frame in place in client mode,
+// otherwise grabbed alone through GDK, planned against the memory ceiling
+// and taken in stripes when it does not fit in one piece. |area| is
+// clamped to the desktop first; an area off the desktop leaves |frame|
+// empty. |charge| holds the frame's bytes like capture_frame's.
+static bool capture_area(DesktopScreenshotPlugin* self, Rect* area,
+                         Frame* frame, MemoryCharge* charge) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  if (attached_ring(self)) {
+    FrameRingReader::View view;
+    for (int attempt = 0; attempt < 4; ++attempt) {
+      if (!self->ring->AcquireLatest(&view)) return false;
+      *area = desktop_screenshot::ClampRect(*area, view.width, view.height);
+      if (area->IsEmpty()) return true;
+      frame->Allocate(area->width, area->height);
+      for (int y = 0; y < area->height; ++y) {
+        std::memcpy(frame->Row(y),
+                    view.pixels +
+                        static_cast<size_t>(area->y + y) * view.stride +
+                        area->x * 4,
+                    frame->stride);
+      }
+      if (self->ring->StillValid(view)) {
+        *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int width = 0;
+  int height = 0;
+  desktop_size(&width, &height);
+  *area = desktop_screenshot::ClampRect(*area, width, height);
+  if (area->IsEmpty()) return true;
+  desktop_screenshot::CapturePlan plan = desktop_screenshot::PlanCapture(
+      ledger.Available(), area->width, area->height, 3, 1);
+  if (!plan.possible) {
+    ledger.NoteRefused();
+    return false;
+  }
+
+  GdkWindow* root = gdk_get_default_root_window();
+  if (!plan.degraded()) {
+    MemoryCharge grab = ledger.Charge(
+        MemoryStage::kGrab,
+        static_cast<size_t>(area->width) * area->height * 3);
+    if (!grab_device_rect(root, *area, frame)) return false;
+    *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+    return true;
+  }
+
+  ledger.NoteDegraded();
+  *charge = ledger.Charge(MemoryStage::kFrame,
+                          static_cast<size_t>(plan.width) * plan.height * 4);
+  const Rect origin = *area;
+  return desktop_screenshot::CaptureInStripes(
+      plan, area->width, area->height,
+      [&ledger, root, origin](const Rect& rect, Frame* stripe) {
+        MemoryCharge grab = ledger.Charge(
+            MemoryStage::kGrab,
+            static_cast<size_t>(rect.width) * rect.height * (3 + 4));
+        return grab_device_rect(
+            root,
+            Rect{origin.x + rect.x, origin.y + rect.y, rect.width,
+                 rect.height},
+            stripe);
+      },
+      frame);
+}
+
+// Encodes a BGRA frame through gdk-pixbuf, or into the raw-frame
+// container, into |out|, starting |offset| bytes in.
+static bool encode_frame_bytes(const Frame& frame, ImageFormat format,
+                               std::vector<uint8_t>* out,
+                               size_t offset = 0) {
+  if (format == ImageFormat::kRaw) {
+    *out = desktop_screenshot::EncodeRawFrame(
+        frame, desktop_screenshot::RawFrameTimestampNow(),
+        desktop_screenshot::FramePredictor::kLeft, offset);
+    return true;
+  }
+  g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
+                                               frame.width, frame.height);
+  if (!pixbuf) return false;
+  // The encoder's RGB copy of the frame, and gdk-pixbuf's own output
+  // until it is copied into |out|; callers charge |out|.
+  MemoryLedger& ledger = MemoryLedger::Process();
+  MemoryCharge input = ledger.Charge(
+      MemoryStage::kEncode,
+      static_cast<size_t>(gdk_pixbuf_get_rowstride(pixbuf)) * frame.height);
+  frame_to_pixbuf(frame, pixbuf);
+
+  ScopedTrace trace("encode");
+  g_autofree gchar* buffer = nullptr;
+  gsize buffer_size = 0;
+  if (!gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &buffer_size,
+                                 desktop_screenshot::ImageFormatName(format),
+                                 nullptr, nullptr)) {
+    return false;
+  }
+  MemoryCharge saved = ledger.Charge(MemoryStage::kEncode, buffer_size);
+  out->resize(offset + buffer_size);
+  std::memcpy(out->data() + offset, buffer, buffer_size);
+  return true;
+}
+
+static int64_t map_get_int(FlValue* map, const gchar* key, int64_t fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return fallback;
+  }
+  return fl_value_get_int(value);
+}
+
+// Reads the optional "format" argument, defaulting to PNG.
+static bool parse_format(FlValue* args, ImageFormat* format) {
+  *format = ImageFormat::kPng;
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return true;
+  }
+  FlValue* value = fl_value_lookup_string(args, "format");
+  if (value == nullptr || fl_value_get_type(value) == FL_VALUE_TYPE_NULL) {
+    return true;
+  }
+  return fl_value_get_type(value) == FL_VALUE_TYPE_STRING &&
+         desktop_screenshot::ParseImageFormat(fl_value_get_string(value),
+                                              format);
+}
+
+// Reads the optional "palette" argument, defaulting to truecolor output.
+static bool parse_palette(FlValue* args, PaletteMode* mode) {
+  *mode = PaletteMode::kOff;
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return true;
+  }
+  FlValue* value = fl_value_lookup_string(args, "palette");
+  if (value == nullptr || fl_value_get_type(value) == FL_VALUE_TYPE_NULL) {
+    return true;
+  }
+  return fl_value_get_type(value) == FL_VALUE_TYPE_STRING &&
+         desktop_screenshot::ParsePaletteMode(fl_value_get_string(value), mode);
+}
+
+// Reads a required list of {x, y, width, height} maps stored under |key|.
+static bool parse_rects(FlValue* args, const gchar* key,
+                        std::vector<Rect>* out) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return false;
+  }
+  FlValue* list = fl_value_lookup_string(args, key);
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return false;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) return false;
+    Rect rect;
+    rect.x = map_get_int(entry, "x", 0);
+    rect.y = map_get_int(entry, "y", 0);
+    rect.width = map_get_int(entry, "width", 0);
+    rect.height = map_get_int(entry, "height", 0);
+    out->push_back(rect);
+  }
+  return true;
+}
+
+// Reads the optional "redactions" list from the getScreenshot arguments.
+// Returns false if an entry is malformed.
+static bool parse_redactions(FlValue* args, std::vector<Redaction>* out) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return true;
+  }
+  FlValue* list = fl_value_lookup_string(args, "redactions");
+  if (list == nullptr || fl_value_get_type(list) == FL_VALUE_TYPE_NULL) {
+    return true;
+  }
+  if (fl_value_get_type(list) != FL_VALUE_TYPE_LIST) return false;
+
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) return false;
+    Redaction redaction;
+    redaction.rect.x = map_get_int(entry, "x", 0);
+    redaction.rect.y = map_get_int(entry, "y", 0);
+    redaction.rect.width = map_get_int(entry, "width", 0);
+    redaction.rect.height = map_get_int(entry, "height", 0);
+    redaction.color = static_cast<uint32_t>(map_get_int(entry, "color", 0xFF000000));
+    // Clamped before narrowing, so a huge value cannot wrap to a small one.
+    redaction.strength = static_cast<int>(
+        std::min<int64_t>(std::max<int64_t>(map_get_int(entry, "strength", 8),
+                                            1),
+                          desktop_screenshot::kMaxRedactionStrength));
+    FlValue* mode = fl_value_lookup_string(entry, "mode");
+    if (mode != nullptr && (fl_value_get_type(mode) != FL_VALUE_TYPE_STRING ||
+                            !desktop_screenshot::ParseRedactionMode(
+                                fl_value_get_string(mode), &redaction.mode))) {
+      return false;
+    }
+    out->push_back(redaction);
+  }
+  return true;
+}
+
+// Captures the whole root window (all monitors) as PNG, applying any
+// requested redactions to the raw pixels before encoding. Unchanged frames
+// are answered from the encode cache.
+static FlMethodResponse* get_screenshot(DesktopScreenshotPlugin* self,
+                                        FlValue* args) {
+  std::vector<Redaction> redactions;
+  PaletteMode palette;
+  if (!parse_redactions(args, &redactions) || !parse_palette(args, &palette)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Malformed redaction list or palette mode",
+        nullptr));
+  }
+
+  // Redactions are in desktop pixels, so a redacted frame keeps full size.
+  Frame frame;
+  MemoryCharge charge;
+  bool captured = redactions.empty()
+                      ? capture_image_frame(self, &frame, &charge)
+                      : capture_frame(self, &frame, &charge);
+  if (!captured) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+  // A frame of another size (a ring written before the resolution changed)
+  // would leave the masks in the wrong place: fail rather than answer it.
+  int width = 0;
+  int height = 0;
+  desktop_size(&width, &height);
+  if (!redactions.empty() &&
+      (frame.width != width || frame.height != height)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to apply redactions", nullptr));
+  }
+
+  std::string cache_key = desktop_screenshot::EncodeParamsKey(
+      ImageFormat::kPng, palette, redactions);
+  uint64_t frame_hash = desktop_screenshot::HashFrame(frame);
+  std::vector<uint8_t> png;
+  if (!self->cache->Lookup(cache_key, frame_hash, &png)) {
+    desktop_screenshot::ApplyRedactions(&frame, redactions);
+
+    // Both go through the plugin's own PNG writer: indexed output, which
+    // gdk-pixbuf cannot write, and truecolor output, which then reuses the
+    // compressed bands of the previous capture.
+    IndexedImage indexed;
+    if (desktop_screenshot::BuildIndexedImage(frame, palette, &indexed)) {
+      png = desktop_screenshot::EncodeIndexedPng(indexed);
+    } else {
+      png = self->png->Encode(frame);
+    }
+    if (png.empty()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+    }
+    self->cache->Store(cache_key, frame_hash, png);
+  }
+
+  // The frame, the PNG and the FlValue copy coexist until the reply.
+  MemoryCharge encoded = MemoryLedger::Process().Charge(MemoryStage::kEncode,
+                                                        png.size());
+  MemoryCharge copied =
+      MemoryLedger::Process().Charge(MemoryStage::kResult, png.size());
+  g_autoptr(FlValue) result = fl_value_new_uint8_list(png.data(), png.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Encodes |frame| as the budgeted mode asks: palette settings go through
+// the plugin's indexed PNG writer, the rest through gdk-pixbuf with the
+// zlib level or JPEG quality.
+static bool encode_with_settings(const Frame& frame,
+                                 const EncodeSettings& settings,
+                                 std::vector<uint8_t>* out) {
+  if (settings.format == ImageFormat::kPng &&
+      settings.palette != PaletteMode::kOff) {
+    IndexedImage indexed;
+    if (desktop_screenshot::BuildIndexedImage(frame, settings.palette,
+                                              &indexed)) {
+      *out = desktop_screenshot::EncodeIndexedPng(indexed, settings.level);
+      return true;
+    }
+  }
+  g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
+                                               frame.width, frame.height);
+  if (!pixbuf) return false;
+  frame_to_pixbuf(frame, pixbuf);
+
+  const bool jpeg = settings.format == ImageFormat::kJpeg;
+  ScopedTrace trace("encode");
+  g_autofree gchar* level = g_strdup_printf("%d", settings.level);
+  g_autofree gchar* buffer = nullptr;
+  gsize buffer_size = 0;
+  if (!gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &buffer_size,
+                                 jpeg ? "jpeg" : "png", nullptr,
+                                 jpeg ? "quality" : "compression", level,
+                                 nullptr)) {
+    return false;
+  }
+  out->assign(reinterpret_cast<const uint8_t*>(buffer),
+              reinterpret_cast<const uint8_t*>(buffer) + buffer_size);
+  return true;
+}
+
+// Captures the desktop and encodes it within "maxBytes" and "maxEncodeMs"
+// (zero or absent: no limit), answering the bytes together with the
+// settings the planner chose for them.
+static FlMethodResponse* get_budgeted_screenshot(DesktopScreenshotPlugin* self,
+                                                 FlValue* args) {
+  desktop_screenshot::EncodeBudget budget;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    int64_t max_bytes = map_get_int(args, "maxBytes", 0);
+    int64_t max_ms = map_get_int(args, "maxEncodeMs", 0);
+    if (max_bytes < 0 || max_ms < 0) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENTS", "Budgets must not be negative", nullptr));
+    }
+    budget.max_bytes = static_cast<size_t>(max_bytes);
+    budget.max_encode_ms = static_cast<double>(max_ms);
+  }
+
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_image_frame(self, &frame, &charge)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+  BudgetResult encoded;
+  if (!self->budget->EncodeWithinBudget(frame, budget, encode_with_settings,
+                                        &encoded)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+
+  const EncodeSettings& settings = encoded.settings;
+  MemoryCharge output = MemoryLedger::Process().Charge(MemoryStage::kEncode,
+                                                       encoded.bytes.size());
+  MemoryCharge copied = MemoryLedger::Process().Charge(MemoryStage::kResult,
+                                                       encoded.bytes.size());
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "bytes",
+      fl_value_new_uint8_list(encoded.bytes.data(), encoded.bytes.size()));
+  fl_value_set_string_take(
+      result, "format",
+      fl_value_new_string(
+          desktop_screenshot::ImageFormatName(settings.format)));
+  fl_value_set_string_take(result, "level", fl_value_new_int(settings.level));
+  fl_value_set_string_take(
+      result, "palette",
+      fl_value_new_string(
+          desktop_screenshot::PaletteModeName(settings.palette)));
+  fl_value_set_string_take(result, "scale", fl_value_new_int(settings.scale));
+  fl_value_set_string_take(result, "width", fl_value_new_int(encoded.width));
+  fl_value_set_string_take(result, "height", fl_value_new_int(encoded.height));
+  fl_value_set_string_take(
+      result, "encodeMicros",
+      fl_value_new_int(static_cast<int64_t>(encoded.encode_ms * 1000)));
+  fl_value_set_string_take(result, "trials", fl_value_new_int(encoded.trials));
+  fl_value_set_string_take(result, "withinBudget",
+                           fl_value_new_bool(encoded.within_budget));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Reports the encode cache counters.
+static FlMethodResponse* get_encode_cache_stats(DesktopScreenshotPlugin* self) {
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "hits",
+                           fl_value_new_int(self->cache->hits()));
+  fl_value_set_string_take(result, "misses",
+                           fl_value_new_int(self->cache->misses()));
+  fl_value_set_string_take(result, "entries",
+                           fl_value_new_int(self->cache->size()));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Restarts the shared workers with "threads" threads (0 = one per core)
+// pinned to cores if "pinThreads" is set. A prepare() warm-up may be running
+// parallel stages on its own thread; Configure waits for them.
+static FlMethodResponse* configure_thread_pool(DesktopScreenshotPlugin* self,
+                                               FlValue* args) {
+  int64_t threads = 0;
+  bool pin = false;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    threads = map_get_int(args, "threads", 0);
+    FlValue* value = fl_value_lookup_string(args, "pinThreads");
+    pin = value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_BOOL &&
+          fl_value_get_bool(value);
+  }
+  if (threads < 0 || threads > 256) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Thread count must be between 0 and 256",
+        nullptr));
+  }
+  self->pool->Configure(static_cast<int>(threads), pin);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Reports the shared pool's size and counters.
+static FlMethodResponse* get_thread_pool_stats(DesktopScreenshotPlugin* self) {
+  TaskPool::Stats stats = self->pool->stats();
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "threads", fl_value_new_int(stats.threads));
+  fl_value_set_string_take(result, "tasks",
+                           fl_value_new_int(static_cast<int64_t>(stats.tasks)));
+  fl_value_set_string_take(
+      result, "steals", fl_value_new_int(static_cast<int64_t>(stats.steals)));
+  fl_value_set_string_take(
+      result, "queueDepth",
+      fl_value_new_int(static_cast<int64_t>(stats.queue_depth)));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// GDK's error traps, for the window capturer sharing GDK's connection:
+// the Xlib handler ErrorTrap installs otherwise would replace GDK's own.
+static void gdk_error_trap_push(Display* display) {
+  gdk_x11_display_error_trap_push(gdk_x11_lookup_xdisplay(display));
+}
+
+static int gdk_error_trap_pop(Display* display) {
+  return gdk_x11_display_error_trap_pop(gdk_x11_lookup_xdisplay(display));
+}
+
+static const ErrorTrapHooks kGdkErrorTraps = {gdk_error_trap_push,
+                                              gdk_error_trap_pop};
+
+// Traps for the monitor capturer's connections, which are its own and
+// unknown to GDK. A trap on GDK's connection puts GDK's error handler in
+// charge instead of Xlib's default, which would exit the process; GDK's
+// ignores errors on connections it did not open, and the monitor grabs
+// see theirs in their failed replies.
+static void gdk_default_error_trap_push(Display*) {
+  gdk_x11_display_error_trap_push(gdk_display_get_default());
+}
+
+static int gdk_default_error_trap_pop(Display*) {
+  return gdk_x11_display_error_trap_pop(gdk_display_get_default());
+}
+
+static const ErrorTrapHooks kGdkDefaultErrorTraps = {
+    gdk_default_error_trap_push, gdk_default_error_trap_pop};
+
+// Switches full-desktop grabs between "sequential" (the root window in one
+// piece) and "parallel" (every monitor at once over its own connection).
+static FlMethodResponse* set_monitor_capture_mode(DesktopScreenshotPlugin* self,
+                                                  FlValue* args) {
+  FlValue* mode = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    mode = fl_value_lookup_string(args, "mode");
+  }
+  if (mode == nullptr || fl_value_get_type(mode) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a mode", nullptr));
+  }
+  if (strcmp(fl_value_get_string(mode), "sequential") == 0) {
+    delete self->monitors;
+    self->monitors = nullptr;
+  } else if (strcmp(fl_value_get_string(mode), "parallel") == 0) {
+    GdkDisplay* display = gdk_display_get_default();
+    if (!GDK_IS_X11_DISPLAY(display)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "UNSUPPORTED", "Parallel monitor capture needs an X11 session",
+          nullptr));
+    }
+    if (self->monitors == nullptr) {
+      self->monitors = new MonitorCapturer(
+          DisplayString(GDK_DISPLAY_XDISPLAY(display)),
+          &kGdkDefaultErrorTraps);
+    }
+  } else {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Unknown monitor capture mode", nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Reports the capture buffers charged to the process-wide ledger, in
+// total and per stage, and the bytes held by frame handles. "resetPeaks"
+// lowers the peaks to the current values after reading them.
+static FlMethodResponse* get_memory_stats(DesktopScreenshotPlugin* self,
+                                          FlValue* args) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  desktop_screenshot::MemoryStats stats = ledger.Stats();
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "current", fl_value_new_int(static_cast<int64_t>(stats.current)));
+  fl_value_set_string_take(
+      result, "peak", fl_value_new_int(static_cast<int64_t>(stats.peak)));
+  fl_value_set_string_take(
+      result, "limit", fl_value_new_int(static_cast<int64_t>(stats.limit)));
+  FlValue* stages = fl_value_new_map();
+  for (int i = 0; i < desktop_screenshot::kMemoryStageCount; ++i) {
+    FlValue* stage = fl_value_new_map();
+    fl_value_set_string_take(
+        stage, "current",
+        fl_value_new_int(static_cast<int64_t>(stats.stages[i].current)));
+    fl_value_set_string_take(
+        stage, "peak",
+        fl_value_new_int(static_cast<int64_t>(stats.stages[i].peak)));
+    fl_value_set_string_take(
+        stages,
+        desktop_screenshot::MemoryStageName(static_cast<MemoryStage>(i)),
+        stage);
+  }
+  fl_value_set_string_take(result, "stages", stages);
+  fl_value_set_string_take(
+      result, "handles",
+      fl_value_new_int(static_cast<int64_t>(self->frames->memory_used())));
+  fl_value_set_string_take(
+      result, "degraded",
+      fl_value_new_int(static_cast<int64_t>(stats.degraded)));
+  fl_value_set_string_take(
+      result, "refused", fl_value_new_int(static_cast<int64_t>(stats.refused)));
+
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* reset = fl_value_lookup_string(args, "resetPeaks");
+    if (reset != nullptr && fl_value_get_type(reset) == FL_VALUE_TYPE_BOOL &&
+        fl_value_get_bool(reset)) {
+      ledger.ResetPeaks();
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Sets the process-wide ceiling on capture buffers to "bytes" (0: none).
+static FlMethodResponse* set_memory_limit(FlValue* args) {
+  int64_t bytes = -1;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    bytes = map_get_int(args, "bytes", -1);
+  }
+  if (bytes < 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a non-negative byte count", nullptr));
+  }
+  MemoryLedger::Process().SetLimit(static_cast<size_t>(bytes));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Starts a new trace recording of the native capture path, keeping up to
+// "eventsPerThread" events per thread.
+static FlMethodResponse* start_trace(FlValue* args) {
+  int64_t events = desktop_screenshot::kDefaultTraceEventsPerThread;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    events = map_get_int(args, "eventsPerThread", events);
+  }
+  if (events <= 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a positive event count", nullptr));
+  }
+  desktop_screenshot::StartTracing(static_cast<size_t>(events));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Writes the trace recording to "path" as Chrome trace-event JSON and
+// answers how many events, dropped events and threads it held.
+static FlMethodResponse* dump_trace(FlValue* args) {
+  FlValue* path = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    path = fl_value_lookup_string(args, "path");
+  }
+  if (path == nullptr || fl_value_get_type(path) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a file path", nullptr));
+  }
+  desktop_screenshot::TraceSummary summary;
+  if (!desktop_screenshot::WriteTrace(fl_value_get_string(path), &summary)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "WRITE_FAILED", "Failed to write the trace file", nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "events", fl_value_new_int(static_cast<int64_t>(summary.events)));
+  fl_value_set_string_take(
+      result, "dropped",
+      fl_value_new_int(static_cast<int64_t>(summary.dropped)));
+  fl_value_set_string_take(
+      result, "threads",
+      fl_value_new_int(static_cast<int64_t>(summary.threads)));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Attaches to the shared-memory ring named by "name" (default
+// "/desktop_screenshot"). Answers false if no daemon has created it.
+static FlMethodResponse* attach_frame_ring(DesktopScreenshotPlugin* self,
+                                           FlValue* args) {
+  std::string name = "/desktop_screenshot";
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* value = fl_value_lookup_string(args, "name");
+    if (value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+      name = fl_value_get_string(value);
+    }
+  }
+  std::unique_ptr<FrameRingReader> ring = FrameRingReader::Open(name);
+  g_autoptr(FlValue) result = fl_value_new_bool(ring != nullptr);
+  if (ring) {
+    delete self->ring;
+    self->ring = ring.release();
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Cuts every requested region from a single capture of their bounding
+// area and encodes the slices in parallel.
+static FlMethodResponse* get_screenshot_regions(DesktopScreenshotPlugin* self,
+                                                FlValue* args) {
+  std::vector<Rect> regions;
+  ImageFormat format;
+  if (!parse_rects(args, "regions", &regions) || !parse_format(args, &format)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a list of regions and a format",
+        nullptr));
+  }
+
+  // One grab of the area the regions span rather than of the desktop or of
+  // each region.
+  Rect bounds = desktop_screenshot::BoundingRect(regions);
+  Frame frame;
+  MemoryCharge charge;
+  if (!bounds.IsEmpty() && !capture_area(self, &bounds, &frame, &charge)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+
+  // Regions outside the desktop come back empty; a region whose encode
+  // fails fails the whole call. Each crop is charged while it is encoded,
+  // each encoding until the reply.
+  MemoryLedger& ledger = MemoryLedger::Process();
+  std::vector<std::vector<uint8_t>> encoded(regions.size());
+  std::vector<MemoryCharge> encoded_charges(regions.size());
+  std::atomic<bool> failed(false);
+  desktop_screenshot::ParallelFor(regions.size(), [&](size_t i) {
+    Rect local = regions[i];
+    local.x -= bounds.x;
+    local.y -= bounds.y;
+    Frame slice = desktop_screenshot::CropFrame(frame, local);
+    if (slice.IsEmpty()) return;
+    MemoryCharge crop =
+        ledger.Charge(MemoryStage::kFrame, slice.pixels.size());
+    if (!encode_frame_bytes(slice, format, &encoded[i]) ||
+        encoded[i].empty()) {
+      failed = true;
+    }
+    encoded_charges[i] =
+        ledger.Charge(MemoryStage::kEncode, encoded[i].size());
+  });
+  if (failed) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+
+  // The FlValue lists copy the encodings.
+  size_t result_bytes = 0;
+  for (const std::vector<uint8_t>& bytes : encoded) {
+    result_bytes += bytes.size();
+  }
+  MemoryCharge copied = ledger.Charge(MemoryStage::kResult, result_bytes);
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (const std::vector<uint8_t>& bytes : encoded) {
+    fl_value_append_take(result,
+                         fl_value_new_uint8_list(bytes.data(), bytes.size()));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Reads the "outputs" list of capturePipeline: maps of "product" ("image"
+// or "fingerprint"), "format", "scale" and an optional "region".
+static bool parse_pipeline_outputs(FlValue* args,
+                                   std::vector<PipelineOutput>* out) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return false;
+  }
+  FlValue* list = fl_value_lookup_string(args, "outputs");
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return false;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) return false;
+    PipelineOutput output;
+    FlValue* product = fl_value_lookup_string(entry, "product");
+    if (product != nullptr &&
+        fl_value_get_type(product) == FL_VALUE_TYPE_STRING &&
+        strcmp(fl_value_get_string(product), "fingerprint") == 0) {
+      output.product = desktop_screenshot::PipelineProduct::kFingerprint;
+    }
+    if (!parse_format(entry, &output.format)) return false;
+    FlValue* scale = fl_value_lookup_string(entry, "scale");
+    if (scale != nullptr && fl_value_get_type(scale) == FL_VALUE_TYPE_FLOAT) {
+      output.scale = fl_value_get_float(scale);
+      if (!(output.scale > 0 && output.scale <= 1)) return false;
+    }
+    FlValue* region = fl_value_lookup_string(entry, "region");
+    if (region != nullptr && fl_value_get_type(region) == FL_VALUE_TYPE_MAP) {
+      output.region = Rect{static_cast<int>(map_get_int(region, "x", 0)),
+                           static_cast<int>(map_get_int(region, "y", 0)),
+                           static_cast<int>(map_get_int(region, "width", 0)),
+                           static_cast<int>(map_get_int(region, "height", 0))};
+      // An empty region would mean the whole desktop to the pipeline.
+      if (output.region.IsEmpty()) return false;
+    }
+    out->push_back(output);
+  }
+  return true;
+}
+
+// Grabs the desktop once and produces every requested output from that
+// single frame, sharing crops and scaled copies between them and encoding
+// them concurrently.
+static FlMethodResponse* capture_pipeline(DesktopScreenshotPlugin* self,
+                                          FlValue* args) {
+  std::vector<PipelineOutput> outputs;
+  if (!parse_pipeline_outputs(args, &outputs)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS",
+        "Expected a list of outputs with a format, a scale in (0, 1] and "
+        "a non-empty region",
+        nullptr));
+  }
+
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_frame(self, &frame, &charge)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+  std::vector<PipelineResult> results;
+  if (!desktop_screenshot::RunCapturePipeline(frame, outputs,
+                                              encode_frame_bytes, &results)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+
+  size_t output_bytes = 0;
+  for (const PipelineResult& produced : results) {
+    output_bytes += produced.bytes.size();
+  }
+  MemoryCharge encoded =
+      MemoryLedger::Process().Charge(MemoryStage::kEncode, output_bytes);
+  MemoryCharge copied =
+      MemoryLedger::Process().Charge(MemoryStage::kResult, output_bytes);
+  g_autoptr(FlValue) list = fl_value_new_list();
+  for (size_t i = 0; i < results.size(); ++i) {
+    const PipelineResult& produced = results[i];
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "width", fl_value_new_int(produced.width));
+    fl_value_set_string_take(entry, "height",
+                             fl_value_new_int(produced.height));
+    if (outputs[i].product ==
+        desktop_screenshot::PipelineProduct::kFingerprint) {
+      // The 64 bits travel as a signed int, like Dart's.
+      fl_value_set_string_take(
+          entry, "fingerprint",
+          fl_value_new_int(static_cast<int64_t>(produced.fingerprint)));
+    } else {
+      fl_value_set_string_take(
+          entry, "bytes",
+          fl_value_new_uint8_list(produced.bytes.data(),
+                                  produced.bytes.size()));
+    }
+    fl_value_append_take(list, entry);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(list));
+}
+
+// Encodes a BGRA frame into a Uint8List value. Returns nullptr on failure.
+static FlValue* encode_frame(const Frame& frame, ImageFormat format) {
+  std::vector<uint8_t> bytes;
+  if (!encode_frame_bytes(frame, format, &bytes)) return nullptr;
+  return fl_value_new_uint8_list(bytes.data(), bytes.size());
+}
+
+static gboolean write_stream_chunk(const gchar* buffer, gsize count,
+                                   GError** error, gpointer user_data) {
+  static_cast<ChunkWriter*>(user_data)->Write(buffer, count);
+  return TRUE;
+}
+
+// Listening on "desktop_screenshot/stream" captures the screen and sends the
+// encoded image as Uint8List events while gdk-pixbuf is still writing it,
+// then a map with the totals, then end-of-stream.
+static FlMethodErrorResponse* screenshot_stream_listen_cb(FlEventChannel* channel,
+                                                          FlValue* args,
+                                                          gpointer user_data) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(user_data);
+  ImageFormat format;
+  if (!parse_format(args, &format)) {
+    return fl_method_error_response_new("INVALID_ARGUMENTS",
+                                        "Unknown image format", nullptr);
+  }
+  int64_t chunk_size = ChunkWriter::kDefaultChunkSize;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    chunk_size = map_get_int(args, "chunkSize", chunk_size);
+  }
+
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_image_frame(self, &frame, &charge)) {
+    return fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr);
+  }
+
+  // The writer holds back at most a chunk, each event copies one.
+  MemoryLedger& ledger = MemoryLedger::Process();
+  gint64 start = g_get_monotonic_time();
+  ChunkWriter writer(static_cast<size_t>(std::max<int64_t>(chunk_size, 1)),
+                     [channel, &ledger](const uint8_t* data, size_t size) {
+                       MemoryCharge copied =
+                           ledger.Charge(MemoryStage::kResult, size);
+                       g_autoptr(FlValue) event =
+                           fl_value_new_uint8_list(data, size);
+                       fl_event_channel_send(channel, event, nullptr, nullptr);
+                     },
+                     &ledger);
+  if (format == ImageFormat::kRaw) {
+    std::vector<uint8_t> bytes = desktop_screenshot::EncodeRawFrame(
+        frame, desktop_screenshot::RawFrameTimestampNow());
+    MemoryCharge encoded = ledger.Charge(MemoryStage::kEncode, bytes.size());
+    writer.Write(bytes.data(), bytes.size());
+  } else {
+    g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new(
+        GDK_COLORSPACE_RGB, FALSE, 8, frame.width, frame.height);
+    if (!pixbuf) {
+      return fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to allocate image", nullptr);
+    }
+    // The encoder's RGB copy of the frame.
+    MemoryCharge input = ledger.Charge(
+        MemoryStage::kEncode,
+        static_cast<size_t>(gdk_pixbuf_get_rowstride(pixbuf)) * frame.height);
+    frame_to_pixbuf(frame, pixbuf);
+    ScopedTrace trace("encode");
+    g_autoptr(GError) error = nullptr;
+    if (!gdk_pixbuf_save_to_callback(pixbuf, write_stream_chunk, &writer,
+                                     desktop_screenshot::ImageFormatName(format),
+                                     &error, nullptr)) {
+      return fl_method_error_response_new("INVALID_IMAGE_DATA",
+                                          error->message, nullptr);
+    }
+  }
+  writer.Finish();
+
+  g_autoptr(FlValue) totals = fl_value_new_map();
+  fl_value_set_string_take(totals, "totalBytes",
+                           fl_value_new_int(writer.total_bytes()));
+  fl_value_set_string_take(totals, "chunks", fl_value_new_int(writer.chunks()));
+  fl_value_set_string_take(totals, "encodeMicros",
+                           fl_value_new_int(g_get_monotonic_time() - start));
+  fl_event_channel_send(channel, totals, nullptr, nullptr);
+  fl_event_channel_send_end_of_stream(channel, nullptr, nullptr);
+  return nullptr;
+}
+
+// The encode runs synchronously inside listen, so there is nothing to stop.
+static FlMethodErrorResponse* screenshot_stream_cancel_cb(FlEventChannel* channel,
+                                                          FlValue* args,
+                                                          gpointer user_data) {
+  return nullptr;
+}
+
+// Hands |bytes| to a GBytes without copying; the vector is freed with it.
+static GBytes* bytes_take_vector(std::vector<uint8_t>&& bytes) {
+  auto* owned = new std::vector<uint8_t>(std::move(bytes));
+  return g_bytes_new_with_free_func(
+      owned->data(), owned->size(),
+      [](gpointer data) { delete static_cast<std::vector<uint8_t>*>(data); },
+      owned);
+}
+
+// Captures and builds the reply to one frame request (see frame_message.h).
+static std::vector<uint8_t> build_frame_message(DesktopScreenshotPlugin* self,
+                                                const uint8_t* data,
+                                                size_t size) {
+  desktop_screenshot::FrameRequest request;
+  if (!data || !desktop_screenshot::ParseFrameRequest(data, size, &request)) {
+    return desktop_screenshot::BuildFrameErrorMessage(
+        FramePayload::kPixels, FrameStatus::kBadRequest);
+  }
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_image_frame(self, &frame, &charge)) {
+    return desktop_screenshot::BuildFrameErrorMessage(
+        request.payload, FrameStatus::kCaptureFailed);
+  }
+  const uint64_t captured_ns = desktop_screenshot::RawFrameTimestampNow();
+  ImageFormat format;
+  if (!desktop_screenshot::FramePayloadFormat(request.payload, &format)) {
+    return desktop_screenshot::BuildPixelMessage(frame, captured_ns);
+  }
+  // The header goes in front of the image without moving it.
+  std::vector<uint8_t> bytes;
+  if (!encode_frame_bytes(frame, format, &bytes,
+                          desktop_screenshot::kFrameMessageHeaderSize)) {
+    return desktop_screenshot::BuildFrameErrorMessage(
+        request.payload, FrameStatus::kEncodeFailed);
+  }
+  desktop_screenshot::FrameMessageHeader header;
+  header.payload = request.payload;
+  header.width = frame.width;
+  header.height = frame.height;
+  header.timestamp_ns = captured_ns;
+  desktop_screenshot::WrapEncodedMessage(header, &bytes);
+  return bytes;
+}
+
+// Answers a request on "desktop_screenshot/frames". The reply goes straight
+// to the binary messenger: no FlValue or codec envelope is built around the
+// payload, and the message buffer itself is handed to the engine.
+static void frame_message_cb(FlBinaryMessenger* messenger,
+                             const gchar* channel, GBytes* message,
+                             FlBinaryMessengerResponseHandle* response_handle,
+                             gpointer user_data) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(user_data);
+  ScopedTrace request("frames", "request");
+  gsize size = 0;
+  const uint8_t* data =
+      message ? static_cast<const uint8_t*>(g_bytes_get_data(message, &size))
+              : nullptr;
+  g_autoptr(GBytes) response =
+      bytes_take_vector(build_frame_message(self, data, size));
+  ScopedTrace reply("reply");
+  g_autoptr(GError) error = nullptr;
+  if (!fl_binary_messenger_send_response(messenger, response_handle, response,
+                                         &error)) {
+    g_warning("Failed to send frame message: %s", error->message);
+  }
+}
+
+// captureHandle and the deferred operations on the returned handles.
+static FlMethodResponse* handle_frame_method(DesktopScreenshotPlugin* self,
+                                             const gchar* method,
+                                             FlValue* args) {
+  if (strcmp(method, "captureHandle") == 0) {
+    Frame frame;
+    MemoryCharge charge;
+    if (!capture_frame(self, &frame, &charge)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to capture valid image data",
+          nullptr));
+    }
+    g_autoptr(FlValue) result =
+        fl_value_new_int(self->frames->Put(std::move(frame)));
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected an argument map", nullptr));
+  }
+
+  if (strcmp(method, "setHandleMemoryLimit") == 0) {
+    int64_t bytes = map_get_int(args, "bytes", -1);
+    if (bytes < 0) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENTS", "Expected a non-negative byte count", nullptr));
+    }
+    self->frames->SetMemoryLimit(static_cast<size_t>(bytes));
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+
+  int64_t id = map_get_int(args, "id", 0);
+  if (strcmp(method, "releaseHandle") == 0) {
+    g_autoptr(FlValue) result = fl_value_new_bool(self->frames->Release(id));
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  std::shared_ptr<const Frame> frame = self->frames->Get(id);
+  if (!frame) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "UNKNOWN_HANDLE", "Handle was released or evicted", nullptr));
+  }
+
+  if (strcmp(method, "encodeHandle") == 0) {
+    ImageFormat format;
+    if (!parse_format(args, &format)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENTS", "Unknown image format", nullptr));
+    }
+    g_autoptr(FlValue) result = encode_frame(*frame, format);
+    if (!result) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+    }
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  Frame derived;
+  if (strcmp(method, "cropHandle") == 0) {
+    Rect rect;
+    rect.x = map_get_int(args, "x", 0);
+    rect.y = map_get_int(args, "y", 0);
+    rect.width = map_get_int(args, "width", 0);
+    rect.height = map_get_int(args, "height", 0);
+    derived = desktop_screenshot::CropFrame(*frame, rect);
+  } else {
+    derived = desktop_screenshot::ScaleFrame(*frame, map_get_int(args, "width", 0),
+                                             map_get_int(args, "height", 0));
+  }
+  if (derived.IsEmpty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Resulting image would be empty", nullptr));
+  }
+  g_autoptr(FlValue) result =
+      fl_value_new_int(self->frames->Put(std::move(derived)));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
 static void clipboard_request_image_callback(GtkClipboard* clipboard,
                                              GdkPixbuf* pixbuf,
                                              gpointer user_data) {
@@ -81,13 +1461,673 @@ static void clipboard_request_image_callback(GtkClipboard* clipboard,
             nullptr);
 }
 
+// Puts a fresh capture on the clipboard without encoding it or sending it
+// to Dart. GTK advertises every image target for the pixbuf and converts
+// only when a paste target asks for a specific one.
+static FlMethodResponse* copy_screenshot_to_clipboard(
+    DesktopScreenshotPlugin* self) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  int width = 0;
+  int height = 0;
+  desktop_size(&width, &height);
+  desktop_screenshot::CapturePlan plan =
+      desktop_screenshot::PlanCapture(ledger.Available(), width, height, 3);
+  g_autoptr(GdkPixbuf) pixbuf = nullptr;
+  if (!attached_ring(self) && plan.possible && !plan.degraded()) {
+    // The captured pixbuf is handed over as is; no copy of the pixels.
+    MemoryCharge grab = ledger.Charge(
+        MemoryStage::kGrab, static_cast<size_t>(width) * height * 3);
+    pixbuf = capture_root_pixbuf();
+  } else {
+    // The ring's latest frame, or a capture that only fits striped and
+    // downscaled, copied into a pixbuf.
+    Frame frame;
+    MemoryCharge charge;
+    if (capture_image_frame(self, &frame, &charge)) {
+      pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, frame.width,
+                              frame.height);
+      if (pixbuf) frame_to_pixbuf(frame, pixbuf);
+    }
+  }
+  if (!pixbuf) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+  // Charged until the clipboard lets go of the pixbuf.
+  g_object_set_data_full(
+      G_OBJECT(pixbuf), "desktop-screenshot-charge",
+      new MemoryCharge(ledger.Charge(MemoryStage::kResult,
+                                     gdk_pixbuf_get_byte_length(pixbuf))),
+      [](gpointer data) { delete static_cast<MemoryCharge*>(data); });
+
+  GtkClipboard* clipboard =
+      gtk_clipboard_get_default(gdk_display_get_default());
+  gtk_clipboard_set_image(clipboard, pixbuf);
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Decodes PNG (or any format gdk-pixbuf reads) bytes into a BGRA frame.
+static bool decode_image(const uint8_t* data, size_t size, Frame* frame) {
+  g_autoptr(GdkPixbufLoader) loader = gdk_pixbuf_loader_new();
+  if (!gdk_pixbuf_loader_write(loader, data, size, nullptr) ||
+      !gdk_pixbuf_loader_close(loader, nullptr)) {
+    return false;
+  }
+  GdkPixbuf* pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  if (!pixbuf) return false;
+  pixbuf_to_frame(pixbuf, frame);
+  return true;
+}
+
+// Captures the desktop into the hybrid container: text and UI tiles as a
+// PNG, photo and video tiles as a JPEG at "quality". "tileSize" is the
+// classifier's grid.
+static FlMethodResponse* get_hybrid_screenshot(DesktopScreenshotPlugin* self,
+                                               FlValue* args) {
+  HybridOptions options;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    options.tile_size = map_get_int(args, "tileSize", options.tile_size);
+    options.quality = map_get_int(args, "quality", options.quality);
+  }
+  if (options.tile_size <= 0 || options.quality < 1 || options.quality > 100) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a positive tile size and quality 1-100",
+        nullptr));
+  }
+
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_image_frame(self, &frame, &charge)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+  std::vector<uint8_t> bytes;
+  HybridStats stats;
+  if (!desktop_screenshot::EncodeHybridImage(frame, options,
+                                             encode_with_settings, &bytes,
+                                             &stats)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+
+  MemoryCharge encoded =
+      MemoryLedger::Process().Charge(MemoryStage::kEncode, bytes.size());
+  MemoryCharge copied =
+      MemoryLedger::Process().Charge(MemoryStage::kResult, bytes.size());
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "bytes",
+                           fl_value_new_uint8_list(bytes.data(), bytes.size()));
+  fl_value_set_string_take(result, "width", fl_value_new_int(frame.width));
+  fl_value_set_string_take(result, "height", fl_value_new_int(frame.height));
+  fl_value_set_string_take(result, "tiles", fl_value_new_int(stats.tiles));
+  fl_value_set_string_take(result, "photoTiles",
+                           fl_value_new_int(stats.photo_tiles));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Composites the hybrid container in "bytes" back into a PNG.
+static FlMethodResponse* decode_hybrid_image(FlValue* args) {
+  FlValue* data = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    data = fl_value_lookup_string(args, "bytes");
+  }
+  Frame frame;
+  if (data == nullptr || fl_value_get_type(data) != FL_VALUE_TYPE_UINT8_LIST ||
+      !desktop_screenshot::DecodeHybridImage(fl_value_get_uint8_list(data),
+                                             fl_value_get_length(data),
+                                             decode_image, &frame)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a hybrid image", nullptr));
+  }
+  std::vector<uint8_t> png;
+  if (!encode_frame_bytes(frame, ImageFormat::kPng, &png)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_uint8_list(png.data(), png.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Looks for the "template" image on screen, or inside the optional "region",
+// and answers a list of {x, y, width, height, score} maps in desktop
+// coordinates. The capture never leaves native code.
+static FlMethodResponse* find_on_screen(DesktopScreenshotPlugin* self,
+                                        FlValue* args) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected an encoded template image", nullptr));
+  }
+  FlValue* image = fl_value_lookup_string(args, "template");
+  Frame needle;
+  if (image == nullptr ||
+      fl_value_get_type(image) != FL_VALUE_TYPE_UINT8_LIST ||
+      !decode_image(fl_value_get_uint8_list(image), fl_value_get_length(image),
+                    &needle)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected an encoded template image", nullptr));
+  }
+  MemoryCharge needle_charge = MemoryLedger::Process().Charge(
+      MemoryStage::kFrame, needle.pixels.size());
+  double threshold = 0.9;
+  FlValue* value = fl_value_lookup_string(args, "threshold");
+  if (value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_FLOAT) {
+    threshold = fl_value_get_float(value);
+  }
+  int max_matches = map_get_int(args, "maxMatches", 16);
+
+  Frame haystack;
+  Rect region{};
+  FlValue* area = fl_value_lookup_string(args, "region");
+  bool has_region =
+      area != nullptr && fl_value_get_type(area) == FL_VALUE_TYPE_MAP;
+  if (has_region) {
+    region.x = map_get_int(area, "x", 0);
+    region.y = map_get_int(area, "y", 0);
+    region.width = map_get_int(area, "width", 0);
+    region.height = map_get_int(area, "height", 0);
+  }
+  // Only the searched area is grabbed, or read from the ring.
+  MemoryCharge charge;
+  bool captured = has_region
+                      ? capture_area(self, &region, &haystack, &charge)
+                      : capture_frame(self, &haystack, &charge);
+  if (!captured || haystack.IsEmpty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+
+  std::vector<TemplateMatch> matches = desktop_screenshot::FindTemplate(
+      haystack, needle, static_cast<float>(threshold), max_matches);
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (const TemplateMatch& match : matches) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "x",
+                             fl_value_new_int(region.x + match.rect.x));
+    fl_value_set_string_take(entry, "y",
+                             fl_value_new_int(region.y + match.rect.y));
+    fl_value_set_string_take(entry, "width",
+                             fl_value_new_int(match.rect.width));
+    fl_value_set_string_take(entry, "height",
+                             fl_value_new_int(match.rect.height));
+    fl_value_set_string_take(entry, "score", fl_value_new_float(match.score));
+    fl_value_append_take(result, entry);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Answers the colors under "points", a flat Int32List of x, y pairs, as
+// 0xAARRGGBB ints, or null for points off the desktop. Only small areas
+// around the points are grabbed; in client mode the ring's newest frame is
+// read in place without copying it.
+static FlMethodResponse* sample_pixels(DesktopScreenshotPlugin* self,
+                                       FlValue* args) {
+  FlValue* list = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    list = fl_value_lookup_string(args, "points");
+  }
+  if (list == nullptr ||
+      fl_value_get_type(list) != FL_VALUE_TYPE_INT32_LIST ||
+      fl_value_get_length(list) % 2 != 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a flat list of x, y pairs", nullptr));
+  }
+  const int32_t* coords = fl_value_get_int32_list(list);
+  const size_t count = fl_value_get_length(list) / 2;
+  // -1 marks a point outside the desktop.
+  std::vector<int64_t> colors(count, -1);
+
+  if (attached_ring(self)) {
+    bool consistent = false;
+    FrameRingReader::View view;
+    for (int attempt = 0; attempt < 4 && !consistent; ++attempt) {
+      if (!self->ring->AcquireLatest(&view)) break;
+      for (size_t i = 0; i < count; ++i) {
+        int x = coords[2 * i];
+        int y = coords[2 * i + 1];
+        if (x < 0 || y < 0 || x >= view.width || y >= view.height) continue;
+        colors[i] =
+            desktop_screenshot::PixelColor(view.pixels, view.stride, x, y);
+      }
+      consistent = self->ring->StillValid(view);
+    }
+    if (!consistent) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+    }
+  } else {
+    int width = 0;
+    int height = 0;
+    desktop_size(&width, &height);
+    std::vector<desktop_screenshot::Point> visible;
+    std::vector<size_t> visible_index;
+    for (size_t i = 0; i < count; ++i) {
+      int x = coords[2 * i];
+      int y = coords[2 * i + 1];
+      if (x < 0 || y < 0 || x >= width || y >= height) continue;
+      visible.push_back(desktop_screenshot::Point{x, y});
+      visible_index.push_back(i);
+    }
+    std::vector<size_t> owner;
+    std::vector<Rect> grabs =
+        desktop_screenshot::PlanPixelGrabs(visible, &owner);
+    for (size_t g = 0; g < grabs.size(); ++g) {
+      // Planned and charged like any other area; the rects already lie on
+      // the desktop.
+      Rect grab = grabs[g];
+      Frame pixels;
+      MemoryCharge charge;
+      if (!capture_area(self, &grab, &pixels, &charge) || pixels.IsEmpty()) {
+        return FL_METHOD_RESPONSE(fl_method_error_response_new(
+            "INVALID_IMAGE_DATA", "Failed to capture valid image data",
+            nullptr));
+      }
+      for (size_t j = 0; j < visible.size(); ++j) {
+        if (owner[j] != g) continue;
+        colors[visible_index[j]] = desktop_screenshot::PixelColor(
+            pixels.pixels.data(), pixels.stride, visible[j].x - grab.x,
+            visible[j].y - grab.y);
+      }
+    }
+  }
+
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (int64_t color : colors) {
+    fl_value_append_take(result, color < 0 ? fl_value_new_null()
+                                           : fl_value_new_int(color));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Resolves the optional "monitor" index and "region" into an area of the
+// root window in device pixels, the coordinates of every capture. A region
+// is relative to the monitor when both are given. Returns false for an
+// unknown monitor.
+static bool parse_screen_area(FlValue* args, Rect* area) {
+  *area = Rect{};
+  desktop_size(&area->width, &area->height);
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return true;
+  }
+  FlValue* monitor = fl_value_lookup_string(args, "monitor");
+  if (monitor != nullptr && fl_value_get_type(monitor) == FL_VALUE_TYPE_INT) {
+    GdkDisplay* display = gdk_display_get_default();
+    int64_t index = fl_value_get_int(monitor);
+    if (index < 0 || index >= gdk_display_get_n_monitors(display)) return false;
+    GdkMonitor* screen =
+        gdk_display_get_monitor(display, static_cast<int>(index));
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(screen, &geometry);
+    *area = MonitorDeviceRect(
+        Rect{geometry.x, geometry.y, geometry.width, geometry.height},
+        gdk_monitor_get_scale_factor(screen));
+  }
+  FlValue* region = fl_value_lookup_string(args, "region");
+  if (region != nullptr && fl_value_get_type(region) == FL_VALUE_TYPE_MAP) {
+    Rect local{static_cast<int>(map_get_int(region, "x", 0)),
+               static_cast<int>(map_get_int(region, "y", 0)),
+               static_cast<int>(map_get_int(region, "width", 0)),
+               static_cast<int>(map_get_int(region, "height", 0))};
+    local = desktop_screenshot::ClampRect(local, area->width, area->height);
+    *area = Rect{area->x + local.x, area->y + local.y, local.width,
+                 local.height};
+  }
+  return true;
+}
+
+// Answers histograms, luminance mean and variance and a uniform-screen flag
+// for the requested area. Only the small summary crosses the channel.
+static FlMethodResponse* get_screen_stats(DesktopScreenshotPlugin* self,
+                                          FlValue* args) {
+  Rect area;
+  if (!parse_screen_area(args, &area)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Unknown monitor", nullptr));
+  }
+
+  Frame frame;
+  MemoryCharge charge;
+  if (!capture_area(self, &area, &frame, &charge) || frame.IsEmpty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr));
+  }
+
+  desktop_screenshot::ScreenStats stats =
+      desktop_screenshot::ComputeScreenStats(frame);
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "pixels", fl_value_new_int(static_cast<int64_t>(stats.pixels)));
+  fl_value_set_string_take(
+      result, "red",
+      fl_value_new_int32_list(
+          reinterpret_cast<const int32_t*>(stats.red.data()), 256));
+  fl_value_set_string_take(
+      result, "green",
+      fl_value_new_int32_list(
+          reinterpret_cast<const int32_t*>(stats.green.data()), 256));
+  fl_value_set_string_take(
+      result, "blue",
+      fl_value_new_int32_list(
+          reinterpret_cast<const int32_t*>(stats.blue.data()), 256));
+  fl_value_set_string_take(result, "meanLuminance",
+                           fl_value_new_float(stats.mean_luminance));
+  fl_value_set_string_take(result, "luminanceVariance",
+                           fl_value_new_float(stats.luminance_variance));
+  fl_value_set_string_take(result, "uniform", fl_value_new_bool(stats.uniform));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// What prepare() warms up off the main thread, and the frame buffer it
+// hands to the plugin once done.
+struct PrepareJob {
+  ImageFormat format;
+  int width;
+  int height;
+  int monitors;
+  gint64 start_us;
+  WarmFrame warm;
+};
+
+// Encodes a full-size frame the way getScreenshot will: PNGs through the
+// plugin's incremental encoder, which keeps its filtered rows and band
+// buffers at the size of a real capture, other formats through the
+// gdk-pixbuf saver, which this loads along with its libjpeg tables. The
+// frame itself is faulted in and kept for the first capture. Also wakes
+// every pool worker.
+static void prepare_thread_func(GTask* task, gpointer source_object,
+                                gpointer task_data,
+                                GCancellable* cancellable) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(source_object);
+  PrepareJob* job = static_cast<PrepareJob*>(task_data);
+  Frame& frame = job->warm.frame;
+  frame.Allocate(job->width, job->height);
+  job->warm.charge = MemoryLedger::Process().Charge(MemoryStage::kFrame,
+                                                    frame.pixels.size());
+  std::vector<uint8_t> encoded;
+  bool ok;
+  if (job->format == ImageFormat::kPng) {
+    encoded = self->png->Encode(frame);
+    ok = !encoded.empty();
+  } else {
+    ok = encode_frame_bytes(frame, job->format, &encoded);
+  }
+  if (!ok) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                            "Failed to encode image");
+    return;
+  }
+  desktop_screenshot::ParallelFor(64, [](size_t) {});
+  g_task_return_boolean(task, TRUE);
+}
+
+static void prepare_done_cb(GObject* source_object, GAsyncResult* result,
+                            gpointer user_data) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(source_object);
+  g_autoptr(FlMethodCall) method_call = FL_METHOD_CALL(user_data);
+  PrepareJob* job =
+      static_cast<PrepareJob*>(g_task_get_task_data(G_TASK(result)));
+  g_autoptr(GError) error = nullptr;
+  if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+    fl_method_call_respond_error(method_call, "INVALID_IMAGE_DATA",
+                                 error->message, nullptr, nullptr);
+    return;
+  }
+  delete self->warm;
+  self->warm = new WarmFrame(std::move(job->warm));
+  g_autoptr(FlValue) value = fl_value_new_map();
+  fl_value_set_string_take(
+      value, "micros", fl_value_new_int(g_get_monotonic_time() - job->start_us));
+  fl_value_set_string_take(value, "monitors", fl_value_new_int(job->monitors));
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+// Pays the one-time costs of the first capture up front: the X connection
+// and cairo/SHM setup with a 1x1 grab, and in parallel mode every
+// monitor's connection and SHM segment, here on the main thread (GDK is
+// not thread-safe), then encoder and buffer warm-up on a worker thread.
+// Answers {micros, monitors} once everything is done.
+static void prepare(DesktopScreenshotPlugin* self, FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  gint64 start_us = g_get_monotonic_time();
+  GdkWindow* root = gdk_get_default_root_window();
+  int desktop_width = 0;
+  int desktop_height = 0;
+  desktop_size(&desktop_width, &desktop_height);
+  int64_t width = desktop_width;
+  int64_t height = desktop_height;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    width = map_get_int(args, "width", width);
+    height = map_get_int(args, "height", height);
+  }
+  ImageFormat format;
+  if (!parse_format(args, &format) || width <= 0 || height <= 0 ||
+      width > 32768 || height > 32768) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "Expected a format and a positive size",
+                                 nullptr, nullptr);
+    return;
+  }
+
+  std::vector<Rect> monitors = monitor_rects();
+  if (!self->ring) {
+    GdkPixbuf* probe = gdk_pixbuf_get_from_window(root, 0, 0, 1, 1);
+    if (probe) g_object_unref(probe);
+    // A layout that cannot be opened now is retried by the first capture.
+    if (self->monitors) self->monitors->Prepare(monitors);
+  }
+  auto* job = new PrepareJob{format, static_cast<int>(width),
+                             static_cast<int>(height),
+                             static_cast<int>(monitors.size()), start_us,
+                             WarmFrame()};
+
+  g_autoptr(GTask) task =
+      g_task_new(self, nullptr, prepare_done_cb, g_object_ref(method_call));
+  g_task_set_task_data(task, job, [](gpointer data) {
+    delete static_cast<PrepareJob*>(data);
+  });
+  g_task_run_in_thread(task, prepare_thread_func);
+}
+
+// Returns the window capturer, creating it on first use, or nullptr when
+// GDK is not running on X11: window ids and Composite are X11 concepts.
+static WindowCapturer* window_capturer(DesktopScreenshotPlugin* self) {
+  if (self->windows == nullptr) {
+    GdkDisplay* display = gdk_display_get_default();
+    if (!GDK_IS_X11_DISPLAY(display)) return nullptr;
+    self->windows = new WindowCapturer(GDK_DISPLAY_XDISPLAY(display),
+                                       &kGdkErrorTraps,
+                                       &MemoryLedger::Process());
+  }
+  return self->windows;
+}
+
+static FlMethodResponse* window_capture_unsupported() {
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      "UNSUPPORTED", "Window capture needs an X11 session", nullptr));
+}
+
+static FlMethodResponse* list_windows(DesktopScreenshotPlugin* self) {
+  WindowCapturer* capturer = window_capturer(self);
+  if (capturer == nullptr) return window_capture_unsupported();
+
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (const WindowInfo& window : capturer->ListWindows()) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "id",
+                             fl_value_new_int(static_cast<int64_t>(window.id)));
+    fl_value_set_string_take(entry, "title",
+                             fl_value_new_string(window.title.c_str()));
+    fl_value_set_string_take(entry, "x", fl_value_new_int(window.rect.x));
+    fl_value_set_string_take(entry, "y", fl_value_new_int(window.rect.y));
+    fl_value_set_string_take(entry, "width",
+                             fl_value_new_int(window.rect.width));
+    fl_value_set_string_take(entry, "height",
+                             fl_value_new_int(window.rect.height));
+    fl_value_append_take(result, entry);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Grabs one window from its own pixmap, so the grab and the encode only
+// touch that window's pixels, even where other windows cover it.
+static FlMethodResponse* get_window_screenshot(DesktopScreenshotPlugin* self,
+                                               FlValue* args) {
+  ImageFormat format;
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP ||
+      map_get_int(args, "windowId", 0) <= 0 || !parse_format(args, &format)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Expected a window id and a format", nullptr));
+  }
+  WindowCapturer* capturer = window_capturer(self);
+  if (capturer == nullptr) return window_capture_unsupported();
+
+  Frame frame;
+  Window window = static_cast<Window>(map_get_int(args, "windowId", 0));
+  if (!capturer->Capture(window, &frame)) {
+    if (capturer->refused()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to capture valid image data",
+          nullptr));
+    }
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "WINDOW_NOT_FOUND", "Window is gone or not mapped", nullptr));
+  }
+  MemoryLedger& ledger = MemoryLedger::Process();
+  MemoryCharge charge = ledger.Charge(MemoryStage::kFrame, frame.pixels.size());
+  std::vector<uint8_t> bytes;
+  if (!encode_frame_bytes(frame, format, &bytes)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_IMAGE_DATA", "Failed to encode image", nullptr));
+  }
+  MemoryCharge encoded = ledger.Charge(MemoryStage::kEncode, bytes.size());
+  MemoryCharge copied = ledger.Charge(MemoryStage::kResult, bytes.size());
+  g_autoptr(FlValue) result =
+      fl_value_new_uint8_list(bytes.data(), bytes.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
 static void read_image_from_clipboard(FlMethodCall* method_call) {
     auto* clipboard = gtk_clipboard_get_default(gdk_display_get_default());
     gtk_clipboard_request_image(clipboard, clipboard_request_image_callback,
                                 g_object_ref(method_call));
 }
 
+// Grabs the screen straight into the preview texture: the root window's
+// pixbuf converted once to RGBA when it fits under the memory ceiling,
+// otherwise the attached ring's latest frame or a striped, downscaled
+// capture.
+static bool publish_preview_frame(DesktopScreenshotPlugin* self) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  int width = 0;
+  int height = 0;
+  desktop_size(&width, &height);
+  desktop_screenshot::CapturePlan plan =
+      desktop_screenshot::PlanCapture(ledger.Available(), width, height, 3);
+  if (attached_ring(self) || !plan.possible || plan.degraded()) {
+    Frame frame;
+    MemoryCharge charge;
+    if (!capture_image_frame(self, &frame, &charge)) return false;
+    preview_texture_publish_frame(self->preview, frame);
+    return true;
+  }
+  MemoryCharge grab = ledger.Charge(
+      MemoryStage::kGrab, static_cast<size_t>(width) * height * 3);
+  g_autoptr(GdkPixbuf) pixbuf = capture_root_pixbuf();
+  if (!pixbuf) return false;
+  preview_texture_publish_pixbuf(self->preview, pixbuf);
+  return true;
+}
+
+static gboolean preview_tick_cb(gpointer user_data) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(user_data);
+  if (publish_preview_frame(self)) {
+    fl_texture_registrar_mark_texture_frame_available(
+        self->textures, FL_TEXTURE(self->preview));
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Starts (or retimes) the live preview at "fps" frames per second (default
+// 30, at most 120) and answers the texture id. Frames go from the grab
+// into the texture; nothing is encoded or sent over the channel. A grab
+// slower than the interval simply lowers the rate, since the next tick is
+// scheduled after the previous one returns.
+static FlMethodResponse* start_preview(DesktopScreenshotPlugin* self,
+                                       FlValue* args) {
+  int64_t fps = 30;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    fps = map_get_int(args, "fps", fps);
+  }
+  if (fps < 1 || fps > 120) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "fps must be between 1 and 120", nullptr));
+  }
+  if (self->textures == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "UNSUPPORTED", "No texture registrar", nullptr));
+  }
+
+  if (self->preview == nullptr) {
+    self->preview = preview_texture_new();
+    // The first frame is in place before the texture can be drawn.
+    if (!publish_preview_frame(self) ||
+        !fl_texture_registrar_register_texture(self->textures,
+                                               FL_TEXTURE(self->preview))) {
+      g_clear_object(&self->preview);
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_IMAGE_DATA", "Failed to capture valid image data",
+          nullptr));
+    }
+    fl_texture_registrar_mark_texture_frame_available(
+        self->textures, FL_TEXTURE(self->preview));
+  }
+  if (self->preview_source != 0) g_source_remove(self->preview_source);
+  self->preview_source =
+      g_timeout_add(static_cast<guint>(1000 / fps), preview_tick_cb, self);
+
+  g_autoptr(FlValue) result =
+      fl_value_new_int(fl_texture_get_id(FL_TEXTURE(self->preview)));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Stops refreshing and unregisters the preview texture, if any.
+static void stop_preview(DesktopScreenshotPlugin* self) {
+  if (self->preview_source != 0) {
+    g_source_remove(self->preview_source);
+    self->preview_source = 0;
+  }
+  if (self->preview == nullptr) return;
+  if (self->textures) {
+    fl_texture_registrar_unregister_texture(self->textures,
+                                            FL_TEXTURE(self->preview));
+  }
+  g_clear_object(&self->preview);
+}
+
 static void desktop_screenshot_plugin_dispose(GObject* object) {
+  DesktopScreenshotPlugin* self = DESKTOP_SCREENSHOT_PLUGIN(object);
+  delete self->frames;
+  self->frames = nullptr;
+  delete self->cache;
+  self->cache = nullptr;
+  delete self->png;
+  self->png = nullptr;
+  delete self->ring;
+  self->ring = nullptr;
+  // Joins the workers once the last plugin instance lets go.
+  if (self->pool) TaskPool::Release();
+  self->pool = nullptr;
+  delete self->windows;
+  self->windows = nullptr;
+  delete self->monitors;
+  self->monitors = nullptr;
+  delete self->budget;
+  self->budget = nullptr;
+  delete self->warm;
+  self->warm = nullptr;
+  stop_preview(self);
+  g_clear_object(&self->textures);
+
   G_OBJECT_CLASS(desktop_screenshot_plugin_parent_class)->dispose(object);
 }
 
@@ -95,7 +2135,20 @@ static void desktop_screenshot_plugin_class_init(DesktopScreenshotPluginClass* k
   G_OBJECT_CLASS(klass)->dispose = desktop_screenshot_plugin_dispose;
 }
 
-static void desktop_screenshot_plugin_init(DesktopScreenshotPlugin* self) {}
+static void desktop_screenshot_plugin_init(DesktopScreenshotPlugin* self) {
+  self->frames = new FrameStore();
+  self->cache = new EncodeCache(&MemoryLedger::Process());
+  self->png = new IncrementalPngEncoder(6, &MemoryLedger::Process());
+  self->ring = nullptr;
+  self->pool = TaskPool::Retain();
+  self->windows = nullptr;
+  self->monitors = nullptr;
+  self->budget = new BudgetPlanner();
+  self->warm = nullptr;
+  self->textures = nullptr;
+  self->preview = nullptr;
+  self->preview_source = 0;
+}
 
 static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
                            gpointer user_data) {
@@ -107,6 +2160,9 @@ void desktop_screenshot_plugin_register_with_registrar(FlPluginRegistrar* regist
   DesktopScreenshotPlugin* plugin = DESKTOP_SCREENSHOT_PLUGIN(
       g_object_new(desktop_screenshot_plugin_get_type(), nullptr));
 
+  plugin->textures = FL_TEXTURE_REGISTRAR(
+      g_object_ref(fl_plugin_registrar_get_texture_registrar(registrar)));
+
   g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
   g_autoptr(FlMethodChannel) channel =
       fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
@@ -116,5 +2172,20 @@ void desktop_screenshot_plugin_register_with_registrar(FlPluginRegistrar* regist
                                             g_object_ref(plugin),
                                             g_object_unref);
 
+  g_autoptr(FlEventChannel) stream_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "desktop_screenshot/stream",
+                           FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(
+      stream_channel, screenshot_stream_listen_cb, screenshot_stream_cancel_cb,
+      g_object_ref(plugin), g_object_unref);
+
+  // "desktop_screenshot/frames" is a BasicMessageChannel with BinaryCodec on
+  // the Dart side; its messages are handled as raw bytes here.
+  fl_binary_messenger_set_message_handler_on_channel(
+      fl_plugin_registrar_get_messenger(registrar),
+      "desktop_screenshot/frames", frame_message_cb, g_object_ref(plugin),
+      g_object_unref);
+
   g_object_unref(plugin);
 }
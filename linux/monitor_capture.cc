@@ -0,0 +1,193 @@
+#include "monitor_capture.h"
+
+#include <X11/Xutil.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "parallel.h"
+#include "trace.h"
+#include "x11_util.h"
+
+using desktop_screenshot::Frame;
+using desktop_screenshot::Rect;
+using desktop_screenshot::ScopedTrace;
+
+namespace {
+
+bool SameRect(const Rect& a, const Rect& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height;
+}
+
+}  // namespace
+
+Rect MonitorDeviceRect(const Rect& geometry, int scale) {
+  if (scale < 1) scale = 1;
+  return Rect{geometry.x * scale, geometry.y * scale, geometry.width * scale,
+              geometry.height * scale};
+}
+
+MonitorCapturer::MonitorCapturer(std::string display_name,
+                                 const ErrorTrapHooks* traps)
+    : display_name_(std::move(display_name)), traps_(traps) {}
+
+MonitorCapturer::~MonitorCapturer() { Close(); }
+
+bool MonitorCapturer::Prepare(const std::vector<Rect>& monitors) {
+  return UseLayout(monitors);
+}
+
+bool MonitorCapturer::UseLayout(const std::vector<Rect>& monitors) {
+  std::vector<Rect> unique;
+  for (const Rect& rect : monitors) {
+    if (rect.IsEmpty()) continue;
+    if (std::none_of(unique.begin(), unique.end(),
+                     [&](const Rect& r) { return SameRect(r, rect); })) {
+      unique.push_back(rect);
+    }
+  }
+  if (unique.empty()) return false;
+
+  bool same_layout = unique.size() == slots_.size();
+  for (size_t i = 0; same_layout && i < unique.size(); ++i) {
+    same_layout = SameRect(unique[i], slots_[i].rect);
+  }
+  if (!same_layout) {
+    Close();
+    if (!Open(unique)) {
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MonitorCapturer::Capture(const std::vector<Rect>& monitors,
+                              Frame* frame) {
+  ScopedTrace trace("grab");
+  if (!UseLayout(monitors)) return false;
+
+  std::vector<Rect> unique;
+  for (const Slot& slot : slots_) unique.push_back(slot.rect);
+  const Rect bounds = desktop_screenshot::BoundingRect(unique);
+  frame->Allocate(bounds.width, bounds.height);
+  int64_t covered = 0;
+  for (const Rect& rect : unique) {
+    covered += static_cast<int64_t>(rect.width) * rect.height;
+  }
+  // Gaps between monitors of different sizes get no grab.
+  if (covered < static_cast<int64_t>(bounds.width) * bounds.height) {
+    std::fill(frame->pixels.begin(), frame->pixels.end(), 0);
+  }
+
+  bool ok = false;
+  {
+    // Keeps errors on any connection, e.g. from a monitor unplugged after
+    // the caller read the layout, from exiting the process. Every request
+    // Grab makes waits for its reply, which fails along with the request,
+    // so no connection needs syncing to see its errors; the trap's own
+    // flag only adds what a handler of ours catches.
+    ErrorTrap trap(slots_[0].display, traps_);
+    std::atomic<bool> failed(false);
+    desktop_screenshot::ParallelFor(slots_.size(), [&](size_t i) {
+      if (!Grab(slots_[i], bounds, frame)) failed = true;
+    });
+    ok = !failed && !trap.Failed();
+  }
+  if (!ok) Close();
+  return ok;
+}
+
+bool MonitorCapturer::Open(const std::vector<Rect>& monitors) {
+  const char* name = display_name_.empty() ? nullptr : display_name_.c_str();
+  // Each connection is used from pool threads. Xlib's own state is only
+  // locked for connections opened after this; it is a no-op once done.
+  XInitThreads();
+  for (const Rect& rect : monitors) {
+    Slot slot;
+    slot.rect = rect;
+    slot.display = XOpenDisplay(name);
+    if (!slot.display) return false;
+    slots_.push_back(slot);
+    Slot& opened = slots_.back();
+    const int screen = DefaultScreen(opened.display);
+    opened.depth = DefaultDepth(opened.display, screen);
+    opened.segment.shmid = -1;
+    if (!XShmQueryExtension(opened.display)) continue;
+
+    ErrorTrap trap(opened.display, traps_);
+    opened.image = XShmCreateImage(
+        opened.display, DefaultVisual(opened.display, screen), opened.depth,
+        ZPixmap, nullptr, &opened.segment, rect.width, rect.height);
+    if (!opened.image) continue;
+    if (AttachSegment(opened.display,
+                      static_cast<size_t>(opened.image->bytes_per_line) *
+                          rect.height,
+                      &opened.segment) &&
+        !trap.Failed() && SegmentAttached(opened)) {
+      opened.image->data = opened.segment.shmaddr;
+      continue;
+    }
+    // A remote server cannot attach our segment; grab without it.
+    DetachSegment(opened.display, &opened.segment);
+    XDestroyImage(opened.image);
+    opened.image = nullptr;
+  }
+  return true;
+}
+
+void MonitorCapturer::Close() {
+  for (Slot& slot : slots_) {
+    if (slot.image) {
+      // The segment is not the image's to free.
+      slot.image->data = nullptr;
+      XDestroyImage(slot.image);
+    }
+    {
+      ErrorTrap trap(slot.display, traps_);
+      DetachSegment(slot.display, &slot.segment);
+    }
+    XCloseDisplay(slot.display);
+  }
+  slots_.clear();
+}
+
+bool MonitorCapturer::SegmentAttached(const Slot& slot) {
+  // The attach fails asynchronously, which a trap through a toolkit's
+  // handler may not report. A one-pixel grab into the segment waits for
+  // its reply and fails with it.
+  XImage* probe = XShmCreateImage(
+      slot.display, DefaultVisual(slot.display, DefaultScreen(slot.display)),
+      slot.depth, ZPixmap, slot.segment.shmaddr,
+      const_cast<XShmSegmentInfo*>(&slot.segment), 1, 1);
+  if (!probe) return false;
+  const bool attached =
+      XShmGetImage(slot.display, DefaultRootWindow(slot.display), probe,
+                   slot.rect.x, slot.rect.y, AllPlanes);
+  // The segment is not the probe's to free.
+  probe->data = nullptr;
+  XDestroyImage(probe);
+  return attached;
+}
+
+bool MonitorCapturer::Grab(const Slot& slot, const Rect& bounds,
+                           Frame* frame) {
+  ScopedTrace trace("grab monitor");
+  Window root = DefaultRootWindow(slot.display);
+  const int x = slot.rect.x - bounds.x;
+  const int y = slot.rect.y - bounds.y;
+  if (slot.image) {
+    return XShmGetImage(slot.display, root, slot.image, slot.rect.x,
+                        slot.rect.y, AllPlanes) &&
+           CopyImageToFrame(slot.image, slot.depth, frame, x, y);
+  }
+  XImage* image = XGetImage(slot.display, root, slot.rect.x, slot.rect.y,
+                            slot.rect.width, slot.rect.height, AllPlanes,
+                            ZPixmap);
+  if (!image) return false;
+  const bool ok = CopyImageToFrame(image, slot.depth, frame, x, y);
+  XDestroyImage(image);
+  return ok;
+}
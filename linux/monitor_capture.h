@@ -0,0 +1,81 @@
+#ifndef DESKTOP_SCREENSHOT_LINUX_MONITOR_CAPTURE_H_
+#define DESKTOP_SCREENSHOT_LINUX_MONITOR_CAPTURE_H_
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include <string>
+#include <vector>
+
+#include "frame.h"
+#include "x11_util.h"
+
+// The root window rect, in device pixels, of a monitor GDK places at
+// |geometry| in application pixels, |scale| device pixels each.
+desktop_screenshot::Rect MonitorDeviceRect(
+    const desktop_screenshot::Rect& geometry, int scale);
+
+// Grabs the desktop one monitor at a time, all monitors at once. Each
+// monitor has its own X connection and SHM segment, so the grabs run on
+// the task pool without sharing a connection, and a full-desktop grab
+// takes about as long as the slowest monitor instead of the sum of all.
+class MonitorCapturer {
+ public:
+  // |display_name| is passed to XOpenDisplay for every connection. Errors
+  // on them are trapped through |traps| when given (see ErrorTrap), which
+  // a toolkit with its own Xlib error handler has to pass.
+  explicit MonitorCapturer(std::string display_name,
+                           const ErrorTrapHooks* traps = nullptr);
+
+  // Closes the connections and frees the SHM segments.
+  ~MonitorCapturer();
+
+  MonitorCapturer(const MonitorCapturer&) = delete;
+  MonitorCapturer& operator=(const MonitorCapturer&) = delete;
+
+  // Grabs each of |monitors| (root window coordinates in device pixels,
+  // see MonitorDeviceRect) into its slice of |frame|, which covers their
+  // bounding rect; parts no monitor covers are zero. Mirrored monitors
+  // with identical rects are grabbed once. Connections and segments are
+  // kept for the next capture of the same layout and set up anew when it
+  // changes or a grab fails.
+  bool Capture(const std::vector<desktop_screenshot::Rect>& monitors,
+               desktop_screenshot::Frame* frame);
+
+  // Opens the connections and segments for |monitors| ahead of the first
+  // Capture, which then only grabs. False if any of them cannot be opened.
+  bool Prepare(const std::vector<desktop_screenshot::Rect>& monitors);
+
+  // Monitors in the current layout, 0 before the first capture.
+  size_t connections() const { return slots_.size(); }
+
+ private:
+  struct Slot {
+    desktop_screenshot::Rect rect;
+    Display* display = nullptr;
+    int depth = 0;
+    // Null if the server cannot share memory with us; the grab then goes
+    // through XGetImage.
+    XImage* image = nullptr;
+    XShmSegmentInfo segment{};
+  };
+
+  // Drops empty and mirrored rects from |monitors| and makes the slots
+  // match what is left, reopening them if the layout changed.
+  bool UseLayout(const std::vector<desktop_screenshot::Rect>& monitors);
+  bool Open(const std::vector<desktop_screenshot::Rect>& monitors);
+  void Close();
+
+  // True if the server attached |slot|'s segment.
+  static bool SegmentAttached(const Slot& slot);
+
+  // Grabs one monitor over its own connection. Called on a pool thread.
+  bool Grab(const Slot& slot, const desktop_screenshot::Rect& bounds,
+            desktop_screenshot::Frame* frame);
+
+  std::string display_name_;
+  const ErrorTrapHooks* const traps_;
+  std::vector<Slot> slots_;
+};
+
+#endif  // DESKTOP_SCREENSHOT_LINUX_MONITOR_CAPTURE_H_
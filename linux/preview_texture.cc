@@ -0,0 +1,157 @@
+#include "preview_texture.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "memory_ledger.h"
+#include "pixel_pipeline.h"
+
+using desktop_screenshot::BgraPixels;
+using desktop_screenshot::ConvertPixels;
+using desktop_screenshot::Frame;
+using desktop_screenshot::MemoryCharge;
+using desktop_screenshot::MemoryLedger;
+using desktop_screenshot::MemoryStage;
+using desktop_screenshot::RgbaPixels;
+using desktop_screenshot::RgbPixels;
+
+namespace {
+
+struct Buffer {
+  std::vector<uint8_t> rgba;
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+struct Buffers {
+  std::mutex lock;
+  // Written by the main thread outside the lock.
+  Buffer back;
+  // Newest complete frame, not yet picked up when |fresh|.
+  Buffer ready;
+  bool fresh = false;
+  // Handed to the engine by the last copy_pixels; untouched until the next.
+  Buffer front;
+  guint64 published = 0;
+  guint64 shown = 0;
+  // What the three buffers hold, in the process ledger's result stage.
+  MemoryCharge charge;
+};
+
+void Resize(Buffer* buffer, int width, int height) {
+  buffer->width = static_cast<uint32_t>(width);
+  buffer->height = static_cast<uint32_t>(height);
+  // Keeps its capacity, so a steady preview does not reallocate.
+  buffer->rgba.resize(static_cast<size_t>(width) * height * 4);
+}
+
+}  // namespace
+
+struct _PreviewTexture {
+  FlPixelBufferTexture parent_instance;
+  Buffers* buffers;
+};
+
+G_DEFINE_TYPE(PreviewTexture, preview_texture,
+              fl_pixel_buffer_texture_get_type())
+
+// Called on the raster thread. The returned buffer stays valid until the
+// next call, by which time the engine has uploaded it.
+static gboolean preview_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                            const uint8_t** out,
+                                            uint32_t* width, uint32_t* height,
+                                            GError** error) {
+  Buffers* buffers = DESKTOP_SCREENSHOT_PREVIEW_TEXTURE(texture)->buffers;
+  std::lock_guard<std::mutex> hold(buffers->lock);
+  if (buffers->fresh) {
+    std::swap(buffers->front, buffers->ready);
+    buffers->fresh = false;
+    ++buffers->shown;
+  }
+  if (buffers->front.rgba.empty()) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED,
+                "No frame has been published");
+    return FALSE;
+  }
+  *out = buffers->front.rgba.data();
+  *width = buffers->front.width;
+  *height = buffers->front.height;
+  return TRUE;
+}
+
+// Makes the back buffer the newest frame, and recharges the buffers if
+// one of them grew or shrank.
+static void preview_texture_swap(PreviewTexture* self) {
+  Buffers* buffers = self->buffers;
+  std::lock_guard<std::mutex> hold(buffers->lock);
+  std::swap(buffers->back, buffers->ready);
+  buffers->fresh = true;
+  ++buffers->published;
+  const size_t bytes = buffers->back.rgba.capacity() +
+                       buffers->ready.rgba.capacity() +
+                       buffers->front.rgba.capacity();
+  if (bytes != buffers->charge.bytes()) {
+    buffers->charge.Reset();
+    buffers->charge =
+        MemoryLedger::Process().Charge(MemoryStage::kResult, bytes);
+  }
+}
+
+static void preview_texture_finalize(GObject* object) {
+  PreviewTexture* self = DESKTOP_SCREENSHOT_PREVIEW_TEXTURE(object);
+  delete self->buffers;
+  self->buffers = nullptr;
+  G_OBJECT_CLASS(preview_texture_parent_class)->finalize(object);
+}
+
+static void preview_texture_class_init(PreviewTextureClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = preview_texture_finalize;
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      preview_texture_copy_pixels;
+}
+
+static void preview_texture_init(PreviewTexture* self) {
+  self->buffers = new Buffers();
+}
+
+PreviewTexture* preview_texture_new() {
+  return DESKTOP_SCREENSHOT_PREVIEW_TEXTURE(
+      g_object_new(preview_texture_get_type(), nullptr));
+}
+
+void preview_texture_publish_pixbuf(PreviewTexture* self, GdkPixbuf* pixbuf) {
+  const int width = gdk_pixbuf_get_width(pixbuf);
+  const int height = gdk_pixbuf_get_height(pixbuf);
+  const size_t stride = gdk_pixbuf_get_rowstride(pixbuf);
+  const guint8* pixels = gdk_pixbuf_read_pixels(pixbuf);
+  Buffer& back = self->buffers->back;
+  Resize(&back, width, height);
+  if (gdk_pixbuf_get_n_channels(pixbuf) == 4) {
+    ConvertPixels<RgbaPixels, RgbaPixels>(pixels, stride, back.rgba.data(),
+                                          width * 4, width, height);
+  } else {
+    ConvertPixels<RgbPixels, RgbaPixels>(pixels, stride, back.rgba.data(),
+                                         width * 4, width, height);
+  }
+  preview_texture_swap(self);
+}
+
+void preview_texture_publish_frame(PreviewTexture* self, const Frame& frame) {
+  Buffer& back = self->buffers->back;
+  Resize(&back, frame.width, frame.height);
+  ConvertPixels<BgraPixels, RgbaPixels>(frame.Row(0), frame.stride,
+                                        back.rgba.data(), frame.width * 4,
+                                        frame.width, frame.height);
+  preview_texture_swap(self);
+}
+
+guint64 preview_texture_get_published(PreviewTexture* self) {
+  std::lock_guard<std::mutex> hold(self->buffers->lock);
+  return self->buffers->published;
+}
+
+guint64 preview_texture_get_shown(PreviewTexture* self) {
+  std::lock_guard<std::mutex> hold(self->buffers->lock);
+  return self->buffers->shown;
+}
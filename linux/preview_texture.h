@@ -0,0 +1,32 @@
+#ifndef DESKTOP_SCREENSHOT_LINUX_PREVIEW_TEXTURE_H_
+#define DESKTOP_SCREENSHOT_LINUX_PREVIEW_TEXTURE_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <gdk/gdk.h>
+
+#include "frame.h"
+
+// A pixel-buffer texture showing the latest captured frame. Captures are
+// converted to RGBA once, on the main thread, into a back buffer; the
+// raster thread's copy_pixels picks up the newest one. Three buffers
+// rotate so neither side waits for the other and the engine never reads a
+// buffer that is being written. The buffers are charged to the process
+// memory ledger until the texture is finalized.
+G_DECLARE_FINAL_TYPE(PreviewTexture, preview_texture, DESKTOP_SCREENSHOT,
+                     PREVIEW_TEXTURE, FlPixelBufferTexture)
+
+PreviewTexture* preview_texture_new();
+
+// Publishes an RGB or RGBA pixbuf as the newest frame.
+void preview_texture_publish_pixbuf(PreviewTexture* texture,
+                                    GdkPixbuf* pixbuf);
+
+// Publishes a BGRA frame as the newest frame.
+void preview_texture_publish_frame(PreviewTexture* texture,
+                                   const desktop_screenshot::Frame& frame);
+
+// Frames published, and frames the engine has picked up, since creation.
+guint64 preview_texture_get_published(PreviewTexture* texture);
+guint64 preview_texture_get_shown(PreviewTexture* texture);
+
+#endif  // DESKTOP_SCREENSHOT_LINUX_PREVIEW_TEXTURE_H_
@@ -0,0 +1,52 @@
+#include "screen_capture.h"
+
+#include "pixel_pipeline.h"
+#include "trace.h"
+
+using desktop_screenshot::BgraPixels;
+using desktop_screenshot::ConvertPixels;
+using desktop_screenshot::Frame;
+using desktop_screenshot::RgbaPixels;
+using desktop_screenshot::RgbPixels;
+using desktop_screenshot::ScopedTrace;
+
+void pixbuf_to_frame(GdkPixbuf* pixbuf, Frame* frame) {
+  const guint8* pixels = gdk_pixbuf_read_pixels(pixbuf);
+  const size_t stride = gdk_pixbuf_get_rowstride(pixbuf);
+  frame->Allocate(gdk_pixbuf_get_width(pixbuf), gdk_pixbuf_get_height(pixbuf));
+  if (gdk_pixbuf_get_n_channels(pixbuf) == 4) {
+    ConvertPixels<RgbaPixels, BgraPixels>(pixels, stride, frame->Row(0),
+                                          frame->stride, frame->width,
+                                          frame->height);
+  } else {
+    ConvertPixels<RgbPixels, BgraPixels>(pixels, stride, frame->Row(0),
+                                         frame->stride, frame->width,
+                                         frame->height);
+  }
+}
+
+void frame_to_pixbuf(const Frame& frame, GdkPixbuf* pixbuf) {
+  guint8* pixels = gdk_pixbuf_get_pixels(pixbuf);
+  const size_t stride = gdk_pixbuf_get_rowstride(pixbuf);
+  if (gdk_pixbuf_get_n_channels(pixbuf) == 4) {
+    ConvertPixels<BgraPixels, RgbaPixels>(frame.Row(0), frame.stride, pixels,
+                                          stride, frame.width, frame.height);
+  } else {
+    ConvertPixels<BgraPixels, RgbPixels>(frame.Row(0), frame.stride, pixels,
+                                         stride, frame.width, frame.height);
+  }
+}
+
+GdkPixbuf* capture_root_pixbuf() {
+  ScopedTrace trace("grab");
+  GdkWindow* root = gdk_get_default_root_window();
+  return gdk_pixbuf_get_from_window(root, 0, 0, gdk_window_get_width(root),
+                                    gdk_window_get_height(root));
+}
+
+bool capture_root_frame(Frame* frame) {
+  g_autoptr(GdkPixbuf) pixbuf = capture_root_pixbuf();
+  if (!pixbuf) return false;
+  pixbuf_to_frame(pixbuf, frame);
+  return true;
+}
@@ -0,0 +1,24 @@
+#ifndef DESKTOP_SCREENSHOT_LINUX_SCREEN_CAPTURE_H_
+#define DESKTOP_SCREENSHOT_LINUX_SCREEN_CAPTURE_H_
+
+#include <gdk/gdk.h>
+
+#include "frame.h"
+
+// GDK capture and pixbuf conversion shared by the plugin and the capture
+// daemon.
+
+// Copies an RGB or RGBA pixbuf into a BGRA frame.
+void pixbuf_to_frame(GdkPixbuf* pixbuf, desktop_screenshot::Frame* frame);
+
+// Writes a BGRA frame back into a pixbuf of the same size.
+void frame_to_pixbuf(const desktop_screenshot::Frame& frame, GdkPixbuf* pixbuf);
+
+// Grabs the whole root window (all monitors) as an RGB pixbuf. Returns
+// nullptr on failure.
+GdkPixbuf* capture_root_pixbuf();
+
+// Grabs the whole root window (all monitors) into a BGRA frame.
+bool capture_root_frame(desktop_screenshot::Frame* frame);
+
+#endif  // DESKTOP_SCREENSHOT_LINUX_SCREEN_CAPTURE_H_
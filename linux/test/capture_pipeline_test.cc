@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "capture_pipeline.h"
+#include "frame_hash.h"
+#include "scale.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// A frame whose pixels encode their own position.
+Frame Gradient(int width, int height) {
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < width; ++x, p += 4) {
+      p[0] = static_cast<uint8_t>(x);
+      p[1] = static_cast<uint8_t>(y);
+      p[2] = static_cast<uint8_t>(x ^ y);
+      p[3] = 0xFF;
+    }
+  }
+  return frame;
+}
+
+// "Encodes" a frame as its dimensions followed by its format.
+FrameEncoder FakeEncoder(std::atomic<int>* calls = nullptr) {
+  return [=](const Frame& frame, ImageFormat format,
+             std::vector<uint8_t>* out) {
+    if (calls) ++*calls;
+    *out = {static_cast<uint8_t>(frame.width),
+            static_cast<uint8_t>(frame.height), static_cast<uint8_t>(format)};
+    return true;
+  };
+}
+
+PipelineOutput Image(ImageFormat format, double scale = 1, Rect region = {}) {
+  PipelineOutput output;
+  output.format = format;
+  output.scale = scale;
+  output.region = region;
+  return output;
+}
+
+PipelineOutput Fingerprint(double scale = 1, Rect region = {}) {
+  PipelineOutput output = Image(ImageFormat::kPng, scale, region);
+  output.product = PipelineProduct::kFingerprint;
+  return output;
+}
+
+}  // namespace
+
+TEST(CapturePipeline, ProducesEveryOutputFromOneFrame) {
+  Frame frame = Gradient(200, 100);
+  std::vector<PipelineResult> results;
+  PipelineStats stats;
+  ASSERT_TRUE(RunCapturePipeline(
+      frame,
+      {Image(ImageFormat::kPng), Image(ImageFormat::kJpeg, 0.25),
+       Fingerprint()},
+      FakeEncoder(), &results, &stats));
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0].bytes,
+            (std::vector<uint8_t>{200, 100,
+                                  static_cast<uint8_t>(ImageFormat::kPng)}));
+  EXPECT_EQ(results[1].width, 50);
+  EXPECT_EQ(results[1].height, 25);
+  EXPECT_EQ(results[1].bytes[2], static_cast<uint8_t>(ImageFormat::kJpeg));
+  EXPECT_EQ(results[2].fingerprint, HashFrame(frame));
+  EXPECT_TRUE(results[2].bytes.empty());
+  // The full-size outputs use the capture itself.
+  EXPECT_EQ(stats.crops, 0);
+  EXPECT_EQ(stats.scales, 1);
+}
+
+TEST(CapturePipeline, SharesCropsAndScalesBetweenOutputs) {
+  Frame frame = Gradient(256, 128);
+  const Rect panel{16, 8, 128, 64};
+  std::atomic<int> calls{0};
+  std::vector<PipelineResult> results;
+  PipelineStats stats;
+  ASSERT_TRUE(RunCapturePipeline(
+      frame,
+      {Image(ImageFormat::kPng, 0.5, panel),
+       Image(ImageFormat::kBmp, 0.5, panel), Fingerprint(0.5, panel),
+       Image(ImageFormat::kPng, 1, panel)},
+      FakeEncoder(&calls), &results, &stats));
+  EXPECT_EQ(stats.crops, 1);
+  EXPECT_EQ(stats.scales, 1);
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(results[2].fingerprint,
+            HashFrame(ScaleFrame(CropFrame(frame, panel), 64, 32)));
+  EXPECT_EQ(results[3].width, 128);
+}
+
+TEST(CapturePipeline, DerivesSmallSizesFromLargerIntermediates) {
+  Frame frame = Gradient(240, 120);
+  std::vector<PipelineResult> results;
+  PipelineStats stats;
+  ASSERT_TRUE(RunCapturePipeline(
+      frame, {Fingerprint(0.25), Fingerprint(0.5)}, FakeEncoder(), &results,
+      &stats));
+  EXPECT_EQ(stats.scales, 2);
+  // The quarter size comes from the half size; with exact 2x steps the box
+  // filter gives the same pixels either way, up to rounding.
+  Frame half = ScaleFrame(frame, 120, 60);
+  EXPECT_EQ(results[0].fingerprint, HashFrame(ScaleFrame(half, 60, 30)));
+  EXPECT_EQ(results[1].fingerprint, HashFrame(half));
+}
+
+TEST(CapturePipeline, ClampsRegionsAndSkipsOnesOffTheCapture) {
+  Frame frame = Gradient(64, 64);
+  std::vector<PipelineResult> results;
+  ASSERT_TRUE(RunCapturePipeline(
+      frame,
+      {Image(ImageFormat::kPng, 1, Rect{48, 48, 32, 32}),
+       Image(ImageFormat::kPng, 1, Rect{100, 0, 10, 10})},
+      FakeEncoder(), &results));
+  EXPECT_EQ(results[0].width, 16);
+  EXPECT_EQ(results[0].height, 16);
+  EXPECT_EQ(results[1].width, 0);
+  EXPECT_TRUE(results[1].bytes.empty());
+}
+
+TEST(CapturePipeline, ReportsEncoderFailure) {
+  Frame frame = Gradient(32, 32);
+  std::vector<PipelineResult> results;
+  FrameEncoder failing = [](const Frame&, ImageFormat,
+                            std::vector<uint8_t>*) { return false; };
+  EXPECT_FALSE(RunCapturePipeline(frame, {Image(ImageFormat::kPng)}, failing,
+                                  &results));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "chunk_writer.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(ChunkWriter, CoalescesSmallWritesAndPreservesBytes) {
+  std::vector<std::vector<uint8_t>> chunks;
+  ChunkWriter writer(16, [&](const uint8_t* data, size_t size) {
+    chunks.emplace_back(data, data + size);
+  });
+
+  std::vector<uint8_t> expected;
+  for (int i = 0; i < 50; ++i) {
+    uint8_t piece[3] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i + 1),
+                        static_cast<uint8_t>(i + 2)};
+    writer.Write(piece, sizeof(piece));
+    expected.insert(expected.end(), piece, piece + sizeof(piece));
+  }
+  EXPECT_EQ(chunks.size(), 9u);
+  writer.Finish();
+
+  std::vector<uint8_t> joined;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (i + 1 < chunks.size()) {
+      EXPECT_EQ(chunks[i].size(), 16u);
+    }
+    joined.insert(joined.end(), chunks[i].begin(), chunks[i].end());
+  }
+  EXPECT_EQ(joined, expected);
+  EXPECT_EQ(writer.total_bytes(), expected.size());
+  EXPECT_EQ(writer.chunks(), static_cast<int>(chunks.size()));
+}
+
+TEST(ChunkWriter, LargeWritesPassThroughWhole) {
+  std::vector<size_t> sizes;
+  ChunkWriter writer(8, [&](const uint8_t*, size_t size) {
+    sizes.push_back(size);
+  });
+  std::vector<uint8_t> big(100, 7);
+  writer.Write(big.data(), 3);
+  writer.Write(big.data(), big.size());
+  writer.Finish();
+  // The first write tops up the pending buffer, the rest goes out as is.
+  ASSERT_EQ(sizes.size(), 2u);
+  EXPECT_EQ(sizes[0], 8u);
+  EXPECT_EQ(sizes[1], 95u);
+  EXPECT_EQ(writer.total_bytes(), 103u);
+}
+
+TEST(ChunkWriter, FinishWithNothingPendingEmitsNothing) {
+  int calls = 0;
+  ChunkWriter writer(8, [&](const uint8_t*, size_t) { ++calls; });
+  writer.Finish();
+  EXPECT_EQ(calls, 0);
+}
+
+TEST(ChunkWriter, ChargesWhatItHoldsBackAndReservesNoMoreThanADefault) {
+  MemoryLedger ledger;
+  {
+    ChunkWriter writer(size_t{1} << 40, [](const uint8_t*, size_t) {},
+                       &ledger);
+    EXPECT_LE(ledger.Stats().current, size_t{ChunkWriter::kDefaultChunkSize});
+    std::vector<uint8_t> bytes(3 * ChunkWriter::kDefaultChunkSize, 1);
+    writer.Write(bytes.data(), bytes.size());
+    EXPECT_GE(ledger.Stats().stages[2].current, bytes.size());
+    writer.Finish();
+  }
+  EXPECT_EQ(ledger.Stats().current, 0u);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
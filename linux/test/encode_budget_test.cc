@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include "encode_budget.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// Bytes per pixel the fake encoder writes for each kind of settings.
+double BytesPerPixel(const EncodeSettings& settings) {
+  if (settings.format == ImageFormat::kPng) {
+    if (settings.palette == PaletteMode::kQuantize) return 0.6;
+    return settings.level == 1 ? 2.0 : 1.5;
+  }
+  if (settings.level >= 90) return 0.8;
+  if (settings.level >= 75) return 0.5;
+  if (settings.level >= 60) return 0.35;
+  return 0.25;
+}
+
+// Writes a fixed header plus a payload proportional to the pixel count.
+// |large_penalty| multiplies the payload of frames bigger than the trial
+// mosaic, the way real content can compress worse than its sample.
+SettingsEncoder FakeEncoder(double large_penalty = 1.0, int* calls = nullptr) {
+  return [=](const Frame& frame, const EncodeSettings& settings,
+             std::vector<uint8_t>* out) {
+    if (calls) ++*calls;
+    double payload = BytesPerPixel(settings) * frame.width * frame.height;
+    if (frame.width > 512) payload *= large_penalty;
+    out->assign(100 + static_cast<size_t>(payload), 0);
+    return true;
+  };
+}
+
+Frame Desktop() {
+  Frame frame;
+  frame.Allocate(1920, 1080);
+  return frame;
+}
+
+}  // namespace
+
+TEST(EncodeBudget, UnlimitedBudgetKeepsBestSettingsWithoutTrials) {
+  BudgetPlanner planner;
+  BudgetResult result;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), EncodeBudget{},
+                                         FakeEncoder(), &result));
+  EXPECT_EQ(result.trials, 0);
+  EXPECT_EQ(result.settings.format, ImageFormat::kPng);
+  EXPECT_EQ(result.settings.scale, 1);
+  EXPECT_TRUE(result.within_budget);
+}
+
+TEST(EncodeBudget, PicksBestSettingsThatFitTheByteLimit) {
+  BudgetPlanner planner;
+  EncodeBudget budget;
+  budget.max_bytes = 800000;  // JPEG 60 at 0.35 bytes/pixel is ~726 KB.
+  BudgetResult result;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), budget, FakeEncoder(),
+                                         &result));
+  EXPECT_EQ(result.settings.format, ImageFormat::kJpeg);
+  EXPECT_EQ(result.settings.level, 60);
+  EXPECT_EQ(result.settings.scale, 1);
+  EXPECT_LE(result.bytes.size(), budget.max_bytes);
+  EXPECT_TRUE(result.within_budget);
+}
+
+TEST(EncodeBudget, DownscalesWhenQualityAloneCannotFit) {
+  BudgetPlanner planner;
+  EncodeBudget budget;
+  budget.max_bytes = 200000;
+  BudgetResult result;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), budget, FakeEncoder(),
+                                         &result));
+  EXPECT_GT(result.settings.scale, 1);
+  EXPECT_EQ(result.width, 1920 / result.settings.scale);
+  EXPECT_EQ(result.height, 1080 / result.settings.scale);
+  EXPECT_LE(result.bytes.size(), budget.max_bytes);
+}
+
+TEST(EncodeBudget, RetriesNativelyAndLearnsWhenTheSampleUnderestimates) {
+  BudgetPlanner planner;
+  EncodeBudget budget;
+  budget.max_bytes = 800000;
+  int calls = 0;
+  SettingsEncoder encode = FakeEncoder(2.0, &calls);
+
+  BudgetResult first;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), budget, encode, &first));
+  EXPECT_LE(first.bytes.size(), budget.max_bytes);
+  EXPECT_TRUE(first.within_budget);
+
+  // The correction learned from the first frame lets the second one land
+  // on fitting settings with its first real encode.
+  BudgetResult second;
+  calls = 0;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), budget, encode, &second));
+  EXPECT_LE(second.bytes.size(), budget.max_bytes);
+  EXPECT_EQ(calls, second.trials + 1);
+}
+
+TEST(EncodeBudget, ReportsAnImpossibleBudget) {
+  BudgetPlanner planner;
+  EncodeBudget budget;
+  budget.max_bytes = 10;
+  BudgetResult result;
+  ASSERT_TRUE(planner.EncodeWithinBudget(Desktop(), budget, FakeEncoder(),
+                                         &result));
+  EXPECT_FALSE(result.within_budget);
+  EXPECT_EQ(result.settings.scale, planner.candidates().back().scale);
+}
+
+TEST(EncodeBudget, SmallFramesAreTheirOwnSample) {
+  Frame frame;
+  frame.Allocate(300, 200);
+  double fraction = 0;
+  Frame sample = SampleMosaic(frame, 1, &fraction);
+  EXPECT_EQ(fraction, 1.0);
+  EXPECT_EQ(sample.width, 300);
+  sample = SampleMosaic(frame, 2, &fraction);
+  EXPECT_EQ(sample.width, 150);
+  EXPECT_EQ(sample.height, 100);
+}
+
+TEST(EncodeBudget, MosaicTakesOneTilePerCell) {
+  Frame frame = Desktop();
+  // Color each pixel by its 4 x 4 grid cell.
+  for (int y = 0; y < frame.height; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      p[0] = static_cast<uint8_t>(x * 4 / frame.width);
+      p[1] = static_cast<uint8_t>(y * 4 / frame.height);
+    }
+  }
+  for (int scale : {1, 2}) {
+    double fraction = 0;
+    Frame mosaic = SampleMosaic(frame, scale, &fraction);
+    ASSERT_EQ(mosaic.width, 256);
+    ASSERT_EQ(mosaic.height, 256);
+    EXPECT_DOUBLE_EQ(fraction, 65536.0 / ((1920 / scale) * (1080 / scale)));
+    for (int gy = 0; gy < 4; ++gy) {
+      for (int gx = 0; gx < 4; ++gx) {
+        const uint8_t* p = mosaic.Row(gy * 64 + 32) + (gx * 64 + 32) * 4;
+        EXPECT_EQ(p[0], gx);
+        EXPECT_EQ(p[1], gy);
+      }
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "encode_cache.h"
+#include "frame_hash.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(FrameHash, DependsOnEveryByteAndTheShape) {
+  std::vector<uint8_t> bytes(4096 + 37);
+  for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = uint8_t(i * 31);
+  uint64_t base = HashBytes(bytes.data(), bytes.size());
+  EXPECT_EQ(base, HashBytes(bytes.data(), bytes.size()));
+  for (size_t i : {size_t(0), size_t(63), size_t(1500), bytes.size() - 1}) {
+    bytes[i] ^= 1;
+    EXPECT_NE(base, HashBytes(bytes.data(), bytes.size())) << i;
+    bytes[i] ^= 1;
+  }
+  EXPECT_NE(base, HashBytes(bytes.data(), bytes.size() - 1));
+
+  Frame wide;
+  wide.Allocate(4, 1);
+  Frame tall;
+  tall.Allocate(1, 4);
+  EXPECT_NE(HashFrame(wide), HashFrame(tall));
+}
+
+TEST(FrameHash, KnownValue) {
+  // Pins the output so the SSE2 and portable paths cannot drift apart.
+  std::vector<uint8_t> bytes(3000);
+  for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = uint8_t(i);
+  EXPECT_EQ(HashBytes(bytes.data(), bytes.size()), 1320749580516580059ull);
+}
+
+TEST(EncodeCache, HitsOnlyForSameParamsAndHash) {
+  EncodeCache cache;
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(cache.Lookup("png", 1, &out));
+  cache.Store("png", 1, {1, 2, 3});
+  EXPECT_TRUE(cache.Lookup("png", 1, &out));
+  EXPECT_EQ(out, (std::vector<uint8_t>{1, 2, 3}));
+  EXPECT_FALSE(cache.Lookup("png", 2, &out));
+  EXPECT_FALSE(cache.Lookup("jpeg", 1, &out));
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.misses(), 3u);
+}
+
+TEST(EncodeCache, KeepsBoundedNumberOfParamSets) {
+  EncodeCache cache;
+  for (size_t i = 0; i <= EncodeCache::kMaxEntries; ++i) {
+    cache.Store(std::to_string(i), i, {uint8_t(i)});
+  }
+  EXPECT_EQ(cache.size(), EncodeCache::kMaxEntries);
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(cache.Lookup("0", 0, &out));
+  EXPECT_TRUE(cache.Lookup("1", 1, &out));
+}
+
+TEST(EncodeCache, DoesNotRecordFailedEncodes) {
+  EncodeCache cache;
+  cache.Store("png", 1, {});
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(cache.Lookup("png", 1, &out));
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(EncodeCache, ChargesWhatItKeepsToTheLedger) {
+  MemoryLedger ledger;
+  {
+    EncodeCache cache(&ledger);
+    cache.Store("png", 1, std::vector<uint8_t>(100));
+    cache.Store("jpeg", 1, std::vector<uint8_t>(50));
+    EXPECT_EQ(ledger.Stats().stages[int(MemoryStage::kEncode)].current,
+              150u);
+    cache.Store("png", 2, std::vector<uint8_t>(10));
+    EXPECT_EQ(ledger.Stats().current, 60u);
+    cache.Clear();
+    EXPECT_EQ(ledger.Stats().current, 0u);
+    cache.Store("png", 3, std::vector<uint8_t>(20));
+  }
+  EXPECT_EQ(ledger.Stats().current, 0u);
+}
+
+TEST(EncodeCache, ParamsKeyReflectsRedactions) {
+  Redaction redaction;
+  redaction.rect = Rect{1, 2, 3, 4};
+  std::string plain = EncodeParamsKey(ImageFormat::kPng, PaletteMode::kOff, {});
+  std::string redacted =
+      EncodeParamsKey(ImageFormat::kPng, PaletteMode::kOff, {redaction});
+  EXPECT_NE(plain, redacted);
+  redaction.mode = RedactionMode::kBlur;
+  EXPECT_NE(redacted,
+            EncodeParamsKey(ImageFormat::kPng, PaletteMode::kOff, {redaction}));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
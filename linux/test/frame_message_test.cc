@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "frame_message.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(FrameMessage, RequestRoundTrips) {
+  FrameRequest request;
+  request.payload = FramePayload::kJpeg;
+  std::vector<uint8_t> bytes = EncodeFrameRequest(request);
+  ASSERT_EQ(bytes.size(), kFrameRequestSize);
+  FrameRequest parsed;
+  ASSERT_TRUE(ParseFrameRequest(bytes.data(), bytes.size(), &parsed));
+  EXPECT_EQ(parsed.payload, FramePayload::kJpeg);
+}
+
+TEST(FrameMessage, RejectsMalformedRequests) {
+  FrameRequest parsed;
+  std::vector<uint8_t> bytes = EncodeFrameRequest(FrameRequest{});
+  EXPECT_FALSE(ParseFrameRequest(bytes.data(), bytes.size() - 1, &parsed));
+  bytes[5] = 9;
+  EXPECT_FALSE(ParseFrameRequest(bytes.data(), bytes.size(), &parsed));
+  bytes = EncodeFrameRequest(FrameRequest{});
+  bytes[0] = 'X';
+  EXPECT_FALSE(ParseFrameRequest(bytes.data(), bytes.size(), &parsed));
+}
+
+TEST(FrameMessage, PixelMessageCarriesTightRows) {
+  Frame frame;
+  frame.Allocate(3, 2);
+  for (size_t i = 0; i < frame.pixels.size(); ++i) {
+    frame.pixels[i] = static_cast<uint8_t>(i);
+  }
+  std::vector<uint8_t> message = BuildPixelMessage(frame, 0x0102030405060708);
+  FrameMessageHeader header;
+  ASSERT_TRUE(ReadFrameMessageHeader(message.data(), message.size(), &header));
+  EXPECT_EQ(header.payload, FramePayload::kPixels);
+  EXPECT_EQ(header.status, FrameStatus::kOk);
+  EXPECT_EQ(header.width, 3u);
+  EXPECT_EQ(header.height, 2u);
+  EXPECT_EQ(header.timestamp_ns, 0x0102030405060708u);
+  ASSERT_EQ(header.size, 24u);
+  ASSERT_EQ(message.size(), kFrameMessageHeaderSize + 24);
+  EXPECT_EQ(0, std::memcmp(message.data() + kFrameMessageHeaderSize,
+                           frame.pixels.data(), 24));
+  // Little-endian on the wire whatever the host order.
+  EXPECT_EQ(message[8], 3);
+  EXPECT_EQ(message[16], 0x08);
+}
+
+TEST(FrameMessage, WrapsEncodedBytes) {
+  // An encoder's output behind the gap it leaves for the header.
+  std::vector<uint8_t> bytes(kFrameMessageHeaderSize + 5);
+  for (int i = 0; i < 5; ++i) bytes[kFrameMessageHeaderSize + i] = i + 1;
+  FrameMessageHeader header;
+  header.payload = FramePayload::kPng;
+  header.width = 10;
+  header.height = 20;
+  WrapEncodedMessage(header, &bytes);
+  FrameMessageHeader parsed;
+  ASSERT_TRUE(ReadFrameMessageHeader(bytes.data(), bytes.size(), &parsed));
+  EXPECT_EQ(parsed.payload, FramePayload::kPng);
+  EXPECT_EQ(parsed.size, 5u);
+  EXPECT_EQ(bytes[kFrameMessageHeaderSize + 4], 5);
+}
+
+TEST(FrameMessage, RejectsTruncatedMessages) {
+  Frame frame;
+  frame.Allocate(4, 4);
+  std::vector<uint8_t> message = BuildPixelMessage(frame, 0);
+  FrameMessageHeader header;
+  EXPECT_FALSE(
+      ReadFrameMessageHeader(message.data(), message.size() - 1, &header));
+  EXPECT_FALSE(ReadFrameMessageHeader(message.data(), 16, &header));
+}
+
+TEST(FrameMessage, ErrorMessageHasNoPayload) {
+  std::vector<uint8_t> message =
+      BuildFrameErrorMessage(FramePayload::kRaw, FrameStatus::kCaptureFailed);
+  FrameMessageHeader header;
+  ASSERT_TRUE(ReadFrameMessageHeader(message.data(), message.size(), &header));
+  EXPECT_EQ(header.status, FrameStatus::kCaptureFailed);
+  EXPECT_EQ(header.size, 0u);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+std::string RingName(const char* suffix) {
+  return "/desktop_screenshot_test_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+// Fills every pixel of |frame| with a value derived from |sequence|, so a
+// reader can tell a torn frame (mixed values) from a whole one.
+void Stamp(Frame* frame, uint64_t sequence) {
+  uint32_t value = static_cast<uint32_t>(sequence * 2654435761u);
+  uint32_t* p = reinterpret_cast<uint32_t*>(frame->pixels.data());
+  std::fill(p, p + frame->pixels.size() / 4, value);
+}
+
+bool IsWhole(const Frame& frame, uint64_t sequence) {
+  uint32_t value = static_cast<uint32_t>(sequence * 2654435761u);
+  const uint32_t* p = reinterpret_cast<const uint32_t*>(frame.pixels.data());
+  for (size_t i = 0; i < frame.pixels.size() / 4; ++i) {
+    if (p[i] != value) return false;
+  }
+  return true;
+}
+
+// Body of a reader process: reads until |last| has been seen. Exit code 0
+// means every frame read was whole, sequences never went backwards and
+// more than one distinct frame was observed.
+int ReaderMain(const std::string& name, uint64_t last) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  std::unique_ptr<FrameRingReader> reader = FrameRingReader::Open(name);
+  if (!reader) return 3;
+  Frame frame;
+  uint64_t previous = 0;
+  int distinct = 0;
+  while (previous < last) {
+    if (std::chrono::steady_clock::now() > deadline) return 4;
+    uint64_t sequence = 0;
+    if (!reader->ReadLatest(&frame, &sequence)) continue;
+    if (sequence < previous || !IsWhole(frame, sequence)) return 1;
+    if (sequence != previous) ++distinct;
+    previous = sequence;
+  }
+  return distinct > 1 ? 0 : 2;
+}
+
+}  // namespace
+
+TEST(FrameRing, OpenFailsWithoutWriter) {
+  EXPECT_EQ(FrameRingReader::Open(RingName("missing")), nullptr);
+}
+
+TEST(FrameRing, ReadsLatestPublishedFrame) {
+  std::string name = RingName("latest");
+  auto writer = FrameRingWriter::Create(name, 3, 64 * 64 * 4);
+  ASSERT_NE(writer, nullptr);
+  auto reader = FrameRingReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+
+  Frame frame;
+  EXPECT_FALSE(reader->ReadLatest(&frame, nullptr));
+
+  Frame source;
+  source.Allocate(64, 32);
+  for (uint64_t sequence = 1; sequence <= 5; ++sequence) {
+    Stamp(&source, sequence);
+    ASSERT_TRUE(writer->Publish(source, sequence * 1000));
+  }
+  uint64_t sequence = 0;
+  ASSERT_TRUE(reader->ReadLatest(&frame, &sequence));
+  EXPECT_EQ(sequence, 5u);
+  EXPECT_EQ(frame.width, 64);
+  EXPECT_EQ(frame.height, 32);
+  EXPECT_TRUE(IsWhole(frame, 5));
+
+  Frame too_big;
+  too_big.Allocate(65, 64);
+  EXPECT_FALSE(writer->Publish(too_big, 0));
+}
+
+TEST(FrameRing, ViewIsInvalidatedWhenSlotIsReused) {
+  std::string name = RingName("view");
+  auto writer = FrameRingWriter::Create(name, 2, 16 * 16 * 4);
+  ASSERT_NE(writer, nullptr);
+  auto reader = FrameRingReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+
+  Frame source;
+  source.Allocate(16, 16);
+  Stamp(&source, 1);
+  writer->Publish(source, 0);
+
+  FrameRingReader::View view;
+  ASSERT_TRUE(reader->AcquireLatest(&view));
+  EXPECT_EQ(view.sequence, 1u);
+  EXPECT_TRUE(reader->StillValid(view));
+
+  // The other slot: the view survives.
+  Stamp(&source, 2);
+  writer->Publish(source, 0);
+  EXPECT_TRUE(reader->StillValid(view));
+
+  // Back around to the view's slot.
+  Stamp(&source, 3);
+  writer->Publish(source, 0);
+  EXPECT_FALSE(reader->StillValid(view));
+}
+
+TEST(FrameRing, ReaderFollowsAReplacedRing) {
+  std::string name = RingName("replaced");
+  auto writer = FrameRingWriter::Create(name, 2, 16 * 16 * 4);
+  ASSERT_NE(writer, nullptr);
+  auto reader = FrameRingReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->name(), name);
+
+  Frame small;
+  small.Allocate(16, 16);
+  Stamp(&small, 1);
+  ASSERT_TRUE(writer->Publish(small, 0));
+  EXPECT_FALSE(reader->closed());
+
+  // The screen grew: the daemon drops the ring and creates a larger one.
+  writer.reset();
+  EXPECT_TRUE(reader->closed());
+  Frame frame;
+  EXPECT_FALSE(reader->ReadLatest(&frame, nullptr));
+  writer = FrameRingWriter::Create(name, 2, 32 * 32 * 4);
+  ASSERT_NE(writer, nullptr);
+  Frame large;
+  large.Allocate(32, 32);
+  Stamp(&large, 1);
+  ASSERT_TRUE(writer->Publish(large, 0));
+
+  reader = FrameRingReader::Open(reader->name());
+  ASSERT_NE(reader, nullptr);
+  ASSERT_TRUE(reader->ReadLatest(&frame, nullptr));
+  EXPECT_EQ(frame.width, 32);
+  EXPECT_TRUE(IsWhole(frame, 1));
+}
+
+TEST(FrameRing, ConcurrentReaderProcessesNeverSeeTornFrames) {
+  const int kReaders = 4;
+  const uint64_t kFrames = 400;
+  std::string name = RingName("procs");
+  auto writer = FrameRingWriter::Create(name, 4, 256 * 256 * 4);
+  ASSERT_NE(writer, nullptr);
+
+  std::vector<pid_t> children;
+  for (int i = 0; i < kReaders; ++i) {
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) _exit(ReaderMain(name, kFrames));
+    children.push_back(pid);
+  }
+
+  Frame source;
+  source.Allocate(256, 256);
+  for (uint64_t sequence = 1; sequence <= kFrames; ++sequence) {
+    Stamp(&source, sequence);
+    ASSERT_TRUE(writer->Publish(source, sequence));
+    usleep(200);
+  }
+
+  for (pid_t pid : children) {
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+  }
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
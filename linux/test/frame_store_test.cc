@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "frame_store.h"
+#include "scale.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+Frame MakeFrame(int width, int height, uint8_t value) {
+  Frame frame;
+  frame.Allocate(width, height);
+  std::fill(frame.pixels.begin(), frame.pixels.end(), value);
+  return frame;
+}
+
+}  // namespace
+
+TEST(FrameStore, ReleasedHandlesAreGone) {
+  FrameStore store;
+  int64_t handle = store.Put(MakeFrame(4, 4, 1));
+  ASSERT_NE(store.Get(handle), nullptr);
+  EXPECT_TRUE(store.Release(handle));
+  EXPECT_EQ(store.Get(handle), nullptr);
+  EXPECT_FALSE(store.Release(handle));
+  EXPECT_EQ(store.memory_used(), 0u);
+}
+
+TEST(FrameStore, EvictsLeastRecentlyUsedOverLimit) {
+  // Each 4x4 frame is 64 bytes; room for two.
+  FrameStore store(128);
+  int64_t a = store.Put(MakeFrame(4, 4, 1));
+  int64_t b = store.Put(MakeFrame(4, 4, 2));
+  ASSERT_NE(store.Get(a), nullptr);  // |b| is now least recently used.
+  int64_t c = store.Put(MakeFrame(4, 4, 3));
+  EXPECT_NE(store.Get(a), nullptr);
+  EXPECT_EQ(store.Get(b), nullptr);
+  EXPECT_NE(store.Get(c), nullptr);
+  EXPECT_EQ(store.memory_used(), 128u);
+}
+
+TEST(FrameStore, KeepsNewestFrameEvenIfOversized) {
+  FrameStore store(16);
+  int64_t handle = store.Put(MakeFrame(8, 8, 0));
+  EXPECT_NE(store.Get(handle), nullptr);
+  EXPECT_EQ(store.size(), 1u);
+}
+
+TEST(ScaleFrame, AveragesWhenHalving) {
+  Frame frame;
+  frame.Allocate(4, 2);
+  for (int x = 0; x < 4; ++x) {
+    for (int y = 0; y < 2; ++y) {
+      uint8_t v = (x % 2 == 0) ? 0 : 200;
+      std::fill_n(frame.Row(y) + x * 4, 4, v);
+    }
+  }
+  Frame half = ScaleFrame(frame, 2, 1);
+  ASSERT_EQ(half.width, 2);
+  ASSERT_EQ(half.height, 1);
+  for (uint8_t v : half.pixels) EXPECT_EQ(v, 100);
+}
+
+TEST(ScaleFrame, UniformFramesStayUniform) {
+  Frame scaled = ScaleFrame(MakeFrame(7, 5, 42), 3, 11);
+  ASSERT_EQ(scaled.width, 3);
+  for (uint8_t v : scaled.pixels) EXPECT_EQ(v, 42);
+  EXPECT_TRUE(ScaleFrame(MakeFrame(2, 2, 0), 0, 4).IsEmpty());
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "frame.h"
+#include "parallel.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(Frame, BoundingRectSkipsEmptyRects) {
+  Rect bounds = BoundingRect({Rect{10, 20, 5, 5}, Rect{0, 0, 0, 100},
+                              Rect{-4, 30, 2, 10}});
+  EXPECT_EQ(bounds.x, -4);
+  EXPECT_EQ(bounds.y, 20);
+  EXPECT_EQ(bounds.width, 19);
+  EXPECT_EQ(bounds.height, 20);
+  EXPECT_TRUE(BoundingRect({}).IsEmpty());
+}
+
+TEST(Frame, CropFrameCopiesClippedPixels) {
+  Frame frame;
+  frame.Allocate(4, 4);
+  for (size_t i = 0; i < frame.pixels.size(); ++i) {
+    frame.pixels[i] = static_cast<uint8_t>(i);
+  }
+  Frame crop = CropFrame(frame, Rect{2, 3, 10, 10});
+  ASSERT_EQ(crop.width, 2);
+  ASSERT_EQ(crop.height, 1);
+  EXPECT_EQ(crop.Row(0)[0], frame.Row(3)[8]);
+  EXPECT_EQ(crop.Row(0)[7], frame.Row(3)[15]);
+  EXPECT_TRUE(CropFrame(frame, Rect{8, 8, 2, 2}).IsEmpty());
+}
+
+TEST(Parallel, ParallelForVisitsEveryIndexOnce) {
+  std::vector<std::atomic<int>> hits(257);
+  ParallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+  for (const auto& hit : hits) EXPECT_EQ(hit.load(), 1);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
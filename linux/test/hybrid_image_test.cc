@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "hybrid_image.h"
+#include "raw_frame.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// A white "window" with black text-like strokes every few pixels.
+void PaintText(Frame* frame, const Rect& rect) {
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    for (int x = rect.x; x < rect.x + rect.width; ++x) {
+      const bool ink =
+          y % 12 < 9 && (x % 7 == 0 || (y % 12 == 4 && x % 7 < 4));
+      uint8_t* p = frame->Row(y) + x * 4;
+      std::memset(p, ink ? 0x10 : 0xF8, 3);
+      p[3] = 0xFF;
+    }
+  }
+}
+
+// Smooth gradients with sensor-like noise.
+void PaintPhoto(Frame* frame, const Rect& rect) {
+  std::mt19937 rng(11);
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    for (int x = rect.x; x < rect.x + rect.width; ++x) {
+      uint8_t* p = frame->Row(y) + x * 4;
+      p[0] = static_cast<uint8_t>(40 + x / 2 + rng() % 16);
+      p[1] = static_cast<uint8_t>(60 + y / 2 + rng() % 16);
+      p[2] = static_cast<uint8_t>(90 + (x + y) / 4 + rng() % 16);
+      p[3] = 0xFF;
+    }
+  }
+}
+
+// Stores layers losslessly in the raw-frame container and remembers the
+// settings it was asked for.
+struct FakeCodec {
+  std::vector<EncodeSettings> calls;
+
+  SettingsEncoder Encoder() {
+    return [this](const Frame& frame, const EncodeSettings& settings,
+                  std::vector<uint8_t>* out) {
+      calls.push_back(settings);
+      *out = EncodeRawFrame(frame, 0);
+      return true;
+    };
+  }
+
+  static bool Decode(const uint8_t* data, size_t size, Frame* frame) {
+    return DecodeRawFrame(data, size, frame, nullptr);
+  }
+};
+
+bool SamePixels(const Frame& a, const Frame& b, const Rect& rect) {
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    if (std::memcmp(a.Row(y) + rect.x * 4, b.Row(y) + rect.x * 4,
+                    rect.width * 4) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(HybridImage, ClassifiesTextAndFlatTilesAsLossless) {
+  Frame frame;
+  frame.Allocate(64, 128);
+  PaintText(&frame, Rect{0, 0, 64, 64});
+  std::memset(frame.Row(64), 0x33, 64 * 64 * 4);
+  EXPECT_EQ(ClassifyTile(MeasureTile(frame, Rect{0, 0, 64, 64})),
+            TileKind::kLossless);
+  EXPECT_EQ(ClassifyTile(MeasureTile(frame, Rect{0, 64, 64, 64})),
+            TileKind::kLossless);
+  EXPECT_EQ(MeasureTile(frame, Rect{0, 64, 64, 64}).colors, 1);
+}
+
+TEST(HybridImage, ClassifiesNoisyGradientsAsPhoto) {
+  Frame frame;
+  frame.Allocate(64, 64);
+  PaintPhoto(&frame, Rect{0, 0, 64, 64});
+  TileStats stats = MeasureTile(frame, Rect{0, 0, 64, 64});
+  EXPECT_EQ(stats.colors, TileStats::kColorCap);
+  EXPECT_EQ(ClassifyTile(stats), TileKind::kPhoto);
+}
+
+TEST(HybridImage, RoundTripsMixedContent) {
+  Frame frame;
+  frame.Allocate(200, 150);
+  PaintText(&frame, Rect{0, 0, 200, 150});
+  // A video pane covering tiles (1..2, 1) of the 64-pixel grid.
+  PaintPhoto(&frame, Rect{64, 64, 128, 64});
+
+  FakeCodec codec;
+  std::vector<uint8_t> bytes;
+  HybridStats stats;
+  ASSERT_TRUE(EncodeHybridImage(frame, HybridOptions(), codec.Encoder(),
+                                &bytes, &stats));
+  EXPECT_EQ(stats.tiles, 4 * 3);
+  EXPECT_EQ(stats.photo_tiles, 2);
+  ASSERT_EQ(codec.calls.size(), 2u);
+
+  Frame decoded;
+  ASSERT_TRUE(DecodeHybridImage(bytes.data(), bytes.size(), FakeCodec::Decode,
+                                &decoded));
+  ASSERT_EQ(decoded.width, 200);
+  ASSERT_EQ(decoded.height, 150);
+  EXPECT_TRUE(SamePixels(frame, decoded, Rect{0, 0, 200, 150}));
+}
+
+TEST(HybridImage, AsksForPngAndJpegLayers) {
+  Frame frame;
+  frame.Allocate(128, 64);
+  PaintText(&frame, Rect{0, 0, 64, 64});
+  PaintPhoto(&frame, Rect{64, 0, 64, 64});
+  FakeCodec codec;
+  std::vector<uint8_t> bytes;
+  HybridOptions options;
+  options.quality = 70;
+  ASSERT_TRUE(EncodeHybridImage(frame, options, codec.Encoder(), &bytes));
+  ASSERT_EQ(codec.calls.size(), 2u);
+  bool png = false;
+  bool jpeg = false;
+  for (const EncodeSettings& settings : codec.calls) {
+    if (settings.format == ImageFormat::kPng) {
+      png = settings.palette == PaletteMode::kExact;
+    } else if (settings.format == ImageFormat::kJpeg) {
+      jpeg = settings.level == 70;
+    }
+  }
+  EXPECT_TRUE(png);
+  EXPECT_TRUE(jpeg);
+  // The photo layer covers just the photo tile.
+  Frame photo;
+  const uint32_t lossless_size = bytes[36] | bytes[37] << 8 |
+                                 bytes[38] << 16 | bytes[39] << 24;
+  ASSERT_TRUE(DecodeRawFrame(bytes.data() + kHybridHeaderSize + 2 +
+                                 lossless_size,
+                             bytes.size() - kHybridHeaderSize - 2 -
+                                 lossless_size,
+                             &photo, nullptr));
+  EXPECT_EQ(photo.width, 64);
+  EXPECT_EQ(photo.height, 64);
+}
+
+TEST(HybridImage, SkipsThePhotoLayerForTextOnlyScreens) {
+  Frame frame;
+  frame.Allocate(100, 40);
+  PaintText(&frame, Rect{0, 0, 100, 40});
+  FakeCodec codec;
+  std::vector<uint8_t> bytes;
+  ASSERT_TRUE(EncodeHybridImage(frame, HybridOptions(), codec.Encoder(),
+                                &bytes));
+  ASSERT_EQ(codec.calls.size(), 1u);
+  EXPECT_EQ(codec.calls[0].format, ImageFormat::kPng);
+  Frame decoded;
+  ASSERT_TRUE(DecodeHybridImage(bytes.data(), bytes.size(), FakeCodec::Decode,
+                                &decoded));
+  EXPECT_TRUE(SamePixels(frame, decoded, Rect{0, 0, 100, 40}));
+}
+
+TEST(HybridImage, RejectsMalformedContainers) {
+  Frame frame;
+  frame.Allocate(32, 32);
+  PaintText(&frame, Rect{0, 0, 32, 32});
+  FakeCodec codec;
+  std::vector<uint8_t> bytes;
+  ASSERT_TRUE(EncodeHybridImage(frame, HybridOptions(), codec.Encoder(),
+                                &bytes));
+  Frame decoded;
+  EXPECT_FALSE(DecodeHybridImage(bytes.data(), bytes.size() - 1,
+                                 FakeCodec::Decode, &decoded));
+  bytes[kHybridHeaderSize] = 7;  // Unknown tile kind.
+  EXPECT_FALSE(DecodeHybridImage(bytes.data(), bytes.size(),
+                                 FakeCodec::Decode, &decoded));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limits>
+
+#include "memory_ledger.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+constexpr size_t kMiB = 1024 * 1024;
+
+// A desktop whose pixel at (x, y) holds x in the blue and y in the green
+// channel, grabbed one rect at a time.
+class FakeDesktop {
+ public:
+  FakeDesktop(int width, int height) : width_(width), height_(height) {}
+
+  StripeGrabber Grabber() {
+    return [this](const Rect& rect, Frame* stripe) {
+      if (ClampRect(rect, width_, height_).height != rect.height) {
+        return false;
+      }
+      grabs_.push_back(rect);
+      stripe->Allocate(rect.width, rect.height);
+      for (int y = 0; y < rect.height; ++y) {
+        for (int x = 0; x < rect.width; ++x) {
+          uint8_t* p = stripe->Row(y) + x * 4;
+          p[0] = static_cast<uint8_t>(rect.x + x);
+          p[1] = static_cast<uint8_t>(rect.y + y);
+          p[2] = 0;
+          p[3] = 0xFF;
+        }
+      }
+      return true;
+    };
+  }
+
+  const std::vector<Rect>& grabs() const { return grabs_; }
+
+ private:
+  int width_;
+  int height_;
+  std::vector<Rect> grabs_;
+};
+
+}  // namespace
+
+TEST(MemoryLedger, TracksCurrentAndPeakPerStage) {
+  MemoryLedger ledger;
+  {
+    MemoryCharge grab = ledger.Charge(MemoryStage::kGrab, 100);
+    MemoryCharge frame = ledger.Charge(MemoryStage::kFrame, 400);
+    frame.Grow(50);
+    EXPECT_EQ(ledger.Stats().current, 550u);
+    grab.Reset();
+    MemoryCharge encode = ledger.Charge(MemoryStage::kEncode, 30);
+    MemoryStats stats = ledger.Stats();
+    EXPECT_EQ(stats.current, 480u);
+    EXPECT_EQ(stats.peak, 550u);
+    EXPECT_EQ(stats.stages[0].current, 0u);
+    EXPECT_EQ(stats.stages[0].peak, 100u);
+    EXPECT_EQ(stats.stages[1].current, 450u);
+    EXPECT_EQ(stats.stages[2].current, 30u);
+  }
+  EXPECT_EQ(ledger.Stats().current, 0u);
+  ledger.ResetPeaks();
+  EXPECT_EQ(ledger.Stats().peak, 0u);
+  EXPECT_EQ(ledger.Stats().stages[1].peak, 0u);
+}
+
+TEST(MemoryLedger, MovedChargesAreReleasedOnce) {
+  MemoryLedger ledger;
+  MemoryCharge outer;
+  {
+    MemoryCharge inner = ledger.Charge(MemoryStage::kResult, 64);
+    outer = std::move(inner);
+  }
+  EXPECT_EQ(ledger.Stats().current, 64u);
+  outer = MemoryCharge();
+  EXPECT_EQ(ledger.Stats().current, 0u);
+  EXPECT_STREQ(MemoryStageName(MemoryStage::kResult), "result");
+}
+
+TEST(MemoryLedger, AvailableHonoursTheLimit) {
+  MemoryLedger ledger;
+  EXPECT_EQ(ledger.Available(), std::numeric_limits<size_t>::max());
+  ledger.SetLimit(1000);
+  MemoryCharge charge = ledger.Charge(MemoryStage::kFrame, 300);
+  EXPECT_EQ(ledger.Available(), 700u);
+  charge.Grow(900);
+  EXPECT_EQ(ledger.Available(), 0u);
+  EXPECT_EQ(ledger.Stats().limit, 1000u);
+}
+
+TEST(PlanCapture, GrabsInOnePieceWhenEverythingFits) {
+  CapturePlan plan = PlanCapture(std::numeric_limits<size_t>::max(), 3840,
+                                 2160, 4);
+  EXPECT_TRUE(plan.possible);
+  EXPECT_FALSE(plan.degraded());
+  EXPECT_EQ(plan.width, 3840);
+
+  // 1920x1080: 8.3 MB grab + 8.3 MB frame + 2 MB encode reserve.
+  plan = PlanCapture(19 * kMiB, 1920, 1080, 4);
+  EXPECT_FALSE(plan.degraded());
+}
+
+TEST(PlanCapture, StripesAtFullSizeBeforeDownscaling) {
+  // The frame and its reserve (10.4 MB) fit, the whole grab does not.
+  CapturePlan plan = PlanCapture(12 * kMiB, 1920, 1080, 4);
+  ASSERT_TRUE(plan.possible);
+  EXPECT_EQ(plan.scale, 1);
+  EXPECT_GT(plan.stripe_rows, 16);
+  EXPECT_LT(plan.stripe_rows, 1080);
+  EXPECT_EQ(plan.width, 1920);
+  EXPECT_EQ(plan.height, 1080);
+}
+
+TEST(PlanCapture, DownscalesWhenTheFullFrameCannotFit) {
+  CapturePlan plan = PlanCapture(4 * kMiB, 1920, 1080, 4);
+  ASSERT_TRUE(plan.possible);
+  EXPECT_EQ(plan.scale, 2);
+  EXPECT_EQ(plan.stripe_rows % 2, 0);
+  EXPECT_EQ(plan.width, 960);
+  EXPECT_EQ(plan.height, 540);
+
+  plan = PlanCapture(64 * 1024, 1920, 1080, 4);
+  EXPECT_FALSE(plan.possible);
+}
+
+TEST(PlanCapture, KeepsFullSizeWhenAskedTo) {
+  CapturePlan plan = PlanCapture(4 * kMiB, 1920, 1080, 4, 1);
+  EXPECT_FALSE(plan.possible);
+  plan = PlanCapture(12 * kMiB, 1920, 1080, 4, 1);
+  EXPECT_TRUE(plan.possible);
+  EXPECT_EQ(plan.scale, 1);
+}
+
+TEST(CaptureInStripes, CopiesStripesAtFullSize) {
+  FakeDesktop desktop(100, 70);
+  CapturePlan plan;
+  plan.possible = true;
+  plan.stripe_rows = 16;
+  plan.width = 100;
+  plan.height = 70;
+  Frame frame;
+  ASSERT_TRUE(CaptureInStripes(plan, 100, 70, desktop.Grabber(), &frame));
+  EXPECT_EQ(desktop.grabs().size(), 5u);
+  EXPECT_EQ(desktop.grabs().back().height, 70 - 64);
+  for (int y : {0, 15, 16, 69}) {
+    EXPECT_EQ(frame.Row(y)[99 * 4], 99);
+    EXPECT_EQ(frame.Row(y)[99 * 4 + 1], y);
+  }
+}
+
+TEST(CaptureInStripes, DownscalesEachStripe) {
+  FakeDesktop desktop(101, 67);
+  CapturePlan plan;
+  plan.possible = true;
+  plan.scale = 2;
+  plan.stripe_rows = 16;
+  plan.width = 50;
+  plan.height = 33;
+  Frame frame;
+  ASSERT_TRUE(CaptureInStripes(plan, 101, 67, desktop.Grabber(), &frame));
+  EXPECT_EQ(frame.width, 50);
+  EXPECT_EQ(frame.height, 33);
+  // Each stripe covers whole 2x2 blocks and the odd last column and row
+  // are left out.
+  for (const Rect& rect : desktop.grabs()) {
+    EXPECT_EQ(rect.width, 100);
+    EXPECT_EQ(rect.height % 2, 0);
+  }
+  // Output pixel (x, y) averages desktop pixels 2x..2x+1 and 2y..2y+1.
+  for (int y : {0, 7, 8, 32}) {
+    EXPECT_NEAR(frame.Row(y)[10 * 4], 20.5, 1);
+    EXPECT_NEAR(frame.Row(y)[10 * 4 + 1], 2 * y + 0.5, 1);
+  }
+}
+
+TEST(CaptureInStripes, FailsWhenAStripeCannotBeGrabbed) {
+  FakeDesktop desktop(32, 20);
+  CapturePlan plan;
+  plan.possible = true;
+  plan.stripe_rows = 16;
+  plan.width = 32;
+  plan.height = 40;
+  Frame frame;
+  EXPECT_FALSE(CaptureInStripes(plan, 32, 40, desktop.Grabber(), &frame));
+  plan.possible = false;
+  EXPECT_FALSE(CaptureInStripes(plan, 32, 20, desktop.Grabber(), &frame));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
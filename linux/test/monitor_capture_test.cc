@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+// After gtest: Xlib defines None, which gtest uses as a type name.
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <cstring>
+
+#include "monitor_capture.h"
+#include "x11_util.h"
+
+// These talk to a real X server. Run them under Xvfb, e.g.
+//   xvfb-run -s "-screen 0 640x480x24" <test runner>
+// Xvfb has a single screen, so the tests split it into made-up monitors.
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+class MonitorCaptureTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    display_ = XOpenDisplay(nullptr);
+    if (!display_) GTEST_SKIP() << "No X display";
+    width_ = DisplayWidth(display_, DefaultScreen(display_));
+    height_ = DisplayHeight(display_, DefaultScreen(display_));
+  }
+
+  void TearDown() override {
+    if (!display_) return;
+    for (Window window : windows_) XDestroyWindow(display_, window);
+    XCloseDisplay(display_);
+  }
+
+  // Maps an override-redirect window filled with |rgb| by the server.
+  void Fill(int x, int y, int width, int height, unsigned long rgb) {
+    XSetWindowAttributes attributes;
+    attributes.background_pixel = rgb;
+    attributes.override_redirect = True;
+    Window window = XCreateWindow(
+        display_, DefaultRootWindow(display_), x, y, width, height, 0,
+        CopyFromParent, InputOutput, CopyFromParent,
+        CWBackPixel | CWOverrideRedirect, &attributes);
+    XMapRaised(display_, window);
+    XSync(display_, False);
+    windows_.push_back(window);
+  }
+
+  // The whole root window in one XGetImage, for comparison.
+  Frame GrabRoot() {
+    Frame frame;
+    XImage* image = XGetImage(display_, DefaultRootWindow(display_), 0, 0,
+                              width_, height_, AllPlanes, ZPixmap);
+    if (!image) return frame;
+    frame.Allocate(width_, height_);
+    CopyImageToFrame(image, DefaultDepth(display_, DefaultScreen(display_)),
+                     &frame, 0, 0);
+    XDestroyImage(image);
+    return frame;
+  }
+
+  Display* display_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<Window> windows_;
+};
+
+// Stands in for a toolkit whose handler ignores errors on connections it
+// did not open, as GDK's does.
+int toolkit_pushes = 0;
+int toolkit_pops = 0;
+XErrorHandler toolkit_previous = nullptr;
+
+int IgnoreError(Display*, XErrorEvent*) { return 0; }
+
+void ToolkitPush(Display*) {
+  if (toolkit_pushes++ == toolkit_pops) {
+    toolkit_previous = XSetErrorHandler(IgnoreError);
+  }
+}
+
+int ToolkitPop(Display*) {
+  if (++toolkit_pops == toolkit_pushes) XSetErrorHandler(toolkit_previous);
+  return 0;
+}
+
+}  // namespace
+
+TEST(MonitorDeviceRect, ScalesAScaledLayoutToDevicePixels) {
+  // Two 2560x1440 panels at scale 2, which GDK reports as 1280x720 each.
+  const std::vector<Rect> monitors = {
+      MonitorDeviceRect(Rect{0, 0, 1280, 720}, 2),
+      MonitorDeviceRect(Rect{1280, 0, 1280, 720}, 2),
+  };
+  EXPECT_EQ(monitors[0].width, 2560);
+  EXPECT_EQ(monitors[0].height, 1440);
+  EXPECT_EQ(monitors[1].x, 2560);
+  const Rect bounds = BoundingRect(monitors);
+  EXPECT_EQ(bounds.width, 5120);
+  EXPECT_EQ(bounds.height, 1440);
+
+  const Rect unscaled = MonitorDeviceRect(Rect{10, 20, 30, 40}, 1);
+  EXPECT_EQ(unscaled.x, 10);
+  EXPECT_EQ(unscaled.height, 40);
+  EXPECT_EQ(MonitorDeviceRect(Rect{10, 20, 30, 40}, 0).width, 30);
+}
+
+TEST_F(MonitorCaptureTest, GrabsAScaledLayoutInDevicePixels) {
+  // The screen as GDK would describe it at scale 2.
+  Fill(0, 0, width_ / 2, height_, 0x00AA00);
+  Frame expected = GrabRoot();
+  ASSERT_FALSE(expected.IsEmpty());
+
+  MonitorCapturer capturer("");
+  const int scale = 2;
+  const std::vector<Rect> monitors = {
+      MonitorDeviceRect(Rect{0, 0, width_ / 4, height_ / 2}, scale),
+      MonitorDeviceRect(Rect{width_ / 4, 0, width_ / 4, height_ / 2},
+                        scale),
+  };
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(monitors, &frame));
+  ASSERT_EQ(frame.width, width_ / 4 * 2 * scale);
+  ASSERT_EQ(frame.height, height_ / 2 * scale);
+  for (int y = 0; y < frame.height; y += 7) {
+    EXPECT_EQ(0, std::memcmp(frame.Row(y), expected.Row(y),
+                             static_cast<size_t>(frame.width) * 4))
+        << "row " << y;
+  }
+}
+
+TEST_F(MonitorCaptureTest, StitchesMonitorsIntoTheDesktop) {
+  Fill(0, 0, width_ / 2, height_, 0xCC3300);
+  Fill(width_ / 2, 0, width_ - width_ / 2, height_, 0x0066FF);
+  Frame expected = GrabRoot();
+  ASSERT_FALSE(expected.IsEmpty());
+
+  MonitorCapturer capturer("");
+  const std::vector<Rect> monitors = {
+      Rect{0, 0, width_ / 2, height_},
+      Rect{width_ / 2, 0, width_ - width_ / 2, height_},
+  };
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(monitors, &frame));
+  EXPECT_EQ(capturer.connections(), 2u);
+  ASSERT_EQ(frame.width, width_);
+  ASSERT_EQ(frame.height, height_);
+  EXPECT_EQ(frame.pixels, expected.pixels);
+}
+
+TEST_F(MonitorCaptureTest, GrabsMirroredMonitorsOnceAndKeepsConnections) {
+  MonitorCapturer capturer("");
+  const std::vector<Rect> mirrored = {Rect{0, 0, 64, 48}, Rect{0, 0, 64, 48}};
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(mirrored, &frame));
+  EXPECT_EQ(capturer.connections(), 1u);
+  EXPECT_EQ(frame.width, 64);
+  ASSERT_TRUE(capturer.Capture(mirrored, &frame));
+  EXPECT_EQ(capturer.connections(), 1u);
+}
+
+TEST_F(MonitorCaptureTest, PrepareOpensTheLayoutForTheFirstCapture) {
+  MonitorCapturer capturer("");
+  const std::vector<Rect> monitors = {Rect{0, 0, 32, 32},
+                                      Rect{32, 0, 32, 32}};
+  ASSERT_TRUE(capturer.Prepare(monitors));
+  EXPECT_EQ(capturer.connections(), 2u);
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(monitors, &frame));
+  EXPECT_EQ(capturer.connections(), 2u);
+  EXPECT_EQ(frame.width, 64);
+  EXPECT_FALSE(capturer.Prepare({}));
+}
+
+TEST_F(MonitorCaptureTest, ZeroesGapsBetweenMonitors) {
+  MonitorCapturer capturer("");
+  // A tall monitor next to a short one leaves a gap below the short one.
+  const std::vector<Rect> monitors = {Rect{0, 0, 32, 64},
+                                      Rect{32, 0, 32, 16}};
+  Frame frame;
+  frame.Allocate(64, 64);
+  std::memset(frame.pixels.data(), 0xAB, frame.pixels.size());
+  ASSERT_TRUE(capturer.Capture(monitors, &frame));
+  EXPECT_EQ(frame.Row(40)[40 * 4], 0);
+}
+
+TEST_F(MonitorCaptureTest, FailsOutsideTheRootAndRecovers) {
+  MonitorCapturer capturer("");
+  Frame frame;
+  EXPECT_FALSE(capturer.Capture({Rect{width_ - 8, 0, 64, 64}}, &frame));
+  EXPECT_EQ(capturer.connections(), 0u);
+  EXPECT_TRUE(capturer.Capture({Rect{0, 0, 8, 8}}, &frame));
+  EXPECT_FALSE(capturer.Capture({}, &frame));
+}
+
+TEST_F(MonitorCaptureTest, FailsThroughAToolkitsHandlerThatIgnoresIt) {
+  const ErrorTrapHooks hooks = {ToolkitPush, ToolkitPop};
+  toolkit_pushes = 0;
+  toolkit_pops = 0;
+  {
+    MonitorCapturer capturer("", &hooks);
+    Frame frame;
+    EXPECT_FALSE(capturer.Capture({Rect{width_ - 8, 0, 64, 64}}, &frame));
+    EXPECT_TRUE(capturer.Capture({Rect{0, 0, 8, 8}}, &frame));
+  }
+  EXPECT_GT(toolkit_pushes, 0);
+  EXPECT_EQ(toolkit_pushes, toolkit_pops);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstring>
+
+#include "palette.h"
+#include "png_writer.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+void SetPixel(Frame* frame, int x, int y, uint32_t argb) {
+  std::memcpy(frame->Row(y) + x * 4, &argb, 4);
+}
+
+// A frame with exactly |colors| distinct colors laid out in stripes.
+Frame MakeStripes(int width, int height, int colors) {
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint32_t c = static_cast<uint32_t>((x + y * width) % colors);
+      SetPixel(&frame, x, y, 0xFF000000u | (c * 0x010305u));
+    }
+  }
+  return frame;
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | p[3];
+}
+
+}  // namespace
+
+TEST(Palette, ExactPaletteRoundTripsColors) {
+  Frame frame = MakeStripes(10, 3, 5);
+  IndexedImage image;
+  ASSERT_TRUE(ExtractExactPalette(frame, &image));
+  EXPECT_EQ(image.palette.size(), 5u);
+  EXPECT_EQ(image.bit_depth, 4);
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      uint32_t expected;
+      std::memcpy(&expected, frame.Row(y) + x * 4, 4);
+      EXPECT_EQ(image.palette[image.indices[y * 10 + x]], expected);
+    }
+  }
+}
+
+TEST(Palette, ExactPaletteIgnoresAlpha) {
+  Frame frame;
+  frame.Allocate(2, 1);
+  SetPixel(&frame, 0, 0, 0x00123456);
+  SetPixel(&frame, 1, 0, 0xFF123456);
+  IndexedImage image;
+  ASSERT_TRUE(ExtractExactPalette(frame, &image));
+  EXPECT_EQ(image.palette.size(), 1u);
+  EXPECT_EQ(image.bit_depth, 1);
+}
+
+TEST(Palette, ExactPaletteBailsOutPast256Colors) {
+  IndexedImage image;
+  EXPECT_TRUE(ExtractExactPalette(MakeStripes(64, 4, 256), &image));
+  EXPECT_FALSE(ExtractExactPalette(MakeStripes(64, 5, 257), &image));
+}
+
+TEST(Palette, MedianCutProducesAtMostRequestedColors) {
+  Frame frame;
+  frame.Allocate(64, 64);
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      SetPixel(&frame, x, y,
+               0xFF000000u | (uint32_t(x * 4) << 16) | (uint32_t(y * 4) << 8));
+    }
+  }
+  IndexedImage image;
+  QuantizeMedianCut(frame, 16, &image);
+  EXPECT_LE(image.palette.size(), 16u);
+  EXPECT_GT(image.palette.size(), 8u);
+  EXPECT_EQ(image.indices.size(), 64u * 64u);
+  for (uint8_t index : image.indices) EXPECT_LT(index, image.palette.size());
+}
+
+TEST(PngWriter, WritesValidIndexedPng) {
+  IndexedImage image;
+  ASSERT_TRUE(ExtractExactPalette(MakeStripes(13, 7, 3), &image));
+  std::vector<uint8_t> png = EncodeIndexedPng(image);
+  ASSERT_GT(png.size(), 8u + 25u);
+  EXPECT_EQ(0, memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8));
+
+  // IHDR: 13x7, bit depth 2, color type 3, with a valid CRC.
+  const uint8_t* ihdr = png.data() + 8;
+  EXPECT_EQ(ReadU32(ihdr), 13u);
+  EXPECT_EQ(0, memcmp(ihdr + 4, "IHDR", 4));
+  EXPECT_EQ(ReadU32(ihdr + 8), 13u);
+  EXPECT_EQ(ReadU32(ihdr + 12), 7u);
+  EXPECT_EQ(ihdr[16], 2);
+  EXPECT_EQ(ihdr[17], 3);
+  EXPECT_EQ(ReadU32(ihdr + 21), crc32(0, ihdr + 4, 17));
+
+  // The IDAT payload inflates back to the packed rows.
+  const uint8_t* chunk = ihdr + 25;
+  while (memcmp(chunk + 4, "IDAT", 4) != 0) chunk += 12 + ReadU32(chunk);
+  std::vector<uint8_t> raw(7 * (1 + 4));
+  uLongf raw_size = raw.size();
+  ASSERT_EQ(uncompress(raw.data(), &raw_size, chunk + 8, ReadU32(chunk)),
+            Z_OK);
+  EXPECT_EQ(raw_size, raw.size());
+  EXPECT_EQ(raw[0], 0);
+  EXPECT_EQ(raw[1] >> 6, image.indices[0]);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "pixel_pipeline.h"
+#include "scale.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(PixelPipeline, ConvertsBetweenLayouts) {
+  const uint8_t rgb[] = {10, 20, 30, 40, 50, 60};
+  uint8_t bgra[8];
+  ConvertRow<RgbPixels, BgraPixels>(rgb, bgra, 2);
+  EXPECT_EQ(std::vector<uint8_t>(bgra, bgra + 8),
+            (std::vector<uint8_t>{30, 20, 10, 0xFF, 60, 50, 40, 0xFF}));
+
+  uint8_t rgba[8];
+  ConvertRow<BgraPixels, RgbaPixels>(bgra, rgba, 2);
+  EXPECT_EQ(std::vector<uint8_t>(rgba, rgba + 8),
+            (std::vector<uint8_t>{10, 20, 30, 0xFF, 40, 50, 60, 0xFF}));
+
+  uint8_t back[6];
+  ConvertRow<RgbaPixels, RgbPixels>(rgba, back, 2);
+  EXPECT_EQ(std::vector<uint8_t>(back, back + 6),
+            std::vector<uint8_t>(rgb, rgb + 6));
+}
+
+TEST(PixelPipeline, PaddingReadsAsOpaque) {
+  const uint8_t bgrx[] = {1, 2, 3, 0, 4, 5, 6, 77};
+  uint8_t bgra[8];
+  ConvertRow<BgrxPixels, BgraPixels>(bgrx, bgra, 2);
+  EXPECT_EQ(bgra[3], 0xFF);
+  EXPECT_EQ(bgra[7], 0xFF);
+  EXPECT_EQ(bgra[4], 4);
+
+  const uint8_t translucent[] = {1, 2, 3, 0x40};
+  uint8_t out[4];
+  ConvertRow<BgraPixels, BgrxPixels>(translucent, out, 1);
+  EXPECT_EQ(out[3], 0xFF);
+}
+
+TEST(PixelPipeline, HonoursStrides) {
+  // Three rows of two RGB pixels, each row padded to 8 bytes.
+  std::vector<uint8_t> src(3 * 8, 0xEE);
+  for (int y = 0; y < 3; ++y) {
+    for (int i = 0; i < 6; ++i) src[y * 8 + i] = static_cast<uint8_t>(y);
+  }
+  Frame frame;
+  frame.Allocate(2, 3);
+  ConvertPixels<RgbPixels, BgraPixels>(src.data(), 8, frame.Row(0),
+                                       frame.stride, 2, 3);
+  for (int y = 0; y < 3; ++y) {
+    EXPECT_EQ(frame.Row(y)[4], y);
+    EXPECT_EQ(frame.Row(y)[7], 0xFF);
+  }
+}
+
+TEST(PixelPipeline, DownscalesWhileConverting) {
+  // 5x3 RGB, red channel x * 10 + y; the odd last column and row are not a
+  // whole 2x2 block.
+  std::vector<uint8_t> src(5 * 3 * 3, 0);
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 5; ++x) {
+      src[(y * 5 + x) * 3] = static_cast<uint8_t>(x * 10 + y);
+    }
+  }
+  Frame frame;
+  frame.Allocate(2, 1);
+  ConvertDownscaled<RgbPixels, BgraPixels>(src.data(), 5 * 3, 5, 3, 2,
+                                           frame.Row(0), frame.stride);
+  // Blocks (0..1, 0..1) and (2..3, 0..1): averages 5.5 and 25.5, rounded.
+  EXPECT_EQ(frame.Row(0)[2], 6);
+  EXPECT_EQ(frame.Row(0)[6], 26);
+  EXPECT_EQ(frame.Row(0)[3], 0xFF);
+}
+
+TEST(PixelPipeline, ScaleFrameAveragesWholeBlocks) {
+  Frame source;
+  source.Allocate(8, 8);
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      uint8_t* p = source.Row(y) + x * 4;
+      p[0] = static_cast<uint8_t>(x * 8);
+      p[1] = static_cast<uint8_t>(y * 8);
+      p[2] = 0;
+      p[3] = 0xFF;
+    }
+  }
+  Frame scaled = ScaleFrame(source, 2, 2);
+  ASSERT_EQ(scaled.width, 2);
+  // Columns 4..7 average to 44, rows 0..3 to 12.
+  EXPECT_EQ(scaled.Row(0)[4], 44);
+  EXPECT_EQ(scaled.Row(0)[5], 12);
+  EXPECT_EQ(scaled.Row(1)[1], 44);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "pixel_sample.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+bool Contains(const Rect& rect, const Point& point) {
+  return point.x >= rect.x && point.x < rect.x + rect.width &&
+         point.y >= rect.y && point.y < rect.y + rect.height;
+}
+
+}  // namespace
+
+TEST(PixelSample, NearbyPointsShareOneGrab) {
+  std::vector<Point> points = {{10, 10}, {40, 12}, {25, 60}, {70, 70}};
+  std::vector<size_t> owner;
+  std::vector<Rect> grabs = PlanPixelGrabs(points, &owner);
+  ASSERT_EQ(grabs.size(), 1u);
+  EXPECT_EQ(grabs[0].x, 10);
+  EXPECT_EQ(grabs[0].y, 10);
+  EXPECT_EQ(grabs[0].width, 61);
+  EXPECT_EQ(grabs[0].height, 61);
+}
+
+TEST(PixelSample, DistantClustersAreGrabbedSeparately) {
+  // Two LED strips in opposite corners of a 4K desktop.
+  std::vector<Point> points = {{5, 5},       {15, 5},      {25, 5},
+                               {3800, 2100}, {3810, 2100}, {3820, 2100}};
+  std::vector<size_t> owner;
+  std::vector<Rect> grabs = PlanPixelGrabs(points, &owner);
+  ASSERT_EQ(grabs.size(), 2u);
+  ASSERT_EQ(owner.size(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    ASSERT_LT(owner[i], grabs.size());
+    EXPECT_TRUE(Contains(grabs[owner[i]], points[i]));
+  }
+  EXPECT_EQ(owner[0], owner[2]);
+  EXPECT_NE(owner[0], owner[3]);
+  EXPECT_EQ(grabs[owner[0]].height, 1);
+  EXPECT_EQ(grabs[owner[3]].width, 21);
+}
+
+TEST(PixelSample, ManyPointsFallBackToBoundingBox) {
+  std::vector<Point> points;
+  for (int i = 0; i < 500; ++i) points.push_back(Point{i * 7, (i * 13) % 900});
+  std::vector<size_t> owner;
+  std::vector<Rect> grabs = PlanPixelGrabs(points, &owner);
+  ASSERT_EQ(grabs.size(), 1u);
+  for (const Point& point : points) EXPECT_TRUE(Contains(grabs[0], point));
+}
+
+TEST(PixelSample, EmptyInputPlansNothing) {
+  std::vector<size_t> owner = {3};
+  EXPECT_TRUE(PlanPixelGrabs({}, &owner).empty());
+  EXPECT_TRUE(owner.empty());
+}
+
+TEST(PixelSample, ColorIsPackedLikeDartColor) {
+  Frame frame;
+  frame.Allocate(2, 2);
+  uint8_t* p = frame.Row(1) + 4;
+  p[0] = 0x33;  // B
+  p[1] = 0x22;  // G
+  p[2] = 0x11;  // R
+  p[3] = 0x00;
+  EXPECT_EQ(PixelColor(frame.pixels.data(), frame.stride, 1, 1), 0xFF112233u);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstring>
+
+#include "png_writer.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// A frame whose pixels encode their own position.
+Frame Gradient(int width, int height) {
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < width; ++x, p += 4) {
+      p[0] = static_cast<uint8_t>(x);
+      p[1] = static_cast<uint8_t>(y);
+      p[2] = static_cast<uint8_t>(x ^ y);
+      p[3] = 0xFF;
+    }
+  }
+  return frame;
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | p[3];
+}
+
+// Checks every chunk CRC, inflates the IDAT payload (which verifies its
+// Adler-32), undoes the Sub filter and compares the pixels with |frame|.
+void ExpectDecodesTo(const std::vector<uint8_t>& png, const Frame& frame) {
+  ASSERT_GT(png.size(), 8u);
+  ASSERT_EQ(0, memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8));
+  const uint8_t* chunk = png.data() + 8;
+  const uint8_t* end = png.data() + png.size();
+  std::vector<uint8_t> raw;
+  while (chunk < end) {
+    const uint32_t length = ReadU32(chunk);
+    ASSERT_LE(chunk + 12 + length, end);
+    EXPECT_EQ(ReadU32(chunk + 8 + length), crc32(0, chunk + 4, length + 4));
+    if (memcmp(chunk + 4, "IHDR", 4) == 0) {
+      EXPECT_EQ(ReadU32(chunk + 8), static_cast<uint32_t>(frame.width));
+      EXPECT_EQ(ReadU32(chunk + 12), static_cast<uint32_t>(frame.height));
+      EXPECT_EQ(chunk[16], 8);
+      EXPECT_EQ(chunk[17], 2);
+    } else if (memcmp(chunk + 4, "IDAT", 4) == 0) {
+      raw.resize(static_cast<size_t>(frame.height) * (1 + frame.width * 3));
+      uLongf raw_size = raw.size();
+      ASSERT_EQ(uncompress(raw.data(), &raw_size, chunk + 8, length), Z_OK);
+      ASSERT_EQ(raw_size, raw.size());
+    }
+    chunk += 12 + length;
+  }
+  ASSERT_FALSE(raw.empty());
+
+  const size_t row_bytes = 1 + frame.width * 3;
+  for (int y = 0; y < frame.height; ++y) {
+    uint8_t* row = &raw[y * row_bytes];
+    ASSERT_EQ(row[0], 1);
+    for (int i = 3; i < frame.width * 3; ++i) {
+      row[1 + i] = static_cast<uint8_t>(row[1 + i] + row[1 + i - 3]);
+    }
+    const uint8_t* bgra = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x) {
+      ASSERT_EQ(row[1 + x * 3], bgra[x * 4 + 2]) << x << "," << y;
+      ASSERT_EQ(row[2 + x * 3], bgra[x * 4 + 1]) << x << "," << y;
+      ASSERT_EQ(row[3 + x * 3], bgra[x * 4 + 0]) << x << "," << y;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(IncrementalPng, WritesValidPng) {
+  Frame frame = Gradient(37, 100);
+  IncrementalPngEncoder encoder;
+  std::vector<uint8_t> png = encoder.Encode(frame);
+  ExpectDecodesTo(png, frame);
+  EXPECT_EQ(encoder.bands(), 4u);
+  EXPECT_EQ(encoder.recompressed(), 4u);
+}
+
+TEST(IncrementalPng, ReusesEveryBandOfAnUnchangedFrame) {
+  Frame frame = Gradient(64, 96);
+  IncrementalPngEncoder encoder;
+  std::vector<uint8_t> first = encoder.Encode(frame);
+  std::vector<uint8_t> second = encoder.Encode(frame);
+  EXPECT_EQ(encoder.recompressed(), 0u);
+  EXPECT_EQ(first, second);
+}
+
+TEST(IncrementalPng, RecompressesOnlyTheChangedBand) {
+  Frame frame = Gradient(64, 128);
+  IncrementalPngEncoder encoder;
+  encoder.Encode(frame);
+
+  // A "clock" in the third band.
+  frame.Row(70)[10 * 4] ^= 0xFF;
+  std::vector<uint8_t> png = encoder.Encode(frame);
+  EXPECT_EQ(encoder.recompressed(), 1u);
+  ExpectDecodesTo(png, frame);
+
+  // Byte for byte what encoding the frame from scratch gives.
+  IncrementalPngEncoder fresh;
+  EXPECT_EQ(png, fresh.Encode(frame));
+}
+
+TEST(IncrementalPng, ChangingTheLastBandKeepsTheStreamFinished) {
+  Frame frame = Gradient(20, 50);
+  IncrementalPngEncoder encoder;
+  encoder.Encode(frame);
+  frame.Row(49)[0] ^= 0xFF;
+  std::vector<uint8_t> png = encoder.Encode(frame);
+  EXPECT_EQ(encoder.recompressed(), 1u);
+  ExpectDecodesTo(png, frame);
+}
+
+TEST(IncrementalPng, NewSizeStartsOver) {
+  IncrementalPngEncoder encoder;
+  encoder.Encode(Gradient(32, 64));
+  Frame frame = Gradient(32, 65);
+  std::vector<uint8_t> png = encoder.Encode(frame);
+  EXPECT_EQ(encoder.bands(), 3u);
+  EXPECT_EQ(encoder.recompressed(), 3u);
+  ExpectDecodesTo(png, frame);
+}
+
+TEST(IncrementalPng, ChargesItsRowsAndBandsToTheLedger) {
+  MemoryLedger ledger;
+  {
+    IncrementalPngEncoder encoder(6, &ledger);
+    Frame frame = Gradient(64, 96);
+    encoder.Encode(frame);
+    const size_t charged = ledger.Stats().current;
+    // At least the filtered rows: a filter byte and RGB per pixel.
+    EXPECT_GE(charged, (1u + 64 * 3) * 96);
+    EXPECT_EQ(ledger.Stats().stages[int(MemoryStage::kEncode)].current,
+              charged);
+    encoder.Encode(frame);
+    EXPECT_EQ(ledger.Stats().current, charged);
+  }
+  EXPECT_EQ(ledger.Stats().current, 0u);
+}
+
+TEST(IncrementalPng, RejectsEmptyFrame) {
+  IncrementalPngEncoder encoder;
+  EXPECT_TRUE(encoder.Encode(Frame()).empty());
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
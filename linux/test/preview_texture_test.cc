@@ -0,0 +1,111 @@
+#include <flutter_linux/flutter_linux.h>
+#include <gtest/gtest.h>
+
+#include "memory_ledger.h"
+#include "preview_texture.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// Calls copy_pixels the way the engine's raster thread does.
+bool CopyPixels(PreviewTexture* texture, const uint8_t** buffer,
+                uint32_t* width, uint32_t* height) {
+  FlPixelBufferTexture* base = FL_PIXEL_BUFFER_TEXTURE(texture);
+  return FL_PIXEL_BUFFER_TEXTURE_GET_CLASS(base)->copy_pixels(
+      base, buffer, width, height, nullptr);
+}
+
+Frame SolidFrame(int width, int height, uint8_t b, uint8_t g, uint8_t r) {
+  Frame frame;
+  frame.Allocate(width, height);
+  for (size_t i = 0; i < frame.pixels.size(); i += 4) {
+    frame.pixels[i] = b;
+    frame.pixels[i + 1] = g;
+    frame.pixels[i + 2] = r;
+    frame.pixels[i + 3] = 0xFF;
+  }
+  return frame;
+}
+
+}  // namespace
+
+TEST(PreviewTexture, FailsUntilAFrameIsPublished) {
+  g_autoptr(PreviewTexture) texture = preview_texture_new();
+  const uint8_t* buffer = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  EXPECT_FALSE(CopyPixels(texture, &buffer, &width, &height));
+}
+
+TEST(PreviewTexture, ConvertsFramesToRgba) {
+  g_autoptr(PreviewTexture) texture = preview_texture_new();
+  preview_texture_publish_frame(texture, SolidFrame(3, 2, 10, 20, 30));
+  const uint8_t* buffer = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  ASSERT_TRUE(CopyPixels(texture, &buffer, &width, &height));
+  EXPECT_EQ(width, 3u);
+  EXPECT_EQ(height, 2u);
+  EXPECT_EQ(buffer[0], 30);
+  EXPECT_EQ(buffer[1], 20);
+  EXPECT_EQ(buffer[2], 10);
+  EXPECT_EQ(buffer[3], 0xFF);
+}
+
+TEST(PreviewTexture, ChargesItsBuffersUntilFinalized) {
+  MemoryLedger& ledger = MemoryLedger::Process();
+  const size_t before = ledger.Stats().current;
+  PreviewTexture* texture = preview_texture_new();
+  preview_texture_publish_frame(texture, SolidFrame(8, 8, 0, 0, 0));
+  EXPECT_GE(ledger.Stats().current, before + 8 * 8 * 4);
+  g_object_unref(texture);
+  EXPECT_EQ(ledger.Stats().current, before);
+}
+
+TEST(PreviewTexture, ConvertsRgbPixbufs) {
+  g_autoptr(PreviewTexture) texture = preview_texture_new();
+  g_autoptr(GdkPixbuf) pixbuf =
+      gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 5, 4);
+  gdk_pixbuf_fill(pixbuf, 0x11223300);
+  preview_texture_publish_pixbuf(texture, pixbuf);
+  const uint8_t* buffer = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  ASSERT_TRUE(CopyPixels(texture, &buffer, &width, &height));
+  EXPECT_EQ(width, 5u);
+  const uint8_t* last = buffer + (5 * 4 - 1) * 4;
+  EXPECT_EQ(last[0], 0x11);
+  EXPECT_EQ(last[1], 0x22);
+  EXPECT_EQ(last[2], 0x33);
+  EXPECT_EQ(last[3], 0xFF);
+}
+
+TEST(PreviewTexture, ShowsOnlyTheNewestFrame) {
+  g_autoptr(PreviewTexture) texture = preview_texture_new();
+  preview_texture_publish_frame(texture, SolidFrame(2, 2, 0, 0, 1));
+  preview_texture_publish_frame(texture, SolidFrame(2, 2, 0, 0, 2));
+  const uint8_t* buffer = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  ASSERT_TRUE(CopyPixels(texture, &buffer, &width, &height));
+  EXPECT_EQ(buffer[0], 2);
+  EXPECT_EQ(preview_texture_get_published(texture), 2u);
+  EXPECT_EQ(preview_texture_get_shown(texture), 1u);
+
+  // Nothing new: the engine keeps the same buffer.
+  const uint8_t* again = nullptr;
+  ASSERT_TRUE(CopyPixels(texture, &again, &width, &height));
+  EXPECT_EQ(again, buffer);
+  EXPECT_EQ(preview_texture_get_shown(texture), 1u);
+
+  // A publish never writes the buffer the engine holds.
+  preview_texture_publish_frame(texture, SolidFrame(2, 2, 0, 0, 3));
+  EXPECT_EQ(buffer[0], 2);
+  ASSERT_TRUE(CopyPixels(texture, &buffer, &width, &height));
+  EXPECT_EQ(buffer[0], 3);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "lz4_block.h"
+#include "raw_frame.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// Flat panels, a gradient band and a noisy strip: every predictor and both
+// codec paths get exercised.
+Frame MakeScreen(int width, int height) {
+  std::mt19937 rng(5);
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < width; ++x, p += 4) {
+      if (y < height / 3) {
+        p[0] = p[1] = p[2] = x < width / 2 ? 0x20 : 0xF0;
+      } else if (y < 2 * height / 3) {
+        p[0] = static_cast<uint8_t>(x);
+        p[1] = static_cast<uint8_t>(y);
+        p[2] = static_cast<uint8_t>(x + y);
+      } else {
+        p[0] = static_cast<uint8_t>(rng());
+        p[1] = static_cast<uint8_t>(rng());
+        p[2] = static_cast<uint8_t>(rng());
+      }
+      p[3] = 0xFF;
+    }
+  }
+  return frame;
+}
+
+std::vector<uint8_t> RoundTripLz4(const std::vector<uint8_t>& input,
+                                  size_t* compressed_size) {
+  std::vector<uint8_t> compressed(Lz4CompressBound(input.size()));
+  size_t size = Lz4Compress(input.data(), input.size(), compressed.data(),
+                            compressed.size());
+  EXPECT_GT(size, 0u);
+  if (compressed_size) *compressed_size = size;
+  std::vector<uint8_t> output(input.size());
+  EXPECT_TRUE(Lz4Decompress(compressed.data(), size, output.data(),
+                            output.size()));
+  return output;
+}
+
+}  // namespace
+
+TEST(Lz4Block, RoundTripsAssortedInputs) {
+  std::mt19937 rng(11);
+  for (size_t size : {0, 1, 12, 13, 100, 4096, 70000, 300000}) {
+    for (int alphabet : {1, 3, 256}) {
+      std::vector<uint8_t> input(size);
+      for (uint8_t& byte : input) byte = static_cast<uint8_t>(rng() % alphabet);
+      EXPECT_EQ(RoundTripLz4(input, nullptr), input)
+          << "size " << size << " alphabet " << alphabet;
+    }
+  }
+}
+
+TEST(Lz4Block, CompressesRuns) {
+  std::vector<uint8_t> input(100000, 0x42);
+  size_t compressed = 0;
+  EXPECT_EQ(RoundTripLz4(input, &compressed), input);
+  EXPECT_LT(compressed, 600u);
+}
+
+TEST(Lz4Block, RejectsCorruptInput) {
+  std::vector<uint8_t> input(5000);
+  for (size_t i = 0; i < input.size(); ++i) input[i] = static_cast<uint8_t>(i / 7);
+  std::vector<uint8_t> compressed(Lz4CompressBound(input.size()));
+  size_t size = Lz4Compress(input.data(), input.size(), compressed.data(),
+                            compressed.size());
+  std::vector<uint8_t> output(input.size());
+
+  // Truncated stream, wrong expected size, and an offset pointing before
+  // the start of the output.
+  EXPECT_FALSE(Lz4Decompress(compressed.data(), size / 2, output.data(),
+                             output.size()));
+  EXPECT_FALSE(Lz4Decompress(compressed.data(), size, output.data(),
+                             output.size() - 1));
+  const uint8_t bad_offset[] = {0x00, 0xFF, 0xFF};
+  EXPECT_FALSE(Lz4Decompress(bad_offset, sizeof(bad_offset), output.data(),
+                             output.size()));
+}
+
+TEST(RawFrame, RoundTripsWithEveryPredictor) {
+  Frame frame = MakeScreen(123, 61);
+  for (FramePredictor predictor :
+       {FramePredictor::kNone, FramePredictor::kLeft, FramePredictor::kUp}) {
+    std::vector<uint8_t> encoded = EncodeRawFrame(frame, 1234567, predictor);
+    Frame decoded;
+    uint64_t timestamp = 0;
+    ASSERT_TRUE(DecodeRawFrame(encoded.data(), encoded.size(), &decoded,
+                               &timestamp));
+    EXPECT_EQ(decoded.width, frame.width);
+    EXPECT_EQ(decoded.height, frame.height);
+    EXPECT_EQ(decoded.stride, frame.stride);
+    EXPECT_EQ(decoded.pixels, frame.pixels);
+    EXPECT_EQ(timestamp, 1234567u);
+    EXPECT_LT(encoded.size(), frame.pixels.size());
+  }
+}
+
+TEST(RawFrame, StoresIncompressibleFrames) {
+  std::mt19937 rng(9);
+  Frame frame;
+  frame.Allocate(64, 64);
+  for (uint8_t& byte : frame.pixels) byte = static_cast<uint8_t>(rng());
+  std::vector<uint8_t> encoded =
+      EncodeRawFrame(frame, 0, FramePredictor::kNone);
+  EXPECT_EQ(encoded[7], 0);  // stored
+  EXPECT_EQ(encoded.size(), kRawFrameHeaderSize + frame.pixels.size());
+
+  Frame decoded;
+  ASSERT_TRUE(DecodeRawFrame(encoded.data(), encoded.size(), &decoded, nullptr));
+  EXPECT_EQ(decoded.pixels, frame.pixels);
+}
+
+TEST(RawFrame, LeavesRoomForACallersHeader) {
+  Frame frame = MakeScreen(40, 30);
+  std::vector<uint8_t> plain = EncodeRawFrame(frame, 77);
+  std::vector<uint8_t> offset =
+      EncodeRawFrame(frame, 77, FramePredictor::kLeft, 32);
+  ASSERT_EQ(offset.size(), plain.size() + 32);
+  EXPECT_TRUE(std::equal(plain.begin(), plain.end(), offset.begin() + 32));
+
+  Frame decoded;
+  ASSERT_TRUE(DecodeRawFrame(offset.data() + 32, offset.size() - 32,
+                             &decoded, nullptr));
+  EXPECT_EQ(decoded.pixels, frame.pixels);
+}
+
+TEST(RawFrame, RejectsMalformedContainers) {
+  Frame frame = MakeScreen(16, 16);
+  std::vector<uint8_t> encoded = EncodeRawFrame(frame, 0);
+  Frame decoded;
+
+  std::vector<uint8_t> bad_magic = encoded;
+  bad_magic[0] = 'X';
+  EXPECT_FALSE(DecodeRawFrame(bad_magic.data(), bad_magic.size(), &decoded,
+                              nullptr));
+  EXPECT_FALSE(DecodeRawFrame(encoded.data(), encoded.size() - 1, &decoded,
+                              nullptr));
+  std::vector<uint8_t> bad_stride = encoded;
+  bad_stride[16] = 1;
+  bad_stride[17] = 0;
+  EXPECT_FALSE(DecodeRawFrame(bad_stride.data(), bad_stride.size(), &decoded,
+                              nullptr));
+}
+
+TEST(RawFrame, ParsesPredictorNames) {
+  FramePredictor predictor;
+  EXPECT_TRUE(ParseFramePredictor("up", &predictor));
+  EXPECT_EQ(predictor, FramePredictor::kUp);
+  EXPECT_FALSE(ParseFramePredictor("paeth", &predictor));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "redaction.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// Builds a frame whose blue channel is a horizontal gradient and whose
+// green channel is a vertical one, so every pixel is distinct.
+Frame MakeGradient(int width, int height) {
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < width; ++x, p += 4) {
+      p[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+      p[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+      p[2] = 0x40;
+      p[3] = 0xFF;
+    }
+  }
+  return frame;
+}
+
+}  // namespace
+
+TEST(Redaction, FillPaintsOnlyTheClippedRect) {
+  Frame frame = MakeGradient(16, 16);
+  Frame original = frame;
+  Redaction redaction;
+  redaction.rect = Rect{12, 12, 10, 10};
+  redaction.color = 0xFF112233;
+  ApplyRedactions(&frame, {redaction});
+
+  const uint8_t* inside = frame.Row(15) + 15 * 4;
+  EXPECT_EQ(inside[0], 0x33);
+  EXPECT_EQ(inside[1], 0x22);
+  EXPECT_EQ(inside[2], 0x11);
+  EXPECT_EQ(inside[3], 0xFF);
+  EXPECT_EQ(0, memcmp(frame.Row(0), original.Row(0), frame.stride));
+  EXPECT_EQ(0, memcmp(frame.Row(12), original.Row(12), 12 * 4));
+}
+
+TEST(Redaction, PixelateAveragesEachBlock) {
+  Frame frame = MakeGradient(8, 8);
+  Redaction redaction;
+  redaction.rect = Rect{0, 0, 8, 8};
+  redaction.mode = RedactionMode::kPixelate;
+  redaction.strength = 4;
+  ApplyRedactions(&frame, {redaction});
+
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      EXPECT_EQ(0, memcmp(frame.Row(y) + x * 4, frame.Row(0), 4));
+    }
+  }
+  EXPECT_NE(0, memcmp(frame.Row(0), frame.Row(0) + 4 * 4, 4));
+}
+
+TEST(Redaction, BlurKeepsUniformAreasAndSmoothsEdges) {
+  Frame frame;
+  frame.Allocate(32, 4);
+  for (int y = 0; y < 4; ++y) {
+    uint8_t* p = frame.Row(y);
+    for (int x = 0; x < 32; ++x, p += 4) {
+      uint8_t v = x < 16 ? 0 : 200;
+      p[0] = p[1] = p[2] = v;
+      p[3] = 0xFF;
+    }
+  }
+  Redaction redaction;
+  redaction.rect = Rect{0, 0, 32, 4};
+  redaction.mode = RedactionMode::kBlur;
+  redaction.strength = 2;
+  ApplyRedactions(&frame, {redaction});
+
+  EXPECT_EQ(frame.Row(2)[0], 0);
+  EXPECT_EQ(frame.Row(2)[31 * 4], 200);
+  EXPECT_EQ(frame.Row(2)[3], 0xFF);
+  uint8_t edge = frame.Row(2)[16 * 4];
+  EXPECT_GT(edge, 0);
+  EXPECT_LT(edge, 200);
+}
+
+TEST(Redaction, ClampsStrengthToTheRect) {
+  Frame frame = MakeGradient(16, 16);
+  Frame expected = frame;
+  Redaction redaction;
+  redaction.rect = Rect{0, 0, 16, 16};
+  redaction.mode = RedactionMode::kBlur;
+  redaction.strength = 16;
+  ApplyRedactions(&expected, {redaction});
+  redaction.strength = 0x7FFFFFFF;
+  ApplyRedactions(&frame, {redaction});
+  EXPECT_EQ(frame.pixels, expected.pixels);
+
+  // Window sums past 16 bits per channel.
+  Frame wide;
+  wide.Allocate(600, 2);
+  std::memset(wide.pixels.data(), 250, wide.pixels.size());
+  redaction.rect = Rect{0, 0, 600, 2};
+  redaction.strength = 500;
+  ApplyRedactions(&wide, {redaction});
+  EXPECT_EQ(wide.Row(1)[300 * 4], 250);
+  EXPECT_EQ(wide.Row(0)[599 * 4 + 2], 250);
+}
+
+TEST(Redaction, ParsesModeNames) {
+  RedactionMode mode;
+  EXPECT_TRUE(ParseRedactionMode("blur", &mode));
+  EXPECT_EQ(mode, RedactionMode::kBlur);
+  EXPECT_TRUE(ParseRedactionMode("pixelate", &mode));
+  EXPECT_EQ(mode, RedactionMode::kPixelate);
+  EXPECT_FALSE(ParseRedactionMode("smudge", &mode));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "screen_stats.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+void Fill(Frame* frame, uint8_t b, uint8_t g, uint8_t r) {
+  for (int y = 0; y < frame->height; ++y) {
+    uint8_t* p = frame->Row(y);
+    for (int x = 0; x < frame->width; ++x, p += 4) {
+      p[0] = b;
+      p[1] = g;
+      p[2] = r;
+      p[3] = 0xFF;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(ScreenStats, BlackScreenIsUniform) {
+  Frame frame;
+  frame.Allocate(37, 11);
+  Fill(&frame, 0, 0, 0);
+  ScreenStats stats = ComputeScreenStats(frame);
+  EXPECT_EQ(stats.pixels, 37u * 11u);
+  EXPECT_TRUE(stats.uniform);
+  EXPECT_DOUBLE_EQ(stats.mean_luminance, 0);
+  EXPECT_DOUBLE_EQ(stats.luminance_variance, 0);
+  EXPECT_EQ(stats.red[0], 37u * 11u);
+  EXPECT_EQ(stats.blue[0], 37u * 11u);
+}
+
+TEST(ScreenStats, SmallDitherStaysUniform) {
+  Frame frame;
+  frame.Allocate(8, 8);
+  Fill(&frame, 20, 20, 20);
+  frame.Row(3)[5 * 4] = 23;
+  EXPECT_TRUE(ComputeScreenStats(frame).uniform);
+  frame.Row(3)[5 * 4 + 2] = 90;
+  EXPECT_FALSE(ComputeScreenStats(frame).uniform);
+}
+
+TEST(ScreenStats, MatchesDirectComputation) {
+  std::mt19937 rng(11);
+  Frame frame;
+  frame.Allocate(103, 29);  // Odd width exercises the scalar tail.
+  for (uint8_t& byte : frame.pixels) byte = static_cast<uint8_t>(rng());
+
+  double sum = 0;
+  double squares = 0;
+  uint32_t green_at_7 = 0;
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* p = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      double l = (29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8;
+      sum += l;
+      squares += l * l;
+      if (p[1] == 7) ++green_at_7;
+    }
+  }
+  double n = 103.0 * 29.0;
+  ScreenStats stats = ComputeScreenStats(frame);
+  EXPECT_NEAR(stats.mean_luminance, sum / n, 1e-9);
+  EXPECT_NEAR(stats.luminance_variance, squares / n - (sum / n) * (sum / n),
+              1e-6);
+  EXPECT_EQ(stats.green[7], green_at_7);
+  EXPECT_FALSE(stats.uniform);
+
+  uint64_t total = 0;
+  for (uint32_t count : stats.red) total += count;
+  EXPECT_EQ(total, stats.pixels);
+}
+
+TEST(ScreenStats, EmptyFrameHasNoPixels) {
+  ScreenStats stats = ComputeScreenStats(Frame());
+  EXPECT_EQ(stats.pixels, 0u);
+  EXPECT_FALSE(stats.uniform);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
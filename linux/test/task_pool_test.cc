@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+#include "task_pool.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+TEST(TaskPool, RunCoversEveryIndexOnce) {
+  TaskPool pool(3);
+  std::vector<std::atomic<int>> hits(1000);
+  pool.Run(hits.size(), 7, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) hits[i]++;
+  });
+  for (const auto& hit : hits) EXPECT_EQ(hit.load(), 1);
+
+  TaskPool::Stats stats = pool.stats();
+  EXPECT_EQ(stats.threads, 3);
+  EXPECT_EQ(stats.tasks, (1000u + 6) / 7);
+  EXPECT_EQ(stats.queue_depth, 0u);
+}
+
+TEST(TaskPool, NestedRunsFinish) {
+  TaskPool pool(2);
+  std::atomic<int> total(0);
+  pool.Run(8, 1, [&](size_t, size_t) {
+    pool.Run(16, 2, [&](size_t begin, size_t end) {
+      total += static_cast<int>(end - begin);
+    });
+  });
+  EXPECT_EQ(total.load(), 8 * 16);
+}
+
+TEST(TaskPool, IdleWorkersStealFromBusyOnes) {
+  TaskPool pool(4);
+  // One slow range per worker deque plus many quick ones; a worker that
+  // finishes its own share has to steal to help.
+  std::atomic<int> done(0);
+  pool.Run(64, 1, [&](size_t begin, size_t) {
+    if (begin % 16 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    done++;
+  });
+  EXPECT_EQ(done.load(), 64);
+  EXPECT_GT(pool.stats().steals, 0u);
+}
+
+TEST(TaskPool, CallerSleepsWhileWorkersFinishItsJob) {
+  TaskPool pool(2);
+  const std::thread::id caller = std::this_thread::get_id();
+  auto cpu_ms = [] {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+  };
+  std::atomic<bool> worker_started(false);
+  const double before = cpu_ms();
+  pool.Run(4, 1, [&](size_t, size_t) {
+    if (std::this_thread::get_id() != caller) {
+      worker_started = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      return;
+    }
+    // Leaves the workers time to take a range before the caller drains
+    // the deques itself.
+    for (int i = 0; i < 1000 && !worker_started; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  ASSERT_TRUE(worker_started);
+  // A caller spinning until the workers' ranges end would use ~200 ms.
+  EXPECT_LT(cpu_ms() - before, 50.0);
+}
+
+TEST(TaskPool, ConfigureRestartsWorkers) {
+  TaskPool pool(2);
+  pool.Configure(5, false);
+  EXPECT_EQ(pool.stats().threads, 5);
+  std::atomic<int> count(0);
+  pool.Run(100, 3, [&](size_t begin, size_t end) {
+    count += static_cast<int>(end - begin);
+  });
+  EXPECT_EQ(count.load(), 100);
+}
+
+TEST(TaskPool, ConfigureWaitsForRunsOnOtherThreads) {
+  TaskPool pool(2);
+  std::atomic<bool> done(false);
+  std::atomic<int> runs(0);
+  // Stands in for prepare's warm-up thread, which runs parallel stages
+  // while the platform thread may reconfigure the pool.
+  std::thread runner([&] {
+    while (!done) {
+      std::atomic<int> count(0);
+      pool.Run(64, 4, [&](size_t begin, size_t end) {
+        count += static_cast<int>(end - begin);
+      });
+      EXPECT_EQ(count.load(), 64);
+      runs++;
+    }
+  });
+  for (int threads = 1; threads <= 4; ++threads) {
+    while (runs.load() < threads * 10) std::this_thread::yield();
+    pool.Configure(threads, false);
+    EXPECT_EQ(pool.stats().threads, threads);
+  }
+  done = true;
+  runner.join();
+}
+
+TEST(TaskPool, SharedPoolLivesWhileRetained) {
+  EXPECT_EQ(TaskPool::Current(), nullptr);
+  TaskPool* first = TaskPool::Retain();
+  TaskPool* second = TaskPool::Retain();
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(TaskPool::Current(), first);
+
+  std::vector<std::atomic<int>> hits(257);
+  ParallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+  for (const auto& hit : hits) EXPECT_EQ(hit.load(), 1);
+  EXPECT_GE(first->stats().tasks, 257u);
+
+  TaskPool::Release();
+  EXPECT_EQ(TaskPool::Current(), first);
+  TaskPool::Release();
+  EXPECT_EQ(TaskPool::Current(), nullptr);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
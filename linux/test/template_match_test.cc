@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+
+#include "template_match.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+// Random blocky texture, similar enough to UI pixels that a patch of it is
+// unique and survives the pyramid downscale.
+Frame MakeTexture(int width, int height, uint32_t seed) {
+  std::mt19937 rng(seed);
+  Frame frame;
+  frame.Allocate(width, height);
+  for (int by = 0; by < height; by += 4) {
+    for (int bx = 0; bx < width; bx += 4) {
+      uint8_t b = static_cast<uint8_t>(rng());
+      uint8_t g = static_cast<uint8_t>(rng());
+      uint8_t r = static_cast<uint8_t>(rng());
+      for (int y = by; y < std::min(by + 4, height); ++y) {
+        for (int x = bx; x < std::min(bx + 4, width); ++x) {
+          uint8_t* p = frame.Row(y) + x * 4;
+          p[0] = b;
+          p[1] = g;
+          p[2] = r;
+          p[3] = 0xFF;
+        }
+      }
+    }
+  }
+  return frame;
+}
+
+void Paste(const Frame& patch, Frame* frame, int left, int top) {
+  for (int y = 0; y < patch.height; ++y) {
+    std::copy(patch.Row(y), patch.Row(y) + patch.stride,
+              frame->Row(top + y) + left * 4);
+  }
+}
+
+}  // namespace
+
+TEST(TemplateMatch, FindsPatchAtOddOffset) {
+  Frame screen = MakeTexture(400, 300, 1);
+  Frame patch = CropFrame(screen, Rect{123, 77, 48, 40});
+  std::vector<TemplateMatch> matches = FindTemplate(screen, patch, 0.95f, 4);
+  ASSERT_EQ(matches.size(), 1u);
+  EXPECT_EQ(matches[0].rect.x, 123);
+  EXPECT_EQ(matches[0].rect.y, 77);
+  EXPECT_EQ(matches[0].rect.width, 48);
+  EXPECT_EQ(matches[0].rect.height, 40);
+  EXPECT_GT(matches[0].score, 0.999f);
+}
+
+TEST(TemplateMatch, FindsEveryCopyBestFirst) {
+  Frame screen = MakeTexture(320, 240, 2);
+  Frame icon = MakeTexture(33, 21, 3);
+  Paste(icon, &screen, 10, 10);
+  Paste(icon, &screen, 201, 150);
+  Paste(icon, &screen, 90, 181);
+  std::vector<TemplateMatch> matches = FindTemplate(screen, icon, 0.9f, 10);
+  ASSERT_EQ(matches.size(), 3u);
+  bool seen[3] = {false, false, false};
+  for (const TemplateMatch& match : matches) {
+    if (match.rect.x == 10 && match.rect.y == 10) seen[0] = true;
+    if (match.rect.x == 201 && match.rect.y == 150) seen[1] = true;
+    if (match.rect.x == 90 && match.rect.y == 181) seen[2] = true;
+  }
+  EXPECT_TRUE(seen[0] && seen[1] && seen[2]);
+
+  EXPECT_EQ(FindTemplate(screen, icon, 0.9f, 2).size(), 2u);
+}
+
+TEST(TemplateMatch, RejectsAbsentTemplate) {
+  Frame screen = MakeTexture(200, 200, 4);
+  Frame other = MakeTexture(24, 24, 5);
+  EXPECT_TRUE(FindTemplate(screen, other, 0.9f, 4).empty());
+}
+
+TEST(TemplateMatch, ToleratesBrightnessShift) {
+  Frame screen = MakeTexture(160, 120, 6);
+  Frame patch = CropFrame(screen, Rect{50, 30, 20, 20});
+  for (int y = 0; y < patch.height; ++y) {
+    uint8_t* p = patch.Row(y);
+    for (int i = 0; i < patch.width * 4; ++i) p[i] = static_cast<uint8_t>(p[i] / 2 + 20);
+  }
+  std::vector<TemplateMatch> matches = FindTemplate(screen, patch, 0.95f, 1);
+  ASSERT_EQ(matches.size(), 1u);
+  EXPECT_EQ(matches[0].rect.x, 50);
+  EXPECT_EQ(matches[0].rect.y, 30);
+}
+
+TEST(TemplateMatch, UniformTemplateMatchesSameColorOnly) {
+  Frame screen = MakeTexture(64, 64, 7);
+  Frame swatch;
+  swatch.Allocate(6, 6);
+  for (int y = 0; y < 6; ++y) {
+    for (int x = 0; x < 6; ++x) {
+      uint8_t* p = swatch.Row(y) + x * 4;
+      p[0] = 10;
+      p[1] = 200;
+      p[2] = 30;
+      p[3] = 0xFF;
+    }
+  }
+  Paste(swatch, &screen, 40, 20);
+  std::vector<TemplateMatch> matches = FindTemplate(screen, swatch, 0.99f, 4);
+  ASSERT_FALSE(matches.empty());
+  EXPECT_EQ(matches[0].rect.x, 40);
+  EXPECT_EQ(matches[0].rect.y, 20);
+}
+
+TEST(TemplateMatch, TemplateLargerThanScreenFindsNothing) {
+  Frame screen = MakeTexture(16, 16, 8);
+  Frame patch = MakeTexture(17, 4, 9);
+  EXPECT_TRUE(FindTemplate(screen, patch, 0.5f, 4).empty());
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
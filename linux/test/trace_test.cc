@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+size_t Count(const std::string& text, const std::string& needle) {
+  size_t count = 0;
+  for (size_t at = text.find(needle); at != std::string::npos;
+       at = text.find(needle, at + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(Trace, RecordsNothingWhileOff) {
+  StartTracing();
+  StopTracing();
+  EXPECT_FALSE(TracingEnabled());
+  { ScopedTrace grab("grab"); }
+  EXPECT_EQ(InternTraceName("getScreenshot"), nullptr);
+  TraceSummary summary;
+  EXPECT_EQ(TraceToJson(&summary), "{\"displayTimeUnit\":\"ms\","
+                                   "\"traceEvents\":[]}");
+  EXPECT_EQ(summary.events, 0u);
+}
+
+TEST(Trace, WritesCompleteEventsAsChromeJson) {
+  StartTracing();
+  {
+    ScopedTrace request(InternTraceName("getScreenshot"), "request");
+    ScopedTrace encode("encode");
+  }
+  StopTracing();
+  TraceSummary summary;
+  const std::string json = TraceToJson(&summary);
+  EXPECT_EQ(summary.events, 2u);
+  EXPECT_EQ(summary.threads, 1u);
+  EXPECT_NE(json.find("{\"name\":\"encode\",\"cat\":\"capture\",\"ph\":\"X\","
+                      "\"ts\":"),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"getScreenshot\",\"cat\":\"request\""),
+            std::string::npos);
+  EXPECT_EQ(json.find(','), json.find(",\"traceEvents\""));
+  EXPECT_EQ(json.substr(json.size() - 2), "]}");
+}
+
+TEST(Trace, EveryThreadRecordsIntoItsOwnBuffer) {
+  StartTracing();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      SetTraceThreadName("worker " + std::to_string(t));
+      for (int i = 0; i < 100; ++i) ScopedTrace task("task", "pool");
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  StopTracing();
+  TraceSummary summary;
+  const std::string json = TraceToJson(&summary);
+  // The threads have exited; their events are still written.
+  EXPECT_EQ(summary.threads, 4u);
+  EXPECT_EQ(summary.events, 400u);
+  EXPECT_EQ(Count(json, "\"name\":\"thread_name\""), 4u);
+  EXPECT_EQ(Count(json, "\"name\":\"task\""), 400u);
+}
+
+TEST(Trace, DropsEventsBeyondTheBuffer) {
+  StartTracing(3);
+  for (int i = 0; i < 5; ++i) ScopedTrace convert("convert");
+  StopTracing();
+  TraceSummary summary;
+  TraceToJson(&summary);
+  EXPECT_EQ(summary.events, 3u);
+  EXPECT_EQ(summary.dropped, 2u);
+
+  // A new recording starts empty.
+  StartTracing();
+  StopTracing();
+  TraceToJson(&summary);
+  EXPECT_EQ(summary.events, 0u);
+  EXPECT_EQ(summary.dropped, 0u);
+}
+
+TEST(Trace, EscapesNames) {
+  StartTracing();
+  { ScopedTrace odd(InternTraceName("a\"b\\c\n")); }
+  StopTracing();
+  EXPECT_NE(TraceToJson().find("\"a\\\"b\\\\c\\u000a\""), std::string::npos);
+}
+
+TEST(Trace, WritesTheTraceFile) {
+  StartTracing();
+  { ScopedTrace reply("reply"); }
+  StopTracing();
+  const std::string path = ::testing::TempDir() + "trace_test.json";
+  TraceSummary summary;
+  ASSERT_TRUE(WriteTrace(path, &summary));
+  EXPECT_EQ(summary.events, 1u);
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  EXPECT_EQ(contents.str(), TraceToJson());
+
+  EXPECT_FALSE(WriteTrace(::testing::TempDir() + "missing/dir/trace.json"));
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
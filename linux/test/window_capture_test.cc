@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+// After gtest: Xlib defines None, which gtest uses as a type name.
+#include <X11/Xlib.h>
+#include <X11/extensions/Xcomposite.h>
+
+#include <algorithm>
+
+#include "window_capture.h"
+
+// These talk to a real X server. Run them under Xvfb, e.g.
+//   xvfb-run -s "-screen 0 640x480x24 +extension Composite" <test runner>
+// Xvfb has no compositing manager, so the fixture stands in for one by
+// redirecting every top-level window offscreen before it is mapped.
+
+namespace desktop_screenshot {
+namespace test {
+
+namespace {
+
+class WindowCaptureTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    display_ = XOpenDisplay(nullptr);
+    if (!display_) GTEST_SKIP() << "No X display";
+    XCompositeRedirectSubwindows(display_, DefaultRootWindow(display_),
+                                 CompositeRedirectAutomatic);
+  }
+
+  void TearDown() override {
+    if (!display_) return;
+    for (Window window : windows_) XDestroyWindow(display_, window);
+    XCloseDisplay(display_);
+  }
+
+  // Maps a top-level window filled with |rgb| by the server itself, so its
+  // pixels do not depend on anyone handling Expose.
+  Window Open(const char* title, int x, int y, int width, int height,
+              unsigned long rgb) {
+    XSetWindowAttributes attributes;
+    attributes.background_pixel = rgb;
+    attributes.override_redirect = False;
+    Window window = XCreateWindow(
+        display_, DefaultRootWindow(display_), x, y, width, height, 0,
+        CopyFromParent, InputOutput, CopyFromParent, CWBackPixel, &attributes);
+    XStoreName(display_, window, title);
+    XMapRaised(display_, window);
+    XSync(display_, False);
+    windows_.push_back(window);
+    return window;
+  }
+
+  uint32_t PixelAt(const Frame& frame, int x, int y) {
+    const uint8_t* p = frame.Row(y) + x * 4;
+    return static_cast<uint32_t>(p[2]) << 16 | p[1] << 8 | p[0];
+  }
+
+  Display* display_ = nullptr;
+  std::vector<Window> windows_;
+};
+
+// Stands in for a toolkit's error traps, counting how they are used.
+int toolkit_error = 0;
+int toolkit_pushes = 0;
+int toolkit_pops = 0;
+XErrorHandler toolkit_previous = nullptr;
+
+int ToolkitHandler(Display*, XErrorEvent* event) {
+  if (!toolkit_error) toolkit_error = event->error_code;
+  return 0;
+}
+
+void ToolkitPush(Display* display) {
+  XSync(display, False);
+  toolkit_error = 0;
+  toolkit_previous = XSetErrorHandler(ToolkitHandler);
+  ++toolkit_pushes;
+}
+
+int ToolkitPop(Display* display) {
+  XSync(display, False);
+  XSetErrorHandler(toolkit_previous);
+  ++toolkit_pops;
+  return toolkit_error;
+}
+
+}  // namespace
+
+TEST_F(WindowCaptureTest, ListsMappedWindowsWithGeometry) {
+  Window window = Open("list me", 30, 40, 120, 90, 0x00FF00);
+  WindowCapturer capturer(display_);
+  std::vector<WindowInfo> list = capturer.ListWindows();
+  auto it = std::find_if(list.begin(), list.end(), [&](const WindowInfo& w) {
+    return w.id == window;
+  });
+  ASSERT_NE(it, list.end());
+  EXPECT_EQ(it->title, "list me");
+  EXPECT_EQ(it->rect.x, 30);
+  EXPECT_EQ(it->rect.y, 40);
+  EXPECT_EQ(it->rect.width, 120);
+  EXPECT_EQ(it->rect.height, 90);
+}
+
+TEST_F(WindowCaptureTest, CapturesOnlyTheWindow) {
+  Window window = Open("solid", 10, 10, 64, 48, 0x3366CC);
+  WindowCapturer capturer(display_);
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(window, &frame));
+  EXPECT_EQ(frame.width, 64);
+  EXPECT_EQ(frame.height, 48);
+  EXPECT_EQ(PixelAt(frame, 0, 0), 0x3366CCu);
+  EXPECT_EQ(PixelAt(frame, 63, 47), 0x3366CCu);
+  EXPECT_EQ(frame.Row(5)[3], 0xFF);
+}
+
+TEST_F(WindowCaptureTest, CapturesContentsHiddenBehindAnotherWindow) {
+  Window below = Open("below", 50, 50, 80, 80, 0xFF0000);
+  Open("above", 40, 40, 100, 100, 0x0000FF);
+  WindowCapturer capturer(display_);
+  ASSERT_TRUE(capturer.has_composite());
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(below, &frame));
+  EXPECT_EQ(PixelAt(frame, 40, 40), 0xFF0000u);
+}
+
+TEST_F(WindowCaptureTest, RepeatedCapturesReuseTheSegment) {
+  Window small = Open("small", 0, 0, 16, 16, 0x101010);
+  Window large = Open("large", 100, 0, 200, 150, 0x202020);
+  WindowCapturer capturer(display_);
+  Frame frame;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(capturer.Capture(large, &frame));
+    EXPECT_EQ(frame.width, 200);
+    ASSERT_TRUE(capturer.Capture(small, &frame));
+    EXPECT_EQ(PixelAt(frame, 8, 8), 0x101010u);
+  }
+}
+
+TEST_F(WindowCaptureTest, RejectsUnknownWindow) {
+  WindowCapturer capturer(display_);
+  Frame frame;
+  EXPECT_FALSE(capturer.Capture(0x1FFFFFF, &frame));
+  EXPECT_FALSE(capturer.Capture(None, &frame));
+}
+
+TEST_F(WindowCaptureTest, TrapsErrorsThroughTheToolkitsHooks) {
+  const ErrorTrapHooks hooks = {ToolkitPush, ToolkitPop};
+  toolkit_pushes = 0;
+  toolkit_pops = 0;
+  {
+    WindowCapturer capturer(display_, &hooks);
+    Frame frame;
+    EXPECT_FALSE(capturer.Capture(0x1FFFFFF, &frame));
+  }
+  EXPECT_GT(toolkit_pushes, 0);
+  EXPECT_EQ(toolkit_pushes, toolkit_pops);
+}
+
+TEST_F(WindowCaptureTest, ForgetsWindowsClosedSinceTheirCapture) {
+  Window first = Open("first", 0, 0, 32, 32, 0x404040);
+  Window second = Open("second", 40, 0, 32, 32, 0x505050);
+  WindowCapturer capturer(display_);
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(first, &frame));
+  EXPECT_EQ(capturer.redirected(), 1u);
+
+  XDestroyWindow(display_, first);
+  XSync(display_, False);
+  windows_.erase(std::find(windows_.begin(), windows_.end(), first));
+  ASSERT_TRUE(capturer.Capture(second, &frame));
+  EXPECT_EQ(capturer.redirected(), 1u);
+}
+
+TEST_F(WindowCaptureTest, RefusesWindowsOverTheLedgersCeiling) {
+  Window window = Open("large", 0, 0, 200, 150, 0x303030);
+  MemoryLedger ledger;
+  WindowCapturer capturer(display_, nullptr, &ledger);
+  Frame frame;
+  ASSERT_TRUE(capturer.Capture(window, &frame));
+  EXPECT_FALSE(capturer.refused());
+  EXPECT_GT(ledger.Stats().peak, 0u);
+
+  ledger.SetLimit(ledger.Stats().current + 1024);
+  EXPECT_FALSE(capturer.Capture(window, &frame));
+  EXPECT_TRUE(capturer.refused());
+  EXPECT_EQ(ledger.Stats().refused, 1u);
+}
+
+}  // namespace test
+}  // namespace desktop_screenshot
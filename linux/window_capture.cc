@@ -0,0 +1,273 @@
+#include "window_capture.h"
+
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+
+#include "trace.h"
+#include "x11_util.h"
+
+using desktop_screenshot::Frame;
+using desktop_screenshot::MemoryCharge;
+using desktop_screenshot::MemoryLedger;
+using desktop_screenshot::MemoryStage;
+using desktop_screenshot::Rect;
+using desktop_screenshot::ScopedTrace;
+
+namespace {
+
+std::string WindowTitle(Display* display, Window window) {
+  Atom name = XInternAtom(display, "_NET_WM_NAME", False);
+  Atom utf8 = XInternAtom(display, "UTF8_STRING", False);
+  Atom type = None;
+  int format = 0;
+  unsigned long count = 0;
+  unsigned long remaining = 0;
+  unsigned char* data = nullptr;
+  std::string title;
+  if (XGetWindowProperty(display, window, name, 0, 1024, False, utf8, &type,
+                         &format, &count, &remaining, &data) == Success &&
+      data) {
+    if (type == utf8 && format == 8) {
+      title.assign(reinterpret_cast<const char*>(data), count);
+    }
+    XFree(data);
+  }
+  if (title.empty()) {
+    char* legacy = nullptr;
+    if (XFetchName(display, window, &legacy) && legacy) {
+      title = legacy;
+      XFree(legacy);
+    }
+  }
+  return title;
+}
+
+// Converts a ZPixmap image to a BGRA frame of its size.
+bool ImageToFrame(const XImage* image, int depth, Frame* frame) {
+  frame->Allocate(image->width, image->height);
+  return CopyImageToFrame(image, depth, frame, 0, 0);
+}
+
+}  // namespace
+
+WindowCapturer::WindowCapturer(Display* display, const ErrorTrapHooks* traps,
+                               MemoryLedger* ledger)
+    : display_(display), traps_(traps), ledger_(ledger) {
+  int event_base = 0;
+  int error_base = 0;
+  int major = 0;
+  int minor = 2;
+  // NameWindowPixmap needs 0.2.
+  composite_ = XCompositeQueryExtension(display_, &event_base, &error_base) &&
+               XCompositeQueryVersion(display_, &major, &minor) &&
+               (major > 0 || minor >= 2);
+  shm_ = XShmQueryExtension(display_);
+  segment_.shmid = -1;
+}
+
+WindowCapturer::~WindowCapturer() {
+  // Windows closed since their capture are already gone; the trap absorbs
+  // the BadWindow.
+  ErrorTrap trap(display_, traps_);
+  for (Window window : redirected_) {
+    XCompositeUnredirectWindow(display_, window, CompositeRedirectAutomatic);
+  }
+  FreeSegment();
+}
+
+std::vector<WindowInfo> WindowCapturer::ListWindows() {
+  std::vector<WindowInfo> out;
+  ErrorTrap trap(display_, traps_);
+  Window root = DefaultRootWindow(display_);
+
+  std::vector<Window> windows;
+  bool managed = false;
+  Atom stacking = XInternAtom(display_, "_NET_CLIENT_LIST_STACKING", True);
+  if (stacking != None) {
+    Atom type = None;
+    int format = 0;
+    unsigned long count = 0;
+    unsigned long remaining = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display_, root, stacking, 0, 65536, False,
+                           XA_WINDOW, &type, &format, &count, &remaining,
+                           &data) == Success &&
+        data) {
+      // Format 32 properties come back as an array of longs.
+      if (type == XA_WINDOW && format == 32) {
+        const Window* ids = reinterpret_cast<const Window*>(data);
+        windows.assign(ids, ids + count);
+        managed = true;
+      }
+      XFree(data);
+    }
+  }
+  if (!managed) {
+    Window root_return = None;
+    Window parent = None;
+    Window* children = nullptr;
+    unsigned int count = 0;
+    if (XQueryTree(display_, root, &root_return, &parent, &children, &count)) {
+      windows.assign(children, children + count);
+      if (children) XFree(children);
+    }
+  }
+
+  for (Window window : windows) {
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display_, window, &attributes)) continue;
+    if (attributes.c_class == InputOnly ||
+        attributes.map_state != IsViewable) {
+      continue;
+    }
+    // Without a window manager, menus and tooltips are root children too.
+    if (!managed && attributes.override_redirect) continue;
+
+    int x = 0;
+    int y = 0;
+    Window child = None;
+    if (!XTranslateCoordinates(display_, window, root, 0, 0, &x, &y,
+                               &child)) {
+      continue;
+    }
+    WindowInfo info;
+    info.id = window;
+    info.rect = Rect{x, y, attributes.width, attributes.height};
+    info.title = WindowTitle(display_, window);
+    out.push_back(std::move(info));
+  }
+  return out;
+}
+
+bool WindowCapturer::Capture(Window window, Frame* frame) {
+  ScopedTrace trace("grab");
+  refused_ = false;
+  ErrorTrap trap(display_, traps_);
+  XWindowAttributes attributes;
+  if (!XGetWindowAttributes(display_, window, &attributes) || trap.Failed()) {
+    return false;
+  }
+  if (attributes.c_class == InputOnly || attributes.map_state != IsViewable ||
+      attributes.width <= 0 || attributes.height <= 0) {
+    return false;
+  }
+  const int width = attributes.width;
+  const int height = attributes.height;
+  if (ledger_) {
+    desktop_screenshot::CapturePlan plan = desktop_screenshot::PlanCapture(
+        ledger_->Available(), width, height, 4, 1);
+    if (!plan.possible || plan.degraded()) {
+      ledger_->NoteRefused();
+      refused_ = true;
+      return false;
+    }
+  }
+
+  Drawable source = window;
+  int offset = 0;
+  Pixmap pixmap = None;
+  if (composite_) {
+    if (!redirected_.count(window)) {
+      ForgetUnmapped(&trap);
+      XCompositeRedirectWindow(display_, window, CompositeRedirectAutomatic);
+      // A compositing manager that already redirects the window manually
+      // makes this fail, but its pixmap can be named all the same.
+      if (!trap.Failed()) redirected_.insert(window);
+      trap.Clear();
+    }
+    pixmap = XCompositeNameWindowPixmap(display_, window);
+    if (trap.Failed()) {
+      pixmap = None;
+      trap.Clear();
+    } else {
+      // The pixmap includes the border; the contents start inside it.
+      source = pixmap;
+      offset = attributes.border_width;
+    }
+  }
+
+  XImage* image = nullptr;
+  bool shared = false;
+  if (shm_) {
+    image = XShmCreateImage(display_, attributes.visual, attributes.depth,
+                            ZPixmap, nullptr, &segment_, width, height);
+    if (image &&
+        EnsureSegment(static_cast<size_t>(image->bytes_per_line) * height)) {
+      if (trap.Failed()) {
+        // A remote server cannot attach our segment; stop trying.
+        shm_ = false;
+      } else {
+        image->data = segment_.shmaddr;
+        shared = XShmGetImage(display_, source, image, offset, offset,
+                              AllPlanes) &&
+                 !trap.Failed();
+      }
+    }
+    if (!shared) {
+      trap.Clear();
+      if (image) {
+        image->data = nullptr;
+        XDestroyImage(image);
+        image = nullptr;
+      }
+    }
+  }
+  MemoryCharge grab;
+  if (!image) {
+    if (ledger_) {
+      grab = ledger_->Charge(MemoryStage::kGrab,
+                             static_cast<size_t>(width) * height * 4);
+    }
+    image = XGetImage(display_, source, offset, offset, width, height,
+                      AllPlanes, ZPixmap);
+  }
+  if (pixmap != None) XFreePixmap(display_, pixmap);
+
+  bool ok = image && !trap.Failed() &&
+            ImageToFrame(image, attributes.depth, frame);
+  if (image) {
+    // The segment is reused by the next capture.
+    if (shared) image->data = nullptr;
+    XDestroyImage(image);
+  }
+  return ok;
+}
+
+void WindowCapturer::ForgetUnmapped(ErrorTrap* trap) {
+  for (auto it = redirected_.begin(); it != redirected_.end();) {
+    XWindowAttributes attributes;
+    // The server dropped the redirection of a destroyed window with it.
+    bool exists = XGetWindowAttributes(display_, *it, &attributes) &&
+                  !trap->Failed();
+    trap->Clear();
+    if (exists && attributes.map_state == IsViewable) {
+      ++it;
+      continue;
+    }
+    if (exists) {
+      XCompositeUnredirectWindow(display_, *it, CompositeRedirectAutomatic);
+      trap->Clear();
+    }
+    it = redirected_.erase(it);
+  }
+}
+
+bool WindowCapturer::EnsureSegment(size_t bytes) {
+  if (bytes <= segment_size_) return true;
+  FreeSegment();
+  // Rounded up to whole megabytes so a window that grows a little does not
+  // reallocate on every capture.
+  const size_t megabyte = 1 << 20;
+  const size_t size = (bytes + megabyte - 1) / megabyte * megabyte;
+  if (!AttachSegment(display_, size, &segment_)) return false;
+  segment_size_ = size;
+  if (ledger_) segment_charge_ = ledger_->Charge(MemoryStage::kGrab, size);
+  return true;
+}
+
+void WindowCapturer::FreeSegment() {
+  DetachSegment(display_, &segment_);
+  segment_size_ = 0;
+  segment_charge_.Reset();
+}
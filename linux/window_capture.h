@@ -0,0 +1,95 @@
+#ifndef DESKTOP_SCREENSHOT_LINUX_WINDOW_CAPTURE_H_
+#define DESKTOP_SCREENSHOT_LINUX_WINDOW_CAPTURE_H_
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+#include "memory_ledger.h"
+#include "x11_util.h"
+
+// Per-window capture on X11. Windows are read from their own backing
+// pixmap through the Composite extension, so the cost follows the window's
+// size rather than the desktop's, and parts covered by other windows are
+// still there.
+
+struct WindowInfo {
+  Window id = None;
+  std::string title;
+  // Position of the window's contents in root (desktop) coordinates.
+  desktop_screenshot::Rect rect;
+};
+
+class WindowCapturer {
+ public:
+  // |display| stays owned by the caller and must outlive the capturer.
+  // A connection shared with a toolkit passes the toolkit's |traps|, which
+  // then catch every X error the capturer's requests cause. With a
+  // |ledger|, grab buffers are charged to it and windows too large for its
+  // ceiling are refused.
+  explicit WindowCapturer(Display* display,
+                          const ErrorTrapHooks* traps = nullptr,
+                          desktop_screenshot::MemoryLedger* ledger = nullptr);
+
+  // Undoes the redirections made by Capture() and frees the SHM segment.
+  ~WindowCapturer();
+
+  WindowCapturer(const WindowCapturer&) = delete;
+  WindowCapturer& operator=(const WindowCapturer&) = delete;
+
+  // Viewable top-level windows, bottom to top. Uses the window manager's
+  // _NET_CLIENT_LIST_STACKING when published, otherwise the root's mapped
+  // children.
+  std::vector<WindowInfo> ListWindows();
+
+  // Copies |window|'s contents into |frame|. Returns false if the window
+  // is gone, unmapped or has no pixels, or was refused (see refused()).
+  //
+  // The first capture redirects the window offscreen; it stays redirected
+  // (automatically composited, so nothing changes on screen) while it is
+  // mapped. Parts that were hidden at that moment appear once the
+  // application repaints them after the resulting Expose. Before another
+  // window is redirected, windows since destroyed are forgotten and
+  // unmapped ones unredirected.
+  bool Capture(Window window, desktop_screenshot::Frame* frame);
+
+  // True if the last Capture() failed because the window's grab and frame
+  // do not fit under the ledger's ceiling. A window is never grabbed in
+  // stripes.
+  bool refused() const { return refused_; }
+
+  // Windows currently redirected by Capture().
+  size_t redirected() const { return redirected_.size(); }
+
+  // False on servers without Composite 0.2, where Capture() falls back to
+  // reading the window from the screen (visible parts only).
+  bool has_composite() const { return composite_; }
+
+ private:
+  // Makes the SHM segment at least |bytes| long and asks the server to
+  // attach it. Returns false if the segment could not be created; a failed
+  // attach (a remote server) only shows up as an X error afterwards.
+  bool EnsureSegment(size_t bytes);
+  void FreeSegment();
+
+  // Drops the redirected windows that are gone or no longer mapped.
+  void ForgetUnmapped(ErrorTrap* trap);
+
+  Display* display_;
+  const ErrorTrapHooks* traps_;
+  desktop_screenshot::MemoryLedger* const ledger_;
+  bool composite_ = false;
+  bool shm_ = false;
+  bool refused_ = false;
+  XShmSegmentInfo segment_{};
+  size_t segment_size_ = 0;
+  // The segment's bytes, charged to |ledger_| while it is attached.
+  desktop_screenshot::MemoryCharge segment_charge_;
+  std::set<Window> redirected_;
+};
+
+#endif  // DESKTOP_SCREENSHOT_LINUX_WINDOW_CAPTURE_H_
@@ -0,0 +1,136 @@
+#include "x11_util.h"
+
+#include <X11/Xutil.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <atomic>
+
+#include "pixel_pipeline.h"
+
+using desktop_screenshot::BgraPixels;
+using desktop_screenshot::BgrxPixels;
+using desktop_screenshot::ConvertRow;
+using desktop_screenshot::Frame;
+
+namespace {
+
+// Written from whichever thread reads the failing reply.
+std::atomic<int> trapped_error(0);
+
+int TrapError(Display*, XErrorEvent* event) {
+  trapped_error = event->error_code;
+  return 0;
+}
+
+// Scales the bits under |mask| to 0..255.
+uint8_t Channel(unsigned long pixel, unsigned long mask) {
+  int shift = __builtin_ctzl(mask);
+  unsigned long max = mask >> shift;
+  return static_cast<uint8_t>(((pixel & mask) >> shift) * 255 / max);
+}
+
+}  // namespace
+
+ErrorTrap::ErrorTrap(Display* display, const ErrorTrapHooks* hooks)
+    : display_(display), hooks_(hooks) {
+  if (hooks_) {
+    hooks_->push(display_);
+    return;
+  }
+  XSync(display_, False);
+  trapped_error = 0;
+  previous_ = XSetErrorHandler(TrapError);
+}
+
+ErrorTrap::~ErrorTrap() {
+  if (hooks_) {
+    hooks_->pop(display_);
+    return;
+  }
+  XSync(display_, False);
+  XSetErrorHandler(previous_);
+}
+
+bool ErrorTrap::Failed() {
+  if (hooks_) {
+    if (hooks_->pop(display_) != 0) failed_ = true;
+    hooks_->push(display_);
+    return failed_;
+  }
+  XSync(display_, False);
+  return trapped_error != 0;
+}
+
+void ErrorTrap::Clear() {
+  if (hooks_) {
+    hooks_->pop(display_);
+    hooks_->push(display_);
+    failed_ = false;
+    return;
+  }
+  XSync(display_, False);
+  trapped_error = 0;
+}
+
+bool AttachSegment(Display* display, size_t bytes, XShmSegmentInfo* segment) {
+  segment->shmid = shmget(IPC_PRIVATE, bytes, IPC_CREAT | 0600);
+  if (segment->shmid < 0) return false;
+  void* address = shmat(segment->shmid, nullptr, 0);
+  if (address == reinterpret_cast<void*>(-1)) {
+    shmctl(segment->shmid, IPC_RMID, nullptr);
+    segment->shmid = -1;
+    return false;
+  }
+  segment->shmaddr = static_cast<char*>(address);
+  segment->readOnly = False;
+  XShmAttach(display, segment);
+  XSync(display, False);
+  // Both sides are attached; the id can go, and the segment disappears
+  // once both detach, even if the process dies.
+  shmctl(segment->shmid, IPC_RMID, nullptr);
+  return true;
+}
+
+void DetachSegment(Display* display, XShmSegmentInfo* segment) {
+  if (segment->shmid < 0) return;
+  XShmDetach(display, segment);
+  XSync(display, False);
+  shmdt(segment->shmaddr);
+  segment->shmid = -1;
+  segment->shmaddr = nullptr;
+}
+
+// 32-bit little-endian images with the usual masks already are BGRX (or
+// premultiplied BGRA for depth 32) and are converted a row at a time.
+bool CopyImageToFrame(const XImage* image, int depth, Frame* frame, int x,
+                      int y) {
+  if (!image->red_mask || !image->green_mask || !image->blue_mask) {
+    return false;
+  }
+  const bool native = image->bits_per_pixel == 32 &&
+                      image->byte_order == LSBFirst &&
+                      image->red_mask == 0xFF0000 &&
+                      image->green_mask == 0xFF00 && image->blue_mask == 0xFF;
+  for (int row = 0; row < image->height; ++row) {
+    uint8_t* dst = frame->Row(y + row) + static_cast<size_t>(x) * 4;
+    if (native) {
+      const uint8_t* src = reinterpret_cast<const uint8_t*>(image->data) +
+                           static_cast<size_t>(row) * image->bytes_per_line;
+      if (depth == 32) {
+        ConvertRow<BgraPixels, BgraPixels>(src, dst, image->width);
+      } else {
+        ConvertRow<BgrxPixels, BgraPixels>(src, dst, image->width);
+      }
+      continue;
+    }
+    for (int i = 0; i < image->width; ++i, dst += 4) {
+      unsigned long pixel = XGetPixel(const_cast<XImage*>(image), i, row);
+      dst[0] = Channel(pixel, image->blue_mask);
+      dst[1] = Channel(pixel, image->green_mask);
+      dst[2] = Channel(pixel, image->red_mask);
+      dst[3] = 0xFF;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,66 @@
+#ifndef DESKTOP_SCREENSHOT_LINUX_X11_UTIL_H_
+#define DESKTOP_SCREENSHOT_LINUX_X11_UTIL_H_
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include <cstddef>
+
+#include "frame.h"
+
+// Xlib helpers shared by window and monitor capture.
+
+// A toolkit's own error trap for a connection it shares with us, e.g.
+// gdk_x11_display_error_trap_push/pop for GDK's. |pop| syncs and returns
+// the code of the first error since the matching |push|, or 0.
+struct ErrorTrapHooks {
+  void (*push)(Display* display);
+  int (*pop)(Display* display);
+};
+
+// Swallows X errors for its lifetime instead of letting the default
+// handler exit the process: windows can disappear between any two
+// requests. The handler is process-wide, so errors on other connections
+// used meanwhile (e.g. by worker threads) are caught too; only
+// |display| is synced by Failed() and Clear().
+//
+// With |hooks|, the trap goes through them instead and leaves the process
+// handler alone, which a toolkit owning |display| relies on.
+class ErrorTrap {
+ public:
+  explicit ErrorTrap(Display* display,
+                     const ErrorTrapHooks* hooks = nullptr);
+  ~ErrorTrap();
+
+  ErrorTrap(const ErrorTrap&) = delete;
+  ErrorTrap& operator=(const ErrorTrap&) = delete;
+
+  // True if a request since construction or the last Clear() failed.
+  bool Failed();
+
+  void Clear();
+
+ private:
+  Display* display_;
+  const ErrorTrapHooks* hooks_;
+  XErrorHandler previous_ = nullptr;
+  // Errors popped from |hooks_| by Failed(), which pushes a fresh trap.
+  bool failed_ = false;
+};
+
+// Creates a SHM segment of at least |bytes| and asks the server to attach
+// it. Returns false if the segment could not be created; a failed attach
+// (a remote server) only shows up as an X error afterwards.
+bool AttachSegment(Display* display, size_t bytes, XShmSegmentInfo* segment);
+
+// Detaches and frees a segment made by AttachSegment. No-op for a segment
+// whose shmid is negative.
+void DetachSegment(Display* display, XShmSegmentInfo* segment);
+
+// Converts a ZPixmap image of a |depth|-bit drawable to BGRA, writing it
+// into |frame| with its top-left corner at (|x|, |y|). The frame must be
+// large enough. Returns false for images without color masks.
+bool CopyImageToFrame(const XImage* image, int depth,
+                      desktop_screenshot::Frame* frame, int x, int y);
+
+#endif  // DESKTOP_SCREENSHOT_LINUX_X11_UTIL_H_
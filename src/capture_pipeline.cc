@@ -0,0 +1,164 @@
+#include "capture_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "frame_hash.h"
+#include "parallel.h"
+#include "scale.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+// One output size of a region, scaled once for every output that wants it.
+struct Intermediate {
+  int width = 0;
+  int height = 0;
+  Frame scaled;
+  // |scaled|, or the region itself when no scaling is needed.
+  const Frame* pixels = nullptr;
+};
+
+struct RegionGroup {
+  Rect rect;
+  // Empty when the region is the whole capture.
+  Frame crop;
+  // Largest first, so smaller sizes can be derived from larger ones.
+  std::vector<Intermediate> sizes;
+  int crops = 0;
+  int scales = 0;
+};
+
+bool SameRect(const Rect& a, const Rect& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height;
+}
+
+// Builds the crop and every scaled size of |group|.
+void BuildGroup(const Frame& frame, RegionGroup* group) {
+  const Frame* source = &frame;
+  if (!SameRect(group->rect, Rect{0, 0, frame.width, frame.height})) {
+    group->crop = CropFrame(frame, group->rect);
+    source = &group->crop;
+    ++group->crops;
+  }
+  for (size_t k = 0; k < group->sizes.size(); ++k) {
+    Intermediate& size = group->sizes[k];
+    if (size.width == source->width && size.height == source->height) {
+      size.pixels = source;
+      continue;
+    }
+    // The smallest larger size that is still at least twice as big.
+    const Frame* base = source;
+    for (size_t j = k; j-- > 0;) {
+      const Intermediate& larger = group->sizes[j];
+      if (larger.width >= 2 * size.width && larger.height >= 2 * size.height) {
+        base = larger.pixels;
+        break;
+      }
+    }
+    size.scaled = ScaleFrame(*base, size.width, size.height);
+    size.pixels = &size.scaled;
+    ++group->scales;
+  }
+}
+
+}  // namespace
+
+bool RunCapturePipeline(const Frame& frame,
+                        const std::vector<PipelineOutput>& outputs,
+                        const FrameEncoder& encode,
+                        std::vector<PipelineResult>* results,
+                        PipelineStats* stats) {
+  results->assign(outputs.size(), PipelineResult{});
+
+  // Resolves every output to a region and a size, and collects the
+  // distinct ones.
+  std::vector<Rect> rects(outputs.size());
+  std::vector<Intermediate> targets(outputs.size());
+  std::vector<RegionGroup> groups;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    const PipelineOutput& output = outputs[i];
+    Rect rect = output.region.IsEmpty()
+                    ? Rect{0, 0, frame.width, frame.height}
+                    : ClampRect(output.region, frame.width, frame.height);
+    rects[i] = rect;
+    if (rect.IsEmpty()) continue;
+    const double scale =
+        output.scale > 0 && output.scale < 1 ? output.scale : 1.0;
+    Intermediate& target = targets[i];
+    target.width =
+        std::max(1, static_cast<int>(std::lround(rect.width * scale)));
+    target.height =
+        std::max(1, static_cast<int>(std::lround(rect.height * scale)));
+
+    auto group = std::find_if(
+        groups.begin(), groups.end(),
+        [&](const RegionGroup& g) { return SameRect(g.rect, rect); });
+    if (group == groups.end()) {
+      groups.emplace_back();
+      group = groups.end() - 1;
+      group->rect = rect;
+    }
+    auto same_size = [&](const Intermediate& size) {
+      return size.width == target.width && size.height == target.height;
+    };
+    if (std::none_of(group->sizes.begin(), group->sizes.end(), same_size)) {
+      group->sizes.emplace_back();
+      group->sizes.back().width = target.width;
+      group->sizes.back().height = target.height;
+    }
+  }
+  for (RegionGroup& group : groups) {
+    std::sort(group.sizes.begin(), group.sizes.end(),
+              [](const Intermediate& a, const Intermediate& b) {
+                return static_cast<int64_t>(a.width) * a.height >
+                       static_cast<int64_t>(b.width) * b.height;
+              });
+  }
+
+  ParallelFor(groups.size(),
+              [&](size_t g) { BuildGroup(frame, &groups[g]); });
+
+  // Points each output at its intermediate.
+  std::vector<const Frame*> sources(outputs.size(), nullptr);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    if (rects[i].IsEmpty()) continue;
+    for (const RegionGroup& group : groups) {
+      if (!SameRect(group.rect, rects[i])) continue;
+      for (const Intermediate& size : group.sizes) {
+        if (size.width == targets[i].width &&
+            size.height == targets[i].height) {
+          sources[i] = size.pixels;
+        }
+      }
+    }
+  }
+
+  std::atomic<bool> failed{false};
+  ParallelFor(outputs.size(), [&](size_t i) {
+    const Frame* pixels = sources[i];
+    if (!pixels) return;
+    PipelineResult& result = (*results)[i];
+    result.width = pixels->width;
+    result.height = pixels->height;
+    if (outputs[i].product == PipelineProduct::kFingerprint) {
+      result.fingerprint = HashFrame(*pixels);
+    } else if (!encode(*pixels, outputs[i].format, &result.bytes)) {
+      failed = true;
+    }
+  });
+
+  if (stats) {
+    *stats = PipelineStats{};
+    for (const RegionGroup& group : groups) {
+      stats->crops += group.crops;
+      stats->scales += group.scales;
+    }
+  }
+  return !failed;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,73 @@
+#ifndef DESKTOP_SCREENSHOT_CAPTURE_PIPELINE_H_
+#define DESKTOP_SCREENSHOT_CAPTURE_PIPELINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frame.h"
+#include "image_format.h"
+
+namespace desktop_screenshot {
+
+// What a pipeline output produces from its part of the capture.
+enum class PipelineProduct {
+  // Encoded image bytes.
+  kImage,
+  // HashFrame() of the pixels, for cheap change detection.
+  kFingerprint,
+};
+
+// One output of a pipeline capture.
+struct PipelineOutput {
+  PipelineProduct product = PipelineProduct::kImage;
+  // For kImage only.
+  ImageFormat format = ImageFormat::kPng;
+  // Part of the capture to use, in capture coordinates. Empty means the
+  // whole capture.
+  Rect region;
+  // Output size relative to the region, in (0, 1]; other values mean 1.
+  double scale = 1;
+};
+
+// What one output produced.
+struct PipelineResult {
+  std::vector<uint8_t> bytes;
+  uint64_t fingerprint = 0;
+  // Size of the scaled region; zero when the region misses the capture,
+  // in which case nothing is produced.
+  int width = 0;
+  int height = 0;
+};
+
+// Intermediates the pipeline built, for tests and tuning.
+struct PipelineStats {
+  int crops = 0;
+  int scales = 0;
+};
+
+// Encodes a frame into |out|. Supplied by the platform; called from pool
+// workers, several at once.
+using FrameEncoder = std::function<bool(const Frame& frame, ImageFormat format,
+                                        std::vector<uint8_t>* out)>;
+
+// Produces every output in |outputs| from the single capture |frame|.
+//
+// Outputs that name the same region share one crop, and outputs of the same
+// region and size share one scaled copy, so a PNG and a fingerprint of the
+// same thumbnail scale it once. Smaller sizes are derived from a larger
+// intermediate of the same region when that one is at least twice the size,
+// which reads fewer pixels than going back to the full crop. The crops and
+// scales of different regions run concurrently on the task pool, then all
+// the encodes and fingerprints do.
+//
+// Returns false if an encode failed.
+bool RunCapturePipeline(const Frame& frame,
+                        const std::vector<PipelineOutput>& outputs,
+                        const FrameEncoder& encode,
+                        std::vector<PipelineResult>* results,
+                        PipelineStats* stats = nullptr);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_CAPTURE_PIPELINE_H_
@@ -0,0 +1,57 @@
+#include "chunk_writer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace desktop_screenshot {
+
+ChunkWriter::ChunkWriter(size_t chunk_size, Sink sink, MemoryLedger* ledger)
+    : chunk_size_(std::max<size_t>(chunk_size, 1)),
+      sink_(std::move(sink)),
+      ledger_(ledger) {
+  // A chunk size past the whole encoding is a request for one chunk, not
+  // for that much memory up front.
+  pending_.reserve(std::min(chunk_size_, size_t{kDefaultChunkSize}));
+  Recharge();
+}
+
+void ChunkWriter::Write(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  total_bytes_ += size;
+  // Large writes bypass the buffer once it has been drained.
+  if (!pending_.empty()) {
+    size_t take = std::min(size, chunk_size_ - pending_.size());
+    pending_.insert(pending_.end(), bytes, bytes + take);
+    bytes += take;
+    size -= take;
+    Recharge();
+    if (pending_.size() < chunk_size_) return;
+    Emit(pending_.data(), pending_.size());
+    pending_.clear();
+  }
+  if (size >= chunk_size_) {
+    Emit(bytes, size);
+  } else {
+    pending_.insert(pending_.end(), bytes, bytes + size);
+    Recharge();
+  }
+}
+
+void ChunkWriter::Finish() {
+  if (pending_.empty()) return;
+  Emit(pending_.data(), pending_.size());
+  pending_.clear();
+}
+
+void ChunkWriter::Recharge() {
+  if (!ledger_ || charge_.bytes() == pending_.capacity()) return;
+  charge_.Reset();
+  charge_ = ledger_->Charge(MemoryStage::kEncode, pending_.capacity());
+}
+
+void ChunkWriter::Emit(const uint8_t* data, size_t size) {
+  ++chunks_;
+  sink_(data, size);
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,54 @@
+#ifndef DESKTOP_SCREENSHOT_CHUNK_WRITER_H_
+#define DESKTOP_SCREENSHOT_CHUNK_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "memory_ledger.h"
+
+namespace desktop_screenshot {
+
+// Collects an encoder's output and hands it to |sink| in chunks of at least
+// |chunk_size| bytes as soon as that much is available. Encoders write in
+// many small pieces (a PNG chunk header, its data, its CRC), and each
+// platform message has a fixed cost, so streaming them one by one would
+// cost more than it saves.
+class ChunkWriter {
+ public:
+  typedef std::function<void(const uint8_t* data, size_t size)> Sink;
+
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  // With a |ledger|, the bytes held back for the next chunk are charged to
+  // it as encoder output.
+  ChunkWriter(size_t chunk_size, Sink sink, MemoryLedger* ledger = nullptr);
+
+  ChunkWriter(const ChunkWriter&) = delete;
+  ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+  void Write(const void* data, size_t size);
+
+  // Emits whatever is still buffered. Call once, after the encoder is done.
+  void Finish();
+
+  uint64_t total_bytes() const { return total_bytes_; }
+  int chunks() const { return chunks_; }
+
+ private:
+  void Emit(const uint8_t* data, size_t size);
+  void Recharge();
+
+  size_t chunk_size_;
+  Sink sink_;
+  MemoryLedger* const ledger_;
+  MemoryCharge charge_;
+  std::vector<uint8_t> pending_;
+  uint64_t total_bytes_ = 0;
+  int chunks_ = 0;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_CHUNK_WRITER_H_
@@ -0,0 +1,189 @@
+#include "encode_budget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "scale.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr int kTile = 64;
+constexpr int kGrid = 4;
+// Real encodes per capture, counting the first: a miss on the byte limit
+// is retried with cheaper settings at most this many times minus one.
+constexpr int kMaxEncodes = 3;
+// Weight of the newest frame in the learned corrections.
+constexpr double kLearningRate = 0.5;
+
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+bool Fits(double bytes, double ms, const EncodeBudget& budget) {
+  return (budget.max_bytes == 0 || bytes <= budget.max_bytes) &&
+         (budget.max_encode_ms <= 0 || ms <= budget.max_encode_ms);
+}
+
+Frame ScaleBy(const Frame& frame, int scale) {
+  return ScaleFrame(frame, std::max(frame.width / scale, 1),
+                    std::max(frame.height / scale, 1));
+}
+
+}  // namespace
+
+Frame SampleMosaic(const Frame& frame, int scale, double* fraction) {
+  const int source_tile = kTile * scale;
+  const double scaled_pixels = static_cast<double>(frame.width / scale) *
+                               (frame.height / scale);
+  const double mosaic_pixels = kTile * kTile * kGrid * kGrid;
+  if (frame.width < source_tile * kGrid || frame.height < source_tile * kGrid ||
+      scaled_pixels <= 4 * mosaic_pixels) {
+    *fraction = 1;
+    return scale == 1 ? frame : ScaleBy(frame, scale);
+  }
+
+  Frame mosaic;
+  mosaic.Allocate(kTile * kGrid, kTile * kGrid);
+  for (int gy = 0; gy < kGrid; ++gy) {
+    for (int gx = 0; gx < kGrid; ++gx) {
+      // Tiles sit in the middle of each grid cell.
+      int x = (2 * gx + 1) * frame.width / (2 * kGrid) - source_tile / 2;
+      int y = (2 * gy + 1) * frame.height / (2 * kGrid) - source_tile / 2;
+      x = std::min(std::max(x, 0), frame.width - source_tile);
+      y = std::min(std::max(y, 0), frame.height - source_tile);
+      Frame tile = CropFrame(frame, Rect{x, y, source_tile, source_tile});
+      if (scale > 1) tile = ScaleFrame(tile, kTile, kTile);
+      for (int row = 0; row < kTile; ++row) {
+        std::memcpy(mosaic.Row(gy * kTile + row) + gx * kTile * 4,
+                    tile.Row(row), kTile * 4);
+      }
+    }
+  }
+  *fraction = mosaic_pixels / scaled_pixels;
+  return mosaic;
+}
+
+BudgetPlanner::BudgetPlanner() {
+  // Best first. Lossless PNG, palette-reduced PNG, JPEG, then smaller JPEG.
+  ladder_ = {
+      {ImageFormat::kPng, 6, PaletteMode::kExact, 1},
+      {ImageFormat::kPng, 6, PaletteMode::kOff, 1},
+      {ImageFormat::kPng, 1, PaletteMode::kOff, 1},
+      {ImageFormat::kPng, 6, PaletteMode::kQuantize, 1},
+      {ImageFormat::kJpeg, 90, PaletteMode::kOff, 1},
+      {ImageFormat::kJpeg, 75, PaletteMode::kOff, 1},
+      {ImageFormat::kJpeg, 60, PaletteMode::kOff, 1},
+      {ImageFormat::kJpeg, 75, PaletteMode::kOff, 2},
+      {ImageFormat::kJpeg, 60, PaletteMode::kOff, 3},
+      {ImageFormat::kJpeg, 50, PaletteMode::kOff, 4},
+  };
+  models_.resize(ladder_.size());
+}
+
+bool BudgetPlanner::Predict(const Frame& frame, size_t index,
+                            const SettingsEncoder& encode,
+                            std::vector<Sample>* samples, Prediction* out) {
+  const EncodeSettings& settings = ladder_[index];
+  Model& model = models_[index];
+  std::vector<uint8_t> bytes;
+  if (model.overhead_bytes < 0) {
+    // Headers and tables do not grow with the image, so they are kept out
+    // of the extrapolation.
+    Frame tiny;
+    tiny.Allocate(8, 8);
+    if (!encode(tiny, settings, &bytes)) return false;
+    model.overhead_bytes = static_cast<double>(bytes.size());
+  }
+
+  Sample& sample = (*samples)[settings.scale - 1];
+  if (sample.fraction == 0) {
+    sample.mosaic = SampleMosaic(frame, settings.scale, &sample.fraction);
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (!encode(sample.mosaic, settings, &bytes)) return false;
+  const double ms = ElapsedMs(start);
+
+  const double payload =
+      std::max(static_cast<double>(bytes.size()) - model.overhead_bytes, 0.0);
+  out->bytes = (model.overhead_bytes + payload / sample.fraction) *
+               model.size_correction;
+  out->ms = ms / sample.fraction * model.time_correction;
+  return true;
+}
+
+void BudgetPlanner::Learn(size_t index, const Prediction& predicted,
+                          double bytes, double ms) {
+  Model& model = models_[index];
+  // The prediction already includes the current correction, so the
+  // corrected value the frame asked for is correction * actual / predicted.
+  auto update = [](double correction, double actual, double expected) {
+    double target = correction * actual / std::max(expected, 1e-3);
+    double next = correction + kLearningRate * (target - correction);
+    return std::min(std::max(next, 0.125), 8.0);
+  };
+  model.size_correction = update(model.size_correction, bytes, predicted.bytes);
+  model.time_correction = update(model.time_correction, ms, predicted.ms);
+}
+
+bool BudgetPlanner::EncodeWithinBudget(const Frame& frame,
+                                       const EncodeBudget& budget,
+                                       const SettingsEncoder& encode,
+                                       BudgetResult* result) {
+  const bool limited = budget.max_bytes > 0 || budget.max_encode_ms > 0;
+  std::vector<Sample> samples(4);
+  result->trials = 0;
+
+  // Searches down from |from| for the first candidate predicted to fit;
+  // the last one is taken when nothing does.
+  size_t index = 0;
+  Prediction predicted;
+  auto search = [&](size_t from) {
+    for (index = from; index < ladder_.size(); ++index) {
+      if (!Predict(frame, index, encode, &samples, &predicted)) return false;
+      ++result->trials;
+      if (Fits(predicted.bytes, predicted.ms, budget)) break;
+    }
+    index = std::min(index, ladder_.size() - 1);
+    return true;
+  };
+  if (limited && !search(last_choice_ > 0 ? last_choice_ - 1 : 0)) {
+    return false;
+  }
+
+  for (int attempt = 1;; ++attempt) {
+    const EncodeSettings& settings = ladder_[index];
+    auto start = std::chrono::steady_clock::now();
+    Frame scaled;
+    if (settings.scale > 1) scaled = ScaleBy(frame, settings.scale);
+    const Frame& output = settings.scale > 1 ? scaled : frame;
+    if (!encode(output, settings, &result->bytes)) return false;
+    const double ms = ElapsedMs(start);
+
+    result->settings = settings;
+    result->width = output.width;
+    result->height = output.height;
+    result->encode_ms = ms;
+    result->within_budget =
+        Fits(static_cast<double>(result->bytes.size()), ms, budget);
+    if (!limited) break;
+    Learn(index, predicted, static_cast<double>(result->bytes.size()), ms);
+
+    const bool bytes_fit =
+        budget.max_bytes == 0 || result->bytes.size() <= budget.max_bytes;
+    if (bytes_fit || attempt == kMaxEncodes ||
+        index + 1 == ladder_.size()) {
+      break;
+    }
+    // The correction just learned makes the next predictions honest.
+    if (!search(index + 1)) return false;
+  }
+  last_choice_ = index;
+  return true;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,119 @@
+#ifndef DESKTOP_SCREENSHOT_ENCODE_BUDGET_H_
+#define DESKTOP_SCREENSHOT_ENCODE_BUDGET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frame.h"
+#include "image_format.h"
+#include "palette.h"
+
+namespace desktop_screenshot {
+
+// One combination of encoder settings the budgeted mode can pick.
+struct EncodeSettings {
+  ImageFormat format = ImageFormat::kPng;
+  // zlib level (0-9) for PNG, quality (1-100) for JPEG.
+  int level = 6;
+  // For PNG only. kExact stays truecolor on frames with too many colors.
+  PaletteMode palette = PaletteMode::kOff;
+  // The output is 1/|scale| of the capture in each dimension.
+  int scale = 1;
+};
+
+// Limits for one capture. Zero means no limit.
+struct EncodeBudget {
+  size_t max_bytes = 0;
+  double max_encode_ms = 0;
+};
+
+// Encodes |frame| (already scaled) with |settings|. Supplied by the
+// platform, whose codecs write JPEG and truecolor PNG.
+using SettingsEncoder = std::function<bool(
+    const Frame& frame, const EncodeSettings& settings,
+    std::vector<uint8_t>* out)>;
+
+// What EncodeWithinBudget produced.
+struct BudgetResult {
+  EncodeSettings settings;
+  std::vector<uint8_t> bytes;
+  int width = 0;
+  int height = 0;
+  // Scaling, palette reduction and encoding of the final output.
+  double encode_ms = 0;
+  // Sample encodes spent choosing the settings.
+  int trials = 0;
+  // False when even the cheapest settings missed |max_bytes| or the
+  // encode took longer than |max_encode_ms|.
+  bool within_budget = true;
+};
+
+// Picks encoder settings that fit a byte and time budget, learning from
+// the frames it has encoded.
+//
+// The candidates form a ladder from best to cheapest: lossless PNG (palette,
+// then truecolor at two zlib levels), quantized PNG, JPEG at falling
+// quality and finally downscaled JPEG. For a new frame each candidate is
+// trial-encoded on a mosaic of 16 tiles sampled across the frame, and the
+// result is extrapolated by pixel count. Every real encode then updates a
+// per-candidate correction (actual over predicted size and time), so the
+// tile sample's bias on this kind of content is learned after a frame or
+// two. The search starts one step above the previous choice, so a steady
+// screen costs about two small trial encodes.
+class BudgetPlanner {
+ public:
+  BudgetPlanner();
+
+  BudgetPlanner(const BudgetPlanner&) = delete;
+  BudgetPlanner& operator=(const BudgetPlanner&) = delete;
+
+  // Encodes |frame| with the best settings predicted to fit |budget|. If
+  // the output is still over |max_bytes|, steps down the ladder and
+  // encodes again, at most twice, so the byte limit holds unless nothing
+  // can meet it. Returns false if |encode| failed.
+  bool EncodeWithinBudget(const Frame& frame, const EncodeBudget& budget,
+                          const SettingsEncoder& encode, BudgetResult* result);
+
+  const std::vector<EncodeSettings>& candidates() const { return ladder_; }
+
+ private:
+  struct Model {
+    // Output bytes for a header-only image, measured once.
+    double overhead_bytes = -1;
+    // Learned actual / predicted ratios; 1 until the first real encode.
+    double size_correction = 1;
+    double time_correction = 1;
+  };
+  struct Prediction {
+    double bytes = 0;
+    double ms = 0;
+  };
+  // Trial mosaics of the current frame, built once per scale factor.
+  struct Sample {
+    Frame mosaic;
+    double fraction = 0;
+  };
+
+  // Trial-encodes the sample for candidate |index| and extrapolates.
+  bool Predict(const Frame& frame, size_t index, const SettingsEncoder& encode,
+               std::vector<Sample>* samples, Prediction* out);
+  void Learn(size_t index, const Prediction& predicted, double bytes,
+             double ms);
+
+  std::vector<EncodeSettings> ladder_;
+  std::vector<Model> models_;
+  // Ladder index picked for the previous frame.
+  size_t last_choice_ = 0;
+};
+
+// Builds the trial sample for |frame| at 1/|scale|: 4 x 4 tiles of 64 x 64
+// output pixels from evenly spread cells. Frames too small to sample are
+// returned whole (scaled). |*fraction| is the share of the scaled frame's
+// pixels in the sample.
+Frame SampleMosaic(const Frame& frame, int scale, double* fraction);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_ENCODE_BUDGET_H_
@@ -0,0 +1,81 @@
+#include "encode_cache.h"
+
+#include <sstream>
+#include <utility>
+
+namespace desktop_screenshot {
+
+bool EncodeCache::Lookup(const std::string& params, uint64_t frame_hash,
+                         std::vector<uint8_t>* out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->params != params) continue;
+    entries_.splice(entries_.begin(), entries_, it);
+    if (it->frame_hash != frame_hash) break;
+    ++hits_;
+    *out = it->bytes;
+    return true;
+  }
+  ++misses_;
+  return false;
+}
+
+void EncodeCache::Store(const std::string& params, uint64_t frame_hash,
+                        std::vector<uint8_t> bytes) {
+  if (bytes.empty()) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->params == params) {
+      entries_.erase(it);
+      break;
+    }
+  }
+  entries_.push_front(Entry{params, frame_hash, std::move(bytes)});
+  if (entries_.size() > kMaxEntries) entries_.pop_back();
+  Recharge();
+}
+
+void EncodeCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  hits_ = 0;
+  misses_ = 0;
+  Recharge();
+}
+
+void EncodeCache::Recharge() {
+  if (!ledger_) return;
+  size_t bytes = 0;
+  for (const Entry& entry : entries_) bytes += entry.bytes.capacity();
+  charge_.Reset();
+  charge_ = ledger_->Charge(MemoryStage::kEncode, bytes);
+}
+
+uint64_t EncodeCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t EncodeCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+size_t EncodeCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::string EncodeParamsKey(ImageFormat format, PaletteMode palette,
+                            const std::vector<Redaction>& redactions) {
+  std::ostringstream key;
+  key << ImageFormatName(format) << '/' << static_cast<int>(palette);
+  for (const Redaction& r : redactions) {
+    key << '/' << r.rect.x << ',' << r.rect.y << ',' << r.rect.width << ','
+        << r.rect.height << ',' << static_cast<int>(r.mode) << ',' << r.color
+        << ',' << r.strength;
+  }
+  return key.str();
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,74 @@
+#ifndef DESKTOP_SCREENSHOT_ENCODE_CACHE_H_
+#define DESKTOP_SCREENSHOT_ENCODE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "image_format.h"
+#include "memory_ledger.h"
+#include "palette.h"
+#include "redaction.h"
+
+namespace desktop_screenshot {
+
+// Remembers the last encoded output for each distinct set of encode
+// parameters, keyed by the content hash of the frame it was made from.
+// A static screen then costs a grab and a hash instead of an encode.
+class EncodeCache {
+ public:
+  // Parameter sets remembered at once; the least recently used is dropped.
+  static constexpr size_t kMaxEntries = 4;
+
+  // Charges the cached bytes to |ledger|'s encode stage, if given, for as
+  // long as they are kept.
+  explicit EncodeCache(MemoryLedger* ledger = nullptr) : ledger_(ledger) {}
+
+  EncodeCache(const EncodeCache&) = delete;
+  EncodeCache& operator=(const EncodeCache&) = delete;
+
+  // Copies the cached bytes into |out| and returns true if |params| was
+  // last encoded from a frame hashing to |frame_hash|. Counts a hit or miss.
+  bool Lookup(const std::string& params, uint64_t frame_hash,
+              std::vector<uint8_t>* out);
+
+  // Records |bytes| as the output for |params| and |frame_hash|. Empty
+  // bytes (a failed encode) are not recorded.
+  void Store(const std::string& params, uint64_t frame_hash,
+             std::vector<uint8_t> bytes);
+
+  void Clear();
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::string params;
+    uint64_t frame_hash;
+    std::vector<uint8_t> bytes;
+  };
+
+  // Charges what |entries_| hold now. Called with |mutex_| held.
+  void Recharge();
+
+  MemoryLedger* const ledger_;
+  mutable std::mutex mutex_;
+  // Most recently used at the front.
+  std::list<Entry> entries_;
+  MemoryCharge charge_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+// Serializes everything besides the frame that affects the encoded bytes.
+std::string EncodeParamsKey(ImageFormat format, PaletteMode palette,
+                            const std::vector<Redaction>& redactions);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_ENCODE_CACHE_H_
@@ -0,0 +1,39 @@
+#include "frame.h"
+
+#include <cstring>
+
+namespace desktop_screenshot {
+
+Rect BoundingRect(const std::vector<Rect>& rects) {
+  Rect bounds;
+  bool first = true;
+  for (const Rect& rect : rects) {
+    if (rect.IsEmpty()) continue;
+    if (first) {
+      bounds = rect;
+      first = false;
+      continue;
+    }
+    int right = std::max(bounds.x + bounds.width, rect.x + rect.width);
+    int bottom = std::max(bounds.y + bounds.height, rect.y + rect.height);
+    bounds.x = std::min(bounds.x, rect.x);
+    bounds.y = std::min(bounds.y, rect.y);
+    bounds.width = right - bounds.x;
+    bounds.height = bottom - bounds.y;
+  }
+  return bounds;
+}
+
+Frame CropFrame(const Frame& frame, const Rect& rect) {
+  Frame out;
+  Rect clipped = ClampRect(rect, frame.width, frame.height);
+  if (clipped.IsEmpty()) return out;
+  out.Allocate(clipped.width, clipped.height);
+  for (int y = 0; y < clipped.height; ++y) {
+    std::memcpy(out.Row(y), frame.Row(clipped.y + y) + clipped.x * 4,
+                out.stride);
+  }
+  return out;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,63 @@
+#ifndef DESKTOP_SCREENSHOT_FRAME_H_
+#define DESKTOP_SCREENSHOT_FRAME_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace desktop_screenshot {
+
+// A rectangle in frame coordinates (pixels, origin at the top-left corner).
+struct Rect {
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+
+  bool IsEmpty() const { return width <= 0 || height <= 0; }
+};
+
+// Returns |rect| clipped to a |width| x |height| frame.
+inline Rect ClampRect(const Rect& rect, int width, int height) {
+  int left = std::max(rect.x, 0);
+  int top = std::max(rect.y, 0);
+  int right = std::min(rect.x + rect.width, width);
+  int bottom = std::min(rect.y + rect.height, height);
+  if (right <= left || bottom <= top) return Rect{};
+  return Rect{left, top, right - left, bottom - top};
+}
+
+// A captured image held as top-down 32-bit BGRA rows of |stride| bytes.
+// This is the layout GDI produces for 32bpp DIBs and X11 for 24/32-bit
+// visuals, so both platforms can fill it without a channel swizzle.
+struct Frame {
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  std::vector<uint8_t> pixels;
+
+  void Allocate(int w, int h) {
+    width = w;
+    height = h;
+    stride = w * 4;
+    pixels.resize(static_cast<size_t>(stride) * h);
+  }
+
+  bool IsEmpty() const { return width <= 0 || height <= 0; }
+
+  uint8_t* Row(int y) { return pixels.data() + static_cast<size_t>(y) * stride; }
+  const uint8_t* Row(int y) const {
+    return pixels.data() + static_cast<size_t>(y) * stride;
+  }
+};
+
+// Returns the smallest rectangle containing every non-empty rect in |rects|,
+// or an empty rect if there are none.
+Rect BoundingRect(const std::vector<Rect>& rects);
+
+// Copies |rect| (clipped to the frame) out of |frame| into a new frame.
+Frame CropFrame(const Frame& frame, const Rect& rect);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_FRAME_H_
@@ -0,0 +1,160 @@
+#include "frame_hash.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DESKTOP_SCREENSHOT_SSE2 1
+#endif
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr size_t kStripe = 64;
+constexpr size_t kStripesPerBlock = 16;
+constexpr uint64_t kPrime32 = 0x9E3779B1u;
+constexpr uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+
+alignas(16) constexpr uint64_t kKeys[8] = {
+    0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull,
+    0x1F67B3B7A4A44072ull, 0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull,
+    0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull};
+
+inline uint64_t Load64(const uint8_t* p) {
+  uint64_t value;
+  std::memcpy(&value, p, 8);
+  return value;
+}
+
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+struct Accumulators {
+  __m128i lanes[4];
+
+  void Init() {
+    lanes[0] = _mm_set_epi64x(static_cast<long long>(kPrime64a), 0);
+    lanes[1] = _mm_set_epi64x(static_cast<long long>(kPrime64b),
+                              static_cast<long long>(kPrime32));
+    lanes[2] = _mm_set_epi64x(static_cast<long long>(kPrime64a ^ kPrime64b),
+                              static_cast<long long>(kPrime64b * 3));
+    lanes[3] = _mm_set_epi64x(static_cast<long long>(kPrime32 * 5),
+                              static_cast<long long>(kPrime64a * 7));
+  }
+
+  void Stripe(const uint8_t* p) {
+    for (int i = 0; i < 4; ++i) {
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + i);
+      __m128i key = _mm_load_si128(reinterpret_cast<const __m128i*>(kKeys) + i);
+      __m128i mixed = _mm_xor_si128(data, key);
+      // low 32 bits times high 32 bits of every 64-bit lane.
+      __m128i product =
+          _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+      // acc[i ^ 1] += data[i]: swap the two 64-bit halves.
+      __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+    }
+  }
+
+  void Scramble() {
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32));
+    for (int i = 0; i < 4; ++i) {
+      __m128i key = _mm_load_si128(reinterpret_cast<const __m128i*>(kKeys) + i);
+      __m128i acc = _mm_xor_si128(lanes[i], _mm_srli_epi64(lanes[i], 47));
+      acc = _mm_xor_si128(acc, key);
+      __m128i lo = _mm_mul_epu32(acc, prime);
+      __m128i hi = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+      lanes[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+  }
+
+  void Store(uint64_t out[8]) const {
+    for (int i = 0; i < 4; ++i) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out) + i, lanes[i]);
+    }
+  }
+};
+#else
+struct Accumulators {
+  uint64_t lanes[8];
+
+  void Init() {
+    const uint64_t init[8] = {0,
+                              kPrime64a,
+                              kPrime32,
+                              kPrime64b,
+                              kPrime64b * 3,
+                              kPrime64a ^ kPrime64b,
+                              kPrime64a * 7,
+                              kPrime32 * 5};
+    std::memcpy(lanes, init, sizeof(lanes));
+  }
+
+  void Stripe(const uint8_t* p) {
+    for (int i = 0; i < 8; ++i) {
+      uint64_t data = Load64(p + i * 8);
+      uint64_t mixed = data ^ kKeys[i];
+      lanes[i ^ 1] += data;
+      lanes[i] += (mixed & 0xFFFFFFFFu) * (mixed >> 32);
+    }
+  }
+
+  void Scramble() {
+    for (int i = 0; i < 8; ++i) {
+      uint64_t acc = lanes[i] ^ (lanes[i] >> 47);
+      acc ^= kKeys[i];
+      lanes[i] = acc * kPrime32;
+    }
+  }
+
+  void Store(uint64_t out[8]) const { std::memcpy(out, lanes, sizeof(lanes)); }
+};
+#endif
+
+inline uint64_t Avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ull;
+  h ^= h >> 32;
+  return h;
+}
+
+}  // namespace
+
+uint64_t HashBytes(const void* data, size_t size) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  Accumulators acc;
+  acc.Init();
+
+  size_t stripes = size / kStripe;
+  for (size_t s = 0; s < stripes; ++s) {
+    acc.Stripe(p + s * kStripe);
+    if ((s + 1) % kStripesPerBlock == 0) acc.Scramble();
+  }
+  size_t tail = size - stripes * kStripe;
+  if (tail > 0) {
+    alignas(16) uint8_t last[kStripe] = {};
+    std::memcpy(last, p + stripes * kStripe, tail);
+    acc.Stripe(last);
+  }
+
+  uint64_t lanes[8];
+  acc.Store(lanes);
+  uint64_t h = static_cast<uint64_t>(size) * kPrime64a;
+  for (int i = 0; i < 8; i += 2) {
+    uint64_t a = lanes[i] ^ kKeys[i];
+    uint64_t b = lanes[i + 1] ^ kKeys[i + 1];
+    h += Avalanche(a * kPrime64b + (b ^ (b >> 29)));
+    h = (h << 27 | h >> 37) * kPrime64a;
+  }
+  return Avalanche(h);
+}
+
+uint64_t HashFrame(const Frame& frame) {
+  uint64_t h = HashBytes(frame.pixels.data(), frame.pixels.size());
+  uint64_t size = static_cast<uint64_t>(frame.width) << 32 |
+                  static_cast<uint32_t>(frame.height);
+  return Avalanche(h ^ (size * kPrime64b));
+}
+
+}  // namespace desktop_screenshot
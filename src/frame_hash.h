@@ -0,0 +1,22 @@
+#ifndef DESKTOP_SCREENSHOT_FRAME_HASH_H_
+#define DESKTOP_SCREENSHOT_FRAME_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// 64-bit non-cryptographic hash built like XXH3's long-input loop: eight
+// 64-bit accumulators fed 64-byte stripes with a 32x32->64 multiply, which
+// maps directly onto SSE2's pmuludq. The SSE2 and portable paths produce
+// identical values. Not compatible with the reference XXH3 output.
+uint64_t HashBytes(const void* data, size_t size);
+
+// Hashes a frame's dimensions and pixels.
+uint64_t HashFrame(const Frame& frame);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_FRAME_HASH_H_
@@ -0,0 +1,146 @@
+#include "frame_message.h"
+
+#include <cstring>
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr uint8_t kRequestMagic[4] = {'D', 'S', 'F', 'Q'};
+constexpr uint8_t kMessageMagic[4] = {'D', 'S', 'F', 'M'};
+constexpr uint8_t kVersion = 1;
+
+void Put32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void Put64(uint8_t* p, uint64_t value) {
+  for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t Get32(const uint8_t* p) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(p[i]) << (8 * i);
+  return value;
+}
+
+uint64_t Get64(const uint8_t* p) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+  return value;
+}
+
+bool KnownPayload(uint8_t value) {
+  return value <= static_cast<uint8_t>(FramePayload::kPixels);
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeFrameRequest(const FrameRequest& request) {
+  std::vector<uint8_t> out(kFrameRequestSize, 0);
+  std::memcpy(out.data(), kRequestMagic, 4);
+  out[4] = kVersion;
+  out[5] = static_cast<uint8_t>(request.payload);
+  return out;
+}
+
+bool ParseFrameRequest(const uint8_t* data, size_t size,
+                       FrameRequest* request) {
+  if (size < kFrameRequestSize || std::memcmp(data, kRequestMagic, 4) != 0 ||
+      data[4] != kVersion || !KnownPayload(data[5])) {
+    return false;
+  }
+  request->payload = static_cast<FramePayload>(data[5]);
+  return true;
+}
+
+void WriteFrameMessageHeader(const FrameMessageHeader& header, uint8_t* out) {
+  std::memset(out, 0, kFrameMessageHeaderSize);
+  std::memcpy(out, kMessageMagic, 4);
+  out[4] = kVersion;
+  out[5] = static_cast<uint8_t>(header.payload);
+  out[6] = static_cast<uint8_t>(header.status);
+  Put32(out + 8, header.width);
+  Put32(out + 12, header.height);
+  Put64(out + 16, header.timestamp_ns);
+  Put32(out + 24, header.size);
+}
+
+bool ReadFrameMessageHeader(const uint8_t* data, size_t size,
+                            FrameMessageHeader* header) {
+  if (size < kFrameMessageHeaderSize ||
+      std::memcmp(data, kMessageMagic, 4) != 0 || data[4] != kVersion ||
+      !KnownPayload(data[5])) {
+    return false;
+  }
+  header->payload = static_cast<FramePayload>(data[5]);
+  header->status = static_cast<FrameStatus>(data[6]);
+  header->width = Get32(data + 8);
+  header->height = Get32(data + 12);
+  header->timestamp_ns = Get64(data + 16);
+  header->size = Get32(data + 24);
+  return header->size <= size - kFrameMessageHeaderSize;
+}
+
+std::vector<uint8_t> BuildPixelMessage(const Frame& frame,
+                                       uint64_t timestamp_ns) {
+  const size_t row_bytes = static_cast<size_t>(frame.width) * 4;
+  const size_t payload = row_bytes * frame.height;
+  // The zero fill of the payload is cheap next to the copy that follows.
+  std::vector<uint8_t> out(kFrameMessageHeaderSize + payload);
+  FrameMessageHeader header;
+  header.payload = FramePayload::kPixels;
+  header.width = static_cast<uint32_t>(frame.width);
+  header.height = static_cast<uint32_t>(frame.height);
+  header.timestamp_ns = timestamp_ns;
+  header.size = static_cast<uint32_t>(payload);
+  WriteFrameMessageHeader(header, out.data());
+  uint8_t* dst = out.data() + kFrameMessageHeaderSize;
+  if (frame.stride == static_cast<int>(row_bytes)) {
+    std::memcpy(dst, frame.pixels.data(), payload);
+  } else {
+    for (int y = 0; y < frame.height; ++y, dst += row_bytes) {
+      std::memcpy(dst, frame.Row(y), row_bytes);
+    }
+  }
+  return out;
+}
+
+void WrapEncodedMessage(FrameMessageHeader header,
+                        std::vector<uint8_t>* message) {
+  header.size =
+      static_cast<uint32_t>(message->size() - kFrameMessageHeaderSize);
+  WriteFrameMessageHeader(header, message->data());
+}
+
+std::vector<uint8_t> BuildFrameErrorMessage(FramePayload payload,
+                                            FrameStatus status) {
+  std::vector<uint8_t> out(kFrameMessageHeaderSize);
+  FrameMessageHeader header;
+  header.payload = payload;
+  header.status = status;
+  WriteFrameMessageHeader(header, out.data());
+  return out;
+}
+
+bool FramePayloadFormat(FramePayload payload, ImageFormat* format) {
+  switch (payload) {
+    case FramePayload::kPng:
+      *format = ImageFormat::kPng;
+      return true;
+    case FramePayload::kJpeg:
+      *format = ImageFormat::kJpeg;
+      return true;
+    case FramePayload::kBmp:
+      *format = ImageFormat::kBmp;
+      return true;
+    case FramePayload::kRaw:
+      *format = ImageFormat::kRaw;
+      return true;
+    case FramePayload::kPixels:
+    default:
+      return false;
+  }
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,105 @@
+#ifndef DESKTOP_SCREENSHOT_FRAME_MESSAGE_H_
+#define DESKTOP_SCREENSHOT_FRAME_MESSAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+#include "image_format.h"
+
+namespace desktop_screenshot {
+
+// Binary protocol of the "desktop_screenshot/frames" message channel. It
+// carries frames as a fixed header followed by the payload in a single
+// buffer, so neither side builds codec containers around the bytes.
+
+// What a frame message carries.
+enum class FramePayload : uint8_t {
+  kPng = 0,
+  kJpeg = 1,
+  kBmp = 2,
+  // The raw-frame container (see raw_frame.h).
+  kRaw = 3,
+  // Unencoded BGRA rows, width * 4 bytes each.
+  kPixels = 4,
+};
+
+enum class FrameStatus : uint8_t {
+  kOk = 0,
+  kBadRequest = 1,
+  kCaptureFailed = 2,
+  kEncodeFailed = 3,
+};
+
+// A request from Dart. Little-endian layout:
+//
+//   0  "DSFQ"          magic
+//   4  u8  version     1
+//   5  u8  payload     FramePayload
+//   6  u16 reserved
+constexpr size_t kFrameRequestSize = 8;
+
+struct FrameRequest {
+  FramePayload payload = FramePayload::kPixels;
+};
+
+// The reply. Little-endian layout:
+//
+//   0  "DSFM"          magic
+//   4  u8  version     1
+//   5  u8  payload     FramePayload
+//   6  u8  status      FrameStatus; no payload unless kOk
+//   7  u8  reserved
+//   8  u32 width
+//  12  u32 height
+//  16  u64 timestamp   capture time, nanoseconds since the Unix epoch
+//  24  u32 size        payload bytes that follow the header
+//  28  u32 reserved
+//  32  payload
+constexpr size_t kFrameMessageHeaderSize = 32;
+
+struct FrameMessageHeader {
+  FramePayload payload = FramePayload::kPixels;
+  FrameStatus status = FrameStatus::kOk;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint64_t timestamp_ns = 0;
+  uint32_t size = 0;
+};
+
+std::vector<uint8_t> EncodeFrameRequest(const FrameRequest& request);
+
+// Returns false if |data| is not a request of a known version and payload.
+bool ParseFrameRequest(const uint8_t* data, size_t size,
+                       FrameRequest* request);
+
+void WriteFrameMessageHeader(const FrameMessageHeader& header, uint8_t* out);
+
+// Returns false if |data| does not start with a valid header or is shorter
+// than the payload it announces.
+bool ReadFrameMessageHeader(const uint8_t* data, size_t size,
+                            FrameMessageHeader* header);
+
+// Builds a kPixels message, copying |frame| row by row straight behind the
+// header into one allocation.
+std::vector<uint8_t> BuildPixelMessage(const Frame& frame,
+                                       uint64_t timestamp_ns);
+
+// Turns |message| into a message by writing the header into its first
+// kFrameMessageHeaderSize bytes, which the encoder of |header.payload|
+// left free in front of the image so the image is never moved. Updates
+// |header.size|.
+void WrapEncodedMessage(FrameMessageHeader header,
+                        std::vector<uint8_t>* message);
+
+// A header-only reply reporting |status|.
+std::vector<uint8_t> BuildFrameErrorMessage(FramePayload payload,
+                                            FrameStatus status);
+
+// The image format of an encoded payload. False for kPixels.
+bool FramePayloadFormat(FramePayload payload, ImageFormat* format);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_FRAME_MESSAGE_H_
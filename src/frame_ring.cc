@@ -0,0 +1,244 @@
+#include "frame_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x52534453;  // "SDSR"
+constexpr uint32_t kVersion = 1;
+constexpr int kReadAttempts = 8;
+
+// The C++14 spelling of std::atomic<T>::is_always_lock_free.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(long long) == 8,
+              "frame ring counters must be lock-free to live in shared memory");
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(int) == 4,
+              "frame ring counters must be lock-free to live in shared memory");
+
+constexpr size_t RoundUp(size_t value) { return (value + 63) & ~size_t(63); }
+
+struct FrameRingLayout {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  // Set by the writer's destructor; readers stop returning frames.
+  std::atomic<uint32_t> closed;
+  uint64_t slot_capacity;
+  // Sequence number of the newest complete frame; 0 before the first one.
+  std::atomic<uint64_t> latest;
+};
+
+struct SlotHeader {
+  // Seqlock counter: odd while the writer is filling the slot.
+  std::atomic<uint32_t> lock;
+  int32_t width;
+  int32_t height;
+  int32_t stride;
+  uint64_t sequence;
+  uint64_t timestamp_ns;
+};
+
+size_t SlotStride(uint64_t capacity) {
+  return RoundUp(sizeof(SlotHeader)) + RoundUp(capacity);
+}
+
+size_t MappingSize(uint32_t slot_count, uint64_t capacity) {
+  return RoundUp(sizeof(FrameRingLayout)) + slot_count * SlotStride(capacity);
+}
+
+SlotHeader* SlotAt(void* base, int slot) {
+  auto* layout = static_cast<FrameRingLayout*>(base);
+  return reinterpret_cast<SlotHeader*>(static_cast<uint8_t*>(base) +
+                                       RoundUp(sizeof(FrameRingLayout)) +
+                                       slot * SlotStride(layout->slot_capacity));
+}
+
+const SlotHeader* SlotAt(const void* base, int slot) {
+  return SlotAt(const_cast<void*>(base), slot);
+}
+
+uint8_t* SlotPixels(SlotHeader* slot) {
+  return reinterpret_cast<uint8_t*>(slot) + RoundUp(sizeof(SlotHeader));
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Writer
+
+std::unique_ptr<FrameRingWriter> FrameRingWriter::Create(
+    const std::string& name, int slot_count, size_t slot_capacity) {
+  if (slot_count < 2) return nullptr;
+  size_t size = MappingSize(static_cast<uint32_t>(slot_count), slot_capacity);
+
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) return nullptr;
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  // ftruncate zero-fills, so every slot starts unlocked and empty.
+  auto* layout = static_cast<FrameRingLayout*>(base);
+  layout->version = kVersion;
+  layout->slot_count = static_cast<uint32_t>(slot_count);
+  layout->slot_capacity = slot_capacity;
+  layout->latest.store(0, std::memory_order_relaxed);
+  layout->closed.store(0, std::memory_order_relaxed);
+  // Readers check the magic last, so publish it after everything else.
+  std::atomic_thread_fence(std::memory_order_release);
+  layout->magic = kMagic;
+
+  return std::unique_ptr<FrameRingWriter>(
+      new FrameRingWriter(name, base, size));
+}
+
+FrameRingWriter::FrameRingWriter(std::string name, void* base, size_t size)
+    : name_(std::move(name)), base_(base), size_(size) {}
+
+FrameRingWriter::~FrameRingWriter() {
+  static_cast<FrameRingLayout*>(base_)->closed.store(
+      1, std::memory_order_release);
+  munmap(base_, size_);
+  shm_unlink(name_.c_str());
+}
+
+bool FrameRingWriter::Publish(const Frame& frame, uint64_t timestamp_ns) {
+  auto* layout = static_cast<FrameRingLayout*>(base_);
+  if (frame.pixels.size() > layout->slot_capacity) return false;
+
+  uint64_t sequence = sequence_ + 1;
+  SlotHeader* slot = SlotAt(base_, static_cast<int>(sequence % layout->slot_count));
+
+  uint32_t lock = slot->lock.load(std::memory_order_relaxed);
+  slot->lock.store(lock + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->width = frame.width;
+  slot->height = frame.height;
+  slot->stride = frame.stride;
+  slot->sequence = sequence;
+  slot->timestamp_ns = timestamp_ns;
+  std::memcpy(SlotPixels(slot), frame.pixels.data(), frame.pixels.size());
+
+  slot->lock.store(lock + 2, std::memory_order_release);
+  layout->latest.store(sequence, std::memory_order_release);
+  sequence_ = sequence;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+
+std::unique_ptr<FrameRingReader> FrameRingReader::Open(
+    const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return nullptr;
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(FrameRingLayout)) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return nullptr;
+
+  const auto* layout = static_cast<const FrameRingLayout*>(base);
+  bool valid = layout->magic == kMagic;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && layout->version == kVersion && layout->slot_count >= 2 &&
+          MappingSize(layout->slot_count, layout->slot_capacity) <= size;
+  if (!valid) {
+    munmap(base, size);
+    return nullptr;
+  }
+  return std::unique_ptr<FrameRingReader>(
+      new FrameRingReader(name, base, size));
+}
+
+FrameRingReader::FrameRingReader(std::string name, const void* base,
+                                 size_t size)
+    : name_(std::move(name)), base_(base), size_(size) {}
+
+FrameRingReader::~FrameRingReader() {
+  munmap(const_cast<void*>(base_), size_);
+}
+
+bool FrameRingReader::AcquireLatest(View* view) const {
+  const auto* layout = static_cast<const FrameRingLayout*>(base_);
+  if (closed()) return false;
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    uint64_t sequence = layout->latest.load(std::memory_order_acquire);
+    if (sequence == 0) return false;
+    int index = static_cast<int>(sequence % layout->slot_count);
+    const SlotHeader* slot = SlotAt(base_, index);
+
+    uint32_t lock = slot->lock.load(std::memory_order_acquire);
+    if (lock & 1) continue;
+    View candidate;
+    candidate.width = slot->width;
+    candidate.height = slot->height;
+    candidate.stride = slot->stride;
+    candidate.sequence = slot->sequence;
+    candidate.timestamp_ns = slot->timestamp_ns;
+    candidate.slot = index;
+    candidate.lock = lock;
+    candidate.pixels = SlotPixels(const_cast<SlotHeader*>(slot));
+    if (candidate.sequence != sequence || !StillValid(candidate)) continue;
+    if (static_cast<uint64_t>(candidate.stride) * candidate.height >
+        layout->slot_capacity) {
+      return false;
+    }
+    *view = candidate;
+    return true;
+  }
+  return false;
+}
+
+bool FrameRingReader::StillValid(const View& view) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return SlotAt(base_, view.slot)->lock.load(std::memory_order_relaxed) ==
+         view.lock;
+}
+
+bool FrameRingReader::closed() const {
+  return static_cast<const FrameRingLayout*>(base_)->closed.load(
+             std::memory_order_acquire) != 0;
+}
+
+bool FrameRingReader::ReadLatest(Frame* frame, uint64_t* sequence) const {
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    View view;
+    if (!AcquireLatest(&view)) return false;
+    frame->width = view.width;
+    frame->height = view.height;
+    frame->stride = view.stride;
+    frame->pixels.assign(view.pixels,
+                         view.pixels + static_cast<size_t>(view.stride) * view.height);
+    if (StillValid(view)) {
+      if (sequence) *sequence = view.sequence;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,106 @@
+#ifndef DESKTOP_SCREENSHOT_FRAME_RING_H_
+#define DESKTOP_SCREENSHOT_FRAME_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// A POSIX shared-memory ring of BGRA frames with one writer (the capture
+// daemon) and any number of reader processes.
+//
+// Every slot is guarded by a seqlock: the writer makes the slot's counter
+// odd while it is writing and even again when done, so readers never block
+// the writer and detect torn reads by comparing the counter before and
+// after. With N slots a reader has N - 1 frame periods to finish with a
+// frame before the writer comes back around to it.
+
+class FrameRingWriter {
+ public:
+  // Creates (or replaces) the shared-memory object |name| (e.g.
+  // "/desktop_screenshot") with |slot_count| slots of up to
+  // |slot_capacity| pixel bytes each. Returns nullptr on failure.
+  static std::unique_ptr<FrameRingWriter> Create(const std::string& name,
+                                                 int slot_count,
+                                                 size_t slot_capacity);
+
+  // Marks the ring closed for its readers, then unmaps and unlinks the
+  // shared-memory object.
+  ~FrameRingWriter();
+
+  FrameRingWriter(const FrameRingWriter&) = delete;
+  FrameRingWriter& operator=(const FrameRingWriter&) = delete;
+
+  // Copies |frame| into the next slot and makes it the latest frame.
+  // Returns false if the frame does not fit a slot.
+  bool Publish(const Frame& frame, uint64_t timestamp_ns);
+
+  uint64_t published() const { return sequence_; }
+
+ private:
+  FrameRingWriter(std::string name, void* base, size_t size);
+
+  std::string name_;
+  void* base_;
+  size_t size_;
+  uint64_t sequence_ = 0;
+};
+
+class FrameRingReader {
+ public:
+  // A frame mapped in place. |pixels| points into shared memory and is only
+  // meaningful until the writer reuses the slot; check StillValid() after
+  // consuming it.
+  struct View {
+    const uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    uint64_t sequence = 0;
+    uint64_t timestamp_ns = 0;
+    int slot = 0;
+    uint32_t lock = 0;
+  };
+
+  // Maps the existing ring |name| read-only. Returns nullptr if it does not
+  // exist or is not a frame ring.
+  static std::unique_ptr<FrameRingReader> Open(const std::string& name);
+
+  ~FrameRingReader();
+
+  FrameRingReader(const FrameRingReader&) = delete;
+  FrameRingReader& operator=(const FrameRingReader&) = delete;
+
+  // Maps the newest complete frame without copying. Returns false if
+  // nothing has been published yet or the writer kept overtaking us.
+  bool AcquireLatest(View* view) const;
+
+  // True if the slot behind |view| has not been rewritten since
+  // AcquireLatest returned it.
+  bool StillValid(const View& view) const;
+
+  // Copies the newest complete frame into |frame|.
+  bool ReadLatest(Frame* frame, uint64_t* sequence) const;
+
+  // True once the writer has gone away, e.g. because the daemon replaced
+  // the ring with a larger one under the same name. Open() the name again
+  // to follow it.
+  bool closed() const;
+
+  const std::string& name() const { return name_; }
+
+ private:
+  FrameRingReader(std::string name, const void* base, size_t size);
+
+  std::string name_;
+  const void* base_;
+  size_t size_;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_FRAME_RING_H_
@@ -0,0 +1,61 @@
+#include "frame_store.h"
+
+#include <utility>
+
+namespace desktop_screenshot {
+
+int64_t FrameStore::Put(Frame frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int64_t handle = next_handle_++;
+  memory_used_ += frame.pixels.size();
+  lru_.push_front(
+      Entry{handle, std::make_shared<const Frame>(std::move(frame))});
+  index_[handle] = lru_.begin();
+  EvictLocked();
+  return handle;
+}
+
+std::shared_ptr<const Frame> FrameStore::Get(int64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(handle);
+  if (it == index_.end()) return nullptr;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->frame;
+}
+
+bool FrameStore::Release(int64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(handle);
+  if (it == index_.end()) return false;
+  memory_used_ -= it->second->frame->pixels.size();
+  lru_.erase(it->second);
+  index_.erase(it);
+  return true;
+}
+
+void FrameStore::SetMemoryLimit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  memory_limit_ = bytes;
+  EvictLocked();
+}
+
+size_t FrameStore::memory_used() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_used_;
+}
+
+size_t FrameStore::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lru_.size();
+}
+
+void FrameStore::EvictLocked() {
+  while (memory_used_ > memory_limit_ && lru_.size() > 1) {
+    const Entry& victim = lru_.back();
+    memory_used_ -= victim.frame->pixels.size();
+    index_.erase(victim.handle);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,67 @@
+#ifndef DESKTOP_SCREENSHOT_FRAME_STORE_H_
+#define DESKTOP_SCREENSHOT_FRAME_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// Keeps captured frames alive behind integer handles so that cropping,
+// scaling and encoding can be deferred until Dart actually asks for them.
+//
+// Frames that are never released are evicted least-recently-used first
+// once their combined size exceeds the memory limit. The most recently
+// stored frame is never evicted, even if it alone exceeds the limit.
+class FrameStore {
+ public:
+  static constexpr size_t kDefaultMemoryLimit = 512u * 1024 * 1024;
+
+  explicit FrameStore(size_t memory_limit = kDefaultMemoryLimit)
+      : memory_limit_(memory_limit) {}
+
+  FrameStore(const FrameStore&) = delete;
+  FrameStore& operator=(const FrameStore&) = delete;
+
+  // Takes ownership of |frame| and returns its handle (always > 0).
+  int64_t Put(Frame frame);
+
+  // Returns the frame for |handle| and marks it most recently used, or
+  // nullptr if it was released or evicted.
+  std::shared_ptr<const Frame> Get(int64_t handle);
+
+  // Drops |handle|. Returns false if it was unknown.
+  bool Release(int64_t handle);
+
+  // Changes the limit and evicts immediately if the store is over it.
+  void SetMemoryLimit(size_t bytes);
+
+  size_t memory_used() const;
+  size_t size() const;
+
+ private:
+  struct Entry {
+    int64_t handle;
+    std::shared_ptr<const Frame> frame;
+  };
+
+  // Requires |mutex_| to be held.
+  void EvictLocked();
+
+  mutable std::mutex mutex_;
+  size_t memory_limit_;
+  size_t memory_used_ = 0;
+  int64_t next_handle_ = 1;
+  // Most recently used at the front.
+  std::list<Entry> lru_;
+  std::unordered_map<int64_t, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_FRAME_STORE_H_
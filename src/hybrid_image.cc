@@ -0,0 +1,288 @@
+#include "hybrid_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "parallel.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'D', 'S', 'H', 'Y'};
+constexpr uint8_t kVersion = 1;
+// What the lossless tiles of the photo layer are flattened to.
+constexpr uint8_t kPhotoFill = 0x80;
+
+void Put16(uint8_t* p, uint16_t value) {
+  p[0] = static_cast<uint8_t>(value);
+  p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void Put32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint16_t Get16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+uint32_t Get32(const uint8_t* p) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(p[i]) << (8 * i);
+  return value;
+}
+
+int Luma(const uint8_t* bgra) {
+  return (bgra[0] + bgra[1] * 5 + bgra[2] * 2) >> 3;
+}
+
+// Tile |index| of a grid of |columns| |tile|-pixel tiles, clipped to the
+// frame.
+Rect TileRect(size_t index, int columns, int tile, int width, int height) {
+  const int column = static_cast<int>(index % columns);
+  const int row = static_cast<int>(index / columns);
+  return ClampRect(Rect{column * tile, row * tile, tile, tile}, width, height);
+}
+
+// Fills |rect| of |frame| with one byte value.
+void FillRect(Frame* frame, const Rect& rect, uint8_t value) {
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    std::memset(frame->Row(y) + rect.x * 4, value,
+                static_cast<size_t>(rect.width) * 4);
+  }
+}
+
+// Copies |rect| of |src|, whose top-left corner is at (|src_x|, |src_y|),
+// into the same place of |dst|.
+void CopyRect(const Frame& src, int src_x, int src_y, const Rect& rect,
+              Frame* dst) {
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    std::memcpy(dst->Row(y) + rect.x * 4,
+                src.Row(y - src_y) + (rect.x - src_x) * 4,
+                static_cast<size_t>(rect.width) * 4);
+  }
+}
+
+}  // namespace
+
+TileStats MeasureTile(const Frame& frame, const Rect& rect) {
+  TileStats stats;
+  stats.pixels = rect.width * rect.height;
+  // Open addressing over twice the cap keeps probes short; 0 marks a free
+  // slot, so stored colors carry a set top byte.
+  uint32_t seen[TileStats::kColorCap * 2] = {};
+  const uint32_t mask = TileStats::kColorCap * 2 - 1;
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    const uint8_t* row = frame.Row(y) + rect.x * 4;
+    const uint8_t* above = y > rect.y ? row - frame.stride : nullptr;
+    for (int x = 0; x < rect.width; ++x) {
+      const uint8_t* p = row + x * 4;
+      const int luma = Luma(p);
+      if (x > 0 && std::memcmp(p, p - 4, 3) == 0) ++stats.flat;
+      if ((x > 0 && std::abs(luma - Luma(p - 4)) > TileStats::kStrongEdge) ||
+          (above && std::abs(luma - Luma(above + x * 4)) >
+                        TileStats::kStrongEdge)) {
+        ++stats.edges;
+      }
+      if (stats.colors >= TileStats::kColorCap) continue;
+      const uint32_t color =
+          0xFF000000u | p[2] << 16 | p[1] << 8 | static_cast<uint32_t>(p[0]);
+      uint32_t slot = (color * 0x9E3779B1u) >> 22 & mask;
+      while (seen[slot] != 0 && seen[slot] != color) slot = (slot + 1) & mask;
+      if (seen[slot] == 0) {
+        seen[slot] = color;
+        ++stats.colors;
+      }
+    }
+  }
+  return stats;
+}
+
+TileKind ClassifyTile(const TileStats& stats) {
+  if (stats.pixels == 0) return TileKind::kLossless;
+  // A 64x64 tile needs the full cap; small edge tiles proportionally less.
+  const int many_colors = std::min(TileStats::kColorCap, stats.pixels / 8);
+  const bool photo = stats.colors >= many_colors &&
+                     stats.flat * 2 < stats.pixels &&
+                     stats.edges * 8 < stats.pixels;
+  return photo ? TileKind::kPhoto : TileKind::kLossless;
+}
+
+bool EncodeHybridImage(const Frame& frame, const HybridOptions& options,
+                       const SettingsEncoder& encode,
+                       std::vector<uint8_t>* out, HybridStats* stats) {
+  if (frame.IsEmpty()) return false;
+  const int tile =
+      std::min(256, std::max(16, (options.tile_size + 15) / 16 * 16));
+  const int columns = (frame.width + tile - 1) / tile;
+  const int rows = (frame.height + tile - 1) / tile;
+  const size_t count = static_cast<size_t>(columns) * rows;
+
+  std::vector<uint8_t> kinds(count);
+  ParallelForRange(count, 16, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Rect rect = TileRect(i, columns, tile, frame.width, frame.height);
+      kinds[i] = static_cast<uint8_t>(ClassifyTile(MeasureTile(frame, rect)));
+    }
+  });
+
+  int photo_tiles = 0;
+  int left = columns, top = rows, right = 0, bottom = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (kinds[i] != static_cast<uint8_t>(TileKind::kPhoto)) continue;
+    ++photo_tiles;
+    const int column = static_cast<int>(i % columns);
+    const int row = static_cast<int>(i / columns);
+    left = std::min(left, column);
+    top = std::min(top, row);
+    right = std::max(right, column + 1);
+    bottom = std::max(bottom, row + 1);
+  }
+  const Rect photo_rect =
+      photo_tiles == 0
+          ? Rect{}
+          : ClampRect(Rect{left * tile, top * tile, (right - left) * tile,
+                           (bottom - top) * tile},
+                      frame.width, frame.height);
+  const bool has_lossless = photo_tiles < static_cast<int>(count);
+
+  // Black photo tiles cost next to nothing in the PNG, flat lossless tiles
+  // next to nothing in the JPEG.
+  Frame lossless;
+  if (has_lossless && photo_tiles > 0) {
+    lossless = frame;
+    for (size_t i = 0; i < count; ++i) {
+      if (kinds[i] == static_cast<uint8_t>(TileKind::kPhoto)) {
+        FillRect(&lossless,
+                 TileRect(i, columns, tile, frame.width, frame.height), 0);
+      }
+    }
+  }
+  Frame photo;
+  if (photo_tiles > 0) {
+    photo = CropFrame(frame, photo_rect);
+    for (size_t i = 0; i < count; ++i) {
+      if (kinds[i] == static_cast<uint8_t>(TileKind::kPhoto)) continue;
+      Rect rect = TileRect(i, columns, tile, frame.width, frame.height);
+      rect = ClampRect(
+          Rect{rect.x - photo_rect.x, rect.y - photo_rect.y, rect.width,
+               rect.height},
+          photo.width, photo.height);
+      if (!rect.IsEmpty()) FillRect(&photo, rect, kPhotoFill);
+    }
+  }
+
+  EncodeSettings lossless_settings;
+  lossless_settings.format = ImageFormat::kPng;
+  lossless_settings.palette = PaletteMode::kExact;
+  EncodeSettings photo_settings;
+  photo_settings.format = ImageFormat::kJpeg;
+  photo_settings.level = std::min(100, std::max(1, options.quality));
+  std::vector<uint8_t> layers[2];
+  std::atomic<bool> failed(false);
+  ParallelFor(2, [&](size_t i) {
+    bool ok = true;
+    if (i == 0 && has_lossless) {
+      ok = encode(photo_tiles > 0 ? lossless : frame, lossless_settings,
+                  &layers[0]);
+    } else if (i == 1 && photo_tiles > 0) {
+      ok = encode(photo, photo_settings, &layers[1]);
+    }
+    if (!ok) failed = true;
+  });
+  if (failed) return false;
+
+  out->assign(kHybridHeaderSize, 0);
+  uint8_t* header = out->data();
+  std::memcpy(header, kMagic, 4);
+  header[4] = kVersion;
+  header[5] = static_cast<uint8_t>(lossless_settings.format);
+  header[6] = static_cast<uint8_t>(photo_settings.format);
+  Put32(header + 8, static_cast<uint32_t>(frame.width));
+  Put32(header + 12, static_cast<uint32_t>(frame.height));
+  Put16(header + 16, static_cast<uint16_t>(tile));
+  Put32(header + 20, static_cast<uint32_t>(photo_rect.x));
+  Put32(header + 24, static_cast<uint32_t>(photo_rect.y));
+  Put32(header + 28, static_cast<uint32_t>(photo_rect.width));
+  Put32(header + 32, static_cast<uint32_t>(photo_rect.height));
+  Put32(header + 36, static_cast<uint32_t>(layers[0].size()));
+  Put32(header + 40, static_cast<uint32_t>(layers[1].size()));
+  out->insert(out->end(), kinds.begin(), kinds.end());
+  out->insert(out->end(), layers[0].begin(), layers[0].end());
+  out->insert(out->end(), layers[1].begin(), layers[1].end());
+
+  if (stats) {
+    stats->tiles = static_cast<int>(count);
+    stats->photo_tiles = photo_tiles;
+  }
+  return true;
+}
+
+bool DecodeHybridImage(const uint8_t* data, size_t size,
+                       const ImageDecoder& decode, Frame* frame) {
+  if (size < kHybridHeaderSize || std::memcmp(data, kMagic, 4) != 0 ||
+      data[4] != kVersion) {
+    return false;
+  }
+  const uint32_t width = Get32(data + 8);
+  const uint32_t height = Get32(data + 12);
+  const int tile = Get16(data + 16);
+  const Rect photo_rect{static_cast<int>(Get32(data + 20)),
+                        static_cast<int>(Get32(data + 24)),
+                        static_cast<int>(Get32(data + 28)),
+                        static_cast<int>(Get32(data + 32))};
+  const uint64_t lossless_size = Get32(data + 36);
+  const uint64_t photo_size = Get32(data + 40);
+  if (width == 0 || height == 0 || width > 0x7FFF || height > 0x7FFF ||
+      tile == 0) {
+    return false;
+  }
+  const int columns = (static_cast<int>(width) + tile - 1) / tile;
+  const int rows = (static_cast<int>(height) + tile - 1) / tile;
+  const size_t count = static_cast<size_t>(columns) * rows;
+  if (kHybridHeaderSize + count + lossless_size + photo_size != size) {
+    return false;
+  }
+  const uint8_t* kinds = data + kHybridHeaderSize;
+  const uint8_t* lossless_bytes = kinds + count;
+  const uint8_t* photo_bytes = lossless_bytes + lossless_size;
+
+  if (lossless_size > 0) {
+    if (!decode(lossless_bytes, lossless_size, frame) ||
+        frame->width != static_cast<int>(width) ||
+        frame->height != static_cast<int>(height)) {
+      return false;
+    }
+  } else {
+    frame->Allocate(static_cast<int>(width), static_cast<int>(height));
+    std::fill(frame->pixels.begin(), frame->pixels.end(), 0);
+  }
+
+  Frame photo;
+  if (photo_size > 0 &&
+      (!decode(photo_bytes, photo_size, &photo) ||
+       photo.width != photo_rect.width || photo.height != photo_rect.height)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (kinds[i] == static_cast<uint8_t>(TileKind::kLossless)) continue;
+    if (kinds[i] != static_cast<uint8_t>(TileKind::kPhoto)) return false;
+    const Rect rect = TileRect(i, columns, tile, static_cast<int>(width),
+                               static_cast<int>(height));
+    // Every photo tile must lie inside the photo layer.
+    const Rect inside =
+        ClampRect(Rect{rect.x - photo_rect.x, rect.y - photo_rect.y,
+                       rect.width, rect.height},
+                  photo.width, photo.height);
+    if (inside.width != rect.width || inside.height != rect.height) {
+      return false;
+    }
+    CopyRect(photo, photo_rect.x, photo_rect.y, rect, frame);
+  }
+  return true;
+}
+
+}  // namespace desktop_screenshot
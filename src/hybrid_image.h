@@ -0,0 +1,109 @@
+#ifndef DESKTOP_SCREENSHOT_HYBRID_IMAGE_H_
+#define DESKTOP_SCREENSHOT_HYBRID_IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "encode_budget.h"
+#include "frame.h"
+#include "image_format.h"
+
+namespace desktop_screenshot {
+
+// Content-aware encoding for screens that mix text and UI with photos or
+// video. The frame is cut into square tiles; each is classified as
+// lossless (text, UI, flat areas) or photo. Lossless tiles go into a PNG
+// (indexed when few enough colors remain) with the photo tiles blacked
+// out, photo tiles into a JPEG of their bounding box with the lossless
+// tiles flattened. Tiles are multiples of 16 pixels on a grid anchored at
+// the frame's top-left corner, so no JPEG block, chroma-subsampled or not,
+// straddles a tile border and text next to a photo stays pixel-exact.
+
+enum class TileKind : uint8_t {
+  kLossless = 0,
+  kPhoto = 1,
+};
+
+// Measurements the classifier bases its decision on.
+struct TileStats {
+  int pixels = 0;
+  // Distinct colors, counted up to kColorCap.
+  int colors = 0;
+  // Pixels equal to their left neighbour.
+  int flat = 0;
+  // Pixels whose luma differs from the left or upper neighbour by more
+  // than kStrongEdge: glyph and widget borders.
+  int edges = 0;
+
+  static constexpr int kColorCap = 512;
+  static constexpr int kStrongEdge = 48;
+};
+
+struct HybridOptions {
+  // Tile edge in pixels; rounded up to a multiple of 16 between 16 and 256.
+  int tile_size = 64;
+  // JPEG quality (1-100) of the photo tiles.
+  int quality = 80;
+};
+
+// Measures |rect| of |frame|.
+TileStats MeasureTile(const Frame& frame, const Rect& rect);
+
+// Photo tiles have many colors, few repeated neighbours and few sharp
+// edges; everything else is lossless.
+TileKind ClassifyTile(const TileStats& stats);
+
+// The hybrid container. Little-endian layout:
+//
+//   0  "DSHY"              magic
+//   4  u8  version         1
+//   5  u8  lossless format ImageFormat of the lossless layer
+//   6  u8  photo format    ImageFormat of the photo layer
+//   7  u8  reserved
+//   8  u32 width
+//  12  u32 height
+//  16  u16 tile size
+//  18  u16 reserved
+//  20  u32 photo x         photo layer rect in frame pixels; tile-aligned,
+//  24  u32 photo y         clipped to the frame, empty if no photo tiles
+//  28  u32 photo width
+//  32  u32 photo height
+//  36  u32 lossless size   bytes of the lossless layer; 0 if every tile is
+//                          a photo tile
+//  40  u32 photo size      bytes of the photo layer
+//  44  tile map            one TileKind byte per tile, row by row
+//      lossless layer      width x height image
+//      photo layer         photo width x photo height image
+//
+// Each pixel of the decoded frame comes from the photo layer if its tile
+// is a photo tile, otherwise from the lossless layer.
+constexpr size_t kHybridHeaderSize = 44;
+
+struct HybridStats {
+  int tiles = 0;
+  int photo_tiles = 0;
+};
+
+// Builds the container for |frame|. |encode| writes the two layers (PNG
+// with PaletteMode::kExact, and JPEG at |options.quality|); both run
+// concurrently on the task pool. Returns false if an encode failed.
+bool EncodeHybridImage(const Frame& frame, const HybridOptions& options,
+                       const SettingsEncoder& encode,
+                       std::vector<uint8_t>* out,
+                       HybridStats* stats = nullptr);
+
+// Decodes a PNG or JPEG layer into a BGRA frame. Supplied by the platform.
+using ImageDecoder =
+    std::function<bool(const uint8_t* data, size_t size, Frame* frame)>;
+
+// Decodes a container built by EncodeHybridImage, compositing the photo
+// tiles over the lossless layer. Returns false if |data| is malformed or
+// a layer fails to decode to its announced size.
+bool DecodeHybridImage(const uint8_t* data, size_t size,
+                       const ImageDecoder& decode, Frame* frame);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_HYBRID_IMAGE_H_
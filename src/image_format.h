@@ -0,0 +1,51 @@
+#ifndef DESKTOP_SCREENSHOT_IMAGE_FORMAT_H_
+#define DESKTOP_SCREENSHOT_IMAGE_FORMAT_H_
+
+#include <cstring>
+
+namespace desktop_screenshot {
+
+// Output encodings accepted by the capture methods.
+enum class ImageFormat {
+  kPng,
+  kJpeg,
+  kBmp,
+  // The plugin's own compressed BGRA container (see raw_frame.h).
+  kRaw,
+};
+
+// Parses the Dart-side format name. Returns false for unknown names.
+inline bool ParseImageFormat(const char* name, ImageFormat* format) {
+  if (std::strcmp(name, "png") == 0) {
+    *format = ImageFormat::kPng;
+  } else if (std::strcmp(name, "jpeg") == 0) {
+    *format = ImageFormat::kJpeg;
+  } else if (std::strcmp(name, "bmp") == 0) {
+    *format = ImageFormat::kBmp;
+  } else if (std::strcmp(name, "raw") == 0) {
+    *format = ImageFormat::kRaw;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// The format name as understood by gdk-pixbuf and the Dart API. gdk-pixbuf
+// has no "raw" writer; callers encode kRaw themselves.
+inline const char* ImageFormatName(ImageFormat format) {
+  switch (format) {
+    case ImageFormat::kJpeg:
+      return "jpeg";
+    case ImageFormat::kBmp:
+      return "bmp";
+    case ImageFormat::kRaw:
+      return "raw";
+    case ImageFormat::kPng:
+    default:
+      return "png";
+  }
+}
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_IMAGE_FORMAT_H_
@@ -0,0 +1,240 @@
+#include "lz4_block.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+// The format requires the last 5 bytes to be literals and the last match
+// to start at least 12 bytes before the end.
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchFindLimit = 12;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 14;
+// After this many consecutive misses the search starts skipping ahead,
+// which keeps incompressible input fast.
+constexpr int kSkipShift = 6;
+
+inline uint32_t Load32(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value;
+}
+
+inline uint64_t Load64(const uint8_t* p) {
+  uint64_t value;
+  std::memcpy(&value, p, 8);
+  return value;
+}
+
+inline uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+inline int CountTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+// Length of the common prefix of |a| and |b|, stopping at |limit| (a
+// pointer into |a|'s buffer). Assumes a little-endian target.
+inline size_t MatchLength(const uint8_t* a, const uint8_t* b,
+                          const uint8_t* limit) {
+  const uint8_t* start = a;
+  while (a + 8 <= limit) {
+    uint64_t diff = Load64(a) ^ Load64(b);
+    if (diff) return (a - start) + (CountTrailingZeros(diff) >> 3);
+    a += 8;
+    b += 8;
+  }
+  while (a < limit && *a == *b) {
+    ++a;
+    ++b;
+  }
+  return a - start;
+}
+
+inline uint8_t* WriteLength(uint8_t* op, size_t length) {
+  length -= 15;
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<uint8_t>(length);
+  return op;
+}
+
+inline uint8_t* WriteLiterals(uint8_t* op, uint8_t* token,
+                              const uint8_t* literals, size_t length) {
+  if (length >= 15) {
+    *token = 0xF0;
+    op = WriteLength(op, length);
+  } else {
+    *token = static_cast<uint8_t>(length << 4);
+  }
+  if (length) std::memcpy(op, literals, length);
+  return op + length;
+}
+
+inline bool ReadLength(const uint8_t** ip, const uint8_t* end,
+                       size_t* length) {
+  uint8_t byte;
+  do {
+    if (*ip >= end) return false;
+    byte = *(*ip)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace
+
+size_t Lz4Compress(const uint8_t* src, size_t size, uint8_t* dst,
+                   size_t capacity) {
+  if (capacity < Lz4CompressBound(size)) return 0;
+  uint8_t* op = dst;
+  const uint8_t* anchor = src;
+  const uint8_t* const end = src + size;
+
+  if (size > kMatchFindLimit) {
+    std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+    const uint8_t* const match_limit = end - kLastLiterals;
+    const uint8_t* const search_limit = end - kMatchFindLimit;
+    const uint8_t* ip = src + 1;
+
+    while (ip < search_limit) {
+      const uint8_t* match = nullptr;
+      unsigned attempts = 1u << kSkipShift;
+      while (ip < search_limit) {
+        uint32_t sequence = Load32(ip);
+        uint32_t& slot = table[Hash(sequence)];
+        const uint8_t* candidate = src + slot;
+        slot = static_cast<uint32_t>(ip - src);
+        if (candidate < ip && static_cast<size_t>(ip - candidate) <= kMaxOffset &&
+            Load32(candidate) == sequence) {
+          match = candidate;
+          break;
+        }
+        ip += attempts++ >> kSkipShift;
+      }
+      if (!match) break;
+
+      while (ip > anchor && match > src && ip[-1] == match[-1]) {
+        --ip;
+        --match;
+      }
+      size_t match_length =
+          MatchLength(ip + kMinMatch, match + kMinMatch, match_limit);
+
+      uint8_t* token = op++;
+      op = WriteLiterals(op, token, anchor, ip - anchor);
+      size_t offset = ip - match;
+      *op++ = static_cast<uint8_t>(offset);
+      *op++ = static_cast<uint8_t>(offset >> 8);
+      if (match_length >= 15) {
+        *token |= 15;
+        op = WriteLength(op, match_length);
+      } else {
+        *token |= static_cast<uint8_t>(match_length);
+      }
+
+      ip += match_length + kMinMatch;
+      anchor = ip;
+      // Index a position inside the match so the next search has a nearby
+      // candidate even when the following bytes repeat it.
+      if (ip < search_limit) {
+        table[Hash(Load32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+      }
+    }
+  }
+
+  uint8_t* token = op++;
+  op = WriteLiterals(op, token, anchor, end - anchor);
+  return op - dst;
+}
+
+bool Lz4Decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                   size_t dst_size) {
+  const uint8_t* ip = src;
+  const uint8_t* const in_end = src + size;
+  uint8_t* op = dst;
+  uint8_t* const out_end = dst + dst_size;
+
+  while (ip < in_end) {
+    unsigned token = *ip++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !ReadLength(&ip, in_end, &literals)) return false;
+    if (literals > static_cast<size_t>(in_end - ip) ||
+        literals > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+    // Short runs are copied as one fixed 16-byte block when both buffers
+    // have the slack; the bytes past the run are overwritten later.
+    if (literals <= 16 && in_end - ip >= 16 && out_end - op >= 16) {
+      std::memcpy(op, ip, 16);
+    } else if (literals) {
+      std::memcpy(op, ip, literals);
+    }
+    op += literals;
+    ip += literals;
+    // The last sequence has literals only.
+    if (ip == in_end) break;
+
+    if (in_end - ip < 2) return false;
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+    size_t length = token & 15;
+    if (length == 15 && !ReadLength(&ip, in_end, &length)) return false;
+    length += kMinMatch;
+    if (length > static_cast<size_t>(out_end - op)) return false;
+
+    const uint8_t* match = op - offset;
+    if (offset >= 16 && static_cast<size_t>(out_end - op) >= length + 16) {
+      // Sixteen bytes at a time, possibly overshooting by up to fifteen.
+      for (size_t i = 0; i < length; i += 16) {
+        std::memcpy(op + i, match + i, 16);
+      }
+    } else if (offset >= 8 && static_cast<size_t>(out_end - op) >= length + 8) {
+      for (size_t i = 0; i < length; i += 8) std::memcpy(op + i, match + i, 8);
+    } else if (static_cast<size_t>(out_end - op) >= length + 8) {
+      // Short period (flat color runs have offset 4): write the first eight
+      // bytes one at a time, then copy from the nearest multiple of the
+      // period that is at least eight bytes back.
+      for (int i = 0; i < 8; ++i) op[i] = match[i];
+      size_t distance = offset * ((8 + offset - 1) / offset);
+      for (size_t i = 8; i < length; i += 8) {
+        std::memcpy(op + i, op + i - distance, 8);
+      }
+    } else if (offset >= length) {
+      std::memcpy(op, match, length);
+    } else {
+      // Overlapping copy (runs): the source span doubles every step and
+      // stays a multiple of |offset|, so each memcpy is non-overlapping.
+      uint8_t* cursor = op;
+      uint8_t* const stop = op + length;
+      while (cursor < stop) {
+        size_t chunk = std::min<size_t>(cursor - match, stop - cursor);
+        std::memcpy(cursor, match, chunk);
+        cursor += chunk;
+      }
+    }
+    op += length;
+  }
+  return op == out_end;
+}
+
+}  // namespace desktop_screenshot
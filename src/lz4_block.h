@@ -0,0 +1,30 @@
+#ifndef DESKTOP_SCREENSHOT_LZ4_BLOCK_H_
+#define DESKTOP_SCREENSHOT_LZ4_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace desktop_screenshot {
+
+// A self-contained codec for the LZ4 block format (no frame headers or
+// checksums): streams it writes decode with the reference LZ4_decompress_safe
+// and vice versa. The compressor is a greedy single-probe matcher like
+// LZ4_compress_fast at acceleration 1.
+
+// Worst-case compressed size of |size| input bytes.
+inline size_t Lz4CompressBound(size_t size) { return size + size / 255 + 16; }
+
+// Compresses |size| bytes into |dst|, which must hold Lz4CompressBound(size)
+// bytes. Returns the compressed size, or 0 if |capacity| is too small.
+size_t Lz4Compress(const uint8_t* src, size_t size, uint8_t* dst,
+                   size_t capacity);
+
+// Decompresses a block that must expand to exactly |dst_size| bytes.
+// Returns false on malformed or truncated input; never reads or writes out
+// of bounds.
+bool Lz4Decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                   size_t dst_size);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_LZ4_BLOCK_H_
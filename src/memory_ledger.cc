@@ -0,0 +1,194 @@
+#include "memory_ledger.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "pixel_pipeline.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+// Thinner stripes cost more in per-grab overhead than they save.
+constexpr int kMinStripeRows = 16;
+
+}  // namespace
+
+const char* MemoryStageName(MemoryStage stage) {
+  switch (stage) {
+    case MemoryStage::kGrab:
+      return "grab";
+    case MemoryStage::kFrame:
+      return "frame";
+    case MemoryStage::kEncode:
+      return "encode";
+    case MemoryStage::kResult:
+      return "result";
+  }
+  return "grab";
+}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& other) noexcept
+    : ledger_(other.ledger_), stage_(other.stage_), bytes_(other.bytes_) {
+  other.ledger_ = nullptr;
+  other.bytes_ = 0;
+}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& other) noexcept {
+  if (this != &other) {
+    Reset();
+    ledger_ = other.ledger_;
+    stage_ = other.stage_;
+    bytes_ = other.bytes_;
+    other.ledger_ = nullptr;
+    other.bytes_ = 0;
+  }
+  return *this;
+}
+
+void MemoryCharge::Grow(size_t bytes) {
+  if (!ledger_) return;
+  ledger_->Add(stage_, bytes);
+  bytes_ += bytes;
+}
+
+void MemoryCharge::Reset() {
+  if (ledger_ && bytes_ > 0) ledger_->Remove(stage_, bytes_);
+  ledger_ = nullptr;
+  bytes_ = 0;
+}
+
+void MemoryLedger::SetLimit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.limit = bytes;
+}
+
+size_t MemoryLedger::limit() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_.limit;
+}
+
+size_t MemoryLedger::Available() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stats_.limit == 0) return std::numeric_limits<size_t>::max();
+  return stats_.limit > stats_.current ? stats_.limit - stats_.current : 0;
+}
+
+MemoryCharge MemoryLedger::Charge(MemoryStage stage, size_t bytes) {
+  Add(stage, bytes);
+  return MemoryCharge(this, stage, bytes);
+}
+
+void MemoryLedger::NoteDegraded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.degraded;
+}
+
+void MemoryLedger::NoteRefused() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.refused;
+}
+
+MemoryStats MemoryLedger::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MemoryLedger::ResetPeaks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.peak = stats_.current;
+  for (MemoryStats::Stage& stage : stats_.stages) stage.peak = stage.current;
+}
+
+MemoryLedger& MemoryLedger::Process() {
+  static MemoryLedger* ledger = new MemoryLedger();
+  return *ledger;
+}
+
+void MemoryLedger::Add(MemoryStage stage, size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MemoryStats::Stage& entry = stats_.stages[static_cast<int>(stage)];
+  entry.current += bytes;
+  entry.peak = std::max(entry.peak, entry.current);
+  stats_.current += bytes;
+  stats_.peak = std::max(stats_.peak, stats_.current);
+}
+
+void MemoryLedger::Remove(MemoryStage stage, size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MemoryStats::Stage& entry = stats_.stages[static_cast<int>(stage)];
+  entry.current -= std::min(entry.current, bytes);
+  stats_.current -= std::min(stats_.current, bytes);
+}
+
+CapturePlan PlanCapture(size_t available, int width, int height,
+                        int grab_bytes_per_pixel, int max_scale) {
+  CapturePlan plan;
+  if (width <= 0 || height <= 0) return plan;
+  const size_t grab_bpp =
+      static_cast<size_t>(std::max(grab_bytes_per_pixel, 0));
+  const size_t frame_bytes = static_cast<size_t>(width) * height * 4;
+  const size_t whole = static_cast<size_t>(width) * height * grab_bpp +
+                       frame_bytes + EncodeReserve(frame_bytes);
+  if (whole <= available) {
+    plan.possible = true;
+    plan.width = width;
+    plan.height = height;
+    return plan;
+  }
+
+  for (int scale = 1; scale <= std::min(max_scale, kMaxCaptureScale);
+       scale *= 2) {
+    const int out_width = width / scale;
+    const int out_height = height / scale;
+    if (out_width == 0 || out_height == 0) break;
+    const size_t out_bytes = static_cast<size_t>(out_width) * out_height * 4;
+    const size_t fixed = out_bytes + EncodeReserve(out_bytes);
+    if (fixed >= available) continue;
+    // A stripe row costs its grab and BGRA copy, plus the box filter's
+    // horizontally scaled row when downscaling.
+    const size_t row_bytes =
+        static_cast<size_t>(out_width) * scale * (grab_bpp + 4) +
+        (scale > 1 ? static_cast<size_t>(out_width) * 4 : 0);
+    const size_t fit = (available - fixed) / row_bytes;
+    int rows = static_cast<int>(
+        std::min(fit, static_cast<size_t>(out_height) * scale));
+    rows -= rows % scale;
+    if (rows < std::max(kMinStripeRows, scale)) continue;
+    plan.possible = true;
+    plan.scale = scale;
+    plan.stripe_rows = rows;
+    plan.width = out_width;
+    plan.height = out_height;
+    return plan;
+  }
+  return plan;
+}
+
+bool CaptureInStripes(const CapturePlan& plan, int width, int height,
+                      const StripeGrabber& grab, Frame* frame) {
+  if (!plan.possible || plan.scale < 1 ||
+      plan.width * plan.scale > width || plan.height * plan.scale > height) {
+    return false;
+  }
+  // Trailing columns and rows that do not fill a whole scale x scale block
+  // are left out.
+  const int covered_width = plan.width * plan.scale;
+  const int covered_height = plan.height * plan.scale;
+  const int rows = plan.stripe_rows > 0 ? plan.stripe_rows : covered_height;
+  frame->Allocate(plan.width, plan.height);
+  Frame stripe;
+  for (int y = 0; y < covered_height; y += rows) {
+    const int count = std::min(rows, covered_height - y);
+    if (!grab(Rect{0, y, covered_width, count}, &stripe) ||
+        stripe.width != covered_width || stripe.height != count) {
+      return false;
+    }
+    ConvertDownscaled<BgraPixels, BgraPixels>(
+        stripe.Row(0), stripe.stride, covered_width, count, plan.scale,
+        frame->Row(y / plan.scale), frame->stride);
+  }
+  return true;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,165 @@
+#ifndef DESKTOP_SCREENSHOT_MEMORY_LEDGER_H_
+#define DESKTOP_SCREENSHOT_MEMORY_LEDGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// Where a capture's buffers are in their life.
+enum class MemoryStage : uint8_t {
+  // What the platform grabs into: the GDI bitmap, the GDK pixbuf, the SHM
+  // segments, one stripe of a striped capture.
+  kGrab = 0,
+  // BGRA frames converted from the grab, and their crops and downscales.
+  kFrame = 1,
+  // Encoder output: PNG/JPEG bytes, GDI+ streams, raw containers.
+  kEncode = 2,
+  // Copies handed to the engine: EncodableValue, FlValue, binary replies.
+  kResult = 3,
+};
+
+constexpr int kMemoryStageCount = 4;
+
+// Lower-case name used on the method channel ("grab", "frame", ...).
+const char* MemoryStageName(MemoryStage stage);
+
+struct MemoryStats {
+  struct Stage {
+    size_t current = 0;
+    size_t peak = 0;
+  };
+
+  size_t current = 0;
+  size_t peak = 0;
+  // Zero when there is no ceiling.
+  size_t limit = 0;
+  Stage stages[kMemoryStageCount];
+  // Captures that only fit striped or downscaled, and captures that did
+  // not fit at all.
+  uint64_t degraded = 0;
+  uint64_t refused = 0;
+};
+
+class MemoryLedger;
+
+// Bytes charged to one stage of a ledger until destroyed or reset.
+class MemoryCharge {
+ public:
+  MemoryCharge() = default;
+  ~MemoryCharge() { Reset(); }
+
+  MemoryCharge(MemoryCharge&& other) noexcept;
+  MemoryCharge& operator=(MemoryCharge&& other) noexcept;
+  MemoryCharge(const MemoryCharge&) = delete;
+  MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+  // Adds |bytes| more to the charge. A default-constructed charge stays
+  // empty.
+  void Grow(size_t bytes);
+
+  // Returns the bytes to the ledger.
+  void Reset();
+
+  size_t bytes() const { return bytes_; }
+
+ private:
+  friend class MemoryLedger;
+  MemoryCharge(MemoryLedger* ledger, MemoryStage stage, size_t bytes)
+      : ledger_(ledger), stage_(stage), bytes_(bytes) {}
+
+  MemoryLedger* ledger_ = nullptr;
+  MemoryStage stage_ = MemoryStage::kGrab;
+  size_t bytes_ = 0;
+};
+
+// Counts the native buffers captures hold, per stage, against an optional
+// process-wide ceiling. The ledger only keeps books: callers charge what
+// they allocate, and PlanCapture below decides beforehand how a capture
+// has to be taken to stay under the ceiling.
+class MemoryLedger {
+ public:
+  MemoryLedger() = default;
+  MemoryLedger(const MemoryLedger&) = delete;
+  MemoryLedger& operator=(const MemoryLedger&) = delete;
+
+  // Zero removes the ceiling. Buffers already charged are not affected.
+  void SetLimit(size_t bytes);
+  size_t limit() const;
+
+  // Bytes that can still be charged under the ceiling; SIZE_MAX without
+  // one.
+  size_t Available() const;
+
+  // Charges |bytes| to |stage|. Charging never fails: by the time a buffer
+  // is charged it exists.
+  MemoryCharge Charge(MemoryStage stage, size_t bytes);
+
+  void NoteDegraded();
+  void NoteRefused();
+
+  MemoryStats Stats() const;
+
+  // Lowers every peak to the current value.
+  void ResetPeaks();
+
+  // The ledger shared by every plugin instance in the process.
+  static MemoryLedger& Process();
+
+ private:
+  friend class MemoryCharge;
+  void Add(MemoryStage stage, size_t bytes);
+  void Remove(MemoryStage stage, size_t bytes);
+
+  mutable std::mutex mutex_;
+  MemoryStats stats_;
+};
+
+// How to grab a |width| x |height| desktop without passing the ceiling.
+struct CapturePlan {
+  // False if not even the smallest striped, downscaled capture fits.
+  bool possible = false;
+  // The frame is 1/|scale| of the desktop in each dimension: 1, 2, 4 or 8.
+  int scale = 1;
+  // Desktop rows grabbed per stripe, a multiple of |scale|; zero grabs the
+  // desktop in one piece.
+  int stripe_rows = 0;
+  // Size of the resulting frame.
+  int width = 0;
+  int height = 0;
+
+  bool degraded() const { return scale > 1 || stripe_rows > 0; }
+};
+
+constexpr int kMaxCaptureScale = 8;
+
+// Picks the cheapest way down within |available| bytes: the whole desktop
+// at once if the grab, the frame and room for its encoding fit; otherwise
+// full size in stripes; otherwise stripes downscaled by 2, 4 or 8, up to
+// |max_scale|. Captures whose pixels must keep desktop coordinates pass
+// a |max_scale| of 1. |grab_bytes_per_pixel| is what the platform's grab
+// buffer costs on top of the BGRA frame.
+CapturePlan PlanCapture(size_t available, int width, int height,
+                        int grab_bytes_per_pixel,
+                        int max_scale = kMaxCaptureScale);
+
+// Room an encode of a |frame_bytes| frame is planned with. Screenshots
+// rarely compress to more than a quarter of their pixels.
+inline size_t EncodeReserve(size_t frame_bytes) { return frame_bytes / 4; }
+
+// Grabs |rect| of the desktop into |stripe|.
+using StripeGrabber = std::function<bool(const Rect& rect, Frame* stripe)>;
+
+// Fills |frame| as |plan| says, one stripe of desktop rows at a time.
+// Each stripe is copied or box-filtered into its rows of |frame| before
+// the next is grabbed, so only one stripe exists at any moment.
+bool CaptureInStripes(const CapturePlan& plan, int width, int height,
+                      const StripeGrabber& grab, Frame* frame);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_MEMORY_LEDGER_H_
@@ -0,0 +1,259 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr uint32_t kOpaque = 0xFF000000u;
+
+inline uint32_t LoadColor(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value | kOpaque;
+}
+
+int BitDepthFor(size_t colors) {
+  if (colors <= 2) return 1;
+  if (colors <= 4) return 2;
+  if (colors <= 16) return 4;
+  return 8;
+}
+
+// 15-bit histogram key: 5 bits each of red, green and blue.
+inline int HistogramKey(uint32_t color) {
+  return static_cast<int>(((color >> 9) & 0x7C00) | ((color >> 6) & 0x03E0) |
+                          ((color >> 3) & 0x001F));
+}
+
+struct Box {
+  int lo[3];  // Inclusive 5-bit bounds for red, green, blue.
+  int hi[3];
+  uint64_t count;
+};
+
+inline int KeyOf(int r, int g, int b) { return (r << 10) | (g << 5) | b; }
+
+// Shrinks |box| to the bins that are actually populated and recounts it.
+void ShrinkBox(const std::vector<uint32_t>& histogram, Box* box) {
+  int lo[3] = {31, 31, 31};
+  int hi[3] = {0, 0, 0};
+  uint64_t count = 0;
+  for (int r = box->lo[0]; r <= box->hi[0]; ++r) {
+    for (int g = box->lo[1]; g <= box->hi[1]; ++g) {
+      for (int b = box->lo[2]; b <= box->hi[2]; ++b) {
+        uint32_t n = histogram[KeyOf(r, g, b)];
+        if (n == 0) continue;
+        count += n;
+        int v[3] = {r, g, b};
+        for (int i = 0; i < 3; ++i) {
+          lo[i] = std::min(lo[i], v[i]);
+          hi[i] = std::max(hi[i], v[i]);
+        }
+      }
+    }
+  }
+  if (count > 0) {
+    std::copy(lo, lo + 3, box->lo);
+    std::copy(hi, hi + 3, box->hi);
+  }
+  box->count = count;
+}
+
+// Splits |box| at the median of its longest axis. Returns false if the box
+// is a single bin.
+bool SplitBox(const std::vector<uint32_t>& histogram, Box* box, Box* other) {
+  int axis = 0;
+  for (int i = 1; i < 3; ++i) {
+    if (box->hi[i] - box->lo[i] > box->hi[axis] - box->lo[axis]) axis = i;
+  }
+  if (box->hi[axis] == box->lo[axis]) return false;
+
+  // Population of each slice along |axis|.
+  uint64_t slices[32] = {};
+  for (int r = box->lo[0]; r <= box->hi[0]; ++r) {
+    for (int g = box->lo[1]; g <= box->hi[1]; ++g) {
+      for (int b = box->lo[2]; b <= box->hi[2]; ++b) {
+        int v[3] = {r, g, b};
+        slices[v[axis]] += histogram[KeyOf(r, g, b)];
+      }
+    }
+  }
+  uint64_t half = box->count / 2;
+  uint64_t running = 0;
+  int cut = box->lo[axis];
+  for (; cut < box->hi[axis] - 1; ++cut) {
+    running += slices[cut];
+    if (running >= half) break;
+  }
+
+  *other = *box;
+  box->hi[axis] = cut;
+  other->lo[axis] = cut + 1;
+  ShrinkBox(histogram, box);
+  ShrinkBox(histogram, other);
+  return true;
+}
+
+}  // namespace
+
+bool ParsePaletteMode(const char* name, PaletteMode* mode) {
+  if (std::strcmp(name, "off") == 0) {
+    *mode = PaletteMode::kOff;
+  } else if (std::strcmp(name, "exact") == 0) {
+    *mode = PaletteMode::kExact;
+  } else if (std::strcmp(name, "quantize") == 0) {
+    *mode = PaletteMode::kQuantize;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* PaletteModeName(PaletteMode mode) {
+  switch (mode) {
+    case PaletteMode::kExact:
+      return "exact";
+    case PaletteMode::kQuantize:
+      return "quantize";
+    case PaletteMode::kOff:
+    default:
+      return "off";
+  }
+}
+
+bool ExtractExactPalette(const Frame& frame, IndexedImage* out) {
+  // Open-addressed table, four times the maximum palette size so probes
+  // stay short. Keys always have the alpha bits set, so 0 marks an empty
+  // slot.
+  constexpr int kSlots = 1024;
+  uint32_t keys[kSlots] = {};
+  uint8_t values[kSlots];
+
+  out->width = frame.width;
+  out->height = frame.height;
+  out->palette.clear();
+  out->indices.resize(static_cast<size_t>(frame.width) * frame.height);
+
+  uint8_t* index = out->indices.data();
+  uint32_t last_color = 0;
+  uint8_t last_index = 0;
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* p = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      uint32_t color = LoadColor(p);
+      // Text and UI rows are mostly long runs of one color.
+      if (color == last_color) {
+        *index++ = last_index;
+        continue;
+      }
+      uint32_t slot = (color * 2654435761u) >> 22;
+      while (keys[slot] != 0 && keys[slot] != color) {
+        slot = (slot + 1) & (kSlots - 1);
+      }
+      if (keys[slot] == 0) {
+        if (out->palette.size() == 256) return false;
+        keys[slot] = color;
+        values[slot] = static_cast<uint8_t>(out->palette.size());
+        out->palette.push_back(color);
+      }
+      last_color = color;
+      last_index = values[slot];
+      *index++ = last_index;
+    }
+  }
+  out->bit_depth = BitDepthFor(out->palette.size());
+  return true;
+}
+
+void QuantizeMedianCut(const Frame& frame, int max_colors, IndexedImage* out) {
+  max_colors = std::min(std::max(max_colors, 2), 256);
+  std::vector<uint32_t> histogram(1 << 15);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* p = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      ++histogram[HistogramKey(LoadColor(p))];
+    }
+  }
+
+  std::vector<Box> boxes;
+  boxes.push_back(Box{{0, 0, 0}, {31, 31, 31}, 0});
+  ShrinkBox(histogram, &boxes[0]);
+  while (static_cast<int>(boxes.size()) < max_colors) {
+    // Split the most populated box that still spans more than one bin.
+    int best = -1;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      const Box& b = boxes[i];
+      bool splittable = b.lo[0] != b.hi[0] || b.lo[1] != b.hi[1] ||
+                        b.lo[2] != b.hi[2];
+      if (splittable && (best < 0 || b.count > boxes[best].count)) {
+        best = static_cast<int>(i);
+      }
+    }
+    if (best < 0) break;
+    Box other;
+    if (!SplitBox(histogram, &boxes[best], &other)) break;
+    boxes.push_back(other);
+  }
+
+  // Each box becomes one palette entry: the population-weighted mean of
+  // its bins. |lookup| maps every populated bin to its entry.
+  std::vector<uint8_t> lookup(1 << 15);
+  out->palette.clear();
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    const Box& box = boxes[i];
+    uint64_t sum[3] = {0, 0, 0};
+    uint64_t total = 0;
+    for (int r = box.lo[0]; r <= box.hi[0]; ++r) {
+      for (int g = box.lo[1]; g <= box.hi[1]; ++g) {
+        for (int b = box.lo[2]; b <= box.hi[2]; ++b) {
+          int key = KeyOf(r, g, b);
+          uint32_t n = histogram[key];
+          if (n == 0) continue;
+          lookup[key] = static_cast<uint8_t>(i);
+          sum[0] += static_cast<uint64_t>((r << 3) | 4) * n;
+          sum[1] += static_cast<uint64_t>((g << 3) | 4) * n;
+          sum[2] += static_cast<uint64_t>((b << 3) | 4) * n;
+          total += n;
+        }
+      }
+    }
+    uint32_t color = kOpaque;
+    if (total > 0) {
+      color |= static_cast<uint32_t>(sum[0] / total) << 16 |
+               static_cast<uint32_t>(sum[1] / total) << 8 |
+               static_cast<uint32_t>(sum[2] / total);
+    }
+    out->palette.push_back(color);
+  }
+
+  out->width = frame.width;
+  out->height = frame.height;
+  out->bit_depth = BitDepthFor(out->palette.size());
+  out->indices.resize(static_cast<size_t>(frame.width) * frame.height);
+  uint8_t* index = out->indices.data();
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* p = frame.Row(y);
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      *index++ = lookup[HistogramKey(LoadColor(p))];
+    }
+  }
+}
+
+bool BuildIndexedImage(const Frame& frame, PaletteMode mode,
+                       IndexedImage* out) {
+  switch (mode) {
+    case PaletteMode::kOff:
+      return false;
+    case PaletteMode::kExact:
+      return ExtractExactPalette(frame, out);
+    case PaletteMode::kQuantize:
+      if (!ExtractExactPalette(frame, out)) QuantizeMedianCut(frame, 256, out);
+      return true;
+  }
+  return false;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,55 @@
+#ifndef DESKTOP_SCREENSHOT_PALETTE_H_
+#define DESKTOP_SCREENSHOT_PALETTE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// How getScreenshot may reduce a frame to an indexed-color PNG.
+enum class PaletteMode {
+  // Always write truecolor.
+  kOff,
+  // Write indexed color only when the frame has at most 256 distinct
+  // colors, which is typical of IDE and terminal screens. Lossless.
+  kExact,
+  // Like kExact, but fall back to median-cut quantization instead of
+  // truecolor when there are more colors. Lossy in that case.
+  kQuantize,
+};
+
+// Parses "off", "exact" or "quantize". Returns false for anything else.
+bool ParsePaletteMode(const char* name, PaletteMode* mode);
+
+// The Dart-side name of |mode|, the inverse of ParsePaletteMode.
+const char* PaletteModeName(PaletteMode mode);
+
+// A frame reduced to at most 256 colors. Alpha is ignored: screen captures
+// are opaque, and GDI leaves the alpha byte undefined.
+struct IndexedImage {
+  int width = 0;
+  int height = 0;
+  // 1, 2, 4 or 8: the smallest PNG bit depth that fits |palette|.
+  int bit_depth = 8;
+  // Colors as 0xAARRGGBB with alpha forced to 0xFF.
+  std::vector<uint32_t> palette;
+  // One palette index per pixel, row-major, |width| * |height| entries.
+  std::vector<uint8_t> indices;
+};
+
+// Builds an indexed image with every distinct color of |frame| in its
+// palette. Bails out and returns false as soon as a 257th color is seen.
+bool ExtractExactPalette(const Frame& frame, IndexedImage* out);
+
+// Reduces |frame| to at most |max_colors| colors by median cut over a
+// 15-bit (5 bits per channel) histogram.
+void QuantizeMedianCut(const Frame& frame, int max_colors, IndexedImage* out);
+
+// Applies |mode|. Returns false if the frame should be written truecolor.
+bool BuildIndexedImage(const Frame& frame, PaletteMode mode, IndexedImage* out);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_PALETTE_H_
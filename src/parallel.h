@@ -0,0 +1,36 @@
+#ifndef DESKTOP_SCREENSHOT_PARALLEL_H_
+#define DESKTOP_SCREENSHOT_PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+
+#include "task_pool.h"
+
+namespace desktop_screenshot {
+
+// Runs |body(begin, end)| over [0, count) in ranges of |grain| indices on
+// the shared task pool. Without one (no plugin instance alive, e.g. in the
+// capture daemon) the whole range runs on the calling thread.
+inline void ParallelForRange(size_t count, size_t grain,
+                             const std::function<void(size_t, size_t)>& body) {
+  TaskPool* pool = TaskPool::Current();
+  if (pool) {
+    pool->Run(count, grain, body);
+  } else if (count > 0) {
+    body(0, count);
+  }
+}
+
+// Runs |fn(i)| for every i in [0, count), one index per task so uneven
+// items balance across the pool. The calling thread takes part and the
+// call returns once every index has been processed.
+template <typename Fn>
+void ParallelFor(size_t count, Fn fn) {
+  ParallelForRange(count, 1, [&fn](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) fn(i);
+  });
+}
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_PARALLEL_H_
@@ -0,0 +1,180 @@
+#ifndef DESKTOP_SCREENSHOT_PIXEL_PIPELINE_H_
+#define DESKTOP_SCREENSHOT_PIXEL_PIPELINE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "parallel.h"
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+// Pixel layouts the capture paths meet, used as template parameters of the
+// row loops below. Read() unpacks one pixel into B, G, R, A order and
+// Write() packs one back, so converting between two layouts compiles to a
+// few byte moves per pixel with nothing decided at run time.
+
+// Frames, and 32-bit images with real alpha.
+struct BgraPixels {
+  static constexpr int kBytes = 4;
+  static void Read(const uint8_t* p, uint8_t* bgra) {
+    std::memcpy(bgra, p, 4);
+  }
+  static void Write(const uint8_t* bgra, uint8_t* p) {
+    std::memcpy(p, bgra, 4);
+  }
+};
+
+// GDI screen DIBs and depth-24 X11 images: the fourth byte is padding, read
+// as opaque and written as 0xFF.
+struct BgrxPixels {
+  static constexpr int kBytes = 4;
+  static void Read(const uint8_t* p, uint8_t* bgra) {
+    bgra[0] = p[0];
+    bgra[1] = p[1];
+    bgra[2] = p[2];
+    bgra[3] = 0xFF;
+  }
+  static void Write(const uint8_t* bgra, uint8_t* p) {
+    p[0] = bgra[0];
+    p[1] = bgra[1];
+    p[2] = bgra[2];
+    p[3] = 0xFF;
+  }
+};
+
+// GdkPixbufs without alpha.
+struct RgbPixels {
+  static constexpr int kBytes = 3;
+  static void Read(const uint8_t* p, uint8_t* bgra) {
+    bgra[0] = p[2];
+    bgra[1] = p[1];
+    bgra[2] = p[0];
+    bgra[3] = 0xFF;
+  }
+  static void Write(const uint8_t* bgra, uint8_t* p) {
+    p[0] = bgra[2];
+    p[1] = bgra[1];
+    p[2] = bgra[0];
+  }
+};
+
+// GdkPixbufs with alpha, and GL textures.
+struct RgbaPixels {
+  static constexpr int kBytes = 4;
+  static void Read(const uint8_t* p, uint8_t* bgra) {
+    bgra[0] = p[2];
+    bgra[1] = p[1];
+    bgra[2] = p[0];
+    bgra[3] = p[3];
+  }
+  static void Write(const uint8_t* bgra, uint8_t* p) {
+    p[0] = bgra[2];
+    p[1] = bgra[1];
+    p[2] = bgra[0];
+    p[3] = bgra[3];
+  }
+};
+
+template <typename Src, typename Dst>
+struct RowConverter {
+  static void Run(const uint8_t* src, uint8_t* dst, int width) {
+    uint8_t bgra[4];
+    for (int x = 0; x < width; ++x, src += Src::kBytes, dst += Dst::kBytes) {
+      Src::Read(src, bgra);
+      Dst::Write(bgra, dst);
+    }
+  }
+};
+
+// The same layout on both sides is a plain copy.
+template <typename Layout>
+struct RowConverter<Layout, Layout> {
+  static void Run(const uint8_t* src, uint8_t* dst, int width) {
+    std::memcpy(dst, src, static_cast<size_t>(width) * Layout::kBytes);
+  }
+};
+
+// Converts |width| pixels of one row. |src| and |dst| must not overlap.
+template <typename Src, typename Dst>
+inline void ConvertRow(const uint8_t* src, uint8_t* dst, int width) {
+  RowConverter<Src, Dst>::Run(src, dst, width);
+}
+
+// Rows per task when an image is spread over the task pool.
+constexpr size_t kPixelRowGrain = 64;
+
+// Converts a |width| x |height| image from |src| into |dst|, in row ranges
+// on the task pool.
+template <typename Src, typename Dst>
+void ConvertPixels(const uint8_t* src, size_t src_stride, uint8_t* dst,
+                   size_t dst_stride, int width, int height) {
+  if (width <= 0 || height <= 0) return;
+  ScopedTrace trace("convert");
+  ParallelForRange(static_cast<size_t>(height), kPixelRowGrain,
+                   [=](size_t begin, size_t end) {
+                     for (size_t y = begin; y < end; ++y) {
+                       ConvertRow<Src, Dst>(src + y * src_stride,
+                                            dst + y * dst_stride, width);
+                     }
+                   });
+}
+
+// Converts and box-filters in one pass: every |scale| x |scale| block of
+// the |width| x |height| source becomes one pixel of the (|width| / |scale|)
+// x (|height| / |scale|) destination. Blocks are summed straight from the
+// source rows, so neither a converted nor a half-scaled copy of the image
+// is made; each task holds one row of sums. Trailing columns and rows that
+// do not fill a whole block are left out.
+template <typename Src, typename Dst>
+void ConvertDownscaled(const uint8_t* src, size_t src_stride, int width,
+                       int height, int scale, uint8_t* dst,
+                       size_t dst_stride) {
+  if (scale <= 1) {
+    ConvertPixels<Src, Dst>(src, src_stride, dst, dst_stride, width, height);
+    return;
+  }
+  const int out_width = width / scale;
+  const int out_height = height / scale;
+  if (out_width <= 0 || out_height <= 0) return;
+  ScopedTrace trace("convert");
+  const uint32_t count = static_cast<uint32_t>(scale) * scale;
+  const size_t grain =
+      std::max<size_t>(kPixelRowGrain / static_cast<size_t>(scale), 1);
+  ParallelForRange(
+      static_cast<size_t>(out_height), grain, [=](size_t begin, size_t end) {
+        std::vector<uint32_t> sums(static_cast<size_t>(out_width) * 4);
+        uint8_t bgra[4];
+        for (size_t y = begin; y < end; ++y) {
+          std::fill(sums.begin(), sums.end(), 0u);
+          for (int row = 0; row < scale; ++row) {
+            const uint8_t* p = src + (y * scale + row) * src_stride;
+            uint32_t* sum = sums.data();
+            for (int x = 0; x < out_width; ++x, sum += 4) {
+              for (int k = 0; k < scale; ++k, p += Src::kBytes) {
+                Src::Read(p, bgra);
+                sum[0] += bgra[0];
+                sum[1] += bgra[1];
+                sum[2] += bgra[2];
+                sum[3] += bgra[3];
+              }
+            }
+          }
+          uint8_t* out = dst + y * dst_stride;
+          const uint32_t* sum = sums.data();
+          for (int x = 0; x < out_width; ++x, sum += 4, out += Dst::kBytes) {
+            for (int c = 0; c < 4; ++c) {
+              bgra[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+            Dst::Write(bgra, out);
+          }
+        }
+      });
+}
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_PIXEL_PIPELINE_H_
@@ -0,0 +1,90 @@
+#include "pixel_sample.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace desktop_screenshot {
+
+namespace {
+
+// What one extra capture call costs, expressed as pixels copied: the X
+// server round trip or GDI blit setup is worth roughly a 128x128 copy.
+constexpr int64_t kGrabCostPixels = 128 * 128;
+// Clustering is quadratic per merge; past this many points one bounding
+// grab is used instead, keeping planning well under a millisecond.
+constexpr size_t kMaxClusteredPoints = 64;
+
+int64_t Area(const Rect& rect) {
+  return static_cast<int64_t>(rect.width) * rect.height;
+}
+
+Rect Union(const Rect& a, const Rect& b) {
+  int left = std::min(a.x, b.x);
+  int top = std::min(a.y, b.y);
+  int right = std::max(a.x + a.width, b.x + b.width);
+  int bottom = std::max(a.y + a.height, b.y + b.height);
+  return Rect{left, top, right - left, bottom - top};
+}
+
+}  // namespace
+
+std::vector<Rect> PlanPixelGrabs(const std::vector<Point>& points,
+                                 std::vector<size_t>* owner) {
+  std::vector<Rect> rects;
+  owner->assign(points.size(), 0);
+  if (points.empty()) return rects;
+
+  rects.reserve(points.size());
+  for (const Point& point : points) rects.push_back(Rect{point.x, point.y, 1, 1});
+  if (points.size() > kMaxClusteredPoints) {
+    return {BoundingRect(rects)};
+  }
+
+  // Greedy agglomeration: keep merging the pair whose union wastes the
+  // fewest pixels while that waste is cheaper than a separate grab.
+  std::vector<size_t> group(points.size());
+  for (size_t i = 0; i < group.size(); ++i) group[i] = i;
+  std::vector<bool> alive(rects.size(), true);
+  for (;;) {
+    int64_t best_waste = std::numeric_limits<int64_t>::max();
+    size_t best_a = 0;
+    size_t best_b = 0;
+    for (size_t a = 0; a < rects.size(); ++a) {
+      if (!alive[a]) continue;
+      for (size_t b = a + 1; b < rects.size(); ++b) {
+        if (!alive[b]) continue;
+        int64_t waste =
+            Area(Union(rects[a], rects[b])) - Area(rects[a]) - Area(rects[b]);
+        if (waste < best_waste) {
+          best_waste = waste;
+          best_a = a;
+          best_b = b;
+        }
+      }
+    }
+    if (best_waste > kGrabCostPixels) break;
+    rects[best_a] = Union(rects[best_a], rects[best_b]);
+    alive[best_b] = false;
+    for (size_t& g : group) {
+      if (g == best_b) g = best_a;
+    }
+  }
+
+  std::vector<size_t> index(rects.size(), 0);
+  std::vector<Rect> grabs;
+  for (size_t i = 0; i < rects.size(); ++i) {
+    if (!alive[i]) continue;
+    index[i] = grabs.size();
+    grabs.push_back(rects[i]);
+  }
+  for (size_t i = 0; i < points.size(); ++i) (*owner)[i] = index[group[i]];
+  return grabs;
+}
+
+uint32_t PixelColor(const uint8_t* pixels, int stride, int x, int y) {
+  const uint8_t* p = pixels + static_cast<size_t>(y) * stride + x * 4;
+  return 0xFF000000u | static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[1]) << 8 | p[0];
+}
+
+}  // namespace desktop_screenshot
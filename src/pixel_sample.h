@@ -0,0 +1,31 @@
+#ifndef DESKTOP_SCREENSHOT_PIXEL_SAMPLE_H_
+#define DESKTOP_SCREENSHOT_PIXEL_SAMPLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+struct Point {
+  int x = 0;
+  int y = 0;
+};
+
+// Chooses the screen rectangles to grab so that every point is covered
+// while copying as few pixels as possible. Points close together share one
+// grab; a grab is only split off when that saves more pixels than the
+// fixed cost of another capture call. |owner| receives, for each point,
+// the index of the returned rectangle that contains it.
+std::vector<Rect> PlanPixelGrabs(const std::vector<Point>& points,
+                                 std::vector<size_t>* owner);
+
+// Reads pixel (|x|, |y|) of a BGRA buffer as 0xAARRGGBB, the same packing
+// as Dart's Color.value. Alpha is forced opaque since captures have none.
+uint32_t PixelColor(const uint8_t* pixels, int stride, int x, int y);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_PIXEL_SAMPLE_H_
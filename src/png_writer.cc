@@ -0,0 +1,248 @@
+#include "png_writer.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "frame_hash.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value >> 24));
+  out->push_back(static_cast<uint8_t>(value >> 16));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void PutChunk(std::vector<uint8_t>* out, const char type[4],
+              const uint8_t* data, size_t size) {
+  PutU32(out, static_cast<uint32_t>(size));
+  size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  if (size > 0) out->insert(out->end(), data, data + size);
+  uLong crc = crc32(0L, out->data() + start, static_cast<uInt>(size + 4));
+  PutU32(out, static_cast<uint32_t>(crc));
+}
+
+// Packs one row of palette indices at |bit_depth| bits per pixel, most
+// significant bits first, behind the filter-type byte.
+void PackRow(const uint8_t* indices, int width, int bit_depth, uint8_t* dst) {
+  *dst++ = 0;  // Filter type None.
+  if (bit_depth == 8) {
+    std::memcpy(dst, indices, width);
+    return;
+  }
+  const int per_byte = 8 / bit_depth;
+  for (int x = 0; x < width; x += per_byte) {
+    uint8_t byte = 0;
+    for (int i = 0; i < per_byte; ++i) {
+      uint8_t value = x + i < width ? indices[x + i] : 0;
+      byte |= static_cast<uint8_t>(value << (8 - bit_depth * (i + 1)));
+    }
+    *dst++ = byte;
+  }
+}
+
+const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+void PutHeader(std::vector<uint8_t>* out, int width, int height,
+               uint8_t bit_depth, uint8_t color_type) {
+  out->insert(out->end(), kSignature, kSignature + 8);
+  uint8_t ihdr[13];
+  uint32_t size[2] = {static_cast<uint32_t>(width),
+                      static_cast<uint32_t>(height)};
+  for (int i = 0; i < 2; ++i) {
+    ihdr[i * 4 + 0] = static_cast<uint8_t>(size[i] >> 24);
+    ihdr[i * 4 + 1] = static_cast<uint8_t>(size[i] >> 16);
+    ihdr[i * 4 + 2] = static_cast<uint8_t>(size[i] >> 8);
+    ihdr[i * 4 + 3] = static_cast<uint8_t>(size[i]);
+  }
+  ihdr[8] = bit_depth;
+  ihdr[9] = color_type;
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+  PutChunk(out, "IHDR", ihdr, sizeof(ihdr));
+}
+
+// Writes one BGRA row as RGB behind filter type Sub.
+void FilterRowSub(const uint8_t* bgra, int width, uint8_t* dst) {
+  *dst++ = 1;  // Filter type Sub.
+  uint8_t left[3] = {0, 0, 0};
+  for (int x = 0; x < width; ++x, bgra += 4, dst += 3) {
+    const uint8_t rgb[3] = {bgra[2], bgra[1], bgra[0]};
+    for (int c = 0; c < 3; ++c) {
+      dst[c] = static_cast<uint8_t>(rgb[c] - left[c]);
+      left[c] = rgb[c];
+    }
+  }
+}
+
+// Deflates |size| bytes as a raw stream of its own. Ends on a full flush
+// so the next band can follow byte-aligned, or finishes the stream.
+bool DeflateBand(const uint8_t* data, size_t size, int level, bool last,
+                 std::vector<uint8_t>* out) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  // Room for the flush marker on top of the bound.
+  out->resize(deflateBound(&stream, static_cast<uLong>(size)) + 16);
+  stream.next_in = const_cast<Bytef*>(data);
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out = out->data();
+  stream.avail_out = static_cast<uInt>(out->size());
+  const int status = deflate(&stream, last ? Z_FINISH : Z_FULL_FLUSH);
+  const bool ok = last ? status == Z_STREAM_END
+                       : status == Z_OK && stream.avail_in == 0;
+  out->resize(stream.total_out);
+  deflateEnd(&stream);
+  return ok;
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeIndexedPng(const IndexedImage& image, int level) {
+  ScopedTrace trace("encode");
+  std::vector<uint8_t> out;
+  PutHeader(&out, image.width, image.height,
+            static_cast<uint8_t>(image.bit_depth), 3);  // Indexed color.
+
+  std::vector<uint8_t> plte;
+  plte.reserve(image.palette.size() * 3);
+  for (uint32_t color : image.palette) {
+    plte.push_back(static_cast<uint8_t>(color >> 16));
+    plte.push_back(static_cast<uint8_t>(color >> 8));
+    plte.push_back(static_cast<uint8_t>(color));
+  }
+  PutChunk(&out, "PLTE", plte.data(), plte.size());
+
+  const size_t row_bytes =
+      1 + (static_cast<size_t>(image.width) * image.bit_depth + 7) / 8;
+  std::vector<uint8_t> raw(row_bytes * image.height);
+  for (int y = 0; y < image.height; ++y) {
+    PackRow(&image.indices[static_cast<size_t>(y) * image.width], image.width,
+            image.bit_depth, &raw[y * row_bytes]);
+  }
+
+  uLongf compressed_size = compressBound(static_cast<uLong>(raw.size()));
+  std::vector<uint8_t> idat(compressed_size);
+  if (compress2(idat.data(), &compressed_size, raw.data(),
+                static_cast<uLong>(raw.size()), level) != Z_OK) {
+    return {};
+  }
+  PutChunk(&out, "IDAT", idat.data(), compressed_size);
+  PutChunk(&out, "IEND", nullptr, 0);
+  return out;
+}
+
+IncrementalPngEncoder::IncrementalPngEncoder(int level, MemoryLedger* ledger)
+    : level_(level), ledger_(ledger) {}
+
+std::vector<uint8_t> IncrementalPngEncoder::Encode(const Frame& frame) {
+  if (frame.width <= 0 || frame.height <= 0) return {};
+  ScopedTrace trace("encode");
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t band_count = (frame.height + kBandRows - 1) / kBandRows;
+  if (frame.width != width_ || frame.height != height_) {
+    width_ = frame.width;
+    height_ = frame.height;
+    bands_.assign(band_count, Band());
+  }
+  const size_t row_bytes = 1 + static_cast<size_t>(frame.width) * 3;
+  filtered_.resize(row_bytes * frame.height);
+
+  std::atomic<size_t> recompressed(0);
+  std::atomic<bool> failed(false);
+  ParallelFor(band_count, [&](size_t i) {
+    const int first = static_cast<int>(i) * kBandRows;
+    const int last = std::min(first + kBandRows, frame.height);
+    uint8_t* rows = &filtered_[first * row_bytes];
+    for (int y = first; y < last; ++y) {
+      FilterRowSub(frame.Row(y), frame.width, rows + (y - first) * row_bytes);
+    }
+    const size_t size = (last - first) * row_bytes;
+    const uint64_t hash = HashBytes(rows, size);
+    Band& band = bands_[i];
+    if (band.valid && band.hash == hash) return;
+
+    band.valid = DeflateBand(rows, size, level_, i + 1 == band_count,
+                             &band.deflated);
+    if (!band.valid) {
+      failed = true;
+      return;
+    }
+    band.hash = hash;
+    band.raw_size = size;
+    band.adler = static_cast<uint32_t>(
+        adler32(adler32(0L, Z_NULL, 0), rows, static_cast<uInt>(size)));
+    band.crc = static_cast<uint32_t>(crc32(
+        0L, band.deflated.data(), static_cast<uInt>(band.deflated.size())));
+    ++recompressed;
+  });
+  recompressed_ = recompressed;
+  Recharge();
+  if (failed) return {};
+
+  size_t deflated_size = 0;
+  for (const Band& band : bands_) deflated_size += band.deflated.size();
+  std::vector<uint8_t> out;
+  out.reserve(8 + 25 + 12 + 6 + deflated_size + 12);
+  PutHeader(&out, frame.width, frame.height, 8, 2);  // Truecolor.
+
+  // IDAT: zlib header, the bands, the Adler-32 of the filtered rows.
+  PutU32(&out, static_cast<uint32_t>(2 + deflated_size + 4));
+  static const uint8_t kIdatStart[6] = {'I', 'D', 'A', 'T', 0x78, 0x9C};
+  out.insert(out.end(), kIdatStart, kIdatStart + 6);
+  uLong crc = crc32(0L, kIdatStart, 6);
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (const Band& band : bands_) {
+    out.insert(out.end(), band.deflated.begin(), band.deflated.end());
+    crc = crc32_combine(crc, band.crc,
+                        static_cast<z_off_t>(band.deflated.size()));
+    adler = adler32_combine(adler, band.adler,
+                            static_cast<z_off_t>(band.raw_size));
+  }
+  PutU32(&out, static_cast<uint32_t>(adler));
+  crc = crc32(crc, &out[out.size() - 4], 4);
+  PutU32(&out, static_cast<uint32_t>(crc));
+  PutChunk(&out, "IEND", nullptr, 0);
+  return out;
+}
+
+void IncrementalPngEncoder::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  width_ = 0;
+  height_ = 0;
+  bands_.clear();
+  recompressed_ = 0;
+  Recharge();
+}
+
+void IncrementalPngEncoder::Recharge() {
+  if (!ledger_) return;
+  size_t bytes = filtered_.capacity();
+  for (const Band& band : bands_) bytes += band.deflated.capacity();
+  charge_.Reset();
+  charge_ = ledger_->Charge(MemoryStage::kEncode, bytes);
+}
+
+size_t IncrementalPngEncoder::bands() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bands_.size();
+}
+
+size_t IncrementalPngEncoder::recompressed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return recompressed_;
+}
+
+}  // namespace desktop_screenshot
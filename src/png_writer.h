@@ -0,0 +1,89 @@
+#ifndef DESKTOP_SCREENSHOT_PNG_WRITER_H_
+#define DESKTOP_SCREENSHOT_PNG_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "frame.h"
+#include "memory_ledger.h"
+#include "palette.h"
+
+namespace desktop_screenshot {
+
+// Writes |image| as a color-type-3 (indexed) PNG at its bit depth. Rows use
+// filter type None, as the PNG specification recommends for palette images.
+// |level| is the zlib compression level (0-9).
+std::vector<uint8_t> EncodeIndexedPng(const IndexedImage& image,
+                                      int level = 6);
+
+// Writes BGRA frames as color-type-2 (RGB) PNGs, reusing the compressed
+// output of bands that did not change since the previous frame.
+//
+// Rows use filter type Sub, so a row's filtered bytes depend on that row
+// alone. Every kBandRows rows form a band that is deflated as its own raw
+// stream, with no dictionary carried over from the band above, and ends
+// on a full flush (the last band finishes the stream); concatenated they
+// form one valid zlib stream. Each band keeps its compressed bytes, the
+// hash of its filtered rows and their Adler-32 and CRC-32, so a frame in
+// which only a clock or cursor moved deflates just the bands it touches;
+// the Adler-32 of the image data and the IDAT CRC are combined from the
+// per-band values rather than recomputed over the whole output.
+class IncrementalPngEncoder {
+ public:
+  static constexpr int kBandRows = 32;
+
+  // |level| is the zlib compression level (0-9). The filtered rows and
+  // compressed bands kept between frames are charged to |ledger|'s encode
+  // stage, if given.
+  explicit IncrementalPngEncoder(int level = 6,
+                                 MemoryLedger* ledger = nullptr);
+
+  IncrementalPngEncoder(const IncrementalPngEncoder&) = delete;
+  IncrementalPngEncoder& operator=(const IncrementalPngEncoder&) = delete;
+
+  // Encodes |frame|, dropping its alpha channel. Returns an empty vector
+  // for an empty frame or if zlib fails. A change of size starts over with
+  // every band recompressed.
+  std::vector<uint8_t> Encode(const Frame& frame);
+
+  // Forgets the previous frame.
+  void Reset();
+
+  // Bands in the last encoded frame, and how many of them were deflated
+  // rather than reused.
+  size_t bands() const;
+  size_t recompressed() const;
+
+ private:
+  // Charges what |filtered_| and |bands_| hold now. Called with |mutex_|
+  // held.
+  void Recharge();
+
+  struct Band {
+    bool valid = false;
+    uint64_t hash = 0;
+    // Filtered bytes the band covers, and their Adler-32.
+    size_t raw_size = 0;
+    uint32_t adler = 0;
+    // The band's raw deflate output, and its CRC-32.
+    std::vector<uint8_t> deflated;
+    uint32_t crc = 0;
+  };
+
+  const int level_;
+  MemoryLedger* const ledger_;
+  mutable std::mutex mutex_;
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<Band> bands_;
+  // Filtered rows of the current frame, kept to avoid reallocating.
+  std::vector<uint8_t> filtered_;
+  size_t recompressed_ = 0;
+  MemoryCharge charge_;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_PNG_WRITER_H_
@@ -0,0 +1,195 @@
+#include "raw_frame.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "lz4_block.h"
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'D', 'S', 'R', 'F'};
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kFormatBgra8 = 0;
+constexpr uint8_t kCodecStored = 0;
+constexpr uint8_t kCodecLz4 = 1;
+
+void Put32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void Put64(uint8_t* p, uint64_t value) {
+  for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t Get32(const uint8_t* p) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(p[i]) << (8 * i);
+  return value;
+}
+
+uint64_t Get64(const uint8_t* p) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+  return value;
+}
+
+// Plain byte loops: compilers vectorize the subtraction and the up-predictor
+// reconstruction on their own.
+void Predict(const Frame& frame, FramePredictor predictor, uint8_t* out) {
+  const size_t row_bytes = static_cast<size_t>(frame.stride);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* row = frame.Row(y);
+    uint8_t* dst = out + y * row_bytes;
+    if (predictor == FramePredictor::kUp && y > 0) {
+      const uint8_t* above = frame.Row(y - 1);
+      for (size_t i = 0; i < row_bytes; ++i) {
+        dst[i] = static_cast<uint8_t>(row[i] - above[i]);
+      }
+    } else if (predictor == FramePredictor::kLeft) {
+      size_t head = std::min<size_t>(4, row_bytes);
+      std::memcpy(dst, row, head);
+      for (size_t i = 4; i < row_bytes; ++i) {
+        dst[i] = static_cast<uint8_t>(row[i] - row[i - 4]);
+      }
+    } else {
+      std::memcpy(dst, row, row_bytes);
+    }
+  }
+}
+
+// Byte-wise add of four packed channels without carries between them.
+inline uint32_t AddBytes(uint32_t a, uint32_t b) {
+  return ((a & 0x7F7F7F7Fu) + (b & 0x7F7F7F7Fu)) ^ ((a ^ b) & 0x80808080u);
+}
+
+void Unpredict(Frame* frame, FramePredictor predictor) {
+  const size_t row_bytes = static_cast<size_t>(frame->stride);
+  for (int y = 0; y < frame->height; ++y) {
+    uint8_t* row = frame->Row(y);
+    if (predictor == FramePredictor::kUp && y > 0) {
+      const uint8_t* above = frame->Row(y - 1);
+      for (size_t i = 0; i < row_bytes; ++i) {
+        row[i] = static_cast<uint8_t>(row[i] + above[i]);
+      }
+    } else if (predictor == FramePredictor::kLeft) {
+      // Each pixel depends on the previous one; whole pixels at a time keep
+      // the dependency chain one add long per pixel.
+      size_t pixels = row_bytes / 4;
+      uint32_t previous = 0;
+      for (size_t x = 0; x < pixels; ++x) {
+        uint32_t value;
+        std::memcpy(&value, row + x * 4, 4);
+        previous = AddBytes(value, previous);
+        std::memcpy(row + x * 4, &previous, 4);
+      }
+      for (size_t i = pixels * 4; i < row_bytes; ++i) {
+        row[i] = static_cast<uint8_t>(row[i] + row[i - 4]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseFramePredictor(const char* name, FramePredictor* predictor) {
+  if (std::strcmp(name, "none") == 0) {
+    *predictor = FramePredictor::kNone;
+  } else if (std::strcmp(name, "left") == 0) {
+    *predictor = FramePredictor::kLeft;
+  } else if (std::strcmp(name, "up") == 0) {
+    *predictor = FramePredictor::kUp;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::vector<uint8_t> EncodeRawFrame(const Frame& frame, uint64_t timestamp_ns,
+                                    FramePredictor predictor, size_t offset) {
+  ScopedTrace trace("encode");
+  const size_t raw_size = static_cast<size_t>(frame.stride) * frame.height;
+  std::vector<uint8_t> predicted(raw_size);
+  Predict(frame, predictor, predicted.data());
+
+  const size_t start = offset + kRawFrameHeaderSize;
+  std::vector<uint8_t> out(start + Lz4CompressBound(raw_size));
+  size_t payload = Lz4Compress(predicted.data(), raw_size, out.data() + start,
+                               out.size() - start);
+  uint8_t codec = kCodecLz4;
+  if (payload == 0 || payload >= raw_size) {
+    codec = kCodecStored;
+    payload = raw_size;
+    std::memcpy(out.data() + start, predicted.data(), raw_size);
+  }
+  out.resize(start + payload);
+
+  uint8_t* header = out.data() + offset;
+  std::memcpy(header, kMagic, 4);
+  header[4] = kVersion;
+  header[5] = kFormatBgra8;
+  header[6] = static_cast<uint8_t>(predictor);
+  header[7] = codec;
+  Put32(header + 8, static_cast<uint32_t>(frame.width));
+  Put32(header + 12, static_cast<uint32_t>(frame.height));
+  Put32(header + 16, static_cast<uint32_t>(frame.stride));
+  Put32(header + 20, static_cast<uint32_t>(payload));
+  Put64(header + 24, timestamp_ns);
+  return out;
+}
+
+bool DecodeRawFrame(const uint8_t* data, size_t size, Frame* frame,
+                    uint64_t* timestamp_ns) {
+  if (size < kRawFrameHeaderSize || std::memcmp(data, kMagic, 4) != 0 ||
+      data[4] != kVersion || data[5] != kFormatBgra8 ||
+      data[6] > static_cast<uint8_t>(FramePredictor::kUp)) {
+    return false;
+  }
+  uint32_t width = Get32(data + 8);
+  uint32_t height = Get32(data + 12);
+  uint32_t stride = Get32(data + 16);
+  uint32_t payload = Get32(data + 20);
+  if (width > 0x7FFFFFFF || height > 0x7FFFFFFF ||
+      static_cast<uint64_t>(stride) < static_cast<uint64_t>(width) * 4 ||
+      stride > 0x7FFFFFFF || payload != size - kRawFrameHeaderSize) {
+    return false;
+  }
+
+  const uint8_t* body = data + kRawFrameHeaderSize;
+  const size_t raw_size = static_cast<size_t>(stride) * height;
+  // An LZ4 byte expands to at most 255, so a corrupt header cannot make us
+  // allocate far more than the input could ever fill.
+  if (raw_size / 255 > payload) return false;
+  frame->width = static_cast<int>(width);
+  frame->height = static_cast<int>(height);
+  frame->stride = static_cast<int>(stride);
+  frame->pixels.resize(raw_size);
+  switch (data[7]) {
+    case kCodecStored:
+      if (payload != raw_size) return false;
+      std::memcpy(frame->pixels.data(), body, raw_size);
+      break;
+    case kCodecLz4:
+      if (!Lz4Decompress(body, payload, frame->pixels.data(), raw_size)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  Unpredict(frame, static_cast<FramePredictor>(data[6]));
+  if (timestamp_ns) *timestamp_ns = Get64(data + 24);
+  return true;
+}
+
+uint64_t RawFrameTimestampNow() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+}  // namespace desktop_screenshot
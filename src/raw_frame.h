@@ -0,0 +1,60 @@
+#ifndef DESKTOP_SCREENSHOT_RAW_FRAME_H_
+#define DESKTOP_SCREENSHOT_RAW_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// Byte-wise predictors applied before compression. Screens are dominated
+// by flat areas and repeated rows, which both predictors turn into runs of
+// zeros.
+enum class FramePredictor : uint8_t {
+  kNone = 0,
+  // Each byte minus the same channel of the pixel to its left.
+  kLeft = 1,
+  // Each byte minus the same byte of the row above.
+  kUp = 2,
+};
+
+// Parses "none", "left" or "up". Returns false for anything else.
+bool ParseFramePredictor(const char* name, FramePredictor* predictor);
+
+// A compact raw-frame container, cheaper to produce than PNG and far
+// smaller than plain BGRA. Little-endian layout:
+//
+//   0  "DSRF"          magic
+//   4  u8  version     1
+//   5  u8  format      0 = BGRA, 8 bits per channel
+//   6  u8  predictor   FramePredictor
+//   7  u8  codec       0 = stored, 1 = LZ4 block
+//   8  u32 width
+//  12  u32 height
+//  16  u32 stride      bytes per row of the decoded pixels
+//  20  u32 payload     size of the bytes that follow the header
+//  24  u64 timestamp   capture time, nanoseconds since the Unix epoch
+//  32  payload         stride * height predicted bytes, compressed
+//
+// The payload is stored uncompressed when LZ4 would not make it smaller.
+constexpr size_t kRawFrameHeaderSize = 32;
+
+// The container starts |offset| bytes into the result, leaving room for a
+// caller's own header; those bytes are zero.
+std::vector<uint8_t> EncodeRawFrame(
+    const Frame& frame, uint64_t timestamp_ns,
+    FramePredictor predictor = FramePredictor::kLeft, size_t offset = 0);
+
+// Decodes a container produced by EncodeRawFrame. Returns false if |data|
+// is not a valid container.
+bool DecodeRawFrame(const uint8_t* data, size_t size, Frame* frame,
+                    uint64_t* timestamp_ns);
+
+// Current time in the container's timestamp unit.
+uint64_t RawFrameTimestampNow();
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_RAW_FRAME_H_
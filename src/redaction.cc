@@ -0,0 +1,190 @@
+#include "redaction.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DESKTOP_SCREENSHOT_SSE2 1
+#endif
+
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+// One BGRA pixel widened to four 32-bit lanes. The blur and pixelate
+// kernels accumulate whole pixels at a time, so with SSE2 every add,
+// subtract and divide touches all four channels in a single instruction.
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+typedef __m128i Lanes;
+
+inline Lanes LoadPixel(const uint8_t* p) {
+  int32_t value;
+  std::memcpy(&value, p, 4);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_cvtsi32_si128(value);
+  return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+}
+inline Lanes Zero() { return _mm_setzero_si128(); }
+inline Lanes Add(Lanes a, Lanes b) { return _mm_add_epi32(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_epi32(a, b); }
+inline Lanes Scale(Lanes a, int factor) {
+  // SSE2 has no 32-bit mullo: multiply the even and the odd lanes into
+  // 64-bit products and keep their low halves.
+  const __m128i f = _mm_set1_epi32(factor);
+  __m128i even = _mm_mul_epu32(a, f);
+  __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), f);
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+inline void StoreAverage(Lanes sum, float inv_count, uint8_t* p) {
+  __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(inv_count));
+  __m128i v = _mm_cvtps_epi32(f);
+  v = _mm_packs_epi32(v, v);
+  v = _mm_packus_epi16(v, v);
+  int32_t value = _mm_cvtsi128_si32(v);
+  std::memcpy(p, &value, 4);
+}
+#else
+struct Lanes {
+  int32_t v[4];
+};
+
+inline Lanes LoadPixel(const uint8_t* p) { return Lanes{{p[0], p[1], p[2], p[3]}}; }
+inline Lanes Zero() { return Lanes{{0, 0, 0, 0}}; }
+inline Lanes Add(Lanes a, Lanes b) {
+  for (int i = 0; i < 4; ++i) a.v[i] += b.v[i];
+  return a;
+}
+inline Lanes Sub(Lanes a, Lanes b) {
+  for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i];
+  return a;
+}
+inline Lanes Scale(Lanes a, int factor) {
+  for (int i = 0; i < 4; ++i) a.v[i] *= factor;
+  return a;
+}
+inline void StoreAverage(Lanes sum, float inv_count, uint8_t* p) {
+  for (int i = 0; i < 4; ++i) {
+    int value = static_cast<int>(static_cast<float>(sum.v[i]) * inv_count + 0.5f);
+    p[i] = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+  }
+}
+#endif
+
+void FillRect(Frame* frame, const Rect& rect, uint32_t color) {
+  // 0xAARRGGBB stored little-endian is B, G, R, A in memory.
+  uint8_t pixel[4] = {
+      static_cast<uint8_t>(color), static_cast<uint8_t>(color >> 8),
+      static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 24)};
+  uint32_t value;
+  std::memcpy(&value, pixel, 4);
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    uint32_t* row = reinterpret_cast<uint32_t*>(frame->Row(y)) + rect.x;
+    std::fill_n(row, rect.width, value);
+  }
+}
+
+void PixelateRect(Frame* frame, const Rect& rect, int block) {
+  block = std::max(block, 1);
+  for (int by = rect.y; by < rect.y + rect.height; by += block) {
+    int bh = std::min(block, rect.y + rect.height - by);
+    for (int bx = rect.x; bx < rect.x + rect.width; bx += block) {
+      int bw = std::min(block, rect.x + rect.width - bx);
+      Lanes sum = Zero();
+      for (int y = by; y < by + bh; ++y) {
+        const uint8_t* p = frame->Row(y) + bx * 4;
+        for (int x = 0; x < bw; ++x, p += 4) sum = Add(sum, LoadPixel(p));
+      }
+      uint8_t average[4];
+      StoreAverage(sum, 1.0f / static_cast<float>(bw * bh), average);
+      uint32_t value;
+      std::memcpy(&value, average, 4);
+      for (int y = by; y < by + bh; ++y) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->Row(y)) + bx;
+        std::fill_n(row, bw, value);
+      }
+    }
+  }
+}
+
+// Sliding-window box filter over |count| pixels spaced |step| bytes apart,
+// clamping at both ends. Cost is independent of |radius|.
+void BoxLine(const uint8_t* src, uint8_t* dst, int count, size_t src_step,
+             size_t dst_step, int radius) {
+  const float inv = 1.0f / static_cast<float>(2 * radius + 1);
+  const int last = count - 1;
+  Lanes sum = Scale(LoadPixel(src), radius + 1);
+  for (int i = 1; i <= radius; ++i) {
+    sum = Add(sum, LoadPixel(src + std::min(i, last) * src_step));
+  }
+  for (int i = 0; i < count; ++i) {
+    StoreAverage(sum, inv, dst + i * dst_step);
+    sum = Add(sum, LoadPixel(src + std::min(i + radius + 1, last) * src_step));
+    sum = Sub(sum, LoadPixel(src + std::max(i - radius, 0) * src_step));
+  }
+}
+
+void BlurRect(Frame* frame, const Rect& rect, int radius) {
+  radius = std::max(radius, 1);
+  const size_t tmp_stride = static_cast<size_t>(rect.width) * 4;
+  std::vector<uint8_t> tmp(tmp_stride * rect.height);
+  for (int pass = 0; pass < 3; ++pass) {
+    // Horizontal pass reads the frame, writes the scratch buffer.
+    for (int y = 0; y < rect.height; ++y) {
+      BoxLine(frame->Row(rect.y + y) + rect.x * 4, &tmp[y * tmp_stride],
+              rect.width, 4, 4, radius);
+    }
+    // Vertical pass reads the scratch buffer column by column and writes
+    // the result back into the frame.
+    for (int x = 0; x < rect.width; ++x) {
+      BoxLine(&tmp[x * 4], frame->Row(rect.y) + (rect.x + x) * 4, rect.height,
+              tmp_stride, frame->stride, radius);
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseRedactionMode(const char* name, RedactionMode* mode) {
+  if (std::strcmp(name, "fill") == 0) {
+    *mode = RedactionMode::kFill;
+  } else if (std::strcmp(name, "pixelate") == 0) {
+    *mode = RedactionMode::kPixelate;
+  } else if (std::strcmp(name, "blur") == 0) {
+    *mode = RedactionMode::kBlur;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void ApplyRedactions(Frame* frame, const std::vector<Redaction>& redactions) {
+  if (redactions.empty()) return;
+  ScopedTrace trace("redact");
+  for (const Redaction& redaction : redactions) {
+    Rect rect = ClampRect(redaction.rect, frame->width, frame->height);
+    if (rect.IsEmpty()) continue;
+    // A block or a radius past the rect's larger side changes nothing
+    // more, while 2 * radius + 1 and the lane sums would overflow.
+    const int strength = std::min(
+        std::max(redaction.strength, 1),
+        std::min(std::max(rect.width, rect.height), kMaxRedactionStrength));
+    switch (redaction.mode) {
+      case RedactionMode::kFill:
+        FillRect(frame, rect, redaction.color);
+        break;
+      case RedactionMode::kPixelate:
+        PixelateRect(frame, rect, strength);
+        break;
+      case RedactionMode::kBlur:
+        BlurRect(frame, rect, strength);
+        break;
+    }
+  }
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,42 @@
+#ifndef DESKTOP_SCREENSHOT_REDACTION_H_
+#define DESKTOP_SCREENSHOT_REDACTION_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+enum class RedactionMode {
+  // Paints the rectangle with a solid color.
+  kFill,
+  // Replaces each |strength| x |strength| block with its average color.
+  kPixelate,
+  // Three box-blur passes of radius |strength| (close to a Gaussian).
+  kBlur,
+};
+
+struct Redaction {
+  Rect rect;
+  RedactionMode mode = RedactionMode::kFill;
+  // Fill color as 0xAARRGGBB, the same packing as Dart's Color.value.
+  uint32_t color = 0xFF000000;
+  // Block size for kPixelate, radius for kBlur. Ignored for kFill.
+  // Clamped to 1..kMaxRedactionStrength and to the rect's larger side.
+  int strength = 8;
+};
+
+// Keeps every sum a block or a blur window accumulates within 32 bits.
+constexpr int kMaxRedactionStrength = 2048;
+
+// Parses "fill", "pixelate" or "blur". Returns false for anything else.
+bool ParseRedactionMode(const char* name, RedactionMode* mode);
+
+// Applies |redactions| in order to |frame|. Rectangles are clipped to the
+// frame; empty ones are skipped.
+void ApplyRedactions(Frame* frame, const std::vector<Redaction>& redactions);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_REDACTION_H_
@@ -0,0 +1,125 @@
+#include "scale.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "pixel_pipeline.h"
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+
+// The source pixels that contribute to one destination pixel, with
+// fixed-point weights proportional to how much of each pixel is covered.
+struct Contribution {
+  int first;
+  std::vector<int> weights;
+};
+
+std::vector<Contribution> BuildContributions(int src_size, int dst_size) {
+  std::vector<Contribution> table(dst_size);
+  const double scale = static_cast<double>(src_size) / dst_size;
+  for (int d = 0; d < dst_size; ++d) {
+    double start = d * scale;
+    double end = std::min((d + 1) * scale, static_cast<double>(src_size));
+    int first = static_cast<int>(std::floor(start));
+    int last = std::min(static_cast<int>(std::ceil(end)) - 1, src_size - 1);
+    last = std::max(last, first);
+
+    Contribution& c = table[d];
+    c.first = first;
+    int sum = 0;
+    size_t largest = 0;
+    for (int s = first; s <= last; ++s) {
+      double cover = std::min(end, s + 1.0) - std::max(start, double(s));
+      int w = static_cast<int>(std::lround(cover / (end - start) * kWeightOne));
+      c.weights.push_back(w);
+      sum += w;
+      if (w > c.weights[largest]) largest = c.weights.size() - 1;
+    }
+    // Absorb rounding error so each output pixel's weights sum to one.
+    c.weights[largest] += kWeightOne - sum;
+  }
+  return table;
+}
+
+void ResampleRow(const uint8_t* src, uint8_t* dst,
+                 const std::vector<Contribution>& table) {
+  for (const Contribution& c : table) {
+    int acc[4] = {kWeightOne / 2, kWeightOne / 2, kWeightOne / 2,
+                  kWeightOne / 2};
+    const uint8_t* p = src + c.first * 4;
+    for (int w : c.weights) {
+      acc[0] += p[0] * w;
+      acc[1] += p[1] * w;
+      acc[2] += p[2] * w;
+      acc[3] += p[3] * w;
+      p += 4;
+    }
+    for (int i = 0; i < 4; ++i) {
+      dst[i] = static_cast<uint8_t>(std::min(acc[i] >> kWeightBits, 255));
+    }
+    dst += 4;
+  }
+}
+
+}  // namespace
+
+Frame ScaleFrame(const Frame& source, int width, int height) {
+  Frame out;
+  if (width <= 0 || height <= 0 || source.IsEmpty()) return out;
+  ScopedTrace trace("scale");
+  out.Allocate(width, height);
+  if (width == source.width && height == source.height) {
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(out.Row(y), source.Row(y), out.stride);
+    }
+    return out;
+  }
+
+  // Whole-number factors are plain block averages, summed in one pass
+  // without the scratch frame.
+  const int factor = source.width / width;
+  if (factor > 1 && source.width == width * factor &&
+      source.height == height * factor) {
+    ConvertDownscaled<BgraPixels, BgraPixels>(source.Row(0), source.stride,
+                                              source.width, source.height,
+                                              factor, out.Row(0), out.stride);
+    return out;
+  }
+
+  // Horizontal pass into a (width x source.height) scratch frame, then a
+  // vertical pass from the scratch frame into the output.
+  std::vector<Contribution> columns = BuildContributions(source.width, width);
+  std::vector<Contribution> rows = BuildContributions(source.height, height);
+  Frame scratch;
+  scratch.Allocate(width, source.height);
+  for (int y = 0; y < source.height; ++y) {
+    ResampleRow(source.Row(y), scratch.Row(y), columns);
+  }
+  // The vertical pass walks whole rows so the inner loop is a contiguous
+  // multiply-accumulate the compiler can vectorize.
+  std::vector<int> acc(out.stride);
+  for (int y = 0; y < height; ++y) {
+    const Contribution& c = rows[y];
+    std::fill(acc.begin(), acc.end(), kWeightOne / 2);
+    for (size_t k = 0; k < c.weights.size(); ++k) {
+      const uint8_t* src = scratch.Row(c.first + static_cast<int>(k));
+      const int w = c.weights[k];
+      for (int i = 0; i < out.stride; ++i) acc[i] += src[i] * w;
+    }
+    uint8_t* dst = out.Row(y);
+    for (int i = 0; i < out.stride; ++i) {
+      dst[i] = static_cast<uint8_t>(std::min(acc[i] >> kWeightBits, 255));
+    }
+  }
+  return out;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,15 @@
+#ifndef DESKTOP_SCREENSHOT_SCALE_H_
+#define DESKTOP_SCREENSHOT_SCALE_H_
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+// Resamples |source| to |width| x |height| with an area-averaging (box)
+// filter, which is alias-free for the large downscales thumbnails need.
+// Returns an empty frame if either target dimension is not positive.
+Frame ScaleFrame(const Frame& source, int width, int height);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_SCALE_H_
@@ -0,0 +1,149 @@
+#include "screen_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DESKTOP_SCREENSHOT_SSE2 1
+#endif
+
+namespace desktop_screenshot {
+
+namespace {
+
+inline uint32_t Luminance(const uint8_t* p) {
+  return (29u * p[0] + 150u * p[1] + 77u * p[2]) >> 8;
+}
+
+// Running reductions over BGRA pixels: luminance sum and sum of squares,
+// and the per-channel minimum and maximum.
+struct Reduction {
+  uint64_t sum = 0;
+  uint64_t squares = 0;
+  uint8_t low[4] = {255, 255, 255, 255};
+  uint8_t high[4] = {0, 0, 0, 0};
+
+  void Scalar(const uint8_t* p, int count) {
+    for (int i = 0; i < count; ++i, p += 4) {
+      uint32_t y = Luminance(p);
+      sum += y;
+      squares += y * y;
+      for (int c = 0; c < 3; ++c) {
+        low[c] = std::min(low[c], p[c]);
+        high[c] = std::max(high[c], p[c]);
+      }
+    }
+  }
+};
+
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+// Four pixels per iteration. The weights multiply-add B, G and R into two
+// 32-bit lanes per pixel; folding the pair and shifting leaves the
+// luminance in the low half of each 64-bit lane, where mul_epu32 squares it.
+struct SimdReduction {
+  __m128i sum = _mm_setzero_si128();
+  __m128i squares = _mm_setzero_si128();
+  __m128i low = _mm_set1_epi8(static_cast<char>(0xFF));
+  __m128i high = _mm_setzero_si128();
+
+  void Add(const uint8_t* p, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_set_epi16(0, 77, 150, 29, 0, 77, 150, 29);
+    const __m128i low_lane = _mm_set_epi32(0, -1, 0, -1);
+    for (int i = 0; i < count; i += 4, p += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      low = _mm_min_epu8(low, v);
+      high = _mm_max_epu8(high, v);
+      for (int half = 0; half < 2; ++half) {
+        __m128i wide = half == 0 ? _mm_unpacklo_epi8(v, zero)
+                                 : _mm_unpackhi_epi8(v, zero);
+        __m128i terms = _mm_madd_epi16(wide, weights);
+        terms = _mm_add_epi32(terms, _mm_srli_epi64(terms, 32));
+        __m128i y = _mm_and_si128(_mm_srli_epi32(terms, 8), low_lane);
+        sum = _mm_add_epi64(sum, y);
+        squares = _mm_add_epi64(squares, _mm_mul_epu32(y, y));
+      }
+    }
+  }
+
+  void FoldInto(Reduction* out) const {
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+    out->sum += lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), squares);
+    out->squares += lanes[0] + lanes[1];
+    uint8_t bytes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), low);
+    for (int i = 0; i < 16; ++i) {
+      out->low[i % 4] = std::min(out->low[i % 4], bytes[i]);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), high);
+    for (int i = 0; i < 16; ++i) {
+      out->high[i % 4] = std::max(out->high[i % 4], bytes[i]);
+    }
+  }
+};
+#endif
+
+}  // namespace
+
+ScreenStats ComputeScreenStats(const Frame& frame) {
+  ScreenStats stats;
+  if (frame.IsEmpty()) return stats;
+
+  // Four banks per channel so consecutive pixels of the same color do not
+  // serialize on one counter; they are summed at the end.
+  std::vector<uint32_t> banks(4 * 3 * 256, 0);
+  Reduction reduction;
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+  SimdReduction simd;
+#endif
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* row = frame.Row(y);
+    int done = 0;
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+    done = frame.width & ~3;
+    simd.Add(row, done);
+#endif
+    reduction.Scalar(row + done * 4, frame.width - done);
+
+    // The row was just read, so the histogram pass hits the cache.
+    const uint8_t* p = row;
+    for (int x = 0; x < frame.width; ++x, p += 4) {
+      uint32_t* bank = &banks[(x & 3) * 3 * 256];
+      ++bank[p[2]];
+      ++bank[256 + p[1]];
+      ++bank[512 + p[0]];
+    }
+  }
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+  simd.FoldInto(&reduction);
+#endif
+
+  for (int b = 0; b < 4; ++b) {
+    const uint32_t* bank = &banks[b * 3 * 256];
+    for (int v = 0; v < 256; ++v) {
+      stats.red[v] += bank[v];
+      stats.green[v] += bank[256 + v];
+      stats.blue[v] += bank[512 + v];
+    }
+  }
+
+  stats.pixels = static_cast<uint64_t>(frame.width) * frame.height;
+  const double count = static_cast<double>(stats.pixels);
+  stats.mean_luminance = static_cast<double>(reduction.sum) / count;
+  stats.luminance_variance =
+      std::max(0.0, static_cast<double>(reduction.squares) / count -
+                        stats.mean_luminance * stats.mean_luminance);
+  stats.uniform = true;
+  for (int c = 0; c < 3; ++c) {
+    if (reduction.high[c] - reduction.low[c] > kUniformTolerance) {
+      stats.uniform = false;
+    }
+  }
+  return stats;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,34 @@
+#ifndef DESKTOP_SCREENSHOT_SCREEN_STATS_H_
+#define DESKTOP_SCREENSHOT_SCREEN_STATS_H_
+
+#include <array>
+#include <cstdint>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+struct ScreenStats {
+  uint64_t pixels = 0;
+  // Per-channel histograms: how many pixels have each value.
+  std::array<uint32_t, 256> red{};
+  std::array<uint32_t, 256> green{};
+  std::array<uint32_t, 256> blue{};
+  // Luminance uses the BT.601 weights in 8-bit fixed point, 0..255.
+  double mean_luminance = 0;
+  double luminance_variance = 0;
+  // True when no channel varies by more than kUniformTolerance over the
+  // frame: a black, frozen-on-one-color or disconnected display.
+  bool uniform = false;
+};
+
+// Largest per-channel spread still reported as uniform. Absorbs the
+// dithering some drivers apply to solid fills.
+constexpr int kUniformTolerance = 4;
+
+// Computes |frame|'s statistics in a single pass. Alpha is ignored.
+ScreenStats ComputeScreenStats(const Frame& frame);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_SCREEN_STATS_H_
@@ -0,0 +1,238 @@
+#include "task_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "trace.h"
+
+namespace desktop_screenshot {
+
+namespace {
+
+// Which pool and deque the current thread works for, so nested Run() calls
+// push onto the worker's own deque.
+thread_local const TaskPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+// The pool whose configuration lock the current thread holds through an
+// outer Run(), so a nested Run() on the same thread does not take it again.
+thread_local const TaskPool* locked_pool = nullptr;
+
+std::mutex shared_mutex;
+std::atomic<TaskPool*> shared_pool{nullptr};
+int shared_refs = 0;
+
+void PinToCore(int core) {
+  unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+  core %= static_cast<int>(cores);
+#if defined(_WIN32)
+  if (core < 64) {
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}  // namespace
+
+struct TaskPool::Job {
+  const std::function<void(size_t, size_t)>* body;
+  std::atomic<size_t> pending;
+};
+
+TaskPool::TaskPool(int threads, bool pin_threads) {
+  Start(threads, pin_threads);
+}
+
+TaskPool::~TaskPool() { Stop(); }
+
+void TaskPool::Start(int threads, bool pin_threads) {
+  if (threads <= 0) {
+    threads = std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1);
+  }
+  workers_.clear();
+  for (int i = 0; i < threads; ++i) workers_.push_back(std::make_unique<Worker>());
+  for (int i = 0; i < threads; ++i) {
+    workers_[i]->thread = std::thread(&TaskPool::WorkerLoop, this, i, pin_threads);
+  }
+}
+
+void TaskPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) worker->thread.join();
+  workers_.clear();
+  stopping_ = false;
+}
+
+void TaskPool::Configure(int threads, bool pin_threads) {
+  std::unique_lock<std::shared_timed_mutex> lock(config_mutex_);
+  Stop();
+  Start(threads, pin_threads);
+}
+
+void TaskPool::Run(size_t count, size_t grain,
+                   const std::function<void(size_t, size_t)>& body) {
+  if (count == 0) return;
+  // Workers only have tasks while some outer Run() holds the lock, and the
+  // thread of an outer Run() already holds it.
+  std::shared_lock<std::shared_timed_mutex> config(config_mutex_,
+                                                   std::defer_lock);
+  const TaskPool* outer_locked = locked_pool;
+  if (current_pool != this && locked_pool != this) {
+    config.lock();
+    locked_pool = this;
+  }
+  struct RestoreLocked {
+    const TaskPool* pool;
+    ~RestoreLocked() { locked_pool = pool; }
+  } restore{outer_locked};
+
+  grain = std::max<size_t>(grain, 1);
+  const size_t chunks = (count + grain - 1) / grain;
+  if (workers_.empty() || chunks == 1) {
+    body(0, count);
+    return;
+  }
+
+  Job job;
+  job.body = &body;
+  job.pending.store(chunks);
+  const int self = current_pool == this ? current_worker : -1;
+  const size_t n = workers_.size();
+  // Counted before publishing so a fast taker never sees it go negative.
+  queued_ += chunks;
+  for (size_t c = 0; c < chunks; ++c) {
+    Task task{&job, c * grain, std::min(count, (c + 1) * grain)};
+    // A worker keeps its own ranges (others steal them); an outside
+    // caller deals them round-robin.
+    size_t target = self >= 0 ? static_cast<size_t>(self) : next_victim_++ % n;
+    std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+    workers_[target]->tasks.push_back(task);
+  }
+  {
+    // Pairs with the predicate check in WorkerLoop so no wake-up is lost.
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  wake_.notify_all();
+  {
+    // Lets callers blocked below steal ranges queued by nested runs.
+    std::lock_guard<std::mutex> lock(done_mutex_);
+  }
+  done_.notify_all();
+
+  while (job.pending.load(std::memory_order_acquire) > 0) {
+    Task task;
+    if (TakeTask(self, &task)) {
+      Execute(task);
+      continue;
+    }
+    // The rest of the job runs on other threads: sleep until its last task
+    // or more work to help with instead of spinning through it.
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    done_.wait(lock, [this, &job] {
+      return job.pending.load(std::memory_order_acquire) == 0 ||
+             queued_.load() > 0;
+    });
+  }
+}
+
+bool TaskPool::TakeTask(int self, Task* task) {
+  const size_t n = workers_.size();
+  if (self >= 0) {
+    Worker& own = *workers_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = own.tasks.back();
+      own.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+  const size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : next_victim_.load();
+  for (size_t i = 0; i < n; ++i) {
+    size_t victim = (start + i) % n;
+    if (static_cast<int>(victim) == self) continue;
+    Worker& other = *workers_[victim];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (other.tasks.empty()) continue;
+    *task = other.tasks.front();
+    other.tasks.pop_front();
+    --queued_;
+    ++steals_;
+    return true;
+  }
+  return false;
+}
+
+void TaskPool::Execute(const Task& task) {
+  ScopedTrace trace("task", "pool");
+  (*task.job->body)(task.begin, task.end);
+  ++tasks_;
+  // |task.job| may be gone once the count reaches zero.
+  if (task.job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Pairs with the predicate check in Run() so no wake-up is lost.
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    done_.notify_all();
+  }
+}
+
+void TaskPool::WorkerLoop(int index, bool pin) {
+  current_pool = this;
+  current_worker = index;
+  SetTraceThreadName("worker " + std::to_string(index));
+  if (pin) PinToCore(index);
+  for (;;) {
+    Task task;
+    if (TakeTask(index, &task)) {
+      Execute(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+    if (stopping_ && queued_.load() == 0) return;
+  }
+}
+
+TaskPool::Stats TaskPool::stats() const {
+  std::shared_lock<std::shared_timed_mutex> lock(config_mutex_);
+  Stats stats;
+  stats.threads = static_cast<int>(workers_.size());
+  stats.tasks = tasks_.load();
+  stats.steals = steals_.load();
+  stats.queue_depth = queued_.load();
+  return stats;
+}
+
+TaskPool* TaskPool::Retain() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if (shared_refs++ == 0) shared_pool.store(new TaskPool());
+  return shared_pool.load();
+}
+
+void TaskPool::Release() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if (shared_refs == 0 || --shared_refs > 0) return;
+  TaskPool* pool = shared_pool.exchange(nullptr);
+  delete pool;
+}
+
+TaskPool* TaskPool::Current() { return shared_pool.load(); }
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,108 @@
+#ifndef DESKTOP_SCREENSHOT_TASK_POOL_H_
+#define DESKTOP_SCREENSHOT_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace desktop_screenshot {
+
+// A fixed set of worker threads, each with its own task deque. Workers pop
+// their own newest task and, when idle, steal the oldest task of another
+// worker, so uneven row ranges still finish together. Threads are created
+// once and reused by every capture instead of per call.
+class TaskPool {
+ public:
+  struct Stats {
+    int threads = 0;
+    // Range tasks executed since the pool was created.
+    uint64_t tasks = 0;
+    // Tasks taken from a deque other than the taker's own.
+    uint64_t steals = 0;
+    // Tasks queued but not yet started, at the time of the call.
+    size_t queue_depth = 0;
+  };
+
+  // Starts |threads| workers; zero or less picks one per core minus the
+  // calling thread, which always helps. |pin_threads| binds worker i to
+  // core i.
+  explicit TaskPool(int threads = 0, bool pin_threads = false);
+
+  // Waits for the workers to exit. No Run() may be in flight.
+  ~TaskPool();
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // Calls |body(begin, end)| over [0, |count|) split into ranges of at most
+  // |grain| indices, and returns once every range has run. The calling
+  // thread runs ranges too, so nested calls from a worker do not deadlock.
+  void Run(size_t count, size_t grain,
+           const std::function<void(size_t, size_t)>& body);
+
+  // Restarts the workers with a new size and affinity. Safe to call while
+  // other threads are in Run(): waits for those runs to return, and runs
+  // that start meanwhile wait for the new workers. Must not be called from
+  // inside a Run() body.
+  void Configure(int threads, bool pin_threads);
+
+  Stats stats() const;
+
+  // The pool shared by every plugin instance. Retain() creates it on first
+  // use and Release() destroys it when the last owner lets go.
+  static TaskPool* Retain();
+  static void Release();
+
+  // The shared pool, or nullptr if nothing retains it.
+  static TaskPool* Current();
+
+ private:
+  struct Job;
+  struct Task {
+    Job* job;
+    size_t begin;
+    size_t end;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void Start(int threads, bool pin_threads);
+  void Stop();
+  void WorkerLoop(int index, bool pin);
+  // Takes a task: the newest of |self|'s deque (if |self| is a worker),
+  // else the oldest of any other.
+  bool TakeTask(int self, Task* task);
+  void Execute(const Task& task);
+
+  // Held shared by every outermost Run() and stats(), exclusively by
+  // Configure(), so |workers_| is never replaced under a run.
+  mutable std::shared_timed_mutex config_mutex_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> next_victim_{0};
+  std::atomic<uint64_t> tasks_{0};
+  std::atomic<uint64_t> steals_{0};
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  // Signalled when a job's last task finishes or new tasks are queued, for
+  // Run() callers that found nothing left to take while their job's last
+  // ranges still run elsewhere.
+  std::mutex done_mutex_;
+  std::condition_variable done_;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_TASK_POOL_H_
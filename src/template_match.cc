@@ -0,0 +1,326 @@
+#include "template_match.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DESKTOP_SCREENSHOT_SSE2 1
+#endif
+
+namespace desktop_screenshot {
+
+namespace {
+
+// Coarsest pyramid level the template is still recognizable at.
+constexpr int kMinTemplateSide = 8;
+constexpr int kMaxLevels = 4;
+// Coarse scores run lower than full-resolution ones because a match at an
+// odd offset straddles pixel boundaries, so candidates get this much slack
+// per level. Only the best peaks are refined, so a low bar stays cheap.
+constexpr float kCoarseSlack = 0.75f;
+// Each refinement step searches this far around the doubled position.
+constexpr int kRefineRadius = 2;
+
+struct GrayImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  const uint8_t* Row(int y) const {
+    return pixels.data() + static_cast<size_t>(y) * width;
+  }
+};
+
+GrayImage ToGray(const Frame& frame) {
+  GrayImage gray;
+  gray.width = frame.width;
+  gray.height = frame.height;
+  gray.pixels.resize(static_cast<size_t>(frame.width) * frame.height);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* src = frame.Row(y);
+    uint8_t* dst = &gray.pixels[static_cast<size_t>(y) * frame.width];
+    for (int x = 0; x < frame.width; ++x, src += 4) {
+      // BT.601 weights in 8-bit fixed point.
+      dst[x] = static_cast<uint8_t>((29 * src[0] + 150 * src[1] + 77 * src[2]) >> 8);
+    }
+  }
+  return gray;
+}
+
+GrayImage Halve(const GrayImage& image) {
+  GrayImage half;
+  half.width = image.width / 2;
+  half.height = image.height / 2;
+  half.pixels.resize(static_cast<size_t>(half.width) * half.height);
+  for (int y = 0; y < half.height; ++y) {
+    const uint8_t* a = image.Row(2 * y);
+    const uint8_t* b = image.Row(2 * y + 1);
+    uint8_t* dst = &half.pixels[static_cast<size_t>(y) * half.width];
+    for (int x = 0; x < half.width; ++x) {
+      dst[x] = static_cast<uint8_t>(
+          (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+    }
+  }
+  return half;
+}
+
+// Summed-area tables of the pixels and their squares, so the mean and
+// variance under any window cost four lookups.
+struct Integrals {
+  int stride = 0;
+  std::vector<uint64_t> sum;
+  std::vector<uint64_t> squares;
+
+  explicit Integrals(const GrayImage& image) {
+    stride = image.width + 1;
+    sum.assign(static_cast<size_t>(stride) * (image.height + 1), 0);
+    squares.assign(sum.size(), 0);
+    for (int y = 0; y < image.height; ++y) {
+      const uint8_t* row = image.Row(y);
+      uint64_t row_sum = 0;
+      uint64_t row_squares = 0;
+      size_t above = static_cast<size_t>(y) * stride;
+      size_t here = above + stride;
+      for (int x = 0; x < image.width; ++x) {
+        row_sum += row[x];
+        row_squares += static_cast<uint64_t>(row[x]) * row[x];
+        sum[here + x + 1] = sum[above + x + 1] + row_sum;
+        squares[here + x + 1] = squares[above + x + 1] + row_squares;
+      }
+    }
+  }
+
+  static uint64_t Box(const std::vector<uint64_t>& table, int stride, int x,
+                      int y, int w, int h) {
+    size_t top = static_cast<size_t>(y) * stride;
+    size_t bottom = static_cast<size_t>(y + h) * stride;
+    return table[bottom + x + w] - table[bottom + x] - table[top + x + w] +
+           table[top + x];
+  }
+};
+
+// One pyramid level of the template, widened to 16 bits for the
+// multiply-add, with the statistics the score needs.
+struct Needle {
+  int width = 0;
+  int height = 0;
+  std::vector<int16_t> pixels;
+  double count = 0;
+  double sum = 0;
+  // count * sum of squares - sum^2, i.e. count^2 times the variance.
+  double spread = 0;
+
+  explicit Needle(const GrayImage& image) {
+    width = image.width;
+    height = image.height;
+    pixels.assign(image.pixels.begin(), image.pixels.end());
+    count = static_cast<double>(width) * height;
+    double squares = 0;
+    for (uint8_t p : image.pixels) {
+      sum += p;
+      squares += static_cast<double>(p) * p;
+    }
+    spread = count * squares - sum * sum;
+  }
+};
+
+// Sum of image[i] * needle[i] over |count| pixels.
+int64_t Dot(const uint8_t* image, const int16_t* needle, int count) {
+  int i = 0;
+  int64_t total = 0;
+#if defined(DESKTOP_SCREENSHOT_SSE2)
+  // Each madd lane adds two products of at most 255 * 255, so a 32-bit
+  // lane holds thousands of iterations, far more than one template row.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+  for (; i + 16 <= count; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(image + i));
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needle + i));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needle + i + 8));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), lo));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), hi));
+  }
+  for (; i + 8 <= count; i += 8) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(image + i));
+    __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needle + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weights));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  total = _mm_cvtsi128_si32(acc);
+#endif
+  for (; i < count; ++i) total += image[i] * needle[i];
+  return total;
+}
+
+struct Level {
+  GrayImage image;
+  Integrals integrals;
+  Needle needle;
+
+  Level(GrayImage haystack, const GrayImage& tmpl)
+      : image(std::move(haystack)), integrals(image), needle(tmpl) {}
+
+  int positions_x() const { return image.width - needle.width + 1; }
+  int positions_y() const { return image.height - needle.height + 1; }
+
+  float Score(int x, int y) const {
+    const double count = needle.count;
+    double sum = static_cast<double>(Integrals::Box(
+        integrals.sum, integrals.stride, x, y, needle.width, needle.height));
+    double squares = static_cast<double>(Integrals::Box(
+        integrals.squares, integrals.stride, x, y, needle.width, needle.height));
+    double spread = count * squares - sum * sum;
+    if (needle.spread <= 0 || spread <= 0) {
+      if (needle.spread > 0 || spread > 0) return 0;
+      return static_cast<float>(1.0 - std::fabs(sum - needle.sum) / (255.0 * count));
+    }
+    int64_t cross = 0;
+    for (int row = 0; row < needle.height; ++row) {
+      cross += Dot(image.Row(y + row) + x,
+                   &needle.pixels[static_cast<size_t>(row) * needle.width],
+                   needle.width);
+    }
+    double numerator = count * static_cast<double>(cross) - sum * needle.sum;
+    return static_cast<float>(numerator / std::sqrt(spread * needle.spread));
+  }
+};
+
+struct Candidate {
+  int x;
+  int y;
+  float score;
+};
+
+bool Better(const Candidate& a, const Candidate& b) { return a.score > b.score; }
+
+// Scores every position of |level| (rows in parallel) and returns the local
+// maxima at or above |threshold|.
+std::vector<Candidate> Exhaustive(const Level& level, float threshold) {
+  const int columns = level.positions_x();
+  const int rows = level.positions_y();
+  std::vector<float> scores(static_cast<size_t>(columns) * rows);
+  ParallelFor(static_cast<size_t>(rows), [&](size_t y) {
+    float* out = &scores[y * columns];
+    for (int x = 0; x < columns; ++x) out[x] = level.Score(x, static_cast<int>(y));
+  });
+
+  std::vector<Candidate> found;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < columns; ++x) {
+      float score = scores[static_cast<size_t>(y) * columns + x];
+      if (score < threshold) continue;
+      bool peak = true;
+      for (int dy = -1; dy <= 1 && peak; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          int nx = x + dx;
+          int ny = y + dy;
+          if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= columns ||
+              ny >= rows) {
+            continue;
+          }
+          if (scores[static_cast<size_t>(ny) * columns + nx] > score) {
+            peak = false;
+            break;
+          }
+        }
+      }
+      if (peak) found.push_back(Candidate{x, y, score});
+    }
+  }
+  return found;
+}
+
+// Moves |candidate| from the next coarser level onto |level| and searches a
+// small window around it.
+Candidate Refine(const Level& level, const Candidate& candidate) {
+  Candidate best{0, 0, -2.0f};
+  const int cx = candidate.x * 2;
+  const int cy = candidate.y * 2;
+  for (int y = std::max(cy - kRefineRadius, 0);
+       y <= std::min(cy + kRefineRadius, level.positions_y() - 1); ++y) {
+    for (int x = std::max(cx - kRefineRadius, 0);
+         x <= std::min(cx + kRefineRadius, level.positions_x() - 1); ++x) {
+      float score = level.Score(x, y);
+      if (score > best.score) best = Candidate{x, y, score};
+    }
+  }
+  return best;
+}
+
+int OverlapArea(const Rect& a, const Rect& b) {
+  int w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+  int h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+  return w > 0 && h > 0 ? w * h : 0;
+}
+
+}  // namespace
+
+std::vector<TemplateMatch> FindTemplate(const Frame& haystack,
+                                        const Frame& needle, float threshold,
+                                        int max_matches) {
+  std::vector<TemplateMatch> matches;
+  if (max_matches <= 0 || needle.IsEmpty() || haystack.IsEmpty() ||
+      needle.width > haystack.width || needle.height > haystack.height) {
+    return matches;
+  }
+
+  int depth = 0;
+  while (depth + 1 < kMaxLevels &&
+         std::min(needle.width, needle.height) >> (depth + 1) >= kMinTemplateSide) {
+    ++depth;
+  }
+
+  std::vector<Level> levels;
+  levels.reserve(depth + 1);
+  GrayImage image = ToGray(haystack);
+  GrayImage tmpl = ToGray(needle);
+  for (int i = 0; i <= depth; ++i) {
+    GrayImage next_image = i < depth ? Halve(image) : GrayImage();
+    GrayImage next_tmpl = i < depth ? Halve(tmpl) : GrayImage();
+    levels.emplace_back(std::move(image), tmpl);
+    image = std::move(next_image);
+    tmpl = std::move(next_tmpl);
+  }
+
+  float coarse_threshold = threshold;
+  for (int i = 0; i < depth; ++i) coarse_threshold *= kCoarseSlack;
+  std::vector<Candidate> candidates = Exhaustive(levels.back(), coarse_threshold);
+  std::sort(candidates.begin(), candidates.end(), Better);
+  const size_t limit = static_cast<size_t>(std::max(64, max_matches * 8));
+  if (candidates.size() > limit) candidates.resize(limit);
+
+  ParallelFor(candidates.size(), [&](size_t i) {
+    for (int level = depth - 1; level >= 0; --level) {
+      candidates[i] = Refine(levels[level], candidates[i]);
+    }
+  });
+  std::sort(candidates.begin(), candidates.end(), Better);
+
+  // Keeps the best of any group of candidates that overlap by more than
+  // half the template.
+  const int area = needle.width * needle.height;
+  for (const Candidate& candidate : candidates) {
+    if (candidate.score < threshold) break;
+    Rect rect{candidate.x, candidate.y, needle.width, needle.height};
+    bool distinct = true;
+    for (const TemplateMatch& match : matches) {
+      if (OverlapArea(rect, match.rect) * 2 > area) {
+        distinct = false;
+        break;
+      }
+    }
+    if (!distinct) continue;
+    matches.push_back(TemplateMatch{rect, std::min(candidate.score, 1.0f)});
+    if (static_cast<int>(matches.size()) == max_matches) break;
+  }
+  return matches;
+}
+
+}  // namespace desktop_screenshot
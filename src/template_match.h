@@ -0,0 +1,31 @@
+#ifndef DESKTOP_SCREENSHOT_TEMPLATE_MATCH_H_
+#define DESKTOP_SCREENSHOT_TEMPLATE_MATCH_H_
+
+#include <vector>
+
+#include "frame.h"
+
+namespace desktop_screenshot {
+
+struct TemplateMatch {
+  // Where the template was found, in |haystack| coordinates.
+  Rect rect;
+  // Normalized cross-correlation of the luminance, in [-1, 1].
+  float score = 0;
+};
+
+// Finds up to |max_matches| non-overlapping places where |needle| appears in
+// |haystack| with a score of at least |threshold|, best first.
+//
+// Both images are reduced to luminance and searched coarse to fine: an
+// exhaustive pass on a downscaled pyramid level proposes candidates, which
+// are refined level by level down to full resolution. Alpha is ignored.
+// A uniform template scores 1 on a uniform area of the same color and 0 on
+// anything textured.
+std::vector<TemplateMatch> FindTemplate(const Frame& haystack,
+                                        const Frame& needle, float threshold,
+                                        int max_matches);
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_TEMPLATE_MATCH_H_
@@ -0,0 +1,253 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace desktop_screenshot {
+
+namespace internal {
+std::atomic<bool> tracing_enabled{false};
+}  // namespace internal
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  const char* category;
+  int64_t start_ns;
+  int64_t end_ns;
+};
+
+// One thread's events. Only the owning thread writes |events|, |size|,
+// |dropped| and |session|; readers take |session| and then |size| with
+// acquire loads and read no further than |size|.
+struct ThreadBuffer {
+  std::unique_ptr<TraceEvent[]> events;
+  size_t capacity = 0;
+  std::atomic<size_t> size{0};
+  std::atomic<size_t> dropped{0};
+  // The recording the buffer holds events of; zero before the first.
+  std::atomic<uint32_t> session{0};
+  // Set when the thread exits; the buffer is freed by the next recording.
+  std::atomic<bool> retired{false};
+  int tid = 0;
+  std::string name;
+};
+
+std::mutex registry_mutex;
+std::vector<ThreadBuffer*> registry;
+int next_tid = 1;
+std::set<std::string> interned;
+
+std::atomic<uint32_t> current_session{0};
+std::atomic<size_t> events_per_thread{kDefaultTraceEventsPerThread};
+
+thread_local std::string thread_name;
+
+// Owns nothing: marks the thread's buffer retired when the thread exits,
+// so its events can still be written out.
+struct BufferHolder {
+  ThreadBuffer* buffer = nullptr;
+  ~BufferHolder() {
+    if (buffer) buffer->retired.store(true, std::memory_order_release);
+  }
+};
+thread_local BufferHolder holder;
+
+ThreadBuffer* CurrentBuffer() {
+  if (holder.buffer) return holder.buffer;
+  ThreadBuffer* buffer = new ThreadBuffer();
+  buffer->name = thread_name;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  buffer->tid = next_tid++;
+  registry.push_back(buffer);
+  holder.buffer = buffer;
+  return buffer;
+}
+
+int ProcessId() {
+#if defined(_WIN32)
+  return static_cast<int>(GetCurrentProcessId());
+#else
+  return static_cast<int>(getpid());
+#endif
+}
+
+void AppendJsonString(const char* text, std::string* out) {
+  out->push_back('"');
+  for (const char* p = text; *p; ++p) {
+    const unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(static_cast<char>(c));
+    } else if (c < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out->append(escaped);
+    } else {
+      out->push_back(static_cast<char>(c));
+    }
+  }
+  out->push_back('"');
+}
+
+// Writes |ns| as microseconds with three decimals. Formatted from integers
+// because printf's %f follows the locale GTK applications set, and a
+// decimal comma is not JSON.
+void AppendMicroseconds(int64_t ns, std::string* out) {
+  if (ns < 0) ns = 0;
+  char digits[32];
+  std::snprintf(digits, sizeof(digits), "%lld.%03d",
+                static_cast<long long>(ns / 1000), static_cast<int>(ns % 1000));
+  out->append(digits);
+}
+
+// Opens |path| (UTF-8, as it arrives from Dart) for writing.
+FILE* OpenForWriting(const std::string& path) {
+#if defined(_WIN32)
+  const int length =
+      MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  if (length <= 0) return nullptr;
+  std::wstring wide(static_cast<size_t>(length), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+  return _wfopen(wide.c_str(), L"wb");
+#else
+  return std::fopen(path.c_str(), "wb");
+#endif
+}
+
+}  // namespace
+
+void StartTracing(size_t events) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  // Buffers of threads that have exited are not written to any more.
+  for (auto it = registry.begin(); it != registry.end();) {
+    if ((*it)->retired.load(std::memory_order_acquire)) {
+      delete *it;
+      it = registry.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  events_per_thread.store(events > 0 ? events : 1, std::memory_order_relaxed);
+  current_session.fetch_add(1, std::memory_order_release);
+  internal::tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() {
+  internal::tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+int64_t TraceNow() {
+  static const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void RecordTraceEvent(const char* name, const char* category,
+                      int64_t start_ns, int64_t end_ns) {
+  ThreadBuffer* buffer = CurrentBuffer();
+  const uint32_t session = current_session.load(std::memory_order_acquire);
+  if (buffer->session.load(std::memory_order_relaxed) != session) {
+    // First event of a new recording on this thread: start over, and
+    // publish the emptied buffer before the session that makes it visible.
+    const size_t capacity = events_per_thread.load(std::memory_order_relaxed);
+    if (buffer->capacity != capacity) {
+      buffer->events.reset(new TraceEvent[capacity]);
+      buffer->capacity = capacity;
+    }
+    buffer->size.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->session.store(session, std::memory_order_release);
+  }
+  const size_t size = buffer->size.load(std::memory_order_relaxed);
+  if (size >= buffer->capacity) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->events[size] = TraceEvent{name, category, start_ns, end_ns};
+  buffer->size.store(size + 1, std::memory_order_release);
+}
+
+const char* InternTraceName(const std::string& name) {
+  if (!TracingEnabled()) return nullptr;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  return interned.insert(name).first->c_str();
+}
+
+void SetTraceThreadName(const std::string& name) { thread_name = name; }
+
+std::string TraceToJson(TraceSummary* summary) {
+  TraceSummary totals;
+  const int pid = ProcessId();
+  const uint32_t session = current_session.load(std::memory_order_acquire);
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char number[64];
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (ThreadBuffer* buffer : registry) {
+    if (session == 0 ||
+        buffer->session.load(std::memory_order_acquire) != session) {
+      continue;
+    }
+    const size_t size = buffer->size.load(std::memory_order_acquire);
+    totals.events += size;
+    totals.dropped += buffer->dropped.load(std::memory_order_relaxed);
+    ++totals.threads;
+    if (!buffer->name.empty()) {
+      if (!first) json.push_back(',');
+      first = false;
+      std::snprintf(number, sizeof(number),
+                    "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,", pid, buffer->tid);
+      json.append(number);
+      json.append("\"name\":\"thread_name\",\"args\":{\"name\":");
+      AppendJsonString(buffer->name.c_str(), &json);
+      json.append("}}");
+    }
+    for (size_t i = 0; i < size; ++i) {
+      const TraceEvent& event = buffer->events[i];
+      if (!first) json.push_back(',');
+      first = false;
+      json.append("{\"name\":");
+      AppendJsonString(event.name, &json);
+      json.append(",\"cat\":");
+      AppendJsonString(event.category, &json);
+      json.append(",\"ph\":\"X\",\"ts\":");
+      AppendMicroseconds(event.start_ns, &json);
+      json.append(",\"dur\":");
+      AppendMicroseconds(event.end_ns - event.start_ns, &json);
+      std::snprintf(number, sizeof(number), ",\"pid\":%d,\"tid\":%d}", pid,
+                    buffer->tid);
+      json.append(number);
+    }
+  }
+  json.append("]}");
+  if (summary) *summary = totals;
+  return json;
+}
+
+bool WriteTrace(const std::string& path, TraceSummary* summary) {
+  const std::string json = TraceToJson(summary);
+  FILE* file = OpenForWriting(path);
+  if (!file) return false;
+  const bool ok = std::fwrite(json.data(), 1, json.size(), file) ==
+                  json.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+}  // namespace desktop_screenshot
@@ -0,0 +1,93 @@
+#ifndef DESKTOP_SCREENSHOT_TRACE_H_
+#define DESKTOP_SCREENSHOT_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace desktop_screenshot {
+
+// A timeline of the native capture path (requests, grabs, conversions,
+// encodes, replies and pool tasks) exported in the Chrome trace-event JSON
+// format that chrome://tracing and ui.perfetto.dev open.
+//
+// Every thread records into a fixed-size buffer of its own that no other
+// thread writes, and publishes each event with a single release store, so
+// recording takes no lock. While tracing is off a ScopedTrace costs one
+// relaxed atomic load, which is why the trace points stay compiled into
+// release builds.
+
+namespace internal {
+extern std::atomic<bool> tracing_enabled;
+}  // namespace internal
+
+constexpr size_t kDefaultTraceEventsPerThread = 16384;
+
+inline bool TracingEnabled() {
+  return internal::tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts a new recording and discards the previous one. Each thread keeps
+// its first |events_per_thread| events; later ones are counted as dropped.
+void StartTracing(size_t events_per_thread = kDefaultTraceEventsPerThread);
+
+// Stops recording. What was recorded stays available to WriteTrace().
+void StopTracing();
+
+// Nanoseconds on the trace clock.
+int64_t TraceNow();
+
+// Appends a complete event to the calling thread's buffer. |name| and
+// |category| must stay valid until the trace is written: string literals
+// or InternTraceName() results.
+void RecordTraceEvent(const char* name, const char* category,
+                      int64_t start_ns, int64_t end_ns);
+
+// A copy of |name| that lives as long as the process, for names that are
+// only known at run time such as method names. Returns nullptr while
+// tracing is off, which makes a ScopedTrace record nothing.
+const char* InternTraceName(const std::string& name);
+
+// Names the calling thread in written traces. Takes effect for threads
+// that have not recorded an event yet.
+void SetTraceThreadName(const std::string& name);
+
+struct TraceSummary {
+  size_t events = 0;
+  // Events that did not fit in their thread's buffer.
+  size_t dropped = 0;
+  size_t threads = 0;
+};
+
+// The current recording as a {"traceEvents": [...]} JSON document.
+std::string TraceToJson(TraceSummary* summary = nullptr);
+
+// Writes TraceToJson() to |path|. Returns false if the file cannot be
+// written.
+bool WriteTrace(const std::string& path, TraceSummary* summary = nullptr);
+
+// Records the time between its construction and destruction as one event,
+// if tracing was on when it was constructed.
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(const char* name, const char* category = "capture")
+      : name_(TracingEnabled() ? name : nullptr),
+        category_(category),
+        start_ns_(name_ ? TraceNow() : 0) {}
+  ~ScopedTrace() {
+    if (name_) RecordTraceEvent(name_, category_, start_ns_, TraceNow());
+  }
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  const char* name_;
+  const char* category_;
+  int64_t start_ns_;
+};
+
+}  // namespace desktop_screenshot
+
+#endif  // DESKTOP_SCREENSHOT_TRACE_H_
@@ -1,3 +1,5 @@
+import 'dart:typed_data';
+
 import 'package:desktop_screenshot/desktop_screenshot.dart';
 import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
@@ -45,4 +47,31 @@ void main() {
   test("getScreenshot", () async {
     expect(await platform.getScreenshot(), isNotNull);
   });
+
+  test('getFrame parses the binary frame message', () async {
+    final messenger =
+        TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+    messenger.setMockMessageHandler('desktop_screenshot/frames',
+        (ByteData? request) async {
+      expect(request!.getUint8(5), 4);
+      final reply = ByteData(32 + 8);
+      [0x44, 0x53, 0x46, 0x4D, 1, 4, 0].asMap().forEach(reply.setUint8);
+      reply.setUint32(8, 2, Endian.little);
+      reply.setUint32(12, 1, Endian.little);
+      reply.setUint64(16, 5000000000, Endian.little);
+      reply.setUint32(24, 8, Endian.little);
+      reply.setUint8(32 + 7, 0xFF);
+      return reply;
+    });
+    addTearDown(() =>
+        messenger.setMockMessageHandler('desktop_screenshot/frames', null));
+
+    final frame = await platform.getFrame();
+    expect(frame, isNotNull);
+    expect(frame!.format, isNull);
+    expect(frame.width, 2);
+    expect(frame.height, 1);
+    expect(frame.timestamp, DateTime.fromMillisecondsSinceEpoch(5000));
+    expect(frame.bytes, [0, 0, 0, 0, 0, 0, 0, 0xFF]);
+  });
 }
@@ -1,4 +1,5 @@
 import 'dart:typed_data';
+import 'dart:ui' show Size;
 
 import 'package:flutter_test/flutter_test.dart';
 import 'package:desktop_screenshot/desktop_screenshot.dart';
@@ -14,7 +15,197 @@ class MockDesktopScreenshotPlatform
   Future<String?> getPlatformVersion() => Future.value('42');
 
   @override
-  Future<Uint8List?> getScreenshot() => Future.value(Uint8List(0));
+  Future<Uint8List?> getScreenshot(
+          {List<Redaction>? redactions, PaletteMode palette = PaletteMode.off}) =>
+      Future.value(Uint8List(0));
+
+  @override
+  Stream<ScreenshotStreamEvent> getScreenshotStream(
+          {ScreenshotFormat format = ScreenshotFormat.png, int? chunkSize}) =>
+      Stream.fromIterable([
+        ScreenshotChunk(Uint8List(4)),
+        ScreenshotChunk(Uint8List(2)),
+        const ScreenshotStreamDone(
+            totalBytes: 6, chunks: 2, encodeTime: Duration.zero),
+      ]);
+
+  @override
+  Future<ScreenFrame?> getFrame({ScreenshotFormat? format}) =>
+      Future.value(ScreenFrame(
+          format: format,
+          width: 2,
+          height: 1,
+          timestamp: DateTime.fromMillisecondsSinceEpoch(0),
+          bytes: Uint8List(8)));
+
+  @override
+  Future<List<Uint8List>?> getScreenshotRegions(List<ScreenRect> regions,
+          {ScreenshotFormat format = ScreenshotFormat.png}) =>
+      Future.value([for (final _ in regions) Uint8List(0)]);
+
+  @override
+  Future<List<PipelineResult>?> capturePipeline(
+          List<PipelineOutput> outputs) =>
+      Future.value([
+        for (final output in outputs)
+          output.product == PipelineProduct.fingerprint
+              ? const PipelineResult(fingerprint: 42, width: 8, height: 4)
+              : PipelineResult(bytes: Uint8List(3), width: 8, height: 4),
+      ]);
+
+  @override
+  Future<int?> captureHandle() => Future.value(1);
+
+  @override
+  Future<Uint8List?> encodeHandle(int id,
+          {ScreenshotFormat format = ScreenshotFormat.png}) =>
+      Future.value(Uint8List(0));
+
+  @override
+  Future<int?> cropHandle(int id, ScreenRect rect) => Future.value(id + 1);
+
+  @override
+  Future<int?> scaleHandle(int id, int width, int height) =>
+      Future.value(id + 1);
+
+  @override
+  Future<bool> releaseHandle(int id) => Future.value(true);
+
+  @override
+  Future<void> setHandleMemoryLimit(int bytes) => Future.value();
+
+  @override
+  Future<List<ScreenMatch>?> findOnScreen(Uint8List templatePng,
+          {double threshold = 0.9, ScreenRect? region, int maxMatches = 16}) =>
+      Future.value([
+        ScreenMatch.fromMap(
+            {'x': 4, 'y': 8, 'width': 16, 'height': 16, 'score': 0.97}),
+      ]);
+
+  @override
+  Future<List<int?>?> samplePixels(List<ScreenPoint> points) =>
+      Future.value([for (final p in points) p.x < 0 ? null : 0xFF00FF00]);
+
+  @override
+  Future<ScreenStats?> getScreenStats({ScreenRect? region, int? monitor}) =>
+      Future.value(ScreenStats.fromMap({
+        'pixels': 4,
+        'red': List<int>.generate(256, (v) => v == 0 ? 4 : 0),
+        'meanLuminance': 0.0,
+        'luminanceVariance': 0.0,
+        'uniform': true,
+      }));
+
+  @override
+  Future<void> configureThreadPool(
+          {int threads = 0, bool pinThreads = false}) =>
+      Future.value();
+
+  @override
+  Future<ThreadPoolStats?> getThreadPoolStats() => Future.value(
+      const ThreadPoolStats(threads: 3, tasks: 0, steals: 0, queueDepth: 0));
+
+  @override
+  Future<void> setMonitorCaptureMode(MonitorCaptureMode mode) =>
+      Future.value();
+
+  @override
+  Future<MemoryStats?> getMemoryStats({bool resetPeaks = false}) =>
+      Future.value(MemoryStats.fromMap({
+        'current': 0,
+        'peak': 8 << 20,
+        'limit': 16 << 20,
+        'stages': {
+          'grab': {'current': 0, 'peak': 4 << 20},
+          'frame': {'current': 0, 'peak': 4 << 20},
+        },
+        'handles': 0,
+        'degraded': 1,
+        'refused': 0,
+      }));
+
+  @override
+  Future<void> setMemoryLimit(int bytes) => Future.value();
+
+  @override
+  Future<void> startTrace({int eventsPerThread = 16384}) => Future.value();
+
+  @override
+  Future<void> stopTrace() => Future.value();
+
+  @override
+  Future<TraceSummary?> dumpTrace(String path) => Future.value(
+      TraceSummary.fromMap({'events': 120, 'dropped': 0, 'threads': 5}));
+
+  @override
+  Future<Duration?> prepare(
+          {ScreenshotFormat expectedFormat = ScreenshotFormat.png,
+          Size? maxSize}) =>
+      Future.value(const Duration(milliseconds: 42));
+
+  @override
+  Future<List<ScreenWindow>?> listWindows() => Future.value(const [
+        ScreenWindow(0x2a00007, 'Terminal', ScreenRect(10, 20, 800, 600)),
+      ]);
+
+  @override
+  Future<Uint8List?> getWindowScreenshot(int windowId,
+          {ScreenshotFormat format = ScreenshotFormat.png}) =>
+      Future.value(windowId == 0x2a00007 ? Uint8List(4) : null);
+
+  @override
+  Future<BudgetedScreenshot?> getBudgetedScreenshot(
+          {int? maxBytes, int? maxEncodeMs}) =>
+      Future.value(BudgetedScreenshot(
+        bytes: Uint8List(8),
+        format: ScreenshotFormat.jpeg,
+        level: 75,
+        palette: PaletteMode.off,
+        scale: 2,
+        width: 960,
+        height: 540,
+        encodeTime: const Duration(milliseconds: 9),
+        trials: 2,
+        withinBudget: (maxBytes ?? 8) >= 8,
+      ));
+
+  @override
+  Future<HybridScreenshot?> getHybridScreenshot(
+          {int tileSize = 64, int quality = 80}) =>
+      Future.value(HybridScreenshot(
+        bytes: Uint8List(12),
+        width: 1920,
+        height: 1080,
+        tiles: 30 * 17,
+        photoTiles: 40,
+      ));
+
+  @override
+  Future<Uint8List?> decodeHybridImage(Uint8List bytes) =>
+      Future.value(bytes.length == 12 ? Uint8List(8) : null);
+
+  @override
+  Future<bool> copyScreenshotToClipboard() => Future.value(true);
+
+  @override
+  Future<EncodeCacheStats?> getEncodeCacheStats() =>
+      Future.value(const EncodeCacheStats(hits: 0, misses: 0, entries: 0));
+
+  @override
+  Future<void> clearEncodeCache() => Future.value();
+
+  @override
+  Future<bool> attachFrameRing({String name = '/desktop_screenshot'}) =>
+      Future.value(false);
+
+  @override
+  Future<void> detachFrameRing() => Future.value();
+
+  @override
+  Future<int?> startPreview({int fps = 30}) => Future.value(7);
+
+  @override
+  Future<void> stopPreview() => Future.value();
 }
 
 void main() {
@@ -31,4 +222,190 @@ void main() {
 
     expect(await desktopScreenshotPlugin.getPlatformVersion(), '42');
   });
+
+  test('getScreenshotRegions returns one image per region', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final images = await desktopScreenshotPlugin.getScreenshotRegions(
+        const [ScreenRect(0, 0, 10, 10), ScreenRect(20, 0, 5, 5)]);
+    expect(images, hasLength(2));
+  });
+
+  test('getFrame returns unencoded pixels by default', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final frame = await desktopScreenshotPlugin.getFrame();
+    expect(frame!.format, isNull);
+    expect(frame.bytes, hasLength(frame.width * frame.height * 4));
+  });
+
+  test('startPreview returns a texture id', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    expect(await desktopScreenshotPlugin.startPreview(fps: 60), 7);
+    await desktopScreenshotPlugin.stopPreview();
+  });
+
+  test('capturePipeline returns one result per output', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final results = await desktopScreenshotPlugin.capturePipeline(const [
+      PipelineOutput.image(),
+      PipelineOutput.image(format: ScreenshotFormat.jpeg, scale: 0.125),
+      PipelineOutput.fingerprint(scale: 0.125),
+    ]);
+    expect(results, hasLength(3));
+    expect(results![0].bytes, hasLength(3));
+    expect(results[2].bytes, isNull);
+    expect(results[2].fingerprint, 42);
+  });
+
+  test('findOnScreen returns match rectangles and scores', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    MockDesktopScreenshotPlatform fakePlatform = MockDesktopScreenshotPlatform();
+    DesktopScreenshotPlatform.instance = fakePlatform;
+
+    final matches = await desktopScreenshotPlugin.findOnScreen(Uint8List(0));
+    expect(matches, hasLength(1));
+    expect(matches!.first.rect.x, 4);
+    expect(matches.first.rect.height, 16);
+    expect(matches.first.score, closeTo(0.97, 1e-9));
+  });
+
+  test('samplePixels answers one color per point', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final colors = await desktopScreenshotPlugin
+        .samplePixels(const [ScreenPoint(1, 2), ScreenPoint(-5, 0)]);
+    expect(colors, [0xFF00FF00, null]);
+  });
+
+  test('getScreenStats reports a blank screen', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final stats = await desktopScreenshotPlugin.getScreenStats(monitor: 0);
+    expect(stats!.uniform, isTrue);
+    expect(stats.red[0], 4);
+    expect(stats.green, hasLength(256));
+  });
+
+  test('prepare reports the warm-up time', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final took = await desktopScreenshotPlugin.prepare(
+        expectedFormat: ScreenshotFormat.jpeg, maxSize: const Size(1920, 1080));
+    expect(took, const Duration(milliseconds: 42));
+  });
+
+  test('getWindowScreenshot captures a listed window', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final windows = await desktopScreenshotPlugin.listWindows();
+    expect(windows!.single.title, 'Terminal');
+    expect(windows.single.rect.width, 800);
+    final bytes =
+        await desktopScreenshotPlugin.getWindowScreenshot(windows.single.id);
+    expect(bytes, hasLength(4));
+  });
+
+  test('getBudgetedScreenshot reports the chosen settings', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final shot = await desktopScreenshotPlugin.getBudgetedScreenshot(
+        maxBytes: 100000, maxEncodeMs: 30);
+    expect(shot!.format, ScreenshotFormat.jpeg);
+    expect(shot.scale, 2);
+    expect(shot.withinBudget, isTrue);
+  });
+
+  test('getHybridScreenshot reports its tiles and decodes', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final shot = await desktopScreenshotPlugin.getHybridScreenshot();
+    expect(shot!.tiles, 30 * 17);
+    expect(shot.photoTiles, 40);
+    final png = await desktopScreenshotPlugin.decodeHybridImage(shot.bytes);
+    expect(png!.length, 8);
+  });
+
+  test('getMemoryStats reports every stage', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    await desktopScreenshotPlugin.setMemoryLimit(16 << 20);
+    final stats = await desktopScreenshotPlugin.getMemoryStats();
+    expect(stats!.limit, 16 << 20);
+    expect(stats.stages[MemoryStage.grab]!.peak, 4 << 20);
+    expect(stats.stages[MemoryStage.result]!.peak, 0);
+    expect(stats.degraded, 1);
+  });
+
+  test('dumpTrace reports what the trace holds', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    await desktopScreenshotPlugin.startTrace();
+    await desktopScreenshotPlugin.stopTrace();
+    final summary = await desktopScreenshotPlugin.dumpTrace('trace.json');
+    expect(summary!.events, 120);
+    expect(summary.dropped, 0);
+    expect(summary.threads, 5);
+  });
+
+  test('getScreenshotStream ends with the totals', () async {
+    DesktopScreenshot desktopScreenshotPlugin = DesktopScreenshot();
+    DesktopScreenshotPlatform.instance = MockDesktopScreenshotPlatform();
+
+    final events = await desktopScreenshotPlugin.getScreenshotStream().toList();
+    final received = events
+        .whereType<ScreenshotChunk>()
+        .fold<int>(0, (sum, chunk) => sum + chunk.bytes.length);
+    final done = events.last as ScreenshotStreamDone;
+    expect(received, done.totalBytes);
+    expect(done.chunks, 2);
+  });
+
+  test('RawFrame decodes an LZ4 container', () {
+    // 2x2 BGRA frame, no predictor: one literal pixel repeated by a match
+    // of offset 4, then a final literal pixel.
+    final bytes = BytesBuilder()
+      ..add('DSRF'.codeUnits)
+      ..add([1, 0, 0, 1]);
+    final header = ByteData(24)
+      ..setUint32(0, 2, Endian.little)
+      ..setUint32(4, 2, Endian.little)
+      ..setUint32(8, 8, Endian.little)
+      ..setUint32(12, 12, Endian.little)
+      ..setUint64(16, 5000000, Endian.little);
+    bytes
+      ..add(header.buffer.asUint8List())
+      ..add([0x44, 1, 2, 3, 4, 4, 0, 0x40, 1, 2, 3, 4]);
+
+    final frame = RawFrame.decode(bytes.toBytes())!;
+    expect(frame.width, 2);
+    expect(frame.height, 2);
+    expect(frame.pixels, [1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4]);
+    expect(frame.timestamp.microsecondsSinceEpoch, 5000);
+    expect(RawFrame.decode(Uint8List(10)), isNull);
+  });
+
+  test('ScreenshotStreamEvent decodes platform events', () {
+    expect(ScreenshotStreamEvent.fromPlatform(Uint8List(3)),
+        isA<ScreenshotChunk>());
+    final done = ScreenshotStreamEvent.fromPlatform(
+            {'totalBytes': 10, 'chunks': 1, 'encodeMicros': 1500})
+        as ScreenshotStreamDone;
+    expect(done.totalBytes, 10);
+    expect(done.encodeTime, const Duration(microseconds: 1500));
+  });
 }
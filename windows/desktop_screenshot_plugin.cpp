@@ -4,21 +4,106 @@
 #include <windows.h>
 
 #include <VersionHelpers.h>
+#include <flutter/event_channel.h>
+#include <flutter/event_stream_handler_functions.h>
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
 #include <atlimage.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <memory>
 #include <sstream>
 #include <iostream>
 #include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include "capture_pipeline.h"
+#include "chunk_writer.h"
+#include "encode_budget.h"
+#include "encode_cache.h"
+#include "frame.h"
+#include "frame_hash.h"
+#include "frame_message.h"
+#include "hybrid_image.h"
+#include "image_format.h"
+#include "memory_ledger.h"
+#include "palette.h"
+#include "parallel.h"
+#include "pixel_pipeline.h"
+#include "pixel_sample.h"
+#include "raw_frame.h"
+#include "redaction.h"
+#include "scale.h"
+#include "screen_stats.h"
+#include "template_match.h"
+#include "trace.h"
 
 namespace desktop_screenshot {
 
-    HBITMAP CaptureAllMonitors();
+    HBITMAP CaptureAllMonitors(bool parallel);
+    HBITMAP CaptureMonitorsInParallel();
+    static BITMAPINFO TopDownBgraInfo(int width, int height);
     std::vector<BYTE> Hbitmap2PNG(HBITMAP hbitmap);
+    bool HbitmapToFrame(HBITMAP hbitmap, Frame* frame);
+    bool FrameToHbitmap(const Frame& frame, HBITMAP hbitmap);
+    bool ParseRedactions(const flutter::EncodableValue* args, std::vector<Redaction>* out);
+    HBITMAP CaptureRegion(const Rect& rect);
+    bool CaptureDesktopFrame(bool parallel, int maxScale, Frame* frame, MemoryCharge* charge);
+    bool CaptureDesktopArea(const Rect& area, Frame* frame, MemoryCharge* charge);
+    std::vector<BYTE> EncodeFrame(const Frame& frame, ImageFormat format, size_t offset = 0);
+    bool ParseFormat(const flutter::EncodableValue* args, ImageFormat* format);
+    bool ParseRects(const flutter::EncodableValue* args, const char* key, std::vector<Rect>* out);
+    bool ParseInt(const flutter::EncodableValue* args, const char* key, int64_t* value);
+    bool ParsePalette(const flutter::EncodableValue* args, PaletteMode* mode);
+    std::vector<BYTE> EncodeIndexedPNG(const IndexedImage& indexed);
+    bool DecodeImage(const std::vector<uint8_t>& bytes, Frame* frame);
+    bool ParseScreenArea(const flutter::EncodableValue* args, Rect* area);
+    bool WarmUp(ImageFormat format, int width, int height, int* monitors,
+                Frame* frame, MemoryCharge* charge);
+    HBITMAP CaptureWindow(HWND hwnd, MemoryCharge* grab);
+    bool EncodeWithSettings(const Frame& frame, const EncodeSettings& settings,
+                            std::vector<uint8_t>* out);
+    flutter::EncodableList ListWindows();
+    bool ParsePipelineOutputs(const flutter::EncodableValue* args, std::vector<PipelineOutput>* out);
+
+    // Повідомлення, яким потік прогріву повертає результат у платформний потік
+    constexpr UINT kPrepareDoneMessage = WM_APP + 0x51;
+
+    // Обгортка результату, що записує відповідь у трасу як подію "reply".
+    // Ставиться лише під час запису, тож без трасування виклики йдуть напряму
+    class TracedMethodResult : public flutter::MethodResult<flutter::EncodableValue> {
+    public:
+        explicit TracedMethodResult(
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> inner)
+                : inner_(std::move(inner)) {}
+
+    protected:
+        void SuccessInternal(const flutter::EncodableValue* result) override {
+            ScopedTrace trace("reply");
+            inner_->Success(result ? *result : flutter::EncodableValue());
+        }
+
+        void ErrorInternal(const std::string& code, const std::string& message,
+                           const flutter::EncodableValue* details) override {
+            ScopedTrace trace("reply");
+            inner_->Error(code, message, details ? *details : flutter::EncodableValue());
+        }
+
+        void NotImplementedInternal() override {
+            ScopedTrace trace("reply");
+            inner_->NotImplemented();
+        }
+
+    private:
+        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> inner_;
+    };
 
     // ------------------------------------------------------------
     // Реєстрація плагіна
@@ -31,17 +116,66 @@ namespace desktop_screenshot {
                         &flutter::StandardMethodCodec::GetInstance());
 
         auto plugin = std::make_unique<DesktopScreenshotPlugin>();
+        plugin->registrar_ = registrar;
 
         channel->SetMethodCallHandler(
                 [plugin_pointer = plugin.get()](const auto &call, auto result) {
+                    ScopedTrace request(InternTraceName(call.method_name()), "request");
+                    if (TracingEnabled()) {
+                        result = std::make_unique<TracedMethodResult>(std::move(result));
+                    }
                     plugin_pointer->HandleMethodCall(call, std::move(result));
                 });
 
+        // Потокова видача: закодовані байти надходять подіями, поки кодер ще працює
+        plugin->stream_channel_ = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+                registrar->messenger(),
+                        "desktop_screenshot/stream",
+                        &flutter::StandardMethodCodec::GetInstance());
+        plugin->stream_channel_->SetStreamHandler(
+                std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+                        [plugin_pointer = plugin.get()](const flutter::EncodableValue* arguments,
+                                                        std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+                                -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+                            return plugin_pointer->StreamScreenshot(arguments, events.get());
+                        },
+                        [](const flutter::EncodableValue*)
+                                -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+                            // Кодування синхронне, тож зупиняти нічого
+                            return nullptr;
+                        }));
+
+        // Кадри без StandardMethodCodec: заголовок і пікселі в одному буфері
+        registrar->messenger()->SetMessageHandler(
+                "desktop_screenshot/frames",
+                [plugin_pointer = plugin.get()](const uint8_t* message, size_t size,
+                                                flutter::BinaryReply reply) {
+                    plugin_pointer->HandleFrameMessage(message, size, reply);
+                });
+
+        // Результат prepare доставляється через чергу повідомлень вікна Flutter
+        plugin->window_proc_delegate_ = registrar->RegisterTopLevelWindowProcDelegate(
+                [plugin_pointer = plugin.get()](HWND, UINT message, WPARAM, LPARAM)
+                        -> std::optional<LRESULT> {
+                    if (message != kPrepareDoneMessage) return std::nullopt;
+                    plugin_pointer->FinishPrepare();
+                    return 0;
+                });
+
         registrar->AddPlugin(std::move(plugin));
     }
 
-    DesktopScreenshotPlugin::DesktopScreenshotPlugin() {}
-    DesktopScreenshotPlugin::~DesktopScreenshotPlugin() {}
+    DesktopScreenshotPlugin::DesktopScreenshotPlugin()
+            : cache_(&MemoryLedger::Process()), pool_(TaskPool::Retain()) {}
+    DesktopScreenshotPlugin::~DesktopScreenshotPlugin() {
+        if (registrar_ && window_proc_delegate_ >= 0) {
+            registrar_->UnregisterTopLevelWindowProcDelegate(window_proc_delegate_);
+        }
+        if (registrar_) registrar_->messenger()->SetMessageHandler("desktop_screenshot/frames", nullptr);
+        if (prepare_thread_.joinable()) prepare_thread_.join();
+        // Потоки зупиняються, коли плагін звільняє останнє посилання
+        if (pool_) TaskPool::Release();
+    }
 
     // ------------------------------------------------------------
     // Основна логіка
@@ -63,24 +197,890 @@ namespace desktop_screenshot {
             result->Success(flutter::EncodableValue(version_stream.str()));
 
         } else if (method_call.method_name().compare("getScreenshot") == 0) {
-            HBITMAP bitmap = CaptureAllMonitors();
-            if (bitmap) {
-                std::vector<BYTE> pngBuf = Hbitmap2PNG(bitmap);
-                result->Success(flutter::EncodableValue(pngBuf));
-                DeleteObject(bitmap);
+            std::vector<Redaction> redactions;
+            PaletteMode palette = PaletteMode::kOff;
+            if (!ParseRedactions(method_call.arguments(), &redactions) ||
+                !ParsePalette(method_call.arguments(), &palette)) {
+                result->Error("INVALID_ARGUMENTS", "Malformed redaction list or palette mode");
+                return;
+            }
+
+            // Прямокутники маскування задані в пікселях робочого столу, тож кадр
+            // із ними не зменшується
+            Frame frame = TakeWarmFrame();
+            MemoryCharge charge;
+            int maxScale = redactions.empty() ? kMaxCaptureScale : 1;
+            if (!CaptureDesktopFrame(parallel_monitors_, maxScale, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+            // Маски лягають точно лише на кадр у розмір робочого столу; інакше
+            // краще помилка, ніж незамаскований знімок
+            if (!redactions.empty() &&
+                (frame.width != GetSystemMetrics(SM_CXVIRTUALSCREEN) ||
+                 frame.height != GetSystemMetrics(SM_CYVIRTUALSCREEN))) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to apply redactions");
+                return;
+            }
+
+            // Незмінений екран з тими самими параметрами не кодується повторно
+            std::string cacheKey = EncodeParamsKey(ImageFormat::kPng, palette, redactions);
+            uint64_t frameHash = HashFrame(frame);
+            std::vector<BYTE> pngBuf;
+            if (!cache_.Lookup(cacheKey, frameHash, &pngBuf)) {
+                // Маскування виконується над сирими пікселями до кодування в PNG
+                ApplyRedactions(&frame, redactions);
+
+                // Екрани з невеликою кількістю кольорів зберігаються як індексований PNG.
+                // Бітмап звільнено ще до кодування, тож він не співіснує з потоком GDI+
+                IndexedImage indexed;
+                pngBuf = BuildIndexedImage(frame, palette, &indexed)
+                                 ? EncodeIndexedPNG(indexed)
+                                 : EncodeFrame(frame, ImageFormat::kPng);
+                if (pngBuf.empty()) {
+                    result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                    return;
+                }
+                cache_.Store(cacheKey, frameHash, pngBuf);
+            }
+            // Байти переходять у відповідь без ще однієї копії
+            MemoryCharge copied = MemoryLedger::Process().Charge(MemoryStage::kResult, pngBuf.size());
+            result->Success(flutter::EncodableValue(std::move(pngBuf)));
+
+        } else if (method_call.method_name().compare("copyScreenshotToClipboard") == 0) {
+            if (!CopyScreenshotToClipboard()) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to put the capture on the clipboard");
+                return;
+            }
+            result->Success(flutter::EncodableValue(true));
+
+        } else if (method_call.method_name().compare("findOnScreen") == 0) {
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            const std::vector<uint8_t>* image = nullptr;
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("template"));
+                if (it != args->end()) image = std::get_if<std::vector<uint8_t>>(&it->second);
+            }
+            Frame needle;
+            if (!image || !DecodeImage(*image, &needle)) {
+                result->Error("INVALID_ARGUMENTS", "Expected an encoded template image");
+                return;
+            }
+            MemoryCharge needleCharge = MemoryLedger::Process().Charge(MemoryStage::kFrame,
+                                                                       needle.pixels.size());
+            double threshold = 0.9;
+            auto thresholdIt = args->find(flutter::EncodableValue("threshold"));
+            if (thresholdIt != args->end() && std::holds_alternative<double>(thresholdIt->second)) {
+                threshold = std::get<double>(thresholdIt->second);
+            }
+            int64_t maxMatches = 16;
+            ParseInt(method_call.arguments(), "maxMatches", &maxMatches);
+
+            // Захоплюється лише область пошуку; кадр не покидає нативний код
+            Rect region;
+            Frame haystack;
+            MemoryCharge charge;
+            bool captured = false;
+            auto regionIt = args->find(flutter::EncodableValue("region"));
+            const auto* area = regionIt != args->end()
+                    ? std::get_if<flutter::EncodableMap>(&regionIt->second)
+                    : nullptr;
+            if (area) {
+                Rect requested{static_cast<int>(MapGetInt(*area, "x", 0)),
+                               static_cast<int>(MapGetInt(*area, "y", 0)),
+                               static_cast<int>(MapGetInt(*area, "width", 0)),
+                               static_cast<int>(MapGetInt(*area, "height", 0))};
+                region = ClampRect(requested, GetSystemMetrics(SM_CXVIRTUALSCREEN),
+                                   GetSystemMetrics(SM_CYVIRTUALSCREEN));
+                captured = !region.IsEmpty() && CaptureDesktopArea(region, &haystack, &charge);
             } else {
+                captured = CaptureDesktopFrame(parallel_monitors_, 1, &haystack, &charge);
+            }
+            if (!captured) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+
+            flutter::EncodableList matches;
+            for (const TemplateMatch& match : FindTemplate(haystack, needle,
+                                                           static_cast<float>(threshold),
+                                                           static_cast<int>(maxMatches))) {
+                flutter::EncodableMap entry;
+                entry[flutter::EncodableValue("x")] = flutter::EncodableValue(region.x + match.rect.x);
+                entry[flutter::EncodableValue("y")] = flutter::EncodableValue(region.y + match.rect.y);
+                entry[flutter::EncodableValue("width")] = flutter::EncodableValue(match.rect.width);
+                entry[flutter::EncodableValue("height")] = flutter::EncodableValue(match.rect.height);
+                entry[flutter::EncodableValue("score")] =
+                        flutter::EncodableValue(static_cast<double>(match.score));
+                matches.push_back(flutter::EncodableValue(std::move(entry)));
+            }
+            result->Success(flutter::EncodableValue(std::move(matches)));
+
+        } else if (method_call.method_name().compare("samplePixels") == 0) {
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            const std::vector<int32_t>* coords = nullptr;
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("points"));
+                if (it != args->end()) coords = std::get_if<std::vector<int32_t>>(&it->second);
+            }
+            if (!coords || coords->size() % 2 != 0) {
+                result->Error("INVALID_ARGUMENTS", "Expected a flat list of x, y pairs");
+                return;
+            }
+
+            // Точки поза віртуальним екраном повертаються як null
+            const int screenWidth = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+            const int screenHeight = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+            const size_t count = coords->size() / 2;
+            std::vector<Point> visible;
+            std::vector<size_t> visibleIndex;
+            for (size_t i = 0; i < count; ++i) {
+                int x = (*coords)[2 * i];
+                int y = (*coords)[2 * i + 1];
+                if (x < 0 || y < 0 || x >= screenWidth || y >= screenHeight) continue;
+                visible.push_back(Point{x, y});
+                visibleIndex.push_back(i);
+            }
+
+            // Знімаються лише невеликі області навколо точок, а не весь екран
+            flutter::EncodableList colors(count);
+            std::vector<size_t> owner;
+            std::vector<Rect> grabs = PlanPixelGrabs(visible, &owner);
+            for (size_t g = 0; g < grabs.size(); ++g) {
+                Frame area;
+                MemoryCharge charge;
+                if (!CaptureDesktopArea(grabs[g], &area, &charge)) {
+                    result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                    return;
+                }
+                for (size_t j = 0; j < visible.size(); ++j) {
+                    if (owner[j] != g) continue;
+                    uint32_t color = PixelColor(area.pixels.data(), area.stride,
+                                                visible[j].x - grabs[g].x,
+                                                visible[j].y - grabs[g].y);
+                    colors[visibleIndex[j]] = flutter::EncodableValue(static_cast<int64_t>(color));
+                }
+            }
+            result->Success(flutter::EncodableValue(std::move(colors)));
+
+        } else if (method_call.method_name().compare("getScreenStats") == 0) {
+            Rect area;
+            if (!ParseScreenArea(method_call.arguments(), &area)) {
+                result->Error("INVALID_ARGUMENTS", "Unknown monitor");
+                return;
+            }
+            Frame frame;
+            MemoryCharge charge;
+            if (area.IsEmpty() || !CaptureDesktopArea(area, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+
+            // Лише короткий підсумок перетинає канал, а не сам кадр
+            ScreenStats stats = ComputeScreenStats(frame);
+            auto histogram = [](const std::array<uint32_t, 256>& counts) {
+                return flutter::EncodableValue(std::vector<int32_t>(counts.begin(), counts.end()));
+            };
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("pixels")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.pixels));
+            summary[flutter::EncodableValue("red")] = histogram(stats.red);
+            summary[flutter::EncodableValue("green")] = histogram(stats.green);
+            summary[flutter::EncodableValue("blue")] = histogram(stats.blue);
+            summary[flutter::EncodableValue("meanLuminance")] =
+                    flutter::EncodableValue(stats.mean_luminance);
+            summary[flutter::EncodableValue("luminanceVariance")] =
+                    flutter::EncodableValue(stats.luminance_variance);
+            summary[flutter::EncodableValue("uniform")] = flutter::EncodableValue(stats.uniform);
+            result->Success(flutter::EncodableValue(std::move(summary)));
+
+        } else if (method_call.method_name().compare("configureThreadPool") == 0) {
+            int64_t threads = 0;
+            ParseInt(method_call.arguments(), "threads", &threads);
+            bool pin = false;
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("pinThreads"));
+                if (it != args->end() && std::holds_alternative<bool>(it->second)) {
+                    pin = std::get<bool>(it->second);
+                }
+            }
+            if (threads < 0 || threads > 256) {
+                result->Error("INVALID_ARGUMENTS", "Thread count must be between 0 and 256");
+                return;
+            }
+            // Потік прогріву prepare може саме виконувати паралельні етапи;
+            // Configure дочікується їх завершення
+            pool_->Configure(static_cast<int>(threads), pin);
+            result->Success();
+
+        } else if (method_call.method_name().compare("getThreadPoolStats") == 0) {
+            TaskPool::Stats stats = pool_->stats();
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("threads")] = flutter::EncodableValue(stats.threads);
+            summary[flutter::EncodableValue("tasks")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.tasks));
+            summary[flutter::EncodableValue("steals")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.steals));
+            summary[flutter::EncodableValue("queueDepth")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.queue_depth));
+            result->Success(flutter::EncodableValue(std::move(summary)));
+
+        } else if (method_call.method_name().compare("setMonitorCaptureMode") == 0) {
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            const std::string* mode = nullptr;
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("mode"));
+                if (it != args->end()) mode = std::get_if<std::string>(&it->second);
+            }
+            if (!mode || (*mode != "sequential" && *mode != "parallel")) {
+                result->Error("INVALID_ARGUMENTS", "Expected mode \"sequential\" or \"parallel\"");
+                return;
+            }
+            parallel_monitors_ = *mode == "parallel";
+            result->Success();
+
+        } else if (method_call.method_name().compare("getMemoryStats") == 0) {
+            // Буфери захоплень усього процесу, разом і за етапами
+            MemoryLedger& ledger = MemoryLedger::Process();
+            MemoryStats stats = ledger.Stats();
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("current")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.current));
+            summary[flutter::EncodableValue("peak")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.peak));
+            summary[flutter::EncodableValue("limit")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.limit));
+            flutter::EncodableMap stages;
+            for (int i = 0; i < kMemoryStageCount; ++i) {
+                flutter::EncodableMap stage;
+                stage[flutter::EncodableValue("current")] =
+                        flutter::EncodableValue(static_cast<int64_t>(stats.stages[i].current));
+                stage[flutter::EncodableValue("peak")] =
+                        flutter::EncodableValue(static_cast<int64_t>(stats.stages[i].peak));
+                stages[flutter::EncodableValue(std::string(MemoryStageName(static_cast<MemoryStage>(i))))] =
+                        flutter::EncodableValue(std::move(stage));
+            }
+            summary[flutter::EncodableValue("stages")] = flutter::EncodableValue(std::move(stages));
+            summary[flutter::EncodableValue("handles")] =
+                    flutter::EncodableValue(static_cast<int64_t>(frames_.memory_used()));
+            summary[flutter::EncodableValue("degraded")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.degraded));
+            summary[flutter::EncodableValue("refused")] =
+                    flutter::EncodableValue(static_cast<int64_t>(stats.refused));
+
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("resetPeaks"));
+                const bool* reset = it != args->end() ? std::get_if<bool>(&it->second) : nullptr;
+                if (reset && *reset) ledger.ResetPeaks();
+            }
+            result->Success(flutter::EncodableValue(std::move(summary)));
+
+        } else if (method_call.method_name().compare("setMemoryLimit") == 0) {
+            int64_t bytes = 0;
+            if (!ParseInt(method_call.arguments(), "bytes", &bytes) || bytes < 0) {
+                result->Error("INVALID_ARGUMENTS", "Expected a non-negative byte count");
+                return;
+            }
+            MemoryLedger::Process().SetLimit(static_cast<size_t>(bytes));
+            result->Success();
+
+        } else if (method_call.method_name().compare("startTrace") == 0) {
+            int64_t events = kDefaultTraceEventsPerThread;
+            ParseInt(method_call.arguments(), "eventsPerThread", &events);
+            if (events <= 0) {
+                result->Error("INVALID_ARGUMENTS", "Expected a positive event count");
+                return;
+            }
+            StartTracing(static_cast<size_t>(events));
+            result->Success();
+
+        } else if (method_call.method_name().compare("stopTrace") == 0) {
+            StopTracing();
+            result->Success();
+
+        } else if (method_call.method_name().compare("dumpTrace") == 0) {
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            const std::string* path = nullptr;
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("path"));
+                if (it != args->end()) path = std::get_if<std::string>(&it->second);
+            }
+            if (!path) {
+                result->Error("INVALID_ARGUMENTS", "Expected a file path");
+                return;
+            }
+            TraceSummary summary;
+            if (!WriteTrace(*path, &summary)) {
+                result->Error("WRITE_FAILED", "Failed to write the trace file");
+                return;
+            }
+            flutter::EncodableMap written;
+            written[flutter::EncodableValue("events")] =
+                    flutter::EncodableValue(static_cast<int64_t>(summary.events));
+            written[flutter::EncodableValue("dropped")] =
+                    flutter::EncodableValue(static_cast<int64_t>(summary.dropped));
+            written[flutter::EncodableValue("threads")] =
+                    flutter::EncodableValue(static_cast<int64_t>(summary.threads));
+            result->Success(flutter::EncodableValue(std::move(written)));
+
+        } else if (method_call.method_name().compare("prepare") == 0) {
+            Prepare(method_call.arguments(), std::move(result));
+
+        } else if (method_call.method_name().compare("listWindows") == 0) {
+            result->Success(flutter::EncodableValue(ListWindows()));
+
+        } else if (method_call.method_name().compare("getWindowScreenshot") == 0) {
+            int64_t id = 0;
+            ImageFormat format = ImageFormat::kPng;
+            if (!ParseInt(method_call.arguments(), "windowId", &id) || id <= 0 ||
+                !ParseFormat(method_call.arguments(), &format)) {
+                result->Error("INVALID_ARGUMENTS", "Expected a window id and a format");
+                return;
+            }
+            HWND hwnd = reinterpret_cast<HWND>(static_cast<intptr_t>(id));
+            MemoryCharge grab;
+            HBITMAP bitmap = CaptureWindow(hwnd, &grab);
+            Frame frame;
+            bool ok = bitmap && HbitmapToFrame(bitmap, &frame);
+            if (bitmap) DeleteObject(bitmap);
+            grab.Reset();
+            if (!ok) {
+                // Вікно на місці, але не вмістилося в ліміт або не намалювалося
+                if (IsWindow(hwnd) && !IsIconic(hwnd)) {
+                    result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                } else {
+                    result->Error("WINDOW_NOT_FOUND", "Window is gone or not mapped");
+                }
+                return;
+            }
+            MemoryLedger& ledger = MemoryLedger::Process();
+            MemoryCharge charge = ledger.Charge(MemoryStage::kFrame, frame.pixels.size());
+            // Кодується лише саме вікно, а не весь робочий стіл
+            std::vector<BYTE> bytes = EncodeFrame(frame, format);
+            if (bytes.empty()) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+            MemoryCharge encoded = ledger.Charge(MemoryStage::kEncode, bytes.size());
+            result->Success(flutter::EncodableValue(std::move(bytes)));
+
+        } else if (method_call.method_name().compare("getBudgetedScreenshot") == 0) {
+            int64_t maxBytes = 0;
+            int64_t maxEncodeMs = 0;
+            ParseInt(method_call.arguments(), "maxBytes", &maxBytes);
+            ParseInt(method_call.arguments(), "maxEncodeMs", &maxEncodeMs);
+            if (maxBytes < 0 || maxEncodeMs < 0) {
+                result->Error("INVALID_ARGUMENTS", "Budgets must not be negative");
+                return;
+            }
+            EncodeBudget budget;
+            budget.max_bytes = static_cast<size_t>(maxBytes);
+            budget.max_encode_ms = static_cast<double>(maxEncodeMs);
+
+            Frame frame = TakeWarmFrame();
+            MemoryCharge charge;
+            if (!CaptureDesktopFrame(parallel_monitors_, kMaxCaptureScale, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+            // Формат, якість, палітру й масштаб обирає планувальник
+            BudgetResult encoded;
+            if (!budget_.EncodeWithinBudget(frame, budget, EncodeWithSettings, &encoded)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+            const EncodeSettings& settings = encoded.settings;
+            MemoryCharge output = MemoryLedger::Process().Charge(MemoryStage::kResult, encoded.bytes.size());
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("bytes")] =
+                    flutter::EncodableValue(std::move(encoded.bytes));
+            summary[flutter::EncodableValue("format")] =
+                    flutter::EncodableValue(std::string(ImageFormatName(settings.format)));
+            summary[flutter::EncodableValue("level")] = flutter::EncodableValue(settings.level);
+            summary[flutter::EncodableValue("palette")] =
+                    flutter::EncodableValue(std::string(PaletteModeName(settings.palette)));
+            summary[flutter::EncodableValue("scale")] = flutter::EncodableValue(settings.scale);
+            summary[flutter::EncodableValue("width")] = flutter::EncodableValue(encoded.width);
+            summary[flutter::EncodableValue("height")] = flutter::EncodableValue(encoded.height);
+            summary[flutter::EncodableValue("encodeMicros")] =
+                    flutter::EncodableValue(static_cast<int64_t>(encoded.encode_ms * 1000));
+            summary[flutter::EncodableValue("trials")] = flutter::EncodableValue(encoded.trials);
+            summary[flutter::EncodableValue("withinBudget")] =
+                    flutter::EncodableValue(encoded.within_budget);
+            result->Success(flutter::EncodableValue(std::move(summary)));
+
+        } else if (method_call.method_name().compare("getHybridScreenshot") == 0) {
+            HybridOptions options;
+            int64_t tileSize = options.tile_size;
+            int64_t quality = options.quality;
+            ParseInt(method_call.arguments(), "tileSize", &tileSize);
+            ParseInt(method_call.arguments(), "quality", &quality);
+            if (tileSize <= 0 || quality < 1 || quality > 100) {
+                result->Error("INVALID_ARGUMENTS", "Expected a positive tile size and quality 1-100");
+                return;
+            }
+            options.tile_size = static_cast<int>(std::min<int64_t>(tileSize, 256));
+            options.quality = static_cast<int>(quality);
+
+            Frame frame = TakeWarmFrame();
+            MemoryCharge charge;
+            if (!CaptureDesktopFrame(parallel_monitors_, kMaxCaptureScale, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+            // Текст і інтерфейс у PNG, фото й відео в JPEG
+            std::vector<uint8_t> bytes;
+            HybridStats stats;
+            if (!EncodeHybridImage(frame, options, EncodeWithSettings, &bytes, &stats)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+            MemoryCharge output = MemoryLedger::Process().Charge(MemoryStage::kResult, bytes.size());
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("bytes")] = flutter::EncodableValue(std::move(bytes));
+            summary[flutter::EncodableValue("width")] = flutter::EncodableValue(frame.width);
+            summary[flutter::EncodableValue("height")] = flutter::EncodableValue(frame.height);
+            summary[flutter::EncodableValue("tiles")] = flutter::EncodableValue(stats.tiles);
+            summary[flutter::EncodableValue("photoTiles")] = flutter::EncodableValue(stats.photo_tiles);
+            result->Success(flutter::EncodableValue(std::move(summary)));
+
+        } else if (method_call.method_name().compare("decodeHybridImage") == 0) {
+            const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+            const std::vector<uint8_t>* bytes = nullptr;
+            if (args) {
+                auto it = args->find(flutter::EncodableValue("bytes"));
+                if (it != args->end()) bytes = std::get_if<std::vector<uint8_t>>(&it->second);
+            }
+            // Шари декодує GDI+, компонує спільний код
+            ImageDecoder decode = [](const uint8_t* data, size_t size, Frame* layer) {
+                return DecodeImage(std::vector<uint8_t>(data, data + size), layer);
+            };
+            Frame frame;
+            if (!bytes || !DecodeHybridImage(bytes->data(), bytes->size(), decode, &frame)) {
+                result->Error("INVALID_ARGUMENTS", "Expected a hybrid image");
+                return;
+            }
+            std::vector<BYTE> png = EncodeFrame(frame, ImageFormat::kPng);
+            if (png.empty()) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+            result->Success(flutter::EncodableValue(std::move(png)));
+
+        } else if (method_call.method_name().compare("capturePipeline") == 0) {
+            std::vector<PipelineOutput> outputs;
+            if (!ParsePipelineOutputs(method_call.arguments(), &outputs)) {
+                result->Error("INVALID_ARGUMENTS",
+                              "Expected a list of outputs with a format, a scale in (0, 1] and a non-empty region");
+                return;
+            }
+
+            // Одне захоплення на всі виходи
+            Frame frame = TakeWarmFrame();
+            MemoryCharge charge;
+            if (!CaptureDesktopFrame(parallel_monitors_, 1, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+            // Спільні обрізання й масштабування, кодування паралельно
+            std::vector<PipelineResult> produced;
+            FrameEncoder encode = [](const Frame& image, ImageFormat format, std::vector<uint8_t>* out) {
+                *out = EncodeFrame(image, format);
+                return !out->empty();
+            };
+            if (!RunCapturePipeline(frame, outputs, encode, &produced)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+
+            size_t outputBytes = 0;
+            for (const PipelineResult& item : produced) outputBytes += item.bytes.size();
+            MemoryCharge output = MemoryLedger::Process().Charge(MemoryStage::kResult, outputBytes);
+            flutter::EncodableList list;
+            list.reserve(produced.size());
+            for (size_t i = 0; i < produced.size(); ++i) {
+                flutter::EncodableMap entry;
+                entry[flutter::EncodableValue("width")] = flutter::EncodableValue(produced[i].width);
+                entry[flutter::EncodableValue("height")] = flutter::EncodableValue(produced[i].height);
+                if (outputs[i].product == PipelineProduct::kFingerprint) {
+                    // 64 біти передаються як знакове ціле, як у Dart
+                    entry[flutter::EncodableValue("fingerprint")] =
+                            flutter::EncodableValue(static_cast<int64_t>(produced[i].fingerprint));
+                } else {
+                    entry[flutter::EncodableValue("bytes")] =
+                            flutter::EncodableValue(std::move(produced[i].bytes));
+                }
+                list.emplace_back(std::move(entry));
+            }
+            result->Success(flutter::EncodableValue(std::move(list)));
+
+        } else if (method_call.method_name().compare("getEncodeCacheStats") == 0) {
+            flutter::EncodableMap stats;
+            stats[flutter::EncodableValue("hits")] =
+                    flutter::EncodableValue(static_cast<int64_t>(cache_.hits()));
+            stats[flutter::EncodableValue("misses")] =
+                    flutter::EncodableValue(static_cast<int64_t>(cache_.misses()));
+            stats[flutter::EncodableValue("entries")] =
+                    flutter::EncodableValue(static_cast<int64_t>(cache_.size()));
+            result->Success(flutter::EncodableValue(std::move(stats)));
+
+        } else if (method_call.method_name().compare("clearEncodeCache") == 0) {
+            cache_.Clear();
+            result->Success();
+
+        } else if (method_call.method_name().compare("getScreenshotRegions") == 0) {
+            std::vector<Rect> regions;
+            ImageFormat format = ImageFormat::kPng;
+            if (!ParseRects(method_call.arguments(), "regions", &regions) ||
+                !ParseFormat(method_call.arguments(), &format)) {
+                result->Error("INVALID_ARGUMENTS", "Expected a list of regions and a format");
+                return;
+            }
+
+            // Один знімок охоплюючої області замість N окремих захоплень,
+            // спланований у межах ліміту пам'яті
+            Rect bounds = BoundingRect(regions);
+            Frame area;
+            MemoryCharge areaCharge;
+            if (!bounds.IsEmpty() && !CaptureDesktopArea(bounds, &area, &areaCharge)) {
                 result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+
+            // Нарізаємо й кодуємо всі регіони паралельно; невдале кодування
+            // будь-якого регіону — помилка всього виклику. Кожен виріз
+            // враховується, поки кодується, кожен результат — до відповіді
+            MemoryLedger& ledger = MemoryLedger::Process();
+            std::vector<std::vector<BYTE>> encoded(regions.size());
+            std::vector<MemoryCharge> encodedCharges(regions.size());
+            std::atomic<bool> failed(false);
+            ParallelFor(regions.size(), [&](size_t i) {
+                Rect local = regions[i];
+                local.x -= bounds.x;
+                local.y -= bounds.y;
+                Frame slice = CropFrame(area, local);
+                if (slice.IsEmpty()) return;
+                MemoryCharge crop = ledger.Charge(MemoryStage::kFrame, slice.pixels.size());
+                encoded[i] = EncodeFrame(slice, format);
+                if (encoded[i].empty()) failed = true;
+                encodedCharges[i] = ledger.Charge(MemoryStage::kEncode, encoded[i].size());
+            });
+            if (failed) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return;
+            }
+
+            flutter::EncodableList list;
+            list.reserve(encoded.size());
+            for (auto& bytes : encoded) {
+                list.emplace_back(std::move(bytes));
+            }
+            result->Success(flutter::EncodableValue(std::move(list)));
+
+        } else if (method_call.method_name().compare("captureHandle") == 0) {
+            // Лише захоплення й копіювання пікселів; кодування відкладається
+            Frame frame = TakeWarmFrame();
+            MemoryCharge charge;
+            if (!CaptureDesktopFrame(parallel_monitors_, 1, &frame, &charge)) {
+                result->Error("INVALID_IMAGE_DATA", "Failed to capture valid image data");
+                return;
+            }
+            result->Success(flutter::EncodableValue(frames_.Put(std::move(frame))));
+
+        } else if (method_call.method_name().compare("encodeHandle") == 0 ||
+                   method_call.method_name().compare("cropHandle") == 0 ||
+                   method_call.method_name().compare("scaleHandle") == 0) {
+            int64_t id = 0;
+            if (!ParseInt(method_call.arguments(), "id", &id)) {
+                result->Error("INVALID_ARGUMENTS", "Expected a handle id");
+                return;
+            }
+            std::shared_ptr<const Frame> frame = frames_.Get(id);
+            if (!frame) {
+                result->Error("UNKNOWN_HANDLE", "Handle was released or evicted");
+                return;
+            }
+
+            if (method_call.method_name().compare("encodeHandle") == 0) {
+                ImageFormat format = ImageFormat::kPng;
+                if (!ParseFormat(method_call.arguments(), &format)) {
+                    result->Error("INVALID_ARGUMENTS", "Unknown image format");
+                    return;
+                }
+                result->Success(flutter::EncodableValue(EncodeFrame(*frame, format)));
+            } else if (method_call.method_name().compare("cropHandle") == 0) {
+                int64_t x = 0, y = 0, width = 0, height = 0;
+                ParseInt(method_call.arguments(), "x", &x);
+                ParseInt(method_call.arguments(), "y", &y);
+                ParseInt(method_call.arguments(), "width", &width);
+                ParseInt(method_call.arguments(), "height", &height);
+                Frame cropped = CropFrame(*frame, Rect{static_cast<int>(x), static_cast<int>(y),
+                                                       static_cast<int>(width), static_cast<int>(height)});
+                if (cropped.IsEmpty()) {
+                    result->Error("INVALID_ARGUMENTS", "Crop rectangle is outside the capture");
+                    return;
+                }
+                result->Success(flutter::EncodableValue(frames_.Put(std::move(cropped))));
+            } else {
+                int64_t width = 0, height = 0;
+                ParseInt(method_call.arguments(), "width", &width);
+                ParseInt(method_call.arguments(), "height", &height);
+                Frame scaled = ScaleFrame(*frame, static_cast<int>(width), static_cast<int>(height));
+                if (scaled.IsEmpty()) {
+                    result->Error("INVALID_ARGUMENTS", "Scale size must be positive");
+                    return;
+                }
+                result->Success(flutter::EncodableValue(frames_.Put(std::move(scaled))));
             }
 
+        } else if (method_call.method_name().compare("releaseHandle") == 0) {
+            int64_t id = 0;
+            ParseInt(method_call.arguments(), "id", &id);
+            result->Success(flutter::EncodableValue(frames_.Release(id)));
+
+        } else if (method_call.method_name().compare("setHandleMemoryLimit") == 0) {
+            int64_t bytes = 0;
+            if (!ParseInt(method_call.arguments(), "bytes", &bytes) || bytes < 0) {
+                result->Error("INVALID_ARGUMENTS", "Expected a non-negative byte count");
+                return;
+            }
+            frames_.SetMemoryLimit(static_cast<size_t>(bytes));
+            result->Success();
+
         } else {
             result->NotImplemented();
         }
     }
 
+    // ------------------------------------------------------------
+    // 📋 CopyScreenshotToClipboard: знімок у буфер обміну без кодування
+    // ------------------------------------------------------------
+    bool DesktopScreenshotPlugin::CopyScreenshotToClipboard() {
+        // Власник потрібен: з NULL-вікном SetClipboardData не спрацює після EmptyClipboard
+        HWND owner = nullptr;
+        if (registrar_ && registrar_->GetView()) {
+            owner = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+        }
+        if (!owner) return false;
+
+        // CF_BITMAP потрібен на весь робочий стіл, тож знімок, що не
+        // вміщається цілим у ліміт пам'яті, не робиться зовсім
+        MemoryLedger& ledger = MemoryLedger::Process();
+        const int width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+        const int height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        const int grabBpp = parallel_monitors_ ? 8 : 4;
+        CapturePlan plan = PlanCapture(ledger.Available(), width, height, grabBpp, 1);
+        if (!plan.possible || plan.degraded()) {
+            ledger.NoteRefused();
+            return false;
+        }
+        // Бітмап наш, доки ним не заволодіє система
+        MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                          static_cast<size_t>(width) * height * grabBpp);
+        HBITMAP bitmap = CaptureAllMonitors(parallel_monitors_);
+        if (!bitmap) return false;
+
+        if (!OpenClipboard(owner)) {
+            DeleteObject(bitmap);
+            return false;
+        }
+        EmptyClipboard();
+        // Після успішного виклику бітмапом володіє система;
+        // CF_DIB / CF_DIBV5 вона синтезує лише на запит вставки
+        bool ok = SetClipboardData(CF_BITMAP, bitmap) != nullptr;
+        CloseClipboard();
+        if (!ok) DeleteObject(bitmap);
+        return ok;
+    }
+
+    // ------------------------------------------------------------
+    // 🔥 Prepare: разові витрати першого знімка — заздалегідь і у фоні
+    // ------------------------------------------------------------
+    void DesktopScreenshotPlugin::Prepare(
+            const flutter::EncodableValue* arguments,
+            std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+        ImageFormat format = ImageFormat::kPng;
+        int64_t width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+        int64_t height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        ParseInt(arguments, "width", &width);
+        ParseInt(arguments, "height", &height);
+        if (!ParseFormat(arguments, &format) || width <= 0 || height <= 0 ||
+            width > 32768 || height > 32768) {
+            result->Error("INVALID_ARGUMENTS", "Expected a format and a positive size");
+            return;
+        }
+
+        const int w = static_cast<int>(width);
+        const int h = static_cast<int>(height);
+        if (!prepare_results_.empty()) {
+            // Поки прогрів триває, виклик з тими самими параметрами чекає на
+            // його результат, а з іншими — стає в чергу на власний прогрів
+            if (format == prepare_format_ && w == prepare_width_ && h == prepare_height_) {
+                prepare_results_.push_back(std::move(result));
+            } else {
+                prepare_queue_.push_back(QueuedPrepare{format, w, h, std::move(result)});
+            }
+            return;
+        }
+        prepare_results_.push_back(std::move(result));
+        StartPrepare(format, w, h);
+    }
+
+    void DesktopScreenshotPlugin::StartPrepare(ImageFormat format, int width, int height) {
+        prepare_format_ = format;
+        prepare_width_ = width;
+        prepare_height_ = height;
+        HWND window = nullptr;
+        if (registrar_ && registrar_->GetView()) {
+            window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+        }
+        if (prepare_thread_.joinable()) prepare_thread_.join();
+        auto start = std::chrono::steady_clock::now();
+        if (!window) {
+            // Без вікна нікуди надсилати повідомлення — прогріваємо синхронно
+            prepare_ok_ = WarmUp(format, width, height, &prepare_monitors_, &prepare_frame_,
+                                 &prepare_charge_);
+            prepare_micros_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            FinishPrepare();
+            return;
+        }
+        prepare_thread_ = std::thread([this, window, start, format, width, height]() {
+            prepare_ok_ = WarmUp(format, width, height, &prepare_monitors_, &prepare_frame_,
+                                 &prepare_charge_);
+            prepare_micros_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            PostMessage(window, kPrepareDoneMessage, 0, 0);
+        });
+    }
+
+    void DesktopScreenshotPlugin::FinishPrepare() {
+        if (prepare_thread_.joinable()) prepare_thread_.join();
+        auto results = std::move(prepare_results_);
+        prepare_results_.clear();
+        if (!prepare_ok_) {
+            prepare_frame_ = Frame();
+            prepare_charge_.Reset();
+            for (auto& result : results) result->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+        } else {
+            // Прогрітий буфер дістанеться першому знімку
+            warm_frame_ = std::move(prepare_frame_);
+            warm_charge_ = std::move(prepare_charge_);
+            prepare_frame_ = Frame();
+
+            flutter::EncodableMap summary;
+            summary[flutter::EncodableValue("micros")] = flutter::EncodableValue(prepare_micros_);
+            summary[flutter::EncodableValue("monitors")] = flutter::EncodableValue(prepare_monitors_);
+            for (auto& result : results) result->Success(flutter::EncodableValue(summary));
+        }
+
+        // Найстаріший виклик черги отримує свій прогрів разом з усіма, хто
+        // просив те саме
+        if (prepare_queue_.empty()) return;
+        const QueuedPrepare& next = prepare_queue_.front();
+        const ImageFormat format = next.format;
+        const int width = next.width;
+        const int height = next.height;
+        for (auto it = prepare_queue_.begin(); it != prepare_queue_.end();) {
+            if (it->format == format && it->width == width && it->height == height) {
+                prepare_results_.push_back(std::move(it->result));
+                it = prepare_queue_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        StartPrepare(format, width, height);
+    }
+
+    Frame DesktopScreenshotPlugin::TakeWarmFrame() {
+        // Allocate у захопленні лише змінює розмір, тож сторінки буфера
+        // лишаються вже зачепленими
+        Frame frame = std::move(warm_frame_);
+        warm_frame_ = Frame();
+        warm_charge_.Reset();
+        return frame;
+    }
+
+    void DesktopScreenshotPlugin::HandleFrameMessage(const uint8_t* message, size_t size,
+                                                     const flutter::BinaryReply& reply) {
+        ScopedTrace trace("frames", "request");
+        FrameRequest request;
+        if (!message || !ParseFrameRequest(message, size, &request)) {
+            std::vector<uint8_t> error = BuildFrameErrorMessage(FramePayload::kPixels, FrameStatus::kBadRequest);
+            reply(error.data(), error.size());
+            return;
+        }
+
+        Frame frame = TakeWarmFrame();
+        MemoryCharge charge;
+        bool ok = CaptureDesktopFrame(parallel_monitors_, kMaxCaptureScale, &frame, &charge);
+        const uint64_t captured = RawFrameTimestampNow();
+
+        std::vector<uint8_t> out;
+        ImageFormat format = ImageFormat::kPng;
+        if (!ok) {
+            out = BuildFrameErrorMessage(request.payload, FrameStatus::kCaptureFailed);
+        } else if (!FramePayloadFormat(request.payload, &format)) {
+            // Рядки копіюються одразу за заголовок, без проміжних контейнерів
+            out = BuildPixelMessage(frame, captured);
+        } else {
+            // Заголовок ляже перед зображенням, не зсуваючи його
+            out = EncodeFrame(frame, format, kFrameMessageHeaderSize);
+            if (out.empty()) {
+                out = BuildFrameErrorMessage(request.payload, FrameStatus::kEncodeFailed);
+            } else {
+                FrameMessageHeader header;
+                header.payload = request.payload;
+                header.width = static_cast<uint32_t>(frame.width);
+                header.height = static_cast<uint32_t>(frame.height);
+                header.timestamp_ns = captured;
+                WrapEncodedMessage(header, &out);
+            }
+        }
+        // Буфер належить нам до повернення з reply
+        ScopedTrace replied("reply");
+        reply(out.data(), out.size());
+    }
+
+    // Перше захоплення (DWM/GDI), топологія моніторів, GDI+ і кодер потрібного
+    // формату, буфер на весь кадр у |frame| і пул потоків. Рахує монітори в
+    // |monitors|; false, якщо кодер не впорався
+    bool WarmUp(ImageFormat format, int width, int height, int* monitors,
+                Frame* frame, MemoryCharge* charge) {
+        *monitors = 0;
+        EnumDisplayMonitors(
+                NULL,
+                NULL,
+                [](HMONITOR, HDC, LPRECT, LPARAM lParam) -> BOOL {
+                    ++*reinterpret_cast<int*>(lParam);
+                    return TRUE;
+                },
+                reinterpret_cast<LPARAM>(monitors));
+
+        HBITMAP probe = CaptureRegion(Rect{0, 0, 1, 1});
+        if (probe) DeleteObject(probe);
+
+        // Кодування кадру повного розміру вантажить кодек, а сам кадр
+        // лишається з уже зачепленими сторінками для першого знімка
+        frame->Allocate(width, height);
+        *charge = MemoryLedger::Process().Charge(MemoryStage::kFrame, frame->pixels.size());
+        if (EncodeFrame(*frame, format).empty()) return false;
+        ParallelFor(64, [](size_t) {});
+        return true;
+    }
+
     // ------------------------------------------------------------
     // 🖼 CaptureAllMonitors: робить один великий скріншот з усіх моніторів
     // ------------------------------------------------------------
-    HBITMAP CaptureAllMonitors() {
+    HBITMAP CaptureAllMonitors(bool parallel) {
+        ScopedTrace trace("grab");
+        if (parallel) {
+            HBITMAP hbitmap = CaptureMonitorsInParallel();
+            if (hbitmap) return hbitmap;
+        }
+
         HDC hdcScreen = GetDC(NULL);
         if (!hdcScreen) return nullptr;
 
@@ -165,29 +1165,923 @@ namespace desktop_screenshot {
         return hbitmap;
     }
 
+    // ------------------------------------------------------------
+    // 🧵 CaptureMonitorsInParallel: кожен монітор копіюється у своєму потоці
+    // ------------------------------------------------------------
+    // Один bitmap не можна вибрати у кілька DC одночасно, тож кожен потік
+    // робить BitBlt у власну DIB-секцію свого монітора і переносить рядки
+    // у свою, ні з ким не спільну, ділянку спільної DIB-секції.
+    // Повний знімок триває приблизно стільки, скільки найповільніший монітор.
+    HBITMAP CaptureMonitorsInParallel() {
+        std::vector<RECT> monitors;
+        EnumDisplayMonitors(
+                NULL,
+                NULL,
+                [](HMONITOR, HDC, LPRECT lprcMon, LPARAM lParam) -> BOOL {
+                    reinterpret_cast<std::vector<RECT>*>(lParam)->push_back(*lprcMon);
+                    return TRUE;
+                },
+                reinterpret_cast<LPARAM>(&monitors));
+        if (monitors.empty()) return nullptr;
+
+        RECT virtualRect = monitors[0];
+        for (const RECT& m : monitors) {
+            virtualRect.left = std::min(virtualRect.left, m.left);
+            virtualRect.top = std::min(virtualRect.top, m.top);
+            virtualRect.right = std::max(virtualRect.right, m.right);
+            virtualRect.bottom = std::max(virtualRect.bottom, m.bottom);
+        }
+        const int totalWidth = virtualRect.right - virtualRect.left;
+        const int totalHeight = virtualRect.bottom - virtualRect.top;
+
+        // DIB-секцію заповнено нулями, тож проміжки між моніторами чорні
+        BITMAPINFO bmi = TopDownBgraInfo(totalWidth, totalHeight);
+        void* bits = nullptr;
+        HBITMAP target = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+        if (!target) return nullptr;
+
+        std::atomic<bool> failed(false);
+        ParallelFor(monitors.size(), [&](size_t i) {
+            ScopedTrace trace("grab monitor");
+            const RECT& m = monitors[i];
+            const int width = m.right - m.left;
+            const int height = m.bottom - m.top;
+
+            HDC hdcScreen = GetDC(NULL);
+            HDC hdcMemDC = hdcScreen ? CreateCompatibleDC(hdcScreen) : nullptr;
+            BITMAPINFO sliceInfo = TopDownBgraInfo(width, height);
+            void* sliceBits = nullptr;
+            HBITMAP slice = hdcMemDC
+                    ? CreateDIBSection(hdcScreen, &sliceInfo, DIB_RGB_COLORS, &sliceBits, NULL, 0)
+                    : nullptr;
+
+            bool copied = false;
+            if (slice) {
+                HGDIOBJ old = SelectObject(hdcMemDC, slice);
+                copied = BitBlt(hdcMemDC, 0, 0, width, height,
+                                hdcScreen, m.left, m.top, SRCCOPY | CAPTUREBLT) != FALSE;
+                GdiFlush();
+                SelectObject(hdcMemDC, old);
+            }
+            if (copied) {
+                const size_t stride = static_cast<size_t>(totalWidth) * 4;
+                BYTE* dst = static_cast<BYTE*>(bits) +
+                            (m.top - virtualRect.top) * stride +
+                            static_cast<size_t>(m.left - virtualRect.left) * 4;
+                ConvertPixels<BgrxPixels, BgrxPixels>(static_cast<const BYTE*>(sliceBits),
+                                                      static_cast<size_t>(width) * 4,
+                                                      dst, stride, width, height);
+            } else {
+                failed = true;
+            }
+
+            if (slice) DeleteObject(slice);
+            if (hdcMemDC) DeleteDC(hdcMemDC);
+            if (hdcScreen) ReleaseDC(NULL, hdcScreen);
+        });
+
+        if (failed) {
+            DeleteObject(target);
+            return nullptr;
+        }
+        return target;
+    }
+
+    // ------------------------------------------------------------
+    // 🔲 CaptureRegion: знімок лише заданої області віртуального екрана
+    // ------------------------------------------------------------
+    HBITMAP CaptureRegion(const Rect& rect) {
+        ScopedTrace trace("grab");
+        HDC hdcScreen = GetDC(NULL);
+        if (!hdcScreen) return nullptr;
+
+        HDC hdcMemDC = CreateCompatibleDC(hdcScreen);
+        if (!hdcMemDC) {
+            ReleaseDC(NULL, hdcScreen);
+            return nullptr;
+        }
+
+        HBITMAP hbitmap = CreateCompatibleBitmap(hdcScreen, rect.width, rect.height);
+        if (!hbitmap) {
+            DeleteDC(hdcMemDC);
+            ReleaseDC(NULL, hdcScreen);
+            return nullptr;
+        }
+
+        // Координати регіону відраховуються від лівого верхнього кута віртуального екрана,
+        // так само як у CaptureAllMonitors
+        int originX = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        int originY = GetSystemMetrics(SM_YVIRTUALSCREEN);
+
+        HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMemDC, hbitmap);
+        BOOL copied = BitBlt(hdcMemDC, 0, 0, rect.width, rect.height,
+                             hdcScreen, originX + rect.x, originY + rect.y,
+                             SRCCOPY | CAPTUREBLT);
+        SelectObject(hdcMemDC, hOldBitmap);
+        DeleteDC(hdcMemDC);
+        ReleaseDC(NULL, hdcScreen);
+
+        if (!copied) {
+            DeleteObject(hbitmap);
+            return nullptr;
+        }
+        return hbitmap;
+    }
+
+    // ------------------------------------------------------------
+    // 🧮 CaptureDesktopFrame: захоплення в межах ліміту пам'яті
+    // ------------------------------------------------------------
+    // Весь віртуальний екран одним бітмапом, якщо бітмап, кадр і запас на кодування
+    // вміщуються в ліміт; інакше смугами через CaptureRegion, зменшеними не більш
+    // ніж у maxScale разів. charge тримає байти кадру, доки його тримає викликач
+    bool CaptureDesktopFrame(bool parallel, int maxScale, Frame* frame, MemoryCharge* charge) {
+        MemoryLedger& ledger = MemoryLedger::Process();
+        const int width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+        const int height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        // Паралельний режим тримає ще й DIB-секції окремих моніторів
+        const int grabBpp = parallel ? 8 : 4;
+        CapturePlan plan = PlanCapture(ledger.Available(), width, height, grabBpp, maxScale);
+        if (!plan.possible) {
+            ledger.NoteRefused();
+            return false;
+        }
+
+        if (!plan.degraded()) {
+            MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                              static_cast<size_t>(width) * height * grabBpp);
+            HBITMAP bitmap = CaptureAllMonitors(parallel);
+            bool ok = bitmap && HbitmapToFrame(bitmap, frame);
+            if (bitmap) DeleteObject(bitmap);
+            if (!ok) return false;
+            *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+            return true;
+        }
+
+        ledger.NoteDegraded();
+        *charge = ledger.Charge(MemoryStage::kFrame, static_cast<size_t>(plan.width) * plan.height * 4);
+        return CaptureInStripes(plan, width, height, [&ledger](const Rect& rect, Frame* stripe) {
+            // Бітмап смуги і її BGRA-копія
+            MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                              static_cast<size_t>(rect.width) * rect.height * 8);
+            HBITMAP bitmap = CaptureRegion(rect);
+            bool ok = bitmap && HbitmapToFrame(bitmap, stripe);
+            if (bitmap) DeleteObject(bitmap);
+            return ok;
+        }, frame);
+    }
+
+    // Прямокутник робочого столу в межах ліміту пам'яті. Без зменшення:
+    // пікселі кадру лишаються пікселями робочого столу. Що не вміщається
+    // цілим, знімається смугами
+    bool CaptureDesktopArea(const Rect& area, Frame* frame, MemoryCharge* charge) {
+        MemoryLedger& ledger = MemoryLedger::Process();
+        CapturePlan plan = PlanCapture(ledger.Available(), area.width, area.height, 4, 1);
+        if (!plan.possible) {
+            ledger.NoteRefused();
+            return false;
+        }
+
+        if (!plan.degraded()) {
+            MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                              static_cast<size_t>(area.width) * area.height * 4);
+            HBITMAP bitmap = CaptureRegion(area);
+            bool ok = bitmap && HbitmapToFrame(bitmap, frame);
+            if (bitmap) DeleteObject(bitmap);
+            if (!ok) return false;
+            *charge = ledger.Charge(MemoryStage::kFrame, frame->pixels.size());
+            return true;
+        }
+
+        ledger.NoteDegraded();
+        *charge = ledger.Charge(MemoryStage::kFrame, static_cast<size_t>(plan.width) * plan.height * 4);
+        return CaptureInStripes(plan, area.width, area.height, [&ledger, &area](const Rect& rect, Frame* stripe) {
+            MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                              static_cast<size_t>(rect.width) * rect.height * 8);
+            HBITMAP bitmap = CaptureRegion(Rect{area.x + rect.x, area.y + rect.y, rect.width, rect.height});
+            bool ok = bitmap && HbitmapToFrame(bitmap, stripe);
+            if (bitmap) DeleteObject(bitmap);
+            return ok;
+        }, frame);
+    }
+
+    // ------------------------------------------------------------
+    // 🪟 Окремі вікна: список і знімок одного вікна
+    // ------------------------------------------------------------
+    // Видимі вікна верхнього рівня з заголовком, знизу вгору, як на Linux.
+    // Координати — від лівого верхнього кута віртуального екрана
+    flutter::EncodableList ListWindows() {
+        std::vector<HWND> windows;
+        EnumWindows(
+                [](HWND hwnd, LPARAM lParam) -> BOOL {
+                    // Пропускаємо приховані, допоміжні та власні (діалогові) вікна
+                    if (!IsWindowVisible(hwnd) || IsIconic(hwnd) ||
+                        GetWindow(hwnd, GW_OWNER) != NULL ||
+                        (GetWindowLongPtr(hwnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) ||
+                        GetWindowTextLengthW(hwnd) == 0) {
+                        return TRUE;
+                    }
+                    reinterpret_cast<std::vector<HWND>*>(lParam)->push_back(hwnd);
+                    return TRUE;
+                },
+                reinterpret_cast<LPARAM>(&windows));
+        // EnumWindows іде згори вниз
+        std::reverse(windows.begin(), windows.end());
+
+        int originX = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        int originY = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        flutter::EncodableList list;
+        for (HWND hwnd : windows) {
+            RECT rect;
+            if (!GetWindowRect(hwnd, &rect)) continue;
+            std::wstring title(GetWindowTextLengthW(hwnd) + 1, L'\0');
+            title.resize(GetWindowTextW(hwnd, &title[0], static_cast<int>(title.size())));
+            std::string utf8(WideCharToMultiByte(CP_UTF8, 0, title.c_str(),
+                                                 static_cast<int>(title.size()),
+                                                 nullptr, 0, nullptr, nullptr), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, title.c_str(), static_cast<int>(title.size()),
+                                &utf8[0], static_cast<int>(utf8.size()), nullptr, nullptr);
+
+            flutter::EncodableMap entry;
+            entry[flutter::EncodableValue("id")] =
+                    flutter::EncodableValue(static_cast<int64_t>(reinterpret_cast<intptr_t>(hwnd)));
+            entry[flutter::EncodableValue("title")] = flutter::EncodableValue(utf8);
+            entry[flutter::EncodableValue("x")] = flutter::EncodableValue(rect.left - originX);
+            entry[flutter::EncodableValue("y")] = flutter::EncodableValue(rect.top - originY);
+            entry[flutter::EncodableValue("width")] =
+                    flutter::EncodableValue(static_cast<int>(rect.right - rect.left));
+            entry[flutter::EncodableValue("height")] =
+                    flutter::EncodableValue(static_cast<int>(rect.bottom - rect.top));
+            list.push_back(flutter::EncodableValue(std::move(entry)));
+        }
+        return list;
+    }
+
+    // PrintWindow з PW_RENDERFULLCONTENT (Windows 8.1+) бере власну поверхню вікна
+    // у DWM, тож перекриті частини та DirectX-вміст теж потрапляють у знімок.
+    // PrintWindow малює вікно цілим, тож вікно понад ліміт пам'яті не знімається;
+    // grab тримає байти бітмапа, доки його тримає викликач
+    HBITMAP CaptureWindow(HWND hwnd, MemoryCharge* grab) {
+        constexpr UINT kRenderFullContent = 0x00000002;
+        RECT rect;
+        if (!IsWindow(hwnd) || IsIconic(hwnd) || !GetWindowRect(hwnd, &rect)) return nullptr;
+        int width = rect.right - rect.left;
+        int height = rect.bottom - rect.top;
+        if (width <= 0 || height <= 0) return nullptr;
+        MemoryLedger& ledger = MemoryLedger::Process();
+        CapturePlan plan = PlanCapture(ledger.Available(), width, height, 4, 1);
+        if (!plan.possible || plan.degraded()) {
+            ledger.NoteRefused();
+            return nullptr;
+        }
+        *grab = ledger.Charge(MemoryStage::kGrab, static_cast<size_t>(width) * height * 4);
+
+        HDC hdcScreen = GetDC(NULL);
+        if (!hdcScreen) return nullptr;
+        HDC hdcMemDC = CreateCompatibleDC(hdcScreen);
+        HBITMAP hbitmap = hdcMemDC ? CreateCompatibleBitmap(hdcScreen, width, height) : nullptr;
+        if (!hbitmap) {
+            if (hdcMemDC) DeleteDC(hdcMemDC);
+            ReleaseDC(NULL, hdcScreen);
+            return nullptr;
+        }
+
+        HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMemDC, hbitmap);
+        BOOL printed = PrintWindow(hwnd, hdcMemDC, kRenderFullContent);
+        SelectObject(hdcMemDC, hOldBitmap);
+        DeleteDC(hdcMemDC);
+        ReleaseDC(NULL, hdcScreen);
+
+        if (!printed) {
+            DeleteObject(hbitmap);
+            return nullptr;
+        }
+        return hbitmap;
+    }
+
     // ------------------------------------------------------------
     // 🧩 Конвертація HBITMAP → PNG
     // ------------------------------------------------------------
+    static const GUID& EncoderGuid(ImageFormat format) {
+        switch (format) {
+            case ImageFormat::kJpeg: return Gdiplus::ImageFormatJPEG;
+            case ImageFormat::kBmp: return Gdiplus::ImageFormatBMP;
+            default: return Gdiplus::ImageFormatPNG;
+        }
+    }
+
+    // Байти зображення починаються через |offset| від початку буфера
+    static std::vector<BYTE> SaveImage(CImage& image, ImageFormat format, size_t offset = 0) {
+        ScopedTrace trace("encode");
+        std::vector<BYTE> buf;
+        IStream* stream = NULL;
+        if (FAILED(CreateStreamOnHGlobal(0, TRUE, &stream))) return buf;
+
+        ULARGE_INTEGER liSize;
+        if (SUCCEEDED(image.Save(stream, EncoderGuid(format)))) {
+            IStream_Size(stream, &liSize);
+            DWORD len = liSize.LowPart;
+            IStream_Reset(stream);
+            buf.resize(offset + len);
+            IStream_Read(stream, &buf[offset], len);
+        }
+        stream->Release();
+        return buf;
+    }
+
     std::vector<BYTE> Hbitmap2PNG(HBITMAP hbitmap) {
         std::vector<BYTE> buf;
         if (hbitmap != NULL) {
-            IStream* stream = NULL;
-            CreateStreamOnHGlobal(0, TRUE, &stream);
             CImage image;
-            ULARGE_INTEGER liSize;
-
             image.Attach(hbitmap);
-            image.Save(stream, Gdiplus::ImageFormatPNG);
+            buf = SaveImage(image, ImageFormat::kPng);
+            image.Detach();
+        }
+        return buf;
+    }
+
+    // Кодує BGRA-кадр без проміжного HBITMAP: CImage створює top-down DIB,
+    // у який рядки копіюються напряму. Формат raw GDI+ не проходить зовсім
+    std::vector<BYTE> EncodeFrame(const Frame& frame, ImageFormat format, size_t offset) {
+        if (format == ImageFormat::kRaw) {
+            return EncodeRawFrame(frame, RawFrameTimestampNow(), FramePredictor::kLeft, offset);
+        }
+        CImage image;
+        if (!image.Create(frame.width, -frame.height, 32)) return {};
+        ConvertPixels<BgraPixels, BgraPixels>(frame.Row(0), frame.stride,
+                                              static_cast<uint8_t*>(image.GetBits()),
+                                              image.GetPitch(), frame.width, frame.height);
+        return SaveImage(image, format, offset);
+    }
+
+    // Індексований PNG: GDI+ зберігає палітру CImage як PLTE. DIB не підтримує 2 біти
+    // на піксель, тому такі зображення пишуться з 4 бітами
+    std::vector<BYTE> EncodeIndexedPNG(const IndexedImage& indexed) {
+        int bpp = indexed.bit_depth == 2 ? 4 : indexed.bit_depth;
+        CImage image;
+        if (!image.Create(indexed.width, -indexed.height, bpp)) return {};
+
+        std::vector<RGBQUAD> table(indexed.palette.size());
+        for (size_t i = 0; i < table.size(); ++i) {
+            uint32_t color = indexed.palette[i];
+            table[i].rgbRed = static_cast<BYTE>(color >> 16);
+            table[i].rgbGreen = static_cast<BYTE>(color >> 8);
+            table[i].rgbBlue = static_cast<BYTE>(color);
+            table[i].rgbReserved = 0;
+        }
+        image.SetColorTable(0, static_cast<UINT>(table.size()), table.data());
+
+        const int perByte = 8 / bpp;
+        for (int y = 0; y < indexed.height; ++y) {
+            const uint8_t* src = &indexed.indices[static_cast<size_t>(y) * indexed.width];
+            BYTE* dst = static_cast<BYTE*>(image.GetPixelAddress(0, y));
+            if (bpp == 8) {
+                memcpy(dst, src, indexed.width);
+                continue;
+            }
+            for (int x = 0; x < indexed.width; x += perByte) {
+                BYTE packed = 0;
+                for (int i = 0; i < perByte && x + i < indexed.width; ++i) {
+                    packed |= static_cast<BYTE>(src[x + i] << (8 - bpp * (i + 1)));
+                }
+                *dst++ = packed;
+            }
+        }
+        return SaveImage(image, ImageFormat::kPng);
+    }
+
+    // JPEG із заданою якістю. CImage::Save не приймає параметрів кодера,
+    // тож кадр іде в Gdiplus::Bitmap напряму, без копіювання
+    static std::vector<BYTE> EncodeJpegQuality(const Frame& frame, int quality) {
+        // CImage запускає GDI+ лише всередині Save/Load; тут потрібен власний запуск
+        static const bool started = [] {
+            ULONG_PTR token = 0;
+            Gdiplus::GdiplusStartupInput input;
+            return Gdiplus::GdiplusStartup(&token, &input, nullptr) == Gdiplus::Ok;
+        }();
+        if (!started) return {};
+
+        UINT count = 0;
+        UINT size = 0;
+        Gdiplus::GetImageEncodersSize(&count, &size);
+        std::vector<BYTE> codecStorage(size);
+        auto* codecs = reinterpret_cast<Gdiplus::ImageCodecInfo*>(codecStorage.data());
+        if (size == 0 || Gdiplus::GetImageEncoders(count, size, codecs) != Gdiplus::Ok) return {};
+        const CLSID* clsid = nullptr;
+        for (UINT i = 0; i < count; ++i) {
+            if (codecs[i].FormatID == Gdiplus::ImageFormatJPEG) clsid = &codecs[i].Clsid;
+        }
+        if (!clsid) return {};
+
+        Gdiplus::Bitmap bitmap(frame.width, frame.height, frame.stride, PixelFormat32bppRGB,
+                               const_cast<BYTE*>(frame.pixels.data()));
+        ULONG value = static_cast<ULONG>(quality);
+        Gdiplus::EncoderParameters params;
+        params.Count = 1;
+        params.Parameter[0].Guid = Gdiplus::EncoderQuality;
+        params.Parameter[0].Type = Gdiplus::EncoderParameterValueTypeLong;
+        params.Parameter[0].NumberOfValues = 1;
+        params.Parameter[0].Value = &value;
+
+        std::vector<BYTE> buf;
+        IStream* stream = NULL;
+        if (FAILED(CreateStreamOnHGlobal(0, TRUE, &stream))) return buf;
+        ScopedTrace trace("encode");
+        if (bitmap.Save(stream, clsid, &params) == Gdiplus::Ok) {
+            ULARGE_INTEGER liSize;
             IStream_Size(stream, &liSize);
             DWORD len = liSize.LowPart;
             IStream_Reset(stream);
             buf.resize(len);
             IStream_Read(stream, &buf[0], len);
-            stream->Release();
         }
+        stream->Release();
         return buf;
     }
 
+    // Кодер бюджетного режиму. PNG у GDI+ не має рівня стиснення, тож для PNG
+    // рівень ігнорується — різницю в розмірі й часі планувальник вивчає сам
+    bool EncodeWithSettings(const Frame& frame, const EncodeSettings& settings,
+                            std::vector<uint8_t>* out) {
+        if (settings.format == ImageFormat::kJpeg) {
+            *out = EncodeJpegQuality(frame, settings.level);
+            return !out->empty();
+        }
+        IndexedImage indexed;
+        if (settings.palette != PaletteMode::kOff &&
+            BuildIndexedImage(frame, settings.palette, &indexed)) {
+            *out = EncodeIndexedPNG(indexed);
+        } else {
+            *out = EncodeFrame(frame, ImageFormat::kPng);
+        }
+        return !out->empty();
+    }
+
+    // ------------------------------------------------------------
+    // 📡 Потокова видача закодованого знімка
+    // ------------------------------------------------------------
+
+    // IStream у пам'яті, який передає записані байти в ChunkWriter, поки GDI+ ще кодує.
+    // Кодер PNG повертається назад, щоб дописати довжину поточного чанка, тому останні
+    // lag байтів утримуються до наступних записів або до Finish. Відправлені байти
+    // старші за ще одне вікно lag звільняються, тож у пам'яті лишається близько
+    // 2 * lag байтів, а не весь закодований знімок
+    class ChunkStream : public IStream {
+    public:
+        ChunkStream(ChunkWriter* writer, size_t lag) : writer_(writer), lag_(lag) {}
+
+        // Передає залишок. false, якщо кодер переписав уже відправлені байти
+        bool Finish() {
+            Flush(End());
+            writer_->Finish();
+            return !rewound_;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** object) override {
+            if (iid == __uuidof(IUnknown) || iid == __uuidof(ISequentialStream) ||
+                iid == __uuidof(IStream)) {
+                *object = static_cast<IStream*>(this);
+                return S_OK;
+            }
+            *object = NULL;
+            return E_NOINTERFACE;
+        }
+        // Живе на стеку StreamScreenshot, тому лічильник посилань не потрібен
+        ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+        ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+        HRESULT STDMETHODCALLTYPE Read(void* data, ULONG size, ULONG* read) override {
+            // Звільнені байти вже не прочитати
+            if (position_ < base_) return STG_E_READFAULT;
+            size_t count = position_ < End()
+                                   ? (std::min)(static_cast<size_t>(size), End() - position_)
+                                   : 0;
+            if (count) memcpy(data, &buffer_[position_ - base_], count);
+            position_ += count;
+            if (read) *read = static_cast<ULONG>(count);
+            return count == size ? S_OK : S_FALSE;
+        }
+
+        HRESULT STDMETHODCALLTYPE Write(const void* data, ULONG size, ULONG* written) override {
+            if (position_ < emitted_) rewound_ = true;
+            const BYTE* bytes = static_cast<const BYTE*>(data);
+            size_t count = size;
+            // Запис у звільнену частину: ті байти вже відправлені, тож результат
+            // однаково зіпсований (rewound_), лишається лише зберегти позицію
+            if (position_ < base_) {
+                size_t skipped = (std::min)(count, base_ - position_);
+                bytes += skipped;
+                count -= skipped;
+                position_ += skipped;
+            }
+            if (position_ + count > End()) buffer_.resize(position_ + count - base_);
+            if (count) memcpy(&buffer_[position_ - base_], bytes, count);
+            position_ += count;
+            if (written) *written = size;
+            if (End() > emitted_ + lag_) Flush(End() - lag_);
+            Recharge();
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin,
+                                       ULARGE_INTEGER* newPosition) override {
+            int64_t base = 0;
+            if (origin == STREAM_SEEK_CUR) base = static_cast<int64_t>(position_);
+            if (origin == STREAM_SEEK_END) base = static_cast<int64_t>(End());
+            int64_t target = base + move.QuadPart;
+            if (target < 0) return STG_E_INVALIDFUNCTION;
+            position_ = static_cast<size_t>(target);
+            if (newPosition) newPosition->QuadPart = static_cast<ULONGLONG>(target);
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER size) override {
+            const size_t target = static_cast<size_t>(size.QuadPart);
+            if (target < emitted_) rewound_ = true;
+            buffer_.resize(target > base_ ? target - base_ : 0);
+            Recharge();
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Stat(STATSTG* stat, DWORD) override {
+            ZeroMemory(stat, sizeof(*stat));
+            stat->type = STGTY_STREAM;
+            stat->cbSize.QuadPart = End();
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE Revert() override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CopyTo(IStream*, ULARGE_INTEGER, ULARGE_INTEGER*,
+                                         ULARGE_INTEGER*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override {
+            return E_NOTIMPL;
+        }
+        HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override {
+            return E_NOTIMPL;
+        }
+        HRESULT STDMETHODCALLTYPE Clone(IStream**) override { return E_NOTIMPL; }
+
+    private:
+        // Кінець потоку: buffer_ тримає байти з base_ до End()
+        size_t End() const { return base_ + buffer_.size(); }
+
+        // Буфер лічиться за ємністю: erase у Flush її не зменшує
+        void Recharge() {
+            if (charge_.bytes() == buffer_.capacity()) return;
+            charge_ = MemoryLedger::Process().Charge(MemoryStage::kEncode, buffer_.capacity());
+        }
+
+        void Flush(size_t end) {
+            if (end <= emitted_) return;
+            writer_->Write(&buffer_[emitted_ - base_], end - emitted_);
+            emitted_ = end;
+            // Звільняємо відправлене, лишаючи lag байтів позаду; лише коли
+            // набралося ще стільки ж, щоб зсув буфера не повторювався щоразу
+            if (emitted_ - base_ >= 2 * lag_) {
+                size_t drop = emitted_ - lag_ - base_;
+                buffer_.erase(buffer_.begin(), buffer_.begin() + drop);
+                base_ += drop;
+            }
+        }
+
+        ChunkWriter* writer_;
+        size_t lag_;
+        // Байти потоку, починаючи з base_; усе раніше вже відправлено й звільнено
+        std::vector<BYTE> buffer_;
+        size_t base_ = 0;
+        size_t position_ = 0;
+        size_t emitted_ = 0;
+        bool rewound_ = false;
+        MemoryCharge charge_;
+    };
+
+    std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>>
+    DesktopScreenshotPlugin::StreamScreenshot(const flutter::EncodableValue* arguments,
+                                              flutter::EventSink<flutter::EncodableValue>* events) {
+        ImageFormat format = ImageFormat::kPng;
+        if (!ParseFormat(arguments, &format)) {
+            return std::make_unique<flutter::StreamHandlerError<flutter::EncodableValue>>(
+                    "INVALID_ARGUMENTS", "Unknown image format", nullptr);
+        }
+        int64_t chunkSize = ChunkWriter::kDefaultChunkSize;
+        ParseInt(arguments, "chunkSize", &chunkSize);
+        chunkSize = (std::max)(chunkSize, int64_t{1});
+
+        // Кодер GDI+ читає бітмап цілим, тож смугами тут не зняти: якщо бітмап
+        // не вміщається в ліміт, потік відмовляє
+        MemoryLedger& ledger = MemoryLedger::Process();
+        const int width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+        const int height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        const int grabBpp = parallel_monitors_ ? 8 : 4;
+        CapturePlan plan = PlanCapture(ledger.Available(), width, height, grabBpp, 1);
+        if (!plan.possible || plan.degraded()) {
+            ledger.NoteRefused();
+            return std::make_unique<flutter::StreamHandlerError<flutter::EncodableValue>>(
+                    "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr);
+        }
+        MemoryCharge grab = ledger.Charge(MemoryStage::kGrab,
+                                          static_cast<size_t>(width) * height * grabBpp);
+        HBITMAP bitmap = CaptureAllMonitors(parallel_monitors_);
+        if (!bitmap) {
+            return std::make_unique<flutter::StreamHandlerError<flutter::EncodableValue>>(
+                    "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ChunkWriter writer(static_cast<size_t>(chunkSize), [events, &ledger](const uint8_t* data, size_t size) {
+            MemoryCharge copied = ledger.Charge(MemoryStage::kResult, size);
+            events->Success(flutter::EncodableValue(std::vector<uint8_t>(data, data + size)));
+        }, &ledger);
+
+        // Контейнер raw кодується одним проходом і віддається тими самими шматками
+        if (format == ImageFormat::kRaw) {
+            Frame frame;
+            bool captured = HbitmapToFrame(bitmap, &frame);
+            DeleteObject(bitmap);
+            grab.Reset();
+            if (!captured) {
+                return std::make_unique<flutter::StreamHandlerError<flutter::EncodableValue>>(
+                        "INVALID_IMAGE_DATA", "Failed to capture valid image data", nullptr);
+            }
+            MemoryCharge frameCharge = ledger.Charge(MemoryStage::kFrame, frame.pixels.size());
+            std::vector<uint8_t> bytes = EncodeRawFrame(frame, RawFrameTimestampNow());
+            MemoryCharge encoded = ledger.Charge(MemoryStage::kEncode, bytes.size());
+            writer.Write(bytes.data(), bytes.size());
+            writer.Finish();
+        } else {
+            ChunkStream stream(&writer, static_cast<size_t>(chunkSize));
+            CImage image;
+            image.Attach(bitmap);
+            ScopedTrace trace("encode");
+            HRESULT hr = image.Save(&stream, EncoderGuid(format));
+            image.Detach();
+            DeleteObject(bitmap);
+            if (FAILED(hr)) {
+                events->Error("INVALID_IMAGE_DATA", "Failed to encode image");
+                return nullptr;
+            }
+            if (!stream.Finish()) {
+                events->Error("STREAM_REWOUND", "Encoder rewrote bytes that were already sent");
+                return nullptr;
+            }
+        }
+
+        flutter::EncodableMap totals;
+        totals[flutter::EncodableValue("totalBytes")] =
+                flutter::EncodableValue(static_cast<int64_t>(writer.total_bytes()));
+        totals[flutter::EncodableValue("chunks")] = flutter::EncodableValue(writer.chunks());
+        totals[flutter::EncodableValue("encodeMicros")] = flutter::EncodableValue(
+                static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count()));
+        events->Success(flutter::EncodableValue(totals));
+        events->EndOfStream();
+        return nullptr;
+    }
+
+    // ------------------------------------------------------------
+    // 🎨 HBITMAP ↔ Frame: доступ до сирих BGRA-пікселів
+    // ------------------------------------------------------------
+    static BITMAPINFO TopDownBgraInfo(int width, int height) {
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = width;
+        bmi.bmiHeader.biHeight = -height;  // від’ємна висота = рядки зверху вниз
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        return bmi;
+    }
+
+    bool HbitmapToFrame(HBITMAP hbitmap, Frame* frame) {
+        ScopedTrace trace("convert");
+        BITMAP bm = {};
+        if (!GetObject(hbitmap, sizeof(bm), &bm)) return false;
+
+        frame->Allocate(bm.bmWidth, bm.bmHeight);
+        BITMAPINFO bmi = TopDownBgraInfo(bm.bmWidth, bm.bmHeight);
+
+        HDC hdcScreen = GetDC(NULL);
+        int lines = GetDIBits(hdcScreen, hbitmap, 0, bm.bmHeight,
+                              frame->pixels.data(), &bmi, DIB_RGB_COLORS);
+        ReleaseDC(NULL, hdcScreen);
+        return lines == bm.bmHeight;
+    }
+
+    // Декодує PNG (або інший формат, який читає GDI+) у BGRA-кадр
+    bool DecodeImage(const std::vector<uint8_t>& bytes, Frame* frame) {
+        if (bytes.empty()) return false;
+        HGLOBAL memory = GlobalAlloc(GMEM_MOVEABLE, bytes.size());
+        if (!memory) return false;
+        void* data = GlobalLock(memory);
+        if (!data) {
+            GlobalFree(memory);
+            return false;
+        }
+        memcpy(data, bytes.data(), bytes.size());
+        GlobalUnlock(memory);
+
+        IStream* stream = nullptr;
+        if (FAILED(CreateStreamOnHGlobal(memory, TRUE, &stream))) {
+            GlobalFree(memory);
+            return false;
+        }
+        CImage image;
+        bool ok = SUCCEEDED(image.Load(stream)) && HbitmapToFrame(image, frame);
+        stream->Release();
+        return ok;
+    }
+
+    bool FrameToHbitmap(const Frame& frame, HBITMAP hbitmap) {
+        ScopedTrace trace("convert");
+        BITMAPINFO bmi = TopDownBgraInfo(frame.width, frame.height);
+
+        HDC hdcScreen = GetDC(NULL);
+        int lines = SetDIBits(hdcScreen, hbitmap, 0, frame.height,
+                              frame.pixels.data(), &bmi, DIB_RGB_COLORS);
+        ReleaseDC(NULL, hdcScreen);
+        return lines == frame.height;
+    }
+
+    // ------------------------------------------------------------
+    // 📥 Розбір аргументів
+    // ------------------------------------------------------------
+    static int64_t MapGetInt(const flutter::EncodableMap& map, const char* key, int64_t fallback) {
+        auto it = map.find(flutter::EncodableValue(key));
+        if (it == map.end()) return fallback;
+        if (std::holds_alternative<int32_t>(it->second) ||
+            std::holds_alternative<int64_t>(it->second)) {
+            return it->second.LongValue();
+        }
+        return fallback;
+    }
+
+    bool ParseInt(const flutter::EncodableValue* args, const char* key, int64_t* value) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map || map->find(flutter::EncodableValue(key)) == map->end()) return false;
+        *value = MapGetInt(*map, key, *value);
+        return true;
+    }
+
+    bool ParseFormat(const flutter::EncodableValue* args, ImageFormat* format) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return true;
+
+        auto it = map->find(flutter::EncodableValue("format"));
+        if (it == map->end() || it->second.IsNull()) return true;
+        const auto* name = std::get_if<std::string>(&it->second);
+        return name && ParseImageFormat(name->c_str(), format);
+    }
+
+    bool ParsePalette(const flutter::EncodableValue* args, PaletteMode* mode) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return true;
+
+        auto it = map->find(flutter::EncodableValue("palette"));
+        if (it == map->end() || it->second.IsNull()) return true;
+        const auto* name = std::get_if<std::string>(&it->second);
+        return name && ParsePaletteMode(name->c_str(), mode);
+    }
+
+    bool ParseRects(const flutter::EncodableValue* args, const char* key, std::vector<Rect>* out) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return false;
+
+        auto it = map->find(flutter::EncodableValue(key));
+        if (it == map->end()) return false;
+        const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+        if (!list) return false;
+
+        for (const auto& item : *list) {
+            const auto* entry = std::get_if<flutter::EncodableMap>(&item);
+            if (!entry) return false;
+            Rect rect;
+            rect.x = static_cast<int>(MapGetInt(*entry, "x", 0));
+            rect.y = static_cast<int>(MapGetInt(*entry, "y", 0));
+            rect.width = static_cast<int>(MapGetInt(*entry, "width", 0));
+            rect.height = static_cast<int>(MapGetInt(*entry, "height", 0));
+            out->push_back(rect);
+        }
+        return true;
+    }
+
+    // Список "outputs" для capturePipeline: "product", "format", "scale", "region"
+    bool ParsePipelineOutputs(const flutter::EncodableValue* args, std::vector<PipelineOutput>* out) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return false;
+
+        auto it = map->find(flutter::EncodableValue("outputs"));
+        if (it == map->end()) return false;
+        const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+        if (!list) return false;
+
+        for (const auto& item : *list) {
+            const auto* entry = std::get_if<flutter::EncodableMap>(&item);
+            if (!entry) return false;
+            PipelineOutput output;
+            auto productIt = entry->find(flutter::EncodableValue("product"));
+            if (productIt != entry->end()) {
+                const auto* product = std::get_if<std::string>(&productIt->second);
+                if (product && *product == "fingerprint") output.product = PipelineProduct::kFingerprint;
+            }
+            if (!ParseFormat(&item, &output.format)) return false;
+            auto scaleIt = entry->find(flutter::EncodableValue("scale"));
+            if (scaleIt != entry->end() && std::holds_alternative<double>(scaleIt->second)) {
+                output.scale = std::get<double>(scaleIt->second);
+                if (!(output.scale > 0 && output.scale <= 1)) return false;
+            }
+            auto regionIt = entry->find(flutter::EncodableValue("region"));
+            const auto* region = regionIt != entry->end()
+                    ? std::get_if<flutter::EncodableMap>(&regionIt->second)
+                    : nullptr;
+            if (region) {
+                output.region = Rect{static_cast<int>(MapGetInt(*region, "x", 0)),
+                                     static_cast<int>(MapGetInt(*region, "y", 0)),
+                                     static_cast<int>(MapGetInt(*region, "width", 0)),
+                                     static_cast<int>(MapGetInt(*region, "height", 0))};
+                // Порожній регіон конвеєр сприйняв би як увесь екран
+                if (output.region.IsEmpty()) return false;
+            }
+            out->push_back(output);
+        }
+        return true;
+    }
+
+    // Необов'язкові "monitor" (індекс) і "region" → область віртуального екрана.
+    // Якщо задано обидва, регіон відраховується від кута монітора
+    bool ParseScreenArea(const flutter::EncodableValue* args, Rect* area) {
+        *area = Rect{0, 0, GetSystemMetrics(SM_CXVIRTUALSCREEN), GetSystemMetrics(SM_CYVIRTUALSCREEN)};
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return true;
+
+        auto monitorIt = map->find(flutter::EncodableValue("monitor"));
+        if (monitorIt != map->end() && !monitorIt->second.IsNull()) {
+            std::vector<RECT> monitors;
+            EnumDisplayMonitors(
+                    NULL,
+                    NULL,
+                    [](HMONITOR, HDC, LPRECT lprcMon, LPARAM lParam) -> BOOL {
+                        reinterpret_cast<std::vector<RECT>*>(lParam)->push_back(*lprcMon);
+                        return TRUE;
+                    },
+                    reinterpret_cast<LPARAM>(&monitors));
+            int64_t index = MapGetInt(*map, "monitor", -1);
+            if (index < 0 || index >= static_cast<int64_t>(monitors.size())) return false;
+            const RECT& bounds = monitors[static_cast<size_t>(index)];
+            *area = Rect{bounds.left - GetSystemMetrics(SM_XVIRTUALSCREEN),
+                         bounds.top - GetSystemMetrics(SM_YVIRTUALSCREEN),
+                         bounds.right - bounds.left, bounds.bottom - bounds.top};
+        }
+
+        auto regionIt = map->find(flutter::EncodableValue("region"));
+        const auto* region = regionIt != map->end()
+                ? std::get_if<flutter::EncodableMap>(&regionIt->second)
+                : nullptr;
+        if (region) {
+            Rect local{static_cast<int>(MapGetInt(*region, "x", 0)),
+                       static_cast<int>(MapGetInt(*region, "y", 0)),
+                       static_cast<int>(MapGetInt(*region, "width", 0)),
+                       static_cast<int>(MapGetInt(*region, "height", 0))};
+            local = ClampRect(local, area->width, area->height);
+            *area = Rect{area->x + local.x, area->y + local.y, local.width, local.height};
+        }
+        return true;
+    }
+
+    bool ParseRedactions(const flutter::EncodableValue* args, std::vector<Redaction>* out) {
+        const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+        if (!map) return true;
+
+        auto it = map->find(flutter::EncodableValue("redactions"));
+        if (it == map->end() || it->second.IsNull()) return true;
+        const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+        if (!list) return false;
+
+        for (const auto& item : *list) {
+            const auto* entry = std::get_if<flutter::EncodableMap>(&item);
+            if (!entry) return false;
+
+            Redaction redaction;
+            redaction.rect.x = static_cast<int>(MapGetInt(*entry, "x", 0));
+            redaction.rect.y = static_cast<int>(MapGetInt(*entry, "y", 0));
+            redaction.rect.width = static_cast<int>(MapGetInt(*entry, "width", 0));
+            redaction.rect.height = static_cast<int>(MapGetInt(*entry, "height", 0));
+            redaction.color = static_cast<uint32_t>(MapGetInt(*entry, "color", 0xFF000000));
+            // Обмежуємо до звуження, щоб величезне значення не стало малим
+            redaction.strength = static_cast<int>(std::min<int64_t>(
+                    std::max<int64_t>(MapGetInt(*entry, "strength", 8), 1), kMaxRedactionStrength));
+
+            auto mode = entry->find(flutter::EncodableValue("mode"));
+            if (mode != entry->end()) {
+                const auto* name = std::get_if<std::string>(&mode->second);
+                if (!name || !ParseRedactionMode(name->c_str(), &redaction.mode)) {
+                    return false;
+                }
+            }
+            out->push_back(redaction);
+        }
+        return true;
+    }
+
 }  // namespace desktop_screenshot
 //#include "desktop_screenshot_plugin.h"
 //
@@ -1,10 +1,23 @@
 #ifndef FLUTTER_PLUGIN_DESKTOP_SCREENSHOT_PLUGIN_H_
 #define FLUTTER_PLUGIN_DESKTOP_SCREENSHOT_PLUGIN_H_
 
+#include <flutter/binary_messenger.h>
+#include <flutter/event_channel.h>
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <thread>
+#include <vector>
+
+#include "encode_budget.h"
+#include "encode_cache.h"
+#include "frame_store.h"
+#include "image_format.h"
+#include "memory_ledger.h"
+#include "task_pool.h"
 
 namespace desktop_screenshot {
 
@@ -24,6 +37,97 @@ class DesktopScreenshotPlugin : public flutter::Plugin {
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+ private:
+  // Captures the desktop and sends the encoded image to |events| in chunks
+  // while it is being encoded, then a totals map and end-of-stream.
+  std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>>
+  StreamScreenshot(const flutter::EncodableValue* arguments,
+                   flutter::EventSink<flutter::EncodableValue>* events);
+
+  // Puts a fresh capture on the clipboard as CF_BITMAP owned by the Flutter
+  // window; the system derives the DIB formats only when they are pasted.
+  bool CopyScreenshotToClipboard();
+
+  // Starts the prepare warm-up on |prepare_thread_|. A call made while one
+  // runs joins it when it warms the same format and size, and otherwise
+  // queues its own warm-up to start once the running one is done; either
+  // way |result| is answered by FinishPrepare.
+  void Prepare(const flutter::EncodableValue* arguments,
+               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Warms |format| and a |width| x |height| frame for the calls in
+  // |prepare_results_|, on |prepare_thread_| when there is a window to post
+  // back to and synchronously otherwise.
+  void StartPrepare(ImageFormat format, int width, int height);
+
+  // Runs on the platform thread once the warm-up thread posts its message,
+  // then starts the next queued warm-up.
+  void FinishPrepare();
+
+  // The frame buffer prepare warmed, for the first capture after it to
+  // grab into instead of allocating; an empty frame once taken.
+  Frame TakeWarmFrame();
+
+  // Answers a request on "desktop_screenshot/frames" with a header-prefixed
+  // frame (see frame_message.h), passing the message buffer to |reply|
+  // without wrapping it in an EncodableValue.
+  void HandleFrameMessage(const uint8_t* message, size_t size,
+                          const flutter::BinaryReply& reply);
+
+  // Used to find the window that owns clipboard data.
+  flutter::PluginRegistrarWindows* registrar_ = nullptr;
+
+  // "desktop_screenshot/stream", backing getScreenshotStream.
+  std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> stream_channel_;
+
+  // Frames captured by captureHandle, awaiting crop/scale/encode/release.
+  FrameStore frames_;
+
+  // Last getScreenshot outputs, reused while the screen does not change.
+  EncodeCache cache_;
+
+  // Settings picker for getBudgetedScreenshot, learning from each capture.
+  BudgetPlanner budget_;
+
+  // Full-desktop grabs copy every monitor on its own pool thread
+  // ("parallel" monitor capture mode) instead of one after another.
+  bool parallel_monitors_ = false;
+
+  // Worker threads shared by every parallel stage and plugin instance.
+  // Each instance holds one reference; the last destructor joins them.
+  TaskPool* pool_ = nullptr;
+
+  // Warm-up thread of prepare and the calls waiting for it. The thread
+  // writes the results below before posting back, and is joined before
+  // they are read.
+  std::thread prepare_thread_;
+  std::vector<std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>> prepare_results_;
+  ImageFormat prepare_format_ = ImageFormat::kPng;
+  int prepare_width_ = 0;
+  int prepare_height_ = 0;
+  int64_t prepare_micros_ = 0;
+  int prepare_monitors_ = 0;
+  bool prepare_ok_ = false;
+  Frame prepare_frame_;
+  MemoryCharge prepare_charge_;
+
+  // Calls that asked for a different warm-up than the running one, oldest
+  // first.
+  struct QueuedPrepare {
+    ImageFormat format;
+    int width;
+    int height;
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result;
+  };
+  std::deque<QueuedPrepare> prepare_queue_;
+
+  // Moved here from |prepare_frame_| by FinishPrepare; see TakeWarmFrame.
+  Frame warm_frame_;
+  MemoryCharge warm_charge_;
+
+  // Top-level window delegate that receives the warm-up's completion.
+  int window_proc_delegate_ = -1;
 };
 
 }  // namespace desktop_screenshot